@@ -0,0 +1,151 @@
+//------------------------------------------------------------------------------
+//! @brief Rays, frame time and error of adaptive anti-aliasing against uniform
+//!        supersampling of every pixel, on the demo scene with a cloud of
+//!        extra spheres to have plenty of silhouettes.
+//!
+//! Error is RMS difference of color channels (0..255) from a reference frame
+//! with REFERENCE_SIDE x REFERENCE_SIDE uniform samples per pixel.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_antialiasing.cpp
+//! @date 2021-10-30
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "ray_tracer.h"
+#include "demo_scene.h"
+#include "bench_common.h"
+
+static const size_t   WIDTH          = 480;
+static const size_t   HEIGHT         = 320;
+static const size_t   FRAMES_COUNT   = 3;
+static const size_t   REFERENCE_SIDE = 8;
+
+static const size_t   SPHERES_COUNT  = 60;
+static const float    SCENE_DISTANCE = 12;
+static const float    SCENE_DEPTH    = 10;
+static const float    SCENE_SIZE     = 14;
+
+static const Material MATERIAL       = {{0.1f, 0.3f, 0.1f}, {0.7f, 0.9f, 0.7f}, {0.5f, 0.5f, 0.5f}, 20};
+
+struct Variant
+{
+    AntialiasingMode mode;
+    size_t           side;
+};
+
+static const Variant  VARIANTS[]     = {{ANTIALIASING_NONE,     1},
+                                        {ANTIALIASING_ADAPTIVE, 2},
+                                        {ANTIALIASING_ADAPTIVE, 4},
+                                        {ANTIALIASING_UNIFORM,  2},
+                                        {ANTIALIASING_UNIFORM,  4}};
+
+//------------------------------------------------------------------------------
+//! @return Average frame time in milliseconds.
+//------------------------------------------------------------------------------
+double renderFrames(RayTracer& rayTracer)
+{
+    double totalTime = 0;
+
+    for (size_t frame = 0; frame < FRAMES_COUNT; frame++)
+    {
+        rayTracer.zbuffer->reset();
+        rayTracer.renderScene();
+
+        totalTime += rayTracer.lastRenderTime;
+    }
+
+    return totalTime / FRAMES_COUNT;
+}
+
+double getRmsError(const FrameBuffer& frame, const std::vector<Color>& reference)
+{
+    double squaredSum = 0;
+
+    for (size_t y = 0; y < HEIGHT; y++)
+    {
+        for (size_t x = 0; x < WIDTH; x++)
+        {
+            for (int shift = 8; shift < 32; shift += 8)
+            {
+                double difference = (double) ((frame[y][x]               >> shift) & 0xFF) -
+                                    (double) ((reference[y * WIDTH + x] >> shift) & 0xFF);
+
+                squaredSum += difference * difference;
+            }
+        }
+    }
+
+    return sqrt(squaredSum / (WIDTH * HEIGHT * 3));
+}
+
+int main()
+{
+    srand(1);
+
+    DemoScene demo({0.78f, (float) WIDTH / (float) HEIGHT, 1, 600});
+    Scene&    scene = demo.scene;
+
+    std::vector<Sphere> spheres;
+    spheres.reserve(SPHERES_COUNT);
+
+    for (size_t i = 0; i < SPHERES_COUNT; i++)
+    {
+        spheres.emplace_back(&MATERIAL, 1);
+        spheres.back().setPos({getRandom(SCENE_DISTANCE, SCENE_DISTANCE + SCENE_DEPTH),
+                               getRandom(-SCENE_SIZE / 2, SCENE_SIZE / 2),
+                               getRandom(-SCENE_SIZE / 2, SCENE_SIZE / 2)});
+        spheres.back().setScale(getRandom(0.2f, 0.8f));
+
+        scene.addObject(&spheres.back());
+    }
+
+    scene.updateWorldSpaceValues();
+
+    FrameBuffer frame(WIDTH, HEIGHT);
+    ZBuffer     zbuffer(WIDTH, HEIGHT);
+
+    /* Single thread, so that times are comparable */
+    RayTracer rayTracer = {&scene, &frame, &zbuffer, nullptr};
+    rayTracer.useBvh            = true;
+    rayTracer.traceInWorldSpace = true;
+    rayTracer.enableShadows     = true;
+
+    /* ================ Reference ================ */
+    rayTracer.antialiasing     = ANTIALIASING_UNIFORM;
+    rayTracer.antialiasingSide = REFERENCE_SIDE;
+    rayTracer.renderScene();
+
+    std::vector<Color> reference;
+    for (size_t y = 0; y < HEIGHT; y++)
+    {
+        reference.insert(reference.end(), frame[y], frame[y] + WIDTH);
+    }
+
+    /* ================ Variants ================ */
+    printf("%-10s %6s %12s %12s %12s %10s\n", "mode", "side", "frame", "rays/pixel", "resampled", "rms error");
+
+    for (const Variant& variant : VARIANTS)
+    {
+        rayTracer.antialiasing     = variant.mode;
+        rayTracer.antialiasingSide = variant.side;
+
+        double frameTime = renderFrames(rayTracer);
+
+        const AntialiasingStats& stats = rayTracer.lastAntialiasingStats;
+        bool   isAntialiasing = rayTracer.isAntialiasing();
+        double resampled      = isAntialiasing ? 100.0 * stats.resampledPixels / stats.pixels : 0;
+
+        printf("%-10s %6zu %9.2f ms %12.2f %11.1f%% %10.2f\n", getAntialiasingModeName(variant.mode),
+               variant.side, frameTime, isAntialiasing ? stats.getRaysPerPixel() : 1.0f, resampled,
+               getRmsError(frame, reference));
+    }
+
+    return 0;
+}
@@ -0,0 +1,154 @@
+//------------------------------------------------------------------------------
+//! @brief Scene generation shared by the benchmarks: random values and square
+//!        grids of triangles facing the default camera.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_common.h
+//! @date 2021-10-25
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory>
+#include "mesh.h"
+
+//------------------------------------------------------------------------------
+//! @brief Uniformly distributed value from rand(), seeded with srand().
+//------------------------------------------------------------------------------
+inline float getRandom(float min, float max)
+{
+    return min + (max - min) * (float) rand() / (float) RAND_MAX;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Position and normal of a vertex of the grid described in
+//!        @ref createGridMesh().
+//------------------------------------------------------------------------------
+inline void getGridVertex(size_t row, size_t column, size_t cells, float distance, float size, float bump,
+                          Vec3<float>* pos, Vec3<float>* normal)
+{
+    float y = size * ((float) row    / (float) cells - 0.5f);
+    float z = size * ((float) column / (float) cells - 0.5f);
+
+    *pos    = {distance + bump * sinf(y) * cosf(z), y, z};
+    *normal = normalize(Vec3<float>{-1, bump * cosf(y) * cosf(z), -bump * sinf(y) * sinf(z)});
+}
+
+//------------------------------------------------------------------------------
+//! @brief Square grid of 2 * cells^2 triangles with vertex normals, centered on
+//!        the default camera's view axis and facing it.
+//!
+//! @param material
+//! @param cells    Number of grid's cells along each side.
+//! @param distance Distance from the origin along the view axis.
+//! @param size     Side of the grid.
+//! @param bump     Amplitude of the grid's displacement along the view axis,
+//!                 the grid is flat if it's 0.
+//!
+//! @return The grid with (cells + 1)^2 vertices and normals.
+//------------------------------------------------------------------------------
+inline std::unique_ptr<Mesh> createGridMesh(const Material* material, size_t cells, float distance, float size,
+                                            float bump = 0)
+{
+    size_t vertSide = cells + 1;
+    auto   mesh     = std::make_unique<Mesh>(material, 2 * cells * cells, vertSide * vertSide, 0,
+                                             vertSide * vertSide);
+
+    for (size_t row = 0; row < vertSide; row++)
+    {
+        for (size_t column = 0; column < vertSide; column++)
+        {
+            size_t idx = row * vertSide + column;
+            getGridVertex(row, column, cells, distance, size, bump, &mesh->vertices[idx], &mesh->normals[idx]);
+        }
+    }
+
+    size_t faceIdx = 0;
+    for (size_t row = 0; row < cells; row++)
+    {
+        for (size_t column = 0; column < cells; column++)
+        {
+            int32_t v00 = (int32_t) (row * vertSide + column);
+            int32_t v01 = v00 + 1;
+            int32_t v10 = v00 + (int32_t) vertSide;
+            int32_t v11 = v10 + 1;
+
+            mesh->faces[faceIdx++] = {{v00, v10, v11}, {-1, -1, -1}, {v00, v10, v11}};
+            mesh->faces[faceIdx++] = {{v00, v11, v01}, {-1, -1, -1}, {v00, v11, v01}};
+        }
+    }
+
+    return mesh;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Write the grid of @ref createGridMesh() as an OBJ file of cells^2 quad
+//!        faces with "v//vn" corners, without creating the mesh in memory.
+//!
+//! @param fileName
+//! @param cells
+//! @param distance
+//! @param size
+//! @param bump
+//! @param relativeIndices Whether every other face uses negative indices.
+//!
+//! @return Whether the file has been written.
+//------------------------------------------------------------------------------
+inline bool writeGridObj(const char* fileName, size_t cells, float distance, float size, float bump = 0,
+                         bool relativeIndices = false)
+{
+    FILE* file = fopen(fileName, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    size_t vertSide = cells + 1;
+    bool   written  = fprintf(file, "# %zu x %zu grid\no grid\n", cells, cells) >= 0;
+
+    for (size_t row = 0; row < vertSide && written; row++)
+    {
+        for (size_t column = 0; column < vertSide && written; column++)
+        {
+            Vec3<float> pos    = {};
+            Vec3<float> normal = {};
+            getGridVertex(row, column, cells, distance, size, bump, &pos, &normal);
+
+            written = fprintf(file, "v %.6f %.6f %.6f\nvn %.6f %.6f %.6f\n", pos.x, pos.y, pos.z,
+                              normal.x, normal.y, normal.z) >= 0;
+        }
+    }
+
+    long verticesCount = (long) (vertSide * vertSide);
+
+    for (size_t row = 0; row < cells && written; row++)
+    {
+        for (size_t column = 0; column < cells && written; column++)
+        {
+            /* OBJ indices start from 1, negative ones count back from the last vertex */
+            long v00 = (long) (row * vertSide + column) + 1;
+            if (relativeIndices && column % 2 == 1)
+            {
+                v00 -= verticesCount + 1;
+            }
+
+            long v01 = v00 + 1;
+            long v10 = v00 + (long) vertSide;
+            long v11 = v10 + 1;
+
+            written = fprintf(file, "f %ld//%ld %ld//%ld %ld//%ld %ld//%ld\n", v00, v00, v10, v10, v11, v11,
+                              v01, v01) >= 0;
+        }
+    }
+
+    bool closed = fclose(file) == 0;
+    return written && closed;
+}
+
+#endif // BENCH_COMMON_H
@@ -0,0 +1,83 @@
+//------------------------------------------------------------------------------
+//! @brief OBJ loading time and peak memory depending on the number of parsing
+//!        threads, on a generated grid of GRID_CELLS^2 quads, split into two
+//!        triangles each, with vertex normals and half of the faces indexed
+//!        relative to the last vertex.
+//!
+//! Usage: bench_obj_loader.out [FILE], where FILE is an existing OBJ to load
+//! instead of the generated one.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_obj_loader.cpp
+//! @date 2021-11-02
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <thread>
+#include "obj_loader.h"
+#include "bench_common.h"
+
+static const size_t   GRID_CELLS     = 1000;
+static const float    GRID_DISTANCE  = 20;
+static const float    GRID_SIZE      = 30;
+static const char*    GRID_FILE_NAME = "bench_obj_loader_grid.obj";
+static const size_t   RUNS_COUNT     = 3;
+
+static const Material MATERIAL       = {{0.1f, 0.1f, 0.1f}, {0.7f, 0.7f, 0.7f}, {0.5f, 0.5f, 0.5f}, 20};
+
+int main(int argc, char* argv[])
+{
+    const char* fileName = argc > 1 ? argv[1] : GRID_FILE_NAME;
+
+    if (argc <= 1 && !writeGridObj(fileName, GRID_CELLS, GRID_DISTANCE, GRID_SIZE, 0, true))
+    {
+        fprintf(stderr, "Couldn't write '%s'\n", fileName);
+        return -1;
+    }
+
+    size_t coresCount = std::thread::hardware_concurrency();
+    if (coresCount == 0)
+    {
+        coresCount = 1;
+    }
+
+    printf("%8s %12s %12s %12s %12s %12s %14s\n", "threads", "faces", "map", "count", "parse", "total",
+           "peak memory");
+
+    for (size_t threadsCount = 1; threadsCount <= coresCount; threadsCount *= 2)
+    {
+        ObjLoadStats best = {};
+        size_t       faces = 0;
+
+        for (size_t run = 0; run < RUNS_COUNT; run++)
+        {
+            ObjLoadStats          stats = {};
+            std::unique_ptr<Mesh> mesh  = loadObj(fileName, &MATERIAL, threadsCount, &stats);
+
+            if (mesh == nullptr)
+            {
+                fprintf(stderr, "Couldn't load '%s'\n", fileName);
+                return -1;
+            }
+
+            if (run == 0 || stats.totalTime < best.totalTime)
+            {
+                best = stats;
+            }
+
+            faces = mesh->faces.getSize();
+        }
+
+        printf("%8zu %12zu %9.2f ms %9.2f ms %9.2f ms %9.2f ms %10.1f MiB\n", threadsCount, faces, best.mapTime,
+               best.countTime, best.parseTime, best.totalTime, (float) best.peakMemory / (1 << 20));
+    }
+
+    if (argc <= 1)
+    {
+        remove(fileName);
+    }
+
+    return 0;
+}
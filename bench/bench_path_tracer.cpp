@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+//! @brief Path tracing throughput in samples per second depending on the
+//!        number of render threads, on the demo scene.
+//!
+//! Each measured frame is a single accumulated pass of SAMPLES_PER_PIXEL paths
+//! per pixel, speedup is relative to a single thread.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_path_tracer.cpp
+//! @date 2021-11-01
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <thread>
+#include "ray_tracer.h"
+#include "demo_scene.h"
+
+static const size_t WIDTH             = 480;
+static const size_t HEIGHT            = 320;
+static const size_t FRAMES_COUNT      = 3;
+static const size_t SAMPLES_PER_PIXEL = 4;
+
+//------------------------------------------------------------------------------
+//! @return Samples per second averaged over FRAMES_COUNT passes.
+//------------------------------------------------------------------------------
+double measureSamplesPerSecond(RayTracer& rayTracer)
+{
+    uint64_t samples   = 0;
+    double   totalTime = 0;
+
+    for (size_t frame = 0; frame < FRAMES_COUNT; frame++)
+    {
+        /* A pass per frame, each starting anew */
+        rayTracer.restartAccumulation();
+        rayTracer.renderScene();
+
+        samples   += rayTracer.lastPathStats.samples;
+        totalTime += rayTracer.lastRenderTime;
+    }
+
+    // Time is in milliseconds
+    return totalTime > 0 ? 1e3 * (double) samples / totalTime : 0;
+}
+
+int main()
+{
+    DemoScene demo({0.78f, (float) WIDTH / (float) HEIGHT, 1, 600});
+    Scene&    scene = demo.scene;
+
+    scene.updateWorldSpaceValues();
+
+    FrameBuffer        frame(WIDTH, HEIGHT);
+    ZBuffer            zbuffer(WIDTH, HEIGHT);
+    AccumulationBuffer accumulation(WIDTH, HEIGHT);
+
+    size_t coresCount = std::thread::hardware_concurrency();
+    if (coresCount == 0)
+    {
+        coresCount = 1;
+    }
+
+    printf("%8s %16s %10s %18s\n", "threads", "Msamples/s", "speedup", "segments/sample");
+
+    double singleThreaded = 0;
+
+    for (size_t threadsCount = 1; threadsCount <= coresCount; threadsCount *= 2)
+    {
+        TileScheduler scheduler(threadsCount);
+
+        RayTracer rayTracer = {&scene, &frame, &zbuffer, &scheduler};
+        rayTracer.useBvh              = true;
+        rayTracer.traceInWorldSpace   = true;
+        rayTracer.integrator          = INTEGRATOR_PATH_TRACING;
+        rayTracer.accumulation        = &accumulation;
+        rayTracer.pathSamplesPerFrame = SAMPLES_PER_PIXEL;
+
+        /* The first pass after a camera's change is a low resolution one */
+        rayTracer.renderScene();
+
+        double samplesPerSecond = measureSamplesPerSecond(rayTracer);
+        if (threadsCount == 1)
+        {
+            singleThreaded = samplesPerSecond;
+        }
+
+        const PathTracingStats& stats = rayTracer.lastPathStats;
+        printf("%8zu %16.3f %9.2fx %18.2f\n", threadsCount, samplesPerSecond / 1e6,
+               singleThreaded > 0 ? samplesPerSecond / singleThreaded : 0,
+               stats.samples > 0 ? (double) stats.segments / (double) stats.samples : 0);
+    }
+
+    return 0;
+}
@@ -0,0 +1,484 @@
+//------------------------------------------------------------------------------
+//! @brief Per-stage timings of the frame pipeline on fixed, seeded scenes,
+//!        reported as JSON with min, median and p99 of every stage.
+//!
+//! Usage: bench_pipeline.out [--frames N] [--width W] [--height H] [--output FILE]
+//!
+//! Every scene is rendered for a warm-up frame first, which isn't timed.
+//! Stages are run one after another over the whole frame on a single thread,
+//! so that each of them can be timed on its own, in the same order and with
+//! the same functions as RayTracer::renderScene() uses in per-pixel mode with
+//! BVH and world space tracing. The whole renderScene() on all cores is timed
+//! as the last stage for reference.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_pipeline.cpp
+//! @date 2021-10-27
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include "ray_tracer.h"
+#include "demo_scene.h"
+#include "bench_common.h"
+
+static const size_t   DEFAULT_FRAMES_COUNT = 20;
+static const size_t   WARMUP_FRAMES_COUNT  = 1;     ///< Not timed, e.g. BVH is built from scratch there.
+static const size_t   DEFAULT_WIDTH        = 640;
+static const size_t   DEFAULT_HEIGHT       = 400;
+static const uint32_t SCENES_SEED          = 2021;
+
+static const float    FOV                  = 0.78f;
+static const float    NEAR                 = 1;
+static const float    FAR                  = 600;
+
+static const float    CAMERA_YAW_STEP      = 0.01f; ///< Camera turns every frame, so camera space is recomputed.
+static const size_t   MOVED_SPHERES_STRIDE = 100;   ///< Every such sphere moves every frame.
+
+static const float    SCENE_DISTANCE       = 20;
+static const float    SCENE_DEPTH          = 60;
+static const float    SCENE_SIZE           = 60;
+
+static const Material MATERIAL             = {{0.3f, 0.1f, 0.1f}, {0.9f, 0.7f, 0.7f}, {0.5f, 0.5f, 0.5f}, 50};
+
+enum Stage
+{
+    STAGE_UPDATE_WORLD,
+    STAGE_UPDATE_CAMERA,
+    STAGE_ZBUFFER_RESET,
+    STAGE_RAY_GENERATION,
+    STAGE_BVH_UPDATE,
+    STAGE_INTERSECTION,
+    STAGE_SHADOWS,
+    STAGE_SHADING,
+    STAGE_UPLOAD,
+    STAGE_RENDER_SCENE,
+
+    STAGES_COUNT
+};
+
+static const char* STAGE_NAMES[STAGES_COUNT] = {"update_world_space_values", "update_camera_space_values",
+                                                "zbuffer_reset", "ray_generation", "bvh_update",
+                                                "intersection", "shadows", "shading", "upload",
+                                                "render_scene"};
+
+struct BenchScene
+{
+    const char*                name;
+
+    /* Either the interactive app's scene or a generated one */
+    std::unique_ptr<DemoScene> demo;
+    std::unique_ptr<Camera>    generatedCamera;
+    std::unique_ptr<Scene>     generatedScene;
+
+    std::vector<Sphere>        spheres;
+    std::vector<Light>         lights;
+    std::unique_ptr<Mesh>      mesh;
+
+    Scene&  getScene()  { return demo ? demo->scene  : *generatedScene; }
+    Camera& getCamera() { return demo ? demo->camera : *generatedCamera; }
+};
+
+struct Options
+{
+    size_t      framesCount = DEFAULT_FRAMES_COUNT;
+    size_t      width       = DEFAULT_WIDTH;
+    size_t      height      = DEFAULT_HEIGHT;
+    const char* outputFile  = nullptr;
+};
+
+std::unique_ptr<BenchScene> createDemoScene(const ViewFrustum& viewFrustum)
+{
+    auto benchScene  = std::make_unique<BenchScene>();
+    benchScene->name = "two_spheres";
+    benchScene->demo = std::make_unique<DemoScene>(viewFrustum);
+
+    return benchScene;
+}
+
+std::unique_ptr<BenchScene> createScene(const char* name, const ViewFrustum& viewFrustum, size_t spheresCount,
+                                        size_t meshCells, size_t lightsCount)
+{
+    srand(SCENES_SEED);
+
+    auto benchScene             = std::make_unique<BenchScene>();
+    benchScene->name            = name;
+    benchScene->generatedCamera = std::make_unique<Camera>(viewFrustum);
+    benchScene->generatedScene  = std::make_unique<Scene>(*benchScene->generatedCamera);
+
+    Scene& scene = *benchScene->generatedScene;
+    scene.ambientColor = {0.1f, 0.1f, 0.1f};
+
+    benchScene->spheres.reserve(spheresCount);
+    for (size_t i = 0; i < spheresCount; i++)
+    {
+        benchScene->spheres.emplace_back(&MATERIAL, 1);
+
+        Sphere& sphere = benchScene->spheres.back();
+        sphere.setPos({getRandom(SCENE_DISTANCE, SCENE_DISTANCE + SCENE_DEPTH),
+                       getRandom(-SCENE_SIZE / 2, SCENE_SIZE / 2), getRandom(-SCENE_SIZE / 2, SCENE_SIZE / 2)});
+        sphere.setScale(getRandom(0.1f, 1));
+
+        scene.addObject(&sphere);
+    }
+
+    if (meshCells != 0)
+    {
+        benchScene->mesh = createGridMesh(&MATERIAL, meshCells, SCENE_DISTANCE + SCENE_DEPTH, SCENE_SIZE);
+        scene.addMesh(benchScene->mesh.get());
+    }
+
+    benchScene->lights.resize(lightsCount);
+    for (Light& light : benchScene->lights)
+    {
+        light.pos.worldSpace = {getRandom(0, SCENE_DISTANCE), getRandom(-SCENE_SIZE, SCENE_SIZE),
+                                getRandom(-SCENE_SIZE, SCENE_SIZE)};
+        light.brightness     = 1;
+        light.diffuse        = {0.5f, 0.5f, 0.5f};
+        light.specular       = {0.2f, 0.2f, 0.2f};
+
+        scene.lightSources.insert(&light);
+    }
+
+    return benchScene;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Deterministic per-frame changes: the camera turns, every
+//!        MOVED_SPHERES_STRIDE-th sphere moves, demo's lights orbit.
+//------------------------------------------------------------------------------
+void animate(BenchScene& benchScene, size_t frameIdx)
+{
+    Camera& camera = benchScene.getCamera();
+    camera.setYawHorizontal(camera.getYawHorizontal() + CAMERA_YAW_STEP);
+
+    if (benchScene.demo)
+    {
+        benchScene.demo->animate();
+    }
+
+    float offset = 0.1f * sinf((float) frameIdx);
+    for (size_t i = 0; i < benchScene.spheres.size(); i += MOVED_SPHERES_STRIDE)
+    {
+        Sphere& sphere = benchScene.spheres[i];
+        sphere.setPos(sphere.pos.worldSpace + Vec3<float>{0, offset, 0});
+    }
+}
+
+struct StageStats
+{
+    double min;
+    double median;
+    double p99;
+};
+
+StageStats calculateStats(std::vector<double> times)
+{
+    std::sort(times.begin(), times.end());
+
+    size_t count    = times.size();
+    size_t p99Rank  = (size_t) ceil(0.99 * (double) count);
+    double median   = count % 2 != 0 ? times[count / 2] : 0.5 * (times[count / 2 - 1] + times[count / 2]);
+
+    return {times[0], median, times[p99Rank > 0 ? p99Rank - 1 : 0]};
+}
+
+class StageTimer
+{
+public:
+    StageTimer(std::vector<double>* times) : m_Times(times), m_StartTime(std::chrono::steady_clock::now()) {}
+
+    ~StageTimer()
+    {
+        std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - m_StartTime;
+        m_Times->push_back(time.count());
+    }
+
+private:
+    std::vector<double>*                  m_Times;
+    std::chrono::steady_clock::time_point m_StartTime;
+};
+
+//------------------------------------------------------------------------------
+//! @brief Render frames of the scene, timing every stage of each of them.
+//------------------------------------------------------------------------------
+void benchmarkScene(BenchScene& benchScene, const Options& options, std::vector<double> times[STAGES_COUNT])
+{
+    Scene&  scene  = benchScene.getScene();
+    Camera& camera = benchScene.getCamera();
+
+    size_t  pixelsCount = options.width * options.height;
+    size_t  lightsCount = scene.lightSources.getSize();
+
+    FrameBuffer   frame(options.width, options.height);
+    FrameBuffer   uploadTarget(options.width, options.height);
+    ZBuffer       zbuffer(options.width, options.height);
+    NearPlaneGrid nearPlane;
+
+    PrimitiveStore            primitives;
+    Bvh                       bvh;
+    std::vector<PrimitiveRef> changedPrimitives;
+
+    /* Pixels are processed tile by tile, as render threads do */
+    std::vector<Tile>    tiles;
+    std::vector<size_t>  tileFirstRays;
+    std::vector<Ray>     rays(pixelsCount);
+    std::vector<size_t>  rayPixels(pixelsCount);
+    std::vector<Hit>     hits(pixelsCount);
+    std::vector<uint8_t> isHit(pixelsCount);
+    std::vector<uint8_t> lightVisible(pixelsCount * lightsCount);
+
+    for (size_t y0 = 0; y0 < options.height; y0 += TILE_DEFAULT_SIZE)
+    {
+        for (size_t x0 = 0; x0 < options.width; x0 += TILE_DEFAULT_SIZE)
+        {
+            tiles.push_back({x0, y0, std::min(x0 + TILE_DEFAULT_SIZE, options.width),
+                                     std::min(y0 + TILE_DEFAULT_SIZE, options.height)});
+        }
+    }
+
+    TileScheduler scheduler;
+    RayTracer     rayTracer = {&scene, &frame, &zbuffer, &scheduler};
+    rayTracer.useBvh            = true;
+    rayTracer.traceInWorldSpace = true;
+    rayTracer.enableShadows     = true;
+
+    for (size_t frameIdx = 0; frameIdx < WARMUP_FRAMES_COUNT + options.framesCount; frameIdx++)
+    {
+        animate(benchScene, frameIdx);
+
+        {
+            StageTimer timer(&times[STAGE_UPDATE_WORLD]);
+            scene.updateWorldSpaceValues();
+        }
+
+        {
+            StageTimer timer(&times[STAGE_UPDATE_CAMERA]);
+            scene.updateCameraSpaceValues();
+        }
+
+        {
+            StageTimer timer(&times[STAGE_ZBUFFER_RESET]);
+            zbuffer.reset();
+        }
+
+        {
+            StageTimer timer(&times[STAGE_RAY_GENERATION]);
+
+            nearPlane.update(options.width, options.height, camera.getViewFrustum());
+
+            size_t rayIdx = 0;
+            for (const Tile& tile : tiles)
+            {
+                for (size_t y = tile.y0; y < tile.y1; y++)
+                {
+                    for (size_t x = tile.x0; x < tile.x1; x++)
+                    {
+                        rays[rayIdx].from      = camera.getPos().worldSpace;
+                        rays[rayIdx].direction = camera.toWorldDirection(nearPlane.getDirection(x, y));
+                        rayPixels[rayIdx]      = y * options.width + x;
+                        rayIdx++;
+                    }
+                }
+            }
+        }
+
+        {
+            StageTimer timer(&times[STAGE_BVH_UPDATE]);
+
+            if (primitives.isCompiledFor(scene) && bvh.isBuiltFor(primitives))
+            {
+                primitives.update(scene, &changedPrimitives);
+                bvh.refit(changedPrimitives);
+            }
+            else
+            {
+                primitives.compile(scene);
+                bvh.build(primitives);
+            }
+        }
+
+        {
+            StageTimer timer(&times[STAGE_INTERSECTION]);
+
+            for (size_t rayIdx = 0; rayIdx < pixelsCount; rayIdx++)
+            {
+                isHit[rayIdx] = bvh.intersect(rays[rayIdx], &hits[rayIdx]);
+            }
+        }
+
+        {
+            StageTimer  timer(&times[STAGE_SHADOWS]);
+            ShadowCache shadows = {};
+
+            size_t rayIdx = 0;
+            for (const Tile& tile : tiles)
+            {
+                shadows.reset(lightsCount);
+
+                size_t tileEnd = rayIdx + (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+                for (; rayIdx < tileEnd; rayIdx++)
+                {
+                    if (isHit[rayIdx])
+                    {
+                        traceShadows(bvh, primitives, scene, hits[rayIdx], &shadows);
+                        std::copy(shadows.lightVisible.begin(), shadows.lightVisible.end(),
+                                  lightVisible.begin() + rayIdx * lightsCount);
+                    }
+                }
+            }
+        }
+
+        {
+            StageTimer timer(&times[STAGE_SHADING]);
+
+            /* Terms are updated every frame, as renderScene() does before tracing */
+            rayTracer.shading.update(scene);
+
+            for (size_t rayIdx = 0; rayIdx < pixelsCount; rayIdx++)
+            {
+                Color color = COLOR_BLACK;
+
+                if (isHit[rayIdx])
+                {
+                    const Hit& hit = hits[rayIdx];
+
+                    zbuffer.setDepth(rayPixels[rayIdx] % options.width, rayPixels[rayIdx] / options.width,
+                                     hit.rayParameter * nearPlane.near);
+                    color = convertToRgba(rayTracer.shading.shade(hit, SPACE_WORLD,
+                                                                  &lightVisible[rayIdx * lightsCount]));
+                }
+
+                frame[rayPixels[rayIdx] / options.width][rayPixels[rayIdx] % options.width] = color;
+            }
+        }
+
+        {
+            /* Same row by row copy as the interactive app's uploadFrame() */
+            StageTimer timer(&times[STAGE_UPLOAD]);
+
+            for (size_t y = 0; y < options.height; y++)
+            {
+                memcpy(uploadTarget[y], frame[y], options.width * sizeof(Color));
+            }
+        }
+
+        {
+            StageTimer timer(&times[STAGE_RENDER_SCENE]);
+
+            zbuffer.reset();
+            rayTracer.renderScene();
+        }
+    }
+
+    for (size_t stage = 0; stage < STAGES_COUNT; stage++)
+    {
+        times[stage].erase(times[stage].begin(), times[stage].begin() + WARMUP_FRAMES_COUNT);
+    }
+}
+
+bool parseOptions(int argc, char* argv[], Options* options)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--frames") == 0)
+        {
+            options->framesCount = strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--width") == 0)
+        {
+            options->width = strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--height") == 0)
+        {
+            options->height = strtoul(argv[i + 1], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--output") == 0)
+        {
+            options->outputFile = argv[i + 1];
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return argc % 2 == 1 && options->framesCount > 0 && options->width > 0 && options->height > 0;
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, &options))
+    {
+        fprintf(stderr, "Usage: %s [--frames N] [--width W] [--height H] [--output FILE]\n", argv[0]);
+        return -1;
+    }
+
+    FILE* output = options.outputFile != nullptr ? fopen(options.outputFile, "w") : stdout;
+    if (output == nullptr)
+    {
+        fprintf(stderr, "Couldn't open '%s'\n", options.outputFile);
+        return -1;
+    }
+
+    ViewFrustum viewFrustum = {FOV, (float) options.width / (float) options.height, NEAR, FAR};
+
+    std::unique_ptr<BenchScene> scenes[] = {createDemoScene(viewFrustum),
+                                            createScene("spheres_1k",   viewFrustum, 1'000,   0,   2),
+                                            createScene("spheres_100k", viewFrustum, 100'000, 0,   2),
+                                            createScene("mesh_100k",    viewFrustum, 0,       224, 2),
+                                            createScene("lights_32",    viewFrustum, 1'000,   64,  32)};
+
+    fprintf(output, "{\n  \"width\": %zu,\n  \"height\": %zu,\n  \"frames\": %zu,\n  \"scenes\": [\n",
+            options.width, options.height, options.framesCount);
+
+    for (size_t sceneIdx = 0; sceneIdx < sizeof(scenes) / sizeof(scenes[0]); sceneIdx++)
+    {
+        BenchScene& benchScene = *scenes[sceneIdx];
+        Scene&      scene      = benchScene.getScene();
+
+        std::vector<double> times[STAGES_COUNT];
+        benchmarkScene(benchScene, options, times);
+
+        size_t trianglesCount = benchScene.mesh ? benchScene.mesh->faces.getSize() : 0;
+        size_t objectsCount   = 0;
+        for (auto object : scene.objects)
+        {
+            (void) object;
+            objectsCount++;
+        }
+
+        fprintf(output, "    {\n      \"name\": \"%s\",\n      \"objects\": %zu,\n      \"triangles\": %zu,\n"
+                        "      \"lights\": %zu,\n      \"stages\": {\n", benchScene.name, objectsCount,
+                trianglesCount, scene.lightSources.getSize());
+
+        for (size_t stage = 0; stage < STAGES_COUNT; stage++)
+        {
+            StageStats stats = calculateStats(times[stage]);
+
+            fprintf(output, "        \"%s\": {\"min_ms\": %.4f, \"median_ms\": %.4f, \"p99_ms\": %.4f}%s\n",
+                    STAGE_NAMES[stage], stats.min, stats.median, stats.p99, stage + 1 < STAGES_COUNT ? "," : "");
+        }
+
+        fprintf(output, "      }\n    }%s\n", sceneIdx + 1 < sizeof(scenes) / sizeof(scenes[0]) ? "," : "");
+        fflush(output);
+    }
+
+    fprintf(output, "  ]\n}\n");
+
+    if (output != stdout)
+    {
+        fclose(output);
+    }
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+//------------------------------------------------------------------------------
+//! @brief Micro-benchmark of primary ray generation and per-pixel buffer
+//!        writes: column-major traversal with per-pixel frustum divisions 
+//!        (the old renderPrimitive() loop) versus row-major traversal with
+//!        @ref NearPlaneGrid.
+//! 
+//! Usage: bench_primary_rays.out [column|row]
+//! 
+//! Running a single variant is meant for hardware counters, e.g.
+//! perf stat -e cache-misses,cache-references bin/bench_primary_rays.out row
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_primary_rays.cpp
+//! @date 2021-10-20
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "camera.h"
+#include "zbuffer.h"
+
+static const size_t FRAMES_COUNT = 20;
+static const float  FOV          = 0.78f;
+
+struct Resolution
+{
+    const char* name;
+    size_t      width;
+    size_t      height;
+};
+
+static const Resolution RESOLUTIONS[] = {{"1200x800", 1200, 800}, {"4K", 3840, 2160}};
+
+typedef void (*TraversalFunction)(const ViewFrustum& frustum, NearPlaneGrid& grid,
+                                  ZBuffer& zbuffer, uint32_t* pixels);
+
+//------------------------------------------------------------------------------
+//! @brief Stand-in for the shading result, cheap enough not to hide the cost of
+//!        traversal itself.
+//------------------------------------------------------------------------------
+static inline uint32_t fakeColor(const Vec3<float>& direction)
+{
+    return (uint32_t) (direction.x * 255) << 24 | (uint32_t) (direction.y * 255) << 16 | 0xFF;
+}
+
+void traverseColumnMajor(const ViewFrustum& frustum, NearPlaneGrid&, ZBuffer& zbuffer, uint32_t* pixels)
+{
+    size_t width  = zbuffer.width;
+    size_t height = zbuffer.height;
+
+    for (size_t x = 0; x < width; x++)
+    {
+        for (size_t y = 0; y < height; y++)
+        {
+            Vec3<float> direction = toViewFrustumPoint({(float) x, (float) y}, 
+                                                       (float) width, (float) height, 
+                                                       frustum);
+
+            zbuffer.setDepth(x, y, direction.z + direction.x * direction.x);
+            pixels[y * width + x] = fakeColor(direction);
+        }
+    }
+}
+
+void traverseRowMajor(const ViewFrustum& frustum, NearPlaneGrid& grid, ZBuffer& zbuffer, uint32_t* pixels)
+{
+    size_t width  = zbuffer.width;
+    size_t height = zbuffer.height;
+
+    grid.update(width, height, frustum);
+
+    for (size_t y = 0; y < height; y++)
+    {
+        uint32_t* row = pixels + y * width;
+
+        for (size_t x = 0; x < width; x++)
+        {
+            Vec3<float> direction = grid.getDirection(x, y);
+
+            zbuffer.setDepth(x, y, direction.z + direction.x * direction.x);
+            row[x] = fakeColor(direction);
+        }
+    }
+}
+
+double runVariant(const Resolution& resolution, TraversalFunction traverse)
+{
+    ViewFrustum           frustum(FOV, (float) resolution.width / (float) resolution.height, 1, 600);
+    NearPlaneGrid         grid;
+    ZBuffer               zbuffer(resolution.width, resolution.height);
+    std::vector<uint32_t> pixels(resolution.width * resolution.height);
+    std::vector<double>   frameTimes;
+
+    for (size_t frame = 0; frame < FRAMES_COUNT; frame++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        zbuffer.reset();
+        traverse(frustum, grid, zbuffer, pixels.data());
+
+        std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - startTime;
+        frameTimes.push_back(frameTime.count());
+    }
+
+    std::sort(frameTimes.begin(), frameTimes.end());
+    return frameTimes[frameTimes.size() / 2];
+}
+
+int main(int argc, char* argv[])
+{
+    bool runColumn = argc < 2 || strcmp(argv[1], "column") == 0;
+    bool runRow    = argc < 2 || strcmp(argv[1], "row")    == 0;
+
+    printf("%-10s %16s %16s\n", "resolution", "column-major ms", "row-major ms");
+
+    for (const Resolution& resolution : RESOLUTIONS)
+    {
+        double columnTime = runColumn ? runVariant(resolution, traverseColumnMajor) : 0;
+        double rowTime    = runRow    ? runVariant(resolution, traverseRowMajor)    : 0;
+
+        printf("%-10s %16.3f %16.3f\n", resolution.name, columnTime, rowTime);
+    }
+
+    return 0;
+}
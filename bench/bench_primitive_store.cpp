@@ -0,0 +1,182 @@
+//------------------------------------------------------------------------------
+//! @brief Memory per primitive and brute force intersect throughput of scene's
+//!        polymorphic objects versus the compiled @ref PrimitiveStore.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_primitive_store.cpp
+//! @date 2021-10-24
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "primitive_store.h"
+#include "bench_common.h"
+
+static const size_t   PRIMITIVES_COUNTS[] = {1'000, 10'000, 100'000};
+static const size_t   RAYS_SIDE           = 16;
+static const float    SCENE_DISTANCE      = 20;
+static const float    SCENE_DEPTH         = 40;
+static const float    SCENE_SIZE          = 30;
+
+static const Material MATERIALS[] = {{{0.3f, 0.1f, 0.1f}, {0.9f, 0.7f, 0.7f}, {0.5f, 0.5f, 0.5f}, 50},
+                                     {{0.1f, 0.3f, 0.1f}, {0.7f, 0.9f, 0.7f}, {0.5f, 0.5f, 0.5f}, 20}};
+
+//------------------------------------------------------------------------------
+//! @brief Fill the scene with a cloud of spheres and triangles (half of each)
+//!        in front of the default camera.
+//------------------------------------------------------------------------------
+void fillScene(Scene& scene, size_t primitivesCount, std::vector<Sphere>& spheres,
+               std::vector<Triangle>& triangles)
+{
+    srand(1);
+
+    spheres.clear();
+    triangles.clear();
+    spheres.reserve(primitivesCount / 2);
+    triangles.reserve(primitivesCount - primitivesCount / 2);
+
+    for (size_t i = 0; i < primitivesCount; i++)
+    {
+        const Material* material = &MATERIALS[i % 2];
+        Object3d*       object   = nullptr;
+
+        if (i % 2 == 0)
+        {
+            spheres.emplace_back(material, 0.3f);
+            object = &spheres.back();
+        }
+        else
+        {
+            triangles.emplace_back(material);
+            triangles.back().setRotation({getRandom(0, 6.28f), getRandom(0, 6.28f), 0});
+            object = &triangles.back();
+        }
+
+        object->setPos({getRandom(SCENE_DISTANCE, SCENE_DISTANCE + SCENE_DEPTH),
+                        getRandom(-SCENE_SIZE / 2, SCENE_SIZE / 2),
+                        getRandom(-SCENE_SIZE / 2, SCENE_SIZE / 2)});
+        object->setScale(0.5f);
+
+        scene.addObject(object);
+    }
+
+    scene.updateWorldSpaceValues();
+    scene.updateCameraSpaceValues();
+}
+
+void report(const char* name, size_t primitivesCount, float bytesPerPrimitive, size_t hitsCount,
+            std::chrono::steady_clock::time_point startTime)
+{
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - startTime;
+    double tests = (double) primitivesCount * RAYS_SIDE * RAYS_SIDE;
+
+    printf("%-8s %10zu %14.1f %12.1f %8zu\n", name, primitivesCount, bytesPerPrimitive,
+           tests / time.count() / 1e6, hitsCount);
+}
+
+int main()
+{
+    printf("%-8s %10s %14s %12s %8s\n", "storage", "primitives", "bytes/prim", "Mtests/s", "hits");
+
+    for (size_t primitivesCount : PRIMITIVES_COUNTS)
+    {
+        Camera camera(ViewFrustum(0.78f, 1.5f, 1, 600));
+        Scene  scene(camera);
+
+        std::vector<Sphere>   spheres;
+        std::vector<Triangle> triangles;
+        fillScene(scene, primitivesCount, spheres, triangles);
+
+        NearPlaneGrid grid;
+        grid.update(RAYS_SIDE, RAYS_SIDE, camera.getViewFrustum());
+
+        /* ================ Objects ================ */
+        /* Objects plus the pointer kept by the scene's list, not counting
+           list's own links */
+        float objectsBytes = (float) (spheres.size() * sizeof(Sphere) + triangles.size() * sizeof(Triangle)) /
+                             (float) primitivesCount + sizeof(Object3d*);
+
+        size_t hitsCount = 0;
+        auto   startTime = std::chrono::steady_clock::now();
+
+        for (size_t y = 0; y < RAYS_SIDE; y++)
+        {
+            for (size_t x = 0; x < RAYS_SIDE; x++)
+            {
+                Ray ray = {};
+                ray.direction = grid.getDirection(x, y);
+
+                bool found   = false;
+                Hit  closest = {};
+
+                for (auto object : scene.objects)
+                {
+                    Hit hit = {};
+                    if (object->intersect(ray, &hit) && (!found || hit.rayParameter < closest.rayParameter))
+                    {
+                        closest = hit;
+                        found   = true;
+                    }
+                }
+
+                hitsCount += found;
+            }
+        }
+
+        report("objects", primitivesCount, objectsBytes, hitsCount, startTime);
+
+        /* ================ Primitive store ================ */
+        PrimitiveStore store;
+        store.compile(scene);
+
+        float storeBytes = (float) store.getMemoryUsage() / (float) primitivesCount;
+
+        hitsCount = 0;
+        startTime = std::chrono::steady_clock::now();
+
+        for (size_t y = 0; y < RAYS_SIDE; y++)
+        {
+            for (size_t x = 0; x < RAYS_SIDE; x++)
+            {
+                Ray ray = {};
+                ray.from      = camera.getPos().worldSpace;
+                ray.direction = camera.toWorldDirection(grid.getDirection(x, y));
+
+                bool found   = false;
+                Hit  closest = {};
+
+                for (uint32_t sphereIdx = 0; sphereIdx < store.getSpheresCount(); sphereIdx++)
+                {
+                    Hit hit = {};
+                    if (store.intersectSphere(sphereIdx, ray, &hit) &&
+                        (!found || hit.rayParameter < closest.rayParameter))
+                    {
+                        closest = hit;
+                        found   = true;
+                    }
+                }
+
+                for (uint32_t triangleIdx = 0; triangleIdx < store.getTrianglesCount(); triangleIdx++)
+                {
+                    Hit hit = {};
+                    if (store.intersectTriangle(triangleIdx, ray, &hit) &&
+                        (!found || hit.rayParameter < closest.rayParameter))
+                    {
+                        closest = hit;
+                        found   = true;
+                    }
+                }
+
+                hitsCount += found;
+            }
+        }
+
+        report("store", primitivesCount, storeBytes, hitsCount, startTime);
+    }
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+//------------------------------------------------------------------------------
+//! @brief Startup time of a generated wavy wall of GRID_CELLS^2 quads, split
+//!        into two triangles each: loaded from OBJ, compiled and with BVH
+//!        built versus mapped from a scene cache, up to the first frame.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_scene_cache.cpp
+//! @date 2021-11-03
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <chrono>
+#include "ray_tracer.h"
+#include "obj_loader.h"
+#include "scene_cache.h"
+#include "bench_common.h"
+
+static const size_t   WIDTH           = 480;
+static const size_t   HEIGHT          = 320;
+static const size_t   GRID_CELLS      = 500;
+static const float    WALL_DISTANCE   = 20;
+static const float    WALL_SIZE       = 30;
+static const float    WALL_BUMP       = 1;   ///< So that BVH isn't trivial.
+static const char*    OBJ_FILE_NAME   = "bench_scene_cache_wall.obj";
+static const char*    CACHE_FILE_NAME = "bench_scene_cache_wall.rtsc";
+
+static const Material MATERIAL        = {{0.1f, 0.1f, 0.1f}, {0.7f, 0.7f, 0.7f}, {0.5f, 0.5f, 0.5f}, 20};
+
+struct StartupTimes
+{
+    float load;       ///< Milliseconds spent loading the OBJ or mapping the cache.
+    float build;      ///< Milliseconds spent building BVH.
+    float firstFrame; ///< Milliseconds spent in the rest of the first frame, compiling primitives included.
+};
+
+//------------------------------------------------------------------------------
+//! @brief Render a frame of the scene, either compiled from its mesh or
+//!        already mapped from a cache.
+//------------------------------------------------------------------------------
+void renderFirstFrame(Scene& scene, RayTracer& rayTracer, StartupTimes* times)
+{
+    scene.updateWorldSpaceValues();
+    scene.invalidateCameraSpaceValues();
+    rayTracer.renderScene();
+
+    /* Compiling and building happen inside renderScene() */
+    times->build      = rayTracer.primitives.isMapped() ? 0 : rayTracer.bvh.getBuildTime();
+    times->firstFrame = rayTracer.lastRenderTime - times->build;
+}
+
+int main()
+{
+    if (!writeGridObj(OBJ_FILE_NAME, GRID_CELLS, WALL_DISTANCE, WALL_SIZE, WALL_BUMP))
+    {
+        fprintf(stderr, "Couldn't write '%s'\n", OBJ_FILE_NAME);
+        return -1;
+    }
+
+    ViewFrustum   frustum(0.78f, (float) WIDTH / (float) HEIGHT, 1, 600);
+    FrameBuffer   frame(WIDTH, HEIGHT);
+    ZBuffer       zbuffer(WIDTH, HEIGHT);
+    TileScheduler scheduler(0);
+
+    StartupTimes  objTimes   = {};
+    StartupTimes  cacheTimes = {};
+    size_t        cacheSize  = 0;
+
+    /* ================ From OBJ ================ */
+    {
+        Camera camera(frustum);
+        Scene  scene(camera);
+        Light  light = {};
+
+        light.pos.worldSpace = {0, 50, 0};
+        light.brightness     = 1;
+        light.diffuse        = {1, 1, 1};
+        light.specular       = {1, 1, 1};
+        scene.lightSources.insert(&light);
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        std::unique_ptr<Mesh> mesh = loadObj(OBJ_FILE_NAME, &MATERIAL);
+        if (mesh == nullptr)
+        {
+            fprintf(stderr, "Couldn't load '%s'\n", OBJ_FILE_NAME);
+            return -1;
+        }
+
+        std::chrono::duration<float, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+        objTimes.load = loadTime.count();
+
+        scene.addMesh(mesh.get());
+
+        RayTracer rayTracer = {&scene, &frame, &zbuffer, &scheduler};
+        rayTracer.useBvh            = true;
+        rayTracer.traceInWorldSpace = true;
+        rayTracer.enableShadows     = true;
+
+        renderFirstFrame(scene, rayTracer, &objTimes);
+
+        if (!writeSceneCache(CACHE_FILE_NAME, scene, rayTracer.primitives, rayTracer.bvh))
+        {
+            fprintf(stderr, "Couldn't write '%s'\n", CACHE_FILE_NAME);
+            return -1;
+        }
+    }
+
+    /* ================ From cache ================ */
+    {
+        Camera     camera(frustum);
+        Scene      scene(camera);
+        SceneCache cache;
+
+        RayTracer rayTracer = {&scene, &frame, &zbuffer, &scheduler};
+        rayTracer.useBvh            = true;
+        rayTracer.traceInWorldSpace = true;
+        rayTracer.enableShadows     = true;
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        if (!cache.load(CACHE_FILE_NAME, &scene, &rayTracer.primitives, &rayTracer.bvh))
+        {
+            fprintf(stderr, "Couldn't load '%s'\n", CACHE_FILE_NAME);
+            return -1;
+        }
+
+        std::chrono::duration<float, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+        cacheTimes.load = loadTime.count();
+        cacheSize       = cache.getFileSize();
+
+        renderFirstFrame(scene, rayTracer, &cacheTimes);
+    }
+
+    printf("%zu triangles, cache %.1f MiB\n", 2 * GRID_CELLS * GRID_CELLS, (float) cacheSize / (1 << 20));
+    printf("%8s %12s %12s %14s %12s\n", "source", "load", "bvh build", "first frame", "total");
+
+    const char*         names[] = {"obj", "cache"};
+    const StartupTimes* times[] = {&objTimes, &cacheTimes};
+
+    for (size_t i = 0; i < 2; i++)
+    {
+        printf("%8s %9.3f ms %9.2f ms %11.2f ms %9.2f ms\n", names[i], times[i]->load, times[i]->build,
+               times[i]->firstFrame, times[i]->load + times[i]->build + times[i]->firstFrame);
+    }
+
+    remove(OBJ_FILE_NAME);
+    remove(CACHE_FILE_NAME);
+
+    return 0;
+}
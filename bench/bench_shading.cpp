@@ -0,0 +1,189 @@
+//------------------------------------------------------------------------------
+//! @brief Shading throughput in hits per second on the demo scene's primary
+//!        hits: calculateColor() versus ShadingTable's precomputed terms, hit
+//!        by hit and in packets, for the demo's integer shininess and for a
+//!        fractional one, which can't be raised by squaring.
+//!
+//! Error is the largest difference from calculateColor() of a color channel
+//! converted to 8 bits.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_shading.cpp
+//! @date 2021-11-08
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "ray_tracer.h"
+#include "demo_scene.h"
+
+static const size_t WIDTH              = 1200;
+static const size_t HEIGHT             = 800;
+static const size_t REPEATS            = 10;
+static const float  FRACTIONAL_SHINESS = 37.5f;
+
+//------------------------------------------------------------------------------
+//! @brief Closest camera space hits of the scene's objects, one per pixel at
+//!        most.
+//------------------------------------------------------------------------------
+std::vector<Hit> collectHits(Scene& scene)
+{
+    NearPlaneGrid grid;
+    grid.update(WIDTH, HEIGHT, scene.camera.getViewFrustum());
+
+    std::vector<Hit> hits;
+
+    for (size_t y = 0; y < HEIGHT; y++)
+    {
+        for (size_t x = 0; x < WIDTH; x++)
+        {
+            Ray ray = {};
+            ray.direction = grid.getDirection(x, y);
+
+            Hit  closest = {};
+            bool isHit   = false;
+
+            for (auto object : scene.objects)
+            {
+                Hit hit = {};
+                if (object->intersect(ray, &hit) && (!isHit || hit.rayParameter < closest.rayParameter))
+                {
+                    closest = hit;
+                    isHit   = true;
+                }
+            }
+
+            if (isHit)
+            {
+                hits.push_back(closest);
+            }
+        }
+    }
+
+    return hits;
+}
+
+float getMaxError(const std::vector<Vec3<float>>& colors, const std::vector<Vec3<float>>& reference)
+{
+    float maxError = 0;
+
+    for (size_t i = 0; i < colors.size(); i++)
+    {
+        for (size_t coord = 0; coord < 3; coord++)
+        {
+            float error = fabsf(colors[i].getCoord(coord) - reference[i].getCoord(coord)) * 0xFF;
+            maxError    = error > maxError ? error : maxError;
+        }
+    }
+
+    return maxError;
+}
+
+//------------------------------------------------------------------------------
+//! @return Hits per second.
+//------------------------------------------------------------------------------
+template<typename Shade>
+double measure(const std::vector<Hit>& hits, std::vector<Vec3<float>>& colors, Shade shade)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (size_t repeat = 0; repeat < REPEATS; repeat++)
+    {
+        shade(hits, colors);
+    }
+
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - startTime;
+    return (double) (hits.size() * REPEATS) / time.count();
+}
+
+void runVariant(const char* name, Scene& scene, const std::vector<Hit>& hits)
+{
+    ShadingTable table;
+
+    auto startTime = std::chrono::steady_clock::now();
+    table.update(scene);
+    std::chrono::duration<double, std::micro> updateTime = std::chrono::steady_clock::now() - startTime;
+
+    std::vector<Vec3<float>> reference(hits.size());
+    std::vector<Vec3<float>> colors(hits.size());
+
+    double referenceRate = measure(hits, reference, [&scene](const std::vector<Hit>& hits,
+                                                             std::vector<Vec3<float>>& colors)
+    {
+        for (size_t i = 0; i < hits.size(); i++)
+        {
+            colors[i] = calculateColor(scene, hits[i]);
+        }
+    });
+
+    printf("%-12s %-16s %12.2f %9s %10s %10s\n", name, "calculateColor", referenceRate / 1e6, "1.00x", "-", "-");
+
+    double tableRate = measure(hits, colors, [&table](const std::vector<Hit>& hits,
+                                                      std::vector<Vec3<float>>& colors)
+    {
+        for (size_t i = 0; i < hits.size(); i++)
+        {
+            colors[i] = table.shade(hits[i]);
+        }
+    });
+
+    printf("%-12s %-16s %12.2f %8.2fx %10.2f %10.1f\n", name, "table", tableRate / 1e6,
+           tableRate / referenceRate, getMaxError(colors, reference), updateTime.count());
+
+    double packetRate = measure(hits, colors, [&table](const std::vector<Hit>& hits,
+                                                       std::vector<Vec3<float>>& colors)
+    {
+        PacketHit packet = {};
+
+        for (size_t first = 0; first < hits.size(); first += RAY_PACKET_SIZE)
+        {
+            size_t count = hits.size() - first < RAY_PACKET_SIZE ? hits.size() - first : RAY_PACKET_SIZE;
+
+            packet.reset();
+            for (size_t lane = 0; lane < count; lane++)
+            {
+                packet.setHit(lane, hits[first + lane]);
+            }
+
+            table.shadePacket(packet, count, SPACE_CAMERA, nullptr, &colors[first]);
+        }
+    });
+
+    printf("%-12s %-16s %12.2f %8.2fx %10.2f %10.1f\n", name, "table packets", packetRate / 1e6,
+           packetRate / referenceRate, getMaxError(colors, reference), updateTime.count());
+}
+
+int main()
+{
+    DemoScene demo({0.78f, (float) WIDTH / (float) HEIGHT, 1, 600});
+    Scene&    scene = demo.scene;
+
+    scene.updateWorldSpaceValues();
+    scene.updateCameraSpaceValues();
+
+    std::vector<Hit> hits = collectHits(scene);
+
+    printf("%zu hits of %zu pixels\n\n", hits.size(), WIDTH * HEIGHT);
+    printf("%-12s %-16s %12s %9s %10s %10s\n", "shininess", "shading", "Mhits/s", "speedup", "error", "update us");
+
+    runVariant("integer", scene, hits);
+
+    /* Same hits, all of a material whose power can't be raised by squaring */
+    Material fractional    = *hits[0].material;
+    fractional.shiness     = FRACTIONAL_SHINESS;
+    uint32_t fractionalIdx = scene.addMaterial(&fractional);
+
+    for (Hit& hit : hits)
+    {
+        hit.material    = &fractional;
+        hit.materialIdx = fractionalIdx;
+    }
+
+    runVariant("fractional", scene, hits);
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+//------------------------------------------------------------------------------
+//! @brief Frame time overhead of hard shadows with 2, 8 and 32 lights: a wall
+//!        of triangles behind a cloud of spheres, traced in world space through
+//!        BVH on a single thread.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_shadows.cpp
+//! @date 2021-10-25
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+#include "ray_tracer.h"
+#include "bench_common.h"
+
+static const size_t   LIGHTS_COUNTS[]   = {2, 8, 32};
+static const size_t   FRAMES_COUNT      = 5;
+static const size_t   WIDTH             = 640;
+static const size_t   HEIGHT            = 400;
+static const size_t   TILE_SIZE         = TILE_DEFAULT_SIZE;
+
+static const size_t   SPHERES_COUNT     = 200;
+static const size_t   WALL_CELLS        = 64;
+static const float    WALL_DISTANCE     = 50;
+static const float    WALL_SIZE         = 60;
+
+static const Material MATERIAL          = {{0.3f, 0.1f, 0.1f}, {0.9f, 0.7f, 0.7f}, {0.5f, 0.5f, 0.5f}, 50};
+
+//------------------------------------------------------------------------------
+//! @brief Trace and shade a frame tile by tile the way renderPixelMajor() does
+//!        when tracing in world space.
+//!
+//! @return Sum of the colors, so that nothing is optimized away.
+//------------------------------------------------------------------------------
+float renderFrame(Scene& scene, const PrimitiveStore& store, const Bvh& bvh, const NearPlaneGrid& grid,
+                  const ShadingTable& shading, bool enableShadows, ShadowStats* stats)
+{
+    Camera&     camera   = scene.camera;
+    float       colorSum = 0;
+    ShadowCache shadows  = {};
+
+    for (size_t y0 = 0; y0 < HEIGHT; y0 += TILE_SIZE)
+    {
+        for (size_t x0 = 0; x0 < WIDTH; x0 += TILE_SIZE)
+        {
+            shadows.reset(scene.lightSources.getSize());
+
+            for (size_t y = y0; y < y0 + TILE_SIZE && y < HEIGHT; y++)
+            {
+                for (size_t x = x0; x < x0 + TILE_SIZE && x < WIDTH; x++)
+                {
+                    Ray ray = {};
+                    ray.from      = camera.getPos().worldSpace;
+                    ray.direction = camera.toWorldDirection(grid.getDirection(x, y));
+
+                    Hit hit = {};
+                    if (!bvh.intersect(ray, &hit))
+                    {
+                        continue;
+                    }
+
+                    if (enableShadows)
+                    {
+                        traceShadows(bvh, store, scene, hit, &shadows);
+                    }
+
+                    Vec3<float> color = shading.shade(hit, SPACE_WORLD,
+                                                      enableShadows ? shadows.lightVisible.data() : nullptr);
+                    colorSum += color.x + color.y + color.z;
+                }
+            }
+
+            stats->merge(shadows.stats);
+        }
+    }
+
+    return colorSum;
+}
+
+int main()
+{
+    srand(1);
+
+    Camera camera(ViewFrustum(0.78f, 1.5f, 1, 600));
+    Scene  scene(camera);
+    scene.ambientColor = {0.1f, 0.1f, 0.1f};
+
+    std::vector<Sphere> spheres;
+    spheres.reserve(SPHERES_COUNT);
+
+    for (size_t i = 0; i < SPHERES_COUNT; i++)
+    {
+        spheres.emplace_back(&MATERIAL, 1);
+        spheres.back().setPos({getRandom(WALL_DISTANCE / 2, WALL_DISTANCE - 5),
+                               getRandom(-WALL_SIZE / 3, WALL_SIZE / 3),
+                               getRandom(-WALL_SIZE / 3, WALL_SIZE / 3)});
+        spheres.back().setScale(getRandom(0.5f, 2));
+
+        scene.addObject(&spheres.back());
+    }
+
+    std::unique_ptr<Mesh> wall = createGridMesh(&MATERIAL, WALL_CELLS, WALL_DISTANCE, WALL_SIZE);
+    scene.addMesh(wall.get());
+
+    scene.updateWorldSpaceValues();
+
+    PrimitiveStore store;
+    store.compile(scene);
+
+    Bvh bvh;
+    bvh.build(store);
+
+    NearPlaneGrid grid;
+    grid.update(WIDTH, HEIGHT, camera.getViewFrustum());
+
+    std::vector<Light> lights(LIGHTS_COUNTS[sizeof(LIGHTS_COUNTS) / sizeof(LIGHTS_COUNTS[0]) - 1]);
+    for (Light& light : lights)
+    {
+        light.pos.worldSpace = {getRandom(0, WALL_DISTANCE / 3), getRandom(-WALL_SIZE, WALL_SIZE),
+                                getRandom(-WALL_SIZE, WALL_SIZE)};
+        light.brightness     = 1;
+        light.diffuse        = {0.2f, 0.2f, 0.2f};
+        light.specular       = {0.1f, 0.1f, 0.1f};
+    }
+
+    printf("%6s %12s %12s %10s %12s %10s %10s\n", "lights", "no shadows", "shadows", "overhead",
+           "shadow rays", "occluded", "cache hit");
+
+    float checksum = 0;
+
+    for (size_t lightsCount : LIGHTS_COUNTS)
+    {
+        while (scene.lightSources.getSize() < lightsCount)
+        {
+            scene.lightSources.insert(&lights[scene.lightSources.getSize()]);
+        }
+
+        ShadingTable shading;
+        shading.update(scene);
+
+        double      frameTimes[2] = {};
+        ShadowStats stats         = {};
+
+        for (size_t variant = 0; variant < 2; variant++)
+        {
+            for (size_t frame = 0; frame < FRAMES_COUNT; frame++)
+            {
+                ShadowStats frameStats = {};
+                auto        startTime  = std::chrono::steady_clock::now();
+
+                checksum += renderFrame(scene, store, bvh, grid, shading, variant == 1, &frameStats);
+
+                std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - startTime;
+                frameTimes[variant] += time.count() / FRAMES_COUNT;
+
+                stats = frameStats;
+            }
+        }
+
+        printf("%6zu %9.2f ms %9.2f ms %9.1f%% %12" PRIu64 " %9.1f%% %9.1f%%\n", lightsCount,
+               frameTimes[0], frameTimes[1], 100 * (frameTimes[1] / frameTimes[0] - 1), stats.rays,
+               stats.rays != 0 ? 100.0 * stats.occluded / stats.rays : 0.0, 100 * stats.getCacheHitRate());
+    }
+
+    printf("checksum %.1f\n", checksum);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+//------------------------------------------------------------------------------
+//! @brief Sphere intersection throughput: Sphere::intersect() one ray at a
+//!        time versus scalar, SSE and AVX2 ray packets.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_sphere_packets.cpp
+//! @date 2021-10-21
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "object3d.h"
+#include "ray_packet.h"
+
+static const size_t   WIDTH         = 1200;
+static const size_t   HEIGHT        = 800;
+static const size_t   SPHERES_COUNT = 16;
+static const size_t   REPEATS       = 5;
+
+static const Material MATERIAL      = {{0.3f, 0.1f, 0.1f}, {0.9f, 0.7f, 0.7f}, {0.5f, 0.5f, 0.5f}, 50};
+
+struct Variant
+{
+    const char*                   name;
+    IntersectSpherePacketFunction function;
+};
+
+double reportThroughput(const char* name, std::chrono::steady_clock::time_point startTime, size_t hitsCount)
+{
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - startTime;
+    double tests = (double) (WIDTH * HEIGHT * SPHERES_COUNT * REPEATS);
+
+    printf("%-8s %10.1f Mtests/s %12zu hits\n", name, tests / time.count() / 1e6, hitsCount);
+    return time.count();
+}
+
+int main()
+{
+    ViewFrustum   frustum(0.78f, (float) WIDTH / (float) HEIGHT, 1, 600);
+    NearPlaneGrid grid;
+    grid.update(WIDTH, HEIGHT, frustum);
+
+    std::vector<Sphere> spheres;
+    for (size_t i = 0; i < SPHERES_COUNT; i++)
+    {
+        Sphere sphere(&MATERIAL);
+        sphere.pos.cameraSpace    = {-10.0f + 1.3f * (float) i, 0.5f * (float) (i % 5) - 1, 30.0f + (float) i};
+        sphere.radius.cameraSpace = 1.0f + 0.25f * (float) (i % 3);
+
+        spheres.push_back(sphere);
+    }
+
+    printf("dispatch: %s\n", getRayPacketIsaName());
+
+    /* ================ One ray at a time ================ */
+    size_t hitsCount = 0;
+    auto   startTime = std::chrono::steady_clock::now();
+
+    for (size_t repeat = 0; repeat < REPEATS; repeat++)
+    {
+        for (size_t y = 0; y < HEIGHT; y++)
+        {
+            for (size_t x = 0; x < WIDTH; x++)
+            {
+                Ray ray = {};
+                ray.direction = grid.getDirection(x, y);
+
+                for (Sphere& sphere : spheres)
+                {
+                    Hit hit = {};
+                    hitsCount += sphere.intersect(ray, &hit);
+                }
+            }
+        }
+    }
+
+    reportThroughput("single", startTime, hitsCount);
+
+    /* ================ Packets ================ */
+    std::vector<Variant> variants = {{"scalar", intersectSpherePacketScalar}};
+
+#if defined(__x86_64__) || defined(__i386__)
+    variants.push_back({"sse", intersectSpherePacketSse});
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        variants.push_back({"avx2", intersectSpherePacketAvx2});
+    }
+#endif
+
+    for (const Variant& variant : variants)
+    {
+        RayPacket packet = {};
+        PacketHit hits   = {};
+
+        packet.count = RAY_PACKET_SIZE;
+        hitsCount    = 0;
+        startTime    = std::chrono::steady_clock::now();
+
+        for (size_t repeat = 0; repeat < REPEATS; repeat++)
+        {
+            for (size_t y = 0; y < HEIGHT; y++)
+            {
+                for (size_t x = 0; x < WIDTH; x += RAY_PACKET_SIZE)
+                {
+                    for (size_t lane = 0; lane < RAY_PACKET_SIZE; lane++)
+                    {
+                        Ray ray = {};
+                        ray.direction = grid.getDirection(x + lane, y);
+
+                        packet.setRay(lane, ray);
+                    }
+
+                    /* Count every hit, not only the closest, to match the loop above */
+                    for (Sphere& sphere : spheres)
+                    {
+                        hits.reset();
+                        variant.function(packet, sphere.pos.cameraSpace, sphere.radius.cameraSpace,
+                                         sphere.material, sphere.materialIdx, &hits);
+
+                        for (size_t lane = 0; lane < RAY_PACKET_SIZE; lane++)
+                        {
+                            hitsCount += hits.isHit(lane);
+                        }
+                    }
+                }
+            }
+        }
+
+        reportThroughput(variant.name, startTime, hitsCount);
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+//------------------------------------------------------------------------------
+//! @brief Ray/triangle throughput on meshes of 10k, 100k and 1M triangles:
+//!        indexed @ref Mesh versus a heap-allocated @ref Triangle per face.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_triangle_mesh.cpp
+//! @date 2021-10-22
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+#include "object3d.h"
+#include "mesh.h"
+#include "bench_common.h"
+
+static const size_t   TRIANGLES_COUNTS[]       = {10'000, 100'000, 1'000'000};
+static const size_t   VIRTUAL_TRIANGLES_MAX    = 100'000;
+static const size_t   RAYS_SIDE                = 16;
+static const float    MESH_DISTANCE            = 20;
+static const float    MESH_SIZE                = 30;
+static const float    MESH_BUMP                = 0.5f;
+
+static const Material MATERIAL = {{0.3f, 0.1f, 0.1f}, {0.9f, 0.7f, 0.7f}, {0.5f, 0.5f, 0.5f}, 50};
+
+std::vector<Ray> createRays(const Camera& camera)
+{
+    NearPlaneGrid grid;
+    grid.update(RAYS_SIDE, RAYS_SIDE, camera.getViewFrustum());
+
+    std::vector<Ray> rays;
+    for (size_t y = 0; y < RAYS_SIDE; y++)
+    {
+        for (size_t x = 0; x < RAYS_SIDE; x++)
+        {
+            Ray ray = {};
+            ray.direction = grid.getDirection(x, y);
+
+            rays.push_back(ray);
+        }
+    }
+
+    return rays;
+}
+
+void report(const char* name, size_t trianglesCount, size_t hitsCount,
+            std::chrono::steady_clock::time_point startTime)
+{
+    std::chrono::duration<double> time = std::chrono::steady_clock::now() - startTime;
+    double tests = (double) trianglesCount * RAYS_SIDE * RAYS_SIDE;
+
+    printf("%-8s %10zu %12.1f %14.3f %8zu\n", name, trianglesCount, tests / time.count() / 1e6,
+           time.count() * 1e3 / (RAYS_SIDE * RAYS_SIDE), hitsCount);
+}
+
+int main()
+{
+    Camera           camera(ViewFrustum(0.78f, 1.5f, 1, 600));
+    std::vector<Ray> rays = createRays(camera);
+
+    printf("%-8s %10s %12s %14s %8s\n", "path", "triangles", "Mtests/s", "ms per ray", "hits");
+
+    for (size_t requestedCount : TRIANGLES_COUNTS)
+    {
+        size_t                cells = (size_t) sqrt((double) requestedCount / 2);
+        std::unique_ptr<Mesh> mesh  = createGridMesh(&MATERIAL, cells, MESH_DISTANCE, MESH_SIZE, MESH_BUMP);
+        mesh->toCameraSpace(camera);
+
+        size_t trianglesCount = mesh->faces.getSize();
+
+        /* ================ Mesh ================ */
+        size_t hitsCount = 0;
+        auto   startTime = std::chrono::steady_clock::now();
+
+        for (const Ray& ray : rays)
+        {
+            Hit hit = {};
+            hitsCount += mesh->intersect(ray, &hit);
+        }
+
+        report("mesh", trianglesCount, hitsCount, startTime);
+
+        /* ================ Triangle per face ================ */
+        if (trianglesCount <= VIRTUAL_TRIANGLES_MAX)
+        {
+            std::vector<Triangle>  storage(trianglesCount, Triangle(&MATERIAL));
+            std::vector<Hittable*> triangles;
+
+            for (size_t faceIdx = 0; faceIdx < trianglesCount; faceIdx++)
+            {
+                const Face& face     = mesh->faces[faceIdx];
+                Triangle*   triangle = &storage[faceIdx];
+
+                triangle->v0.pos.cameraSpace    = mesh->cameraSpaceVertices[face.idxVertices.x];
+                triangle->v1.pos.cameraSpace    = mesh->cameraSpaceVertices[face.idxVertices.y];
+                triangle->v2.pos.cameraSpace    = mesh->cameraSpaceVertices[face.idxVertices.z];
+                triangle->v0.normal.cameraSpace = mesh->cameraSpaceNormals[face.idxNormals.x];
+                triangle->v1.normal.cameraSpace = mesh->cameraSpaceNormals[face.idxNormals.y];
+                triangle->v2.normal.cameraSpace = mesh->cameraSpaceNormals[face.idxNormals.z];
+
+                triangles.push_back(triangle);
+            }
+
+            hitsCount = 0;
+            startTime = std::chrono::steady_clock::now();
+
+            for (const Ray& ray : rays)
+            {
+                bool found   = false;
+                Hit  closest = {};
+
+                for (Hittable* triangle : triangles)
+                {
+                    Hit hit = {};
+                    if (triangle->intersect(ray, &hit) && (!found || hit.rayParameter < closest.rayParameter))
+                    {
+                        closest = hit;
+                        found   = true;
+                    }
+                }
+
+                hitsCount += found;
+            }
+
+            report("triangle", trianglesCount, hitsCount, startTime);
+        }
+    }
+
+    return 0;
+}
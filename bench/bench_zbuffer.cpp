@@ -0,0 +1,247 @@
+//------------------------------------------------------------------------------
+//! @brief Per-frame cost of the depth buffer: a flat buffer cleared in full
+//!        every frame (the old ZBuffer) versus the tiled, lazily cleared one,
+//!        written tile by tile like the render scheduler does, for fractions
+//!        of the screen covered by geometry. Also checks setDepthAtomic()
+//!        with all threads depth testing the same pixels.
+//!
+//! Reset is the serial part of a frame, depth tests run in parallel tiles
+//! along with tracing, which takes far longer than the tests themselves.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bench_zbuffer.cpp
+//! @date 2021-11-05
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "tile_scheduler.h"
+#include "zbuffer.h"
+
+static const size_t FRAMES_COUNT       = 20;
+static const size_t LAYERS_COUNT       = 3;   ///< Depth tests per covered pixel, as with overlapping primitives.
+static const size_t ATOMIC_WRITES      = 1 << 20;
+static const size_t ATOMIC_SIDE        = 64;  ///< Side of the square all threads write to.
+
+static const float  COVERAGES[]        = {0.1f, 0.5f, 1.0f};
+
+struct Resolution
+{
+    const char* name;
+    size_t      width;
+    size_t      height;
+};
+
+static const Resolution RESOLUTIONS[] = {{"1200x800", 1200, 800}, {"4K", 3840, 2160}};
+
+//------------------------------------------------------------------------------
+//! @brief The old ZBuffer, zero meaning an empty pixel.
+//------------------------------------------------------------------------------
+struct FlatZBuffer
+{
+    const size_t       width;
+    std::vector<float> depths;
+
+    FlatZBuffer(size_t width, size_t height) : width(width), depths(width * height) {}
+
+    void reset()
+    {
+        std::fill(depths.begin(), depths.end(), 0.0f);
+    }
+
+    bool setDepth(size_t x, size_t y, float depth)
+    {
+        float& current = depths[y * width + x];
+
+        if (current > depth || current == 0.0f)
+        {
+            current = depth;
+            return true;
+        }
+
+        return false;
+    }
+};
+
+//------------------------------------------------------------------------------
+//! @brief Depth test covered pixels tile by tile, the central @p coverage
+//!        fraction of rows being covered.
+//!
+//! @return Number of successful depth tests, so that they aren't optimized out.
+//------------------------------------------------------------------------------
+template<typename DepthBuffer>
+size_t renderFrame(DepthBuffer& zbuffer, size_t width, size_t height, float coverage)
+{
+    size_t coveredHeight = (size_t) (coverage * (float) height);
+    size_t y0            = (height - coveredHeight) / 2;
+    size_t y1            = y0 + coveredHeight;
+    size_t written       = 0;
+
+    for (size_t tileY = 0; tileY < height; tileY += TILE_DEFAULT_SIZE)
+    {
+        for (size_t tileX = 0; tileX < width; tileX += TILE_DEFAULT_SIZE)
+        {
+            size_t tileY0 = std::max(tileY, y0);
+            size_t tileY1 = std::min({tileY + TILE_DEFAULT_SIZE, height, y1});
+            size_t tileX1 = std::min(tileX + TILE_DEFAULT_SIZE, width);
+
+            for (size_t layer = 0; layer < LAYERS_COUNT; layer++)
+            {
+                for (size_t y = tileY0; y < tileY1; y++)
+                {
+                    for (size_t x = tileX; x < tileX1; x++)
+                    {
+                        written += zbuffer.setDepth(x, y, (float) (LAYERS_COUNT - layer + (x ^ y) % 7));
+                    }
+                }
+            }
+        }
+    }
+
+    return written;
+}
+
+struct FrameTimes
+{
+    double reset; ///< Milliseconds.
+    double tests; ///< Milliseconds spent depth testing, lazy clears included.
+};
+
+//------------------------------------------------------------------------------
+//! @return Median times of a frame.
+//------------------------------------------------------------------------------
+template<typename DepthBuffer>
+FrameTimes runVariant(const Resolution& resolution, float coverage)
+{
+    DepthBuffer         zbuffer(resolution.width, resolution.height);
+    std::vector<double> resetTimes;
+    std::vector<double> testTimes;
+    size_t              written = 0;
+
+    for (size_t frame = 0; frame < FRAMES_COUNT; frame++)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        zbuffer.reset();
+
+        auto resetEndTime = std::chrono::steady_clock::now();
+
+        written += renderFrame(zbuffer, resolution.width, resolution.height, coverage);
+
+        std::chrono::duration<double, std::milli> resetTime = resetEndTime - startTime;
+        std::chrono::duration<double, std::milli> testTime  = std::chrono::steady_clock::now() - resetEndTime;
+        resetTimes.push_back(resetTime.count());
+        testTimes.push_back(testTime.count());
+    }
+
+    if (written == 0)
+    {
+        printf("Nothing written\n");
+    }
+
+    std::sort(resetTimes.begin(), resetTimes.end());
+    std::sort(testTimes.begin(), testTimes.end());
+
+    return {resetTimes[resetTimes.size() / 2], testTimes[testTimes.size() / 2]};
+}
+
+//------------------------------------------------------------------------------
+//! @brief All threads depth test ATOMIC_WRITES pseudo-random depths each on
+//!        the same ATOMIC_SIDE^2 pixels, starting right after a reset.
+//!
+//! @return Whether every pixel ended up with the least depth written to it.
+//------------------------------------------------------------------------------
+bool runAtomic(size_t threadsCount, double* nsPerWrite)
+{
+    ZBuffer                  zbuffer(ATOMIC_SIDE, ATOMIC_SIDE);
+    std::vector<std::thread> threads;
+    std::vector<float>       minDepths(threadsCount * ATOMIC_SIDE * ATOMIC_SIDE, ZBUFFER_EMPTY_DEPTH);
+
+    zbuffer.reset();
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    for (size_t thread = 0; thread < threadsCount; thread++)
+    {
+        threads.emplace_back([&zbuffer, &minDepths, thread]()
+        {
+            float*   threadMins = minDepths.data() + thread * ATOMIC_SIDE * ATOMIC_SIDE;
+            uint32_t state      = (uint32_t) thread + 1;
+
+            for (size_t i = 0; i < ATOMIC_WRITES; i++)
+            {
+                /* Xorshift32 */
+                state ^= state << 13;
+                state ^= state >> 17;
+                state ^= state << 5;
+
+                size_t pixel = i % (ATOMIC_SIDE * ATOMIC_SIDE);
+                float  depth = (float) (state >> 8);
+
+                zbuffer.setDepthAtomic(pixel % ATOMIC_SIDE, pixel / ATOMIC_SIDE, depth);
+                threadMins[pixel] = std::min(threadMins[pixel], depth);
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+
+    std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - startTime;
+    *nsPerWrite = time.count() / (double) ATOMIC_WRITES;
+
+    for (size_t pixel = 0; pixel < ATOMIC_SIDE * ATOMIC_SIDE; pixel++)
+    {
+        float minDepth = ZBUFFER_EMPTY_DEPTH;
+        for (size_t thread = 0; thread < threadsCount; thread++)
+        {
+            minDepth = std::min(minDepth, minDepths[thread * ATOMIC_SIDE * ATOMIC_SIDE + pixel]);
+        }
+
+        if (zbuffer.getDepth(pixel % ATOMIC_SIDE, pixel / ATOMIC_SIDE) != minDepth)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    printf("%-10s %9s %15s %15s %15s %15s\n", "resolution", "coverage",
+           "flat reset ms", "flat tests ms", "tiled reset ms", "tiled tests ms");
+
+    for (const Resolution& resolution : RESOLUTIONS)
+    {
+        for (float coverage : COVERAGES)
+        {
+            FrameTimes flatTimes  = runVariant<FlatZBuffer>(resolution, coverage);
+            FrameTimes tiledTimes = runVariant<ZBuffer>(resolution, coverage);
+
+            printf("%-10s %8.0f%% %15.3f %15.3f %15.4f %15.3f\n", resolution.name, 100 * coverage,
+                   flatTimes.reset, flatTimes.tests, tiledTimes.reset, tiledTimes.tests);
+        }
+    }
+
+    size_t threadsCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    printf("\n%8s %16s %8s\n", "threads", "atomic ns/write", "valid");
+
+    for (size_t threads = 1; threads <= threadsCount; threads *= 2)
+    {
+        double nsPerWrite = 0;
+        bool   isValid    = runAtomic(threads, &nsPerWrite);
+
+        printf("%8zu %16.2f %8s\n", threads, nsPerWrite, isValid ? "yes" : "NO");
+    }
+
+    return 0;
+}
@@ -0,0 +1,43 @@
+//------------------------------------------------------------------------------
+//! @brief Floating-point per-pixel sums of samples, which progressive rendering
+//!        accumulates while the view stays the same.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file accumulation_buffer.h
+//! @date 2021-10-29
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef ACCUMULATION_BUFFER_H
+#define ACCUMULATION_BUFFER_H
+
+#include <stdlib.h>
+#include "sml/sml_math.h"
+
+static const size_t ACCUMULATION_BUFFER_ALIGNMENT = 64;
+
+struct AccumulationBuffer
+{
+    const size_t width;
+    const size_t height;
+    Vec3<float>* pixels;       ///< Row-major, width * height sums of samples' colors.
+    size_t       samplesCount; ///< Samples accumulated in every pixel.
+
+    AccumulationBuffer(size_t width, size_t height);
+    ~AccumulationBuffer();
+
+    AccumulationBuffer(const AccumulationBuffer& other) = delete;
+    AccumulationBuffer& operator=(const AccumulationBuffer& other) = delete;
+
+    Vec3<float>*       operator[](size_t y)       { return pixels + y * width; }
+    const Vec3<float>* operator[](size_t y) const { return pixels + y * width; }
+
+    //--------------------------------------------------------------------------
+    //! @brief Start accumulating anew. Pixels aren't touched, the first sample
+    //!        overwrites them.
+    //--------------------------------------------------------------------------
+    void               reset() { samplesCount = 0; }
+};
+
+#endif // ACCUMULATION_BUFFER_H
@@ -0,0 +1,177 @@
+//------------------------------------------------------------------------------
+//! @brief Bounding volume hierarchy over primitives of @ref PrimitiveStore,
+//!        built in world space with binned SAH.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bvh.h
+//! @date 2021-10-23
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdint.h>
+#include <vector>
+#include "sml/sml_math.h"
+#include "primitive_store.h"
+
+static const size_t   BVH_BINS_COUNT    = 16;
+static const size_t   BVH_MAX_LEAF_SIZE = 4;
+static const size_t   BVH_MAX_DEPTH     = 64; ///< Also the size of traversal's stack.
+static const uint32_t BVH_NO_PARENT     = UINT32_MAX;
+
+//------------------------------------------------------------------------------
+//! @brief Node of the flat node array, two of them fit in a cache line.
+//! 
+//! Children of an inner node are stored next to each other, so only the
+//! left one's index is kept.
+//------------------------------------------------------------------------------
+struct alignas(32) BvhNode
+{
+    Vec3<float> boundsMin;
+    uint32_t    leftOrFirst; ///< Left child for inner nodes, first primitive for leaves.
+    Vec3<float> boundsMax;
+    uint32_t    count;       ///< Number of primitives in a leaf, 0 for inner nodes.
+
+    bool isLeaf() const { return count != 0; }
+};
+
+struct BvhTraversalStats
+{
+    uint64_t rays;
+    uint64_t nodesVisited;
+    uint64_t primitiveTests;
+
+    void     merge(const BvhTraversalStats& other);
+
+    float    getNodesPerRay() const;
+    float    getTestsPerRay() const;
+};
+
+class Bvh
+{
+public:
+    Bvh();
+
+    //--------------------------------------------------------------------------
+    //! @brief Build the hierarchy from scratch over all primitives of the store.
+    //! 
+    //! @warning The store must outlive the hierarchy or its next build.
+    //--------------------------------------------------------------------------
+    void   build(const PrimitiveStore& store);
+
+    //--------------------------------------------------------------------------
+    //! @brief Update bounds of the changed primitives and of their ancestors,
+    //!        keeping the hierarchy's topology.
+    //! 
+    //! A few changed primitives only cost a walk from their leaves up to the
+    //! root, otherwise the whole hierarchy is refitted bottom-up.
+    //! 
+    //! @param changed See PrimitiveStore::update().
+    //! 
+    //! @warning Hierarchy must have been built over the same set of primitives,
+    //!          see @ref isBuiltFor().
+    //--------------------------------------------------------------------------
+    void   refit(const std::vector<PrimitiveRef>& changed);
+
+    //--------------------------------------------------------------------------
+    //! @brief Make the hierarchy a view of one built earlier, without copying
+    //!        it, e.g. of a scene cache's mapped sections.
+    //! 
+    //! Such a hierarchy can be traversed, but not refitted, until the next
+    //! build().
+    //! 
+    //! @param store           Store mapped to the same primitives.
+    //! @param nodes           getNodesCount() + 1 nodes as given by getNodes().
+    //! @param nodesCount
+    //! @param primitives      As given by getPrimitives().
+    //! @param primitivesCount
+    //! 
+    //! @warning The store and both arrays must outlive the hierarchy or its
+    //!          next build.
+    //--------------------------------------------------------------------------
+    void   attach(const PrimitiveStore& store, const BvhNode* nodes, size_t nodesCount,
+                  const PrimitiveRef* primitives, size_t primitivesCount);
+
+    //--------------------------------------------------------------------------
+    //! @brief Whether the hierarchy has been built over the store with as many
+    //!        primitives as it has now, so that it can be refitted.
+    //--------------------------------------------------------------------------
+    bool   isBuiltFor(const PrimitiveStore& store) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Find the closest front-facing hit of a world space ray.
+    //! 
+    //! @param ray
+    //! @param hit           Hit in world space.
+    //! @param stats         Optional, traversal counters are added to it.
+    //! @param cullBackFaces If false, hits of either side count, e.g. for rays
+    //!                      refracted into a primitive.
+    //! 
+    //! @return Whether anything has been hit.
+    //--------------------------------------------------------------------------
+    bool   intersect(const Ray& ray, Hit* hit, BvhTraversalStats* stats = nullptr,
+                     bool cullBackFaces = true) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Find any primitive, either side of it, hit by a world space ray
+    //!        closer than maxRayParameter. Traversal stops at the first such.
+    //! 
+    //! @param ray
+    //! @param maxRayParameter
+    //! @param occluder Optional, the primitive found.
+    //! @param stats    Optional, traversal counters are added to it.
+    //! 
+    //! @return Whether anything has been hit.
+    //--------------------------------------------------------------------------
+    bool   intersectAny(const Ray& ray, float maxRayParameter, PrimitiveRef* occluder = nullptr,
+                        BvhTraversalStats* stats = nullptr) const;
+
+    bool   isEmpty() const;
+    size_t getNodesCount() const;
+    size_t getPrimitivesCount() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Flat node array, root first. There are getNodesCount() + 1 of
+    //!        them, as the root's sibling is skipped to align sibling pairs.
+    //--------------------------------------------------------------------------
+    const BvhNode*      getNodes() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Primitives in the order leaves refer to them.
+    //--------------------------------------------------------------------------
+    const PrimitiveRef* getPrimitives() const;
+
+    float  getBuildTime() const; ///< Duration of the last build in milliseconds.
+    float  getRefitTime() const; ///< Duration of the last refit in milliseconds.
+
+private:
+    const PrimitiveStore*       m_Store;
+    MappableArray<BvhNode>      m_Nodes;
+    MappableArray<PrimitiveRef> m_Primitives;
+    uint32_t                    m_NodesUsed;
+    float                       m_BuildTime;
+    float                       m_RefitTime;
+
+    /* In the same order as m_Primitives */
+    std::vector<Aabb>           m_Bounds;
+    std::vector<Vec3<float>>    m_Centroids;
+    std::vector<uint32_t>       m_PrimitiveLeaves;
+
+    std::vector<uint32_t>       m_Parents;       ///< Parent of each node, root's is BVH_NO_PARENT.
+
+    /* Position in m_Primitives of each store's sphere and triangle */
+    std::vector<uint32_t>       m_SphereSlots;
+    std::vector<uint32_t>       m_TriangleSlots;
+
+    void   addPrimitive(PrimitiveRef primitive);
+    void   updateNodeBounds(uint32_t nodeIdx);
+    void   refitNode(uint32_t nodeIdx);
+    void   refitAll();
+    void   subdivide(uint32_t nodeIdx, size_t depth);
+    float  findBestSplit(const BvhNode& node, size_t* axis, float* splitPos) const;
+};
+
+#endif // BVH_H
@@ -9,6 +9,7 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <vector>
 #include "sml/sml_math.h"
 #include "space_dep_value.h"
 
@@ -69,9 +70,25 @@ public:
 
     const Mat4<float>&                getViewMatrix() const;
 
+    //--------------------------------------------------------------------------
+    //! @brief Rotate a direction (not a point) from camera to world space.
+    //--------------------------------------------------------------------------
+    Vec3<float>                       toWorldDirection(const Vec3<float>& cameraDirection) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Rotate a direction (not a point) from world to camera space.
+    //--------------------------------------------------------------------------
+    Vec3<float>                       toCameraDirection(const Vec3<float>& worldDirection) const;
+
     const ViewFrustum&                getViewFrustum() const;
     void                              setViewFrustum(const ViewFrustum& viewFrustum);
 
+    //--------------------------------------------------------------------------
+    //! @brief Version of the camera's view, incremented by every setter, so
+    //!        that users can cheaply check whether it has changed.
+    //--------------------------------------------------------------------------
+    uint64_t                          getVersion() const;
+
 private:
     /** Position in model/world/camera spaces. */
     SpaceDepValue<Vec3<float>> m_Pos;
@@ -85,9 +102,15 @@ private:
     /** View matrix for converting vertices from world to camera space. */
     Mat4<float> m_ViewMatrix;
 
+    /** World space X, Y and Z axes in camera space, i.e. columns of the view
+     *  matrix' rotation part. */
+    Vec3<float> m_WorldAxes[3];
+
     /** Camera's view frustum */
     ViewFrustum m_ViewFrustum;
 
+    uint64_t    m_Version;
+
     //--------------------------------------------------------------------------
     //! @brief Update viewMatrix based on pos and forward vectors.
     //--------------------------------------------------------------------------
@@ -132,4 +155,43 @@ Vec3<float> toViewFrustumPoint(const Vec2<float>& pixel,
                                float height,
                                const ViewFrustum& frustum);
 
+//------------------------------------------------------------------------------
+//! @brief Near plane coordinates of every screen column and row.
+//! 
+//! Direction of the primary ray through pixel (x, y) is (xs[x], ys[y], near),
+//! exactly what @ref toViewFrustumPoint() returns for it, but the divisions
+//! are done only once per column/row each time the frustum or screen changes.
+//------------------------------------------------------------------------------
+struct NearPlaneGrid
+{
+    NearPlaneGrid();
+
+    std::vector<float> xs;
+    std::vector<float> ys;
+    float              near;
+    float              pixelWidth;  ///< Along the near plane's x axis.
+    float              pixelHeight; ///< Along the near plane's y axis.
+
+    //--------------------------------------------------------------------------
+    //! @brief Recalculate the grid if screen's size or frustum has changed.
+    //! 
+    //! @return Whether the grid has been recalculated.
+    //--------------------------------------------------------------------------
+    bool update(size_t width, size_t height, const ViewFrustum& frustum);
+
+    Vec3<float> getDirection(size_t x, size_t y) const { return {xs[x], ys[y], near}; }
+
+    //--------------------------------------------------------------------------
+    //! @brief Direction through a point offset from pixel (x, y) by a fraction
+    //!        of a pixel (dx to the right, dy down the screen).
+    //--------------------------------------------------------------------------
+    Vec3<float> getDirection(size_t x, size_t y, float dx, float dy) const
+    {
+        return {xs[x] + dx * pixelWidth, ys[y] - dy * pixelHeight, near};
+    }
+
+private:
+    ViewFrustum m_Frustum;
+};
+
 #endif // CAMERA_H
\ No newline at end of file
@@ -0,0 +1,42 @@
+//------------------------------------------------------------------------------
+//! @brief The demo scene shared by the interactive app and the headless
+//!        renderer.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file demo_scene.h
+//! @date 2021-10-26
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef DEMO_SCENE_H
+#define DEMO_SCENE_H
+
+#include "scene.h"
+
+struct DemoScene
+{
+    DemoScene(const ViewFrustum& viewFrustum);
+
+    DemoScene(const DemoScene& other) = delete;
+    DemoScene& operator=(const DemoScene& other) = delete;
+
+    Camera camera;
+    Light  light1;
+    Light  light2;
+    Sphere sphere1;
+    Sphere sphere2; ///< Mirror.
+    Sphere sphere3; ///< Glass.
+    Scene  scene;
+
+    //--------------------------------------------------------------------------
+    //! @brief Move lights along their orbits by one frame's step.
+    //--------------------------------------------------------------------------
+    void animate();
+
+private:
+    Mat4<float> m_Light1Rotation;
+    Mat4<float> m_Light2Rotation;
+};
+
+#endif // DEMO_SCENE_H
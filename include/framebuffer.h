@@ -0,0 +1,39 @@
+//------------------------------------------------------------------------------
+//! @brief Plain in-memory RGBA image the ray tracer renders into, independent
+//!        of any window or texture.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file framebuffer.h
+//! @date 2021-10-26
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdlib.h>
+#include "sml/sml_graphics_wrapper.h"
+
+static const size_t FRAMEBUFFER_ALIGNMENT = 64;
+
+struct FrameBuffer
+{
+    const size_t width;
+    const size_t height;
+    const size_t stride; ///< Pixels from a row's start to the next's, rows start on cache lines.
+    Color*       pixels; ///< Row-major, stride * height.
+
+    FrameBuffer(size_t width, size_t height);
+    ~FrameBuffer();
+
+    FrameBuffer(const FrameBuffer& other) = delete;
+    FrameBuffer& operator=(const FrameBuffer& other) = delete;
+
+    Color*       operator[](size_t y)       { return pixels + y * stride; }
+    const Color* operator[](size_t y) const { return pixels + y * stride; }
+
+    void         clear(Color color);
+};
+
+#endif // FRAMEBUFFER_H
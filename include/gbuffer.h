@@ -0,0 +1,85 @@
+//------------------------------------------------------------------------------
+//! @brief Geometry buffer of deferred shading: the closest hit of every
+//!        pixel's primary ray, which the lighting pass shades.
+//! 
+//! Pixels are stored in blocks of RAY_PACKET_SIZE consecutive pixels of a row,
+//! each block holds every attribute of its pixels in SoA order, so that the
+//! lighting pass loads a whole block's positions or normals with a single
+//! vector load and walks the buffer linearly. Blocks of a row are followed by
+//! blocks of the next row, the last block of a row is padded with misses.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file gbuffer.h
+//! @date 2021-11-09
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef GBUFFER_H
+#define GBUFFER_H
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include "ray_packet.h"
+
+static const float    GBUFFER_EMPTY_DEPTH = INFINITY;   ///< Depth of pixels without a hit, same as ZBuffer's.
+static const uint32_t GBUFFER_NO_MATERIAL = UINT32_MAX; ///< Material index of pixels without a hit.
+
+struct alignas(32) GBufferBlock
+{
+    float    depth[RAY_PACKET_SIZE]; ///< Camera space z of the hit.
+
+    float    posX[RAY_PACKET_SIZE];
+    float    posY[RAY_PACKET_SIZE];
+    float    posZ[RAY_PACKET_SIZE];
+
+    float    normalX[RAY_PACKET_SIZE];
+    float    normalY[RAY_PACKET_SIZE];
+    float    normalZ[RAY_PACKET_SIZE];
+
+    uint32_t material[RAY_PACKET_SIZE]; ///< Hit::materialIdx of the hit.
+
+    //--------------------------------------------------------------------------
+    //! @brief Mark all lanes as missed, zeroing their positions and normals, so
+    //!        that missed lanes don't slow down vector math with denormals.
+    //--------------------------------------------------------------------------
+    void reset();
+
+    bool isHit(size_t lane) const { return depth[lane] != GBUFFER_EMPTY_DEPTH; }
+
+    void setHit(size_t lane, const Hit& hit);
+
+    //--------------------------------------------------------------------------
+    //! @return Camera space hit with neither material nor rayParameter set,
+    //!         which is enough for traceShadows().
+    //--------------------------------------------------------------------------
+    Hit  getHit(size_t lane) const;
+};
+
+struct GBuffer
+{
+    GBuffer();
+
+    size_t                    width;
+    size_t                    height;
+    size_t                    blocksPerRow;
+    std::vector<GBufferBlock> blocks; ///< Row-major, blocksPerRow per row of pixels.
+
+    //--------------------------------------------------------------------------
+    //! @brief Reallocate blocks if the screen's size has changed, their
+    //!        contents are undefined then.
+    //!
+    //! @return Whether the buffer has been reallocated.
+    //--------------------------------------------------------------------------
+    bool update(size_t screenWidth, size_t screenHeight);
+
+    //--------------------------------------------------------------------------
+    //! @return Block starting at pixel (x, y), x must be a multiple of
+    //!         RAY_PACKET_SIZE.
+    //--------------------------------------------------------------------------
+    GBufferBlock&       getBlock(size_t x, size_t y)       { return blocks[y * blocksPerRow + x / RAY_PACKET_SIZE]; }
+    const GBufferBlock& getBlock(size_t x, size_t y) const { return blocks[y * blocksPerRow + x / RAY_PACKET_SIZE]; }
+};
+
+#endif // GBUFFER_H
@@ -14,10 +14,11 @@
 
 struct Hit
 {
-    Vec3<float>     pos;          ///< Hit's position in camera space.
+    Vec3<float>     pos;          ///< Hit's position in the ray's space (camera space by default).
     float           rayParameter; ///< pos = ray.from + ray.direction * rayParameter
-    Vec3<float>     normal;       ///< Normal to the surface at pos in camera space.
+    Vec3<float>     normal;       ///< Normal to the surface at pos in the ray's space.
     const Material* material;     ///< Material of the surface having been hit.
+    uint32_t        materialIdx;  ///< Index of the material in Scene::materials.
 };
 
 class Hittable
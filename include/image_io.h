@@ -0,0 +1,49 @@
+//------------------------------------------------------------------------------
+//! @brief Writing framebuffers to image files without any external library.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file image_io.h
+//! @date 2021-10-26
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include "framebuffer.h"
+
+enum ImageFormat
+{
+    IMAGE_FORMAT_PPM, ///< Binary P6.
+    IMAGE_FORMAT_PNG, ///< 8-bit RGB, deflate with stored (uncompressed) blocks.
+    IMAGE_FORMAT_EXR, ///< 32-bit float RGB scanlines without compression.
+
+    IMAGE_FORMAT_UNKNOWN
+};
+
+//------------------------------------------------------------------------------
+//! @brief Guess the format by file name's extension (case-sensitive).
+//------------------------------------------------------------------------------
+ImageFormat getImageFormat(const char* fileName);
+
+//------------------------------------------------------------------------------
+//! @brief Write the image in the format given by file name's extension.
+//! 
+//! @return Whether the file has been written, false for unknown extensions
+//!         and I/O errors.
+//------------------------------------------------------------------------------
+bool writeImage(const FrameBuffer& image, const char* fileName);
+
+bool writePpm(const FrameBuffer& image, const char* fileName);
+bool writePng(const FrameBuffer& image, const char* fileName);
+
+//------------------------------------------------------------------------------
+//! @brief Write the image as OpenEXR.
+//! 
+//! Shading results are linear and only clamped to [0, 1] on conversion to
+//! Color, so channels are just divided by 255 without any gamma.
+//------------------------------------------------------------------------------
+bool writeExr(const FrameBuffer& image, const char* fileName);
+
+#endif // IMAGE_IO_H
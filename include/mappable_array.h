@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+//! @brief Array with the subset of std::vector's interface used by the hot
+//!        primitive and BVH arrays, which can also be a read-only view of
+//!        memory it doesn't own, e.g. a section of a memory-mapped file.
+//! 
+//! Element access always goes through the same pointer, so reading a view
+//! costs the same as reading owned elements. T must be plain data.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file mappable_array.h
+//! @date 2021-11-03
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef MAPPABLE_ARRAY_H
+#define MAPPABLE_ARRAY_H
+
+#include <assert.h>
+#include <stddef.h>
+#include <vector>
+
+template<typename T>
+class MappableArray
+{
+public:
+    MappableArray() : m_Data(nullptr), m_Size(0), m_Mapped(false) {}
+
+    MappableArray(const MappableArray& other) = delete;
+    MappableArray& operator=(const MappableArray& other) = delete;
+
+    //--------------------------------------------------------------------------
+    //! @brief Make the array a view of size elements at data, dropping owned
+    //!        ones. Any modification turns it back into an empty owning array
+    //!        first.
+    //! 
+    //! @warning Memory must stay valid while the array views it.
+    //--------------------------------------------------------------------------
+    void map(const T* data, size_t size)
+    {
+        m_Owned.clear();
+        m_Owned.shrink_to_fit();
+
+        m_Data   = data;
+        m_Size   = size;
+        m_Mapped = true;
+    }
+
+    bool     isMapped() const               { return m_Mapped; }
+
+    size_t   size() const                   { return m_Size; }
+    bool     empty() const                  { return m_Size == 0; }
+    const T* data() const                   { return m_Data; }
+
+    const T& operator[](size_t idx) const   { assert(idx < m_Size); return m_Data[idx]; }
+
+    T&       operator[](size_t idx)
+    {
+        assert(!m_Mapped && "Mapped arrays are read-only");
+        return m_Owned[idx];
+    }
+
+    void     clear()                        { own(); m_Owned.clear(); sync(); }
+    void     reserve(size_t capacity)       { own(); m_Owned.reserve(capacity); sync(); }
+    void     resize(size_t size)            { own(); m_Owned.resize(size); sync(); }
+    void     push_back(const T& value)      { own(); m_Owned.push_back(value); sync(); }
+
+private:
+    std::vector<T> m_Owned;
+    const T*       m_Data;   ///< Either m_Owned's elements or the mapped ones.
+    size_t         m_Size;
+    bool           m_Mapped;
+
+    void own()
+    {
+        if (m_Mapped)
+        {
+            m_Mapped = false;
+            m_Size   = 0;
+        }
+    }
+
+    void sync()
+    {
+        m_Data = m_Owned.data();
+        m_Size = m_Owned.size();
+    }
+};
+
+#endif // MAPPABLE_ARRAY_H
@@ -9,8 +9,11 @@
 #ifndef MATERIAL_H
 #define MATERIAL_H
 
+#include <stdint.h>
 #include "sml/sml_math.h"
 
+static const uint32_t MATERIAL_NO_INDEX = UINT32_MAX; ///< Of entities not added to a scene.
+
 struct Material
 {
     Vec3<float> ambient;
@@ -18,6 +21,21 @@ struct Material
     Vec3<float> specular;
 
     float       shiness;
+
+    /* Fractions of light carried by secondary rays, the rest is shaded with
+       Blinn-Phong, see getSurfaceWeight() */
+    float       reflectivity    = 0;
+    float       transparency    = 0;
+    float       refractiveIndex = 1;
 };
 
+//------------------------------------------------------------------------------
+//! @return Fraction of the hit's color given by its own shading.
+//------------------------------------------------------------------------------
+inline float getSurfaceWeight(const Material& material)
+{
+    float weight = 1 - material.reflectivity - material.transparency;
+    return weight > 0 ? weight : 0;
+}
+
 #endif // MATERIAL_H
\ No newline at end of file
@@ -9,23 +9,130 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <vector>
 #include "sml/containers/array.h"
 #include "sml/math/vec3.h"
+#include "space_dep_value.h"
+#include "hit.h"
 
 struct Face
 {
     Vec3<int32_t> idxVertices;
     Vec3<int32_t> idxUV;
-    Vec3<int32_t> idxNormals;
+    Vec3<int32_t> idxNormals;  ///< Negative if the face has no vertex normals.
 };
 
-struct Mesh
+//------------------------------------------------------------------------------
+//! @brief Indexed triangle mesh, rendered as a whole without creating a
+//!        @ref Triangle object for each face.
+//! 
+//! Vertices and normals are given in world space.
+//------------------------------------------------------------------------------
+struct Mesh : public SpaceDependent, public Hittable
 {
-    Array<Face>        faces;
+    Mesh(const Material* material = nullptr, size_t facesCount = 0, size_t verticesCount = 0,
+         size_t uvCount = 0, size_t normalsCount = 0);
+
+    const Material*          material;
+    uint32_t                 materialIdx; ///< Set by Scene::addMesh(), see Hit::materialIdx.
+
+    Array<Face>              faces;
     
-    Array<Vec3<float>> vertices;
-    Array<Vec3<float>> uv;
-    Array<Vec3<float>> normals;
+    Array<Vec3<float>>       vertices;
+    Array<Vec3<float>>       uv;
+    Array<Vec3<float>>       normals;
+
+    /* Filled by toCameraSpace() */
+    std::vector<Vec3<float>> cameraSpaceVertices;
+    std::vector<Vec3<float>> cameraSpaceNormals;
+
+    //--------------------------------------------------------------------------
+    //! @brief Intersect the ray with a single face, normal is interpolated from
+    //!        vertex normals if the face has them.
+    //! 
+    //! @param faceIdx
+    //! @param ray
+    //! @param hit
+    //! @param space   Either SPACE_WORLD or SPACE_CAMERA, the ray is supposed to
+    //!                be given in the same space.
+    //--------------------------------------------------------------------------
+    bool intersectFace(size_t faceIdx, const Ray& ray, Hit* hit, Space space = SPACE_CAMERA) const;
+
+    /* SpaceDependent */
+    virtual void toWorldSpace() override;
+    virtual void toCameraSpace(const Camera& camera) override;
+
+    /* Hittable */
+    virtual bool intersect(const Ray& ray, Hit* hit) override;
 };
 
-#endif // MESH_H
\ No newline at end of file
+static const float TRIANGLE_PARALLEL_EPSILON = 1e-8f;
+
+//------------------------------------------------------------------------------
+//! @brief @ref intersectTriangle() of a triangle given by one vertex and the
+//!        edges to the other two, for callers that store the edges.
+//! 
+//! @param v0
+//! @param edge1        v1 - v0.
+//! @param edge2        v2 - v0.
+//! @param ray
+//! @param rayParameter
+//! @param u
+//! @param v
+//! 
+//! @return Whether the ray hits the triangle at a positive ray parameter.
+//------------------------------------------------------------------------------
+inline bool intersectTriangleEdges(const Vec3<float>& v0, const Vec3<float>& edge1, const Vec3<float>& edge2,
+                                   const Ray& ray, float* rayParameter, float* u, float* v)
+{
+    Vec3<float> p   = crossProduct(ray.direction, edge2);
+    float       det = dotProduct(edge1, p);
+
+    // det == 0 <=> ray is parallel to the triangle's plane
+    if (det > -TRIANGLE_PARALLEL_EPSILON && det < TRIANGLE_PARALLEL_EPSILON)
+    {
+        return false;
+    }
+
+    float       invDet = 1 / det;
+    Vec3<float> s      = ray.from - v0;
+
+    *u = dotProduct(s, p) * invDet;
+    if (*u < 0 || *u > 1)
+    {
+        return false;
+    }
+
+    Vec3<float> q = crossProduct(s, edge1);
+
+    *v = dotProduct(ray.direction, q) * invDet;
+    if (*v < 0 || *u + *v > 1)
+    {
+        return false;
+    }
+
+    *rayParameter = dotProduct(edge2, q) * invDet;
+
+    return *rayParameter > 0;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Möller–Trumbore ray/triangle intersection.
+//! 
+//! Hit point is (1 - u - v) * v0 + u * v1 + v * v2 = ray.at(*rayParameter).
+//! Both sides of the triangle are reported as hit.
+//! 
+//! @param v0
+//! @param v1
+//! @param v2
+//! @param ray
+//! @param rayParameter
+//! @param u
+//! @param v
+//! 
+//! @return Whether the ray hits the triangle at a positive ray parameter.
+//------------------------------------------------------------------------------
+bool intersectTriangle(const Vec3<float>& v0, const Vec3<float>& v1, const Vec3<float>& v2,
+                       const Ray& ray, float* rayParameter, float* u, float* v);
+
+#endif // MESH_H
@@ -0,0 +1,75 @@
+//------------------------------------------------------------------------------
+//! @brief Wavefront OBJ importer into @ref Mesh.
+//! 
+//! The file is memory-mapped and split into chunks at line boundaries, which
+//! are parsed in parallel in two passes: the first one counts each chunk's
+//! vertices, texture coordinates, normals and triangles, so that the mesh is
+//! allocated exactly once with the final sizes, the second one parses the
+//! chunks straight into their ranges of the mesh's arrays.
+//! 
+//! Only "v", "vt", "vn" and "f" statements are read, everything else (groups,
+//! materials, smoothing) is skipped. Polygons are triangulated as fans, and
+//! negative (relative) indices are supported.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file obj_loader.h
+//! @date 2021-11-02
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include <stdint.h>
+#include <memory>
+#include "mesh.h"
+
+struct ObjLoadStats
+{
+    size_t fileSize;    ///< In bytes.
+    size_t chunksCount;
+    float  mapTime;     ///< Milliseconds spent opening and mapping the file.
+    float  countTime;   ///< Milliseconds spent in the counting pass.
+    float  parseTime;   ///< Milliseconds spent allocating the mesh and parsing.
+    float  totalTime;   ///< Milliseconds from opening the file to having the mesh.
+    size_t peakMemory;  ///< Process' peak resident set size in bytes after loading.
+};
+
+//------------------------------------------------------------------------------
+//! @brief Load a triangle mesh from an OBJ file.
+//! 
+//! @param fileName
+//! @param material     Material of the whole mesh.
+//! @param threadsCount Number of threads parsing chunks, 0 means one per
+//!                     hardware core.
+//! @param stats        Optional, filled if the mesh has been loaded.
+//! 
+//! @return The mesh, or nullptr if the file couldn't be read, is malformed or
+//!         refers to vertices it doesn't have.
+//------------------------------------------------------------------------------
+std::unique_ptr<Mesh> loadObj(const char* fileName, const Material* material, size_t threadsCount = 0,
+                              ObjLoadStats* stats = nullptr);
+
+//------------------------------------------------------------------------------
+//! @brief Parse a decimal floating-point number, optionally signed and with an
+//!        exponent, without locale or iostream overhead.
+//! 
+//! Digits beyond float's precision are read but ignored, so results may
+//! differ from strtof() in the last bit.
+//! 
+//! @param str Pointer to the first character, leading blanks are skipped.
+//! @param end End of the buffer, str never reads past it.
+//! @param value
+//! 
+//! @return Pointer past the number, or nullptr if there's no number at str.
+//------------------------------------------------------------------------------
+const char* parseFloat(const char* str, const char* end, float* value);
+
+//------------------------------------------------------------------------------
+//! @return Pointer to the first character at or after str that isn't a space,
+//!         tab or '\r', end if there's none.
+//------------------------------------------------------------------------------
+const char* skipBlanks(const char* str, const char* end);
+
+#endif // OBJ_LOADER_H
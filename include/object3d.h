@@ -25,9 +25,13 @@ struct Object3d : public SpaceDependent, public Hittable
 {
     Object3d(const Material* material);
 
-    SpaceDepValue<Vec3<float>> pos;      ///< Position in world space.
-    float                      scale;    ///< Scale in world space.
-    const Material*            material; ///< Primitive's material used for shading. 
+    SpaceDepValue<Vec3<float>> pos;         ///< Position in world space.
+    float                      scale;       ///< Scale in world space.
+    const Material*            material;    ///< Primitive's material used for shading. 
+    uint32_t                   materialIdx; ///< Set by Scene::addObject(), see Hit::materialIdx.
+
+    void setPos(const Vec3<float>& worldPos);
+    void setScale(float newScale);
 };
 
 struct Sphere : public Object3d
@@ -44,6 +48,14 @@ struct Sphere : public Object3d
     virtual bool intersect(const Ray& ray, Hit* hit) override;
 };
 
+//------------------------------------------------------------------------------
+//! @brief Intersect the ray with a sphere given in the same space as the ray.
+//! 
+//! @return Whether the sphere is hit at a non-negative ray parameter.
+//------------------------------------------------------------------------------
+bool intersectSphere(const Vec3<float>& center, float radius, const Material* material,
+                     uint32_t materialIdx, const Ray& ray, Hit* hit);
+
 struct Triangle : public Object3d
 {
     Vertex v0;
@@ -54,6 +66,8 @@ struct Triangle : public Object3d
 
     Triangle(const Material* material);
 
+    void setRotation(const Vec3<float>& newRotation);
+
     /* SpaceDependent */
     virtual void toWorldSpace() override;
     virtual void toCameraSpace(const Camera& camera) override;
@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------------
+//! @brief Monte Carlo path tracing: an unbiased estimate of a pixel's radiance
+//!        per traced path, meant to be averaged over many frames to get
+//!        reference images.
+//! 
+//! Diffuse surfaces scatter cosine-weighted, mirrors and glass follow their
+//! single direction, chosen stochastically by the material's fractions. Point
+//! lights can't be hit, so they're sampled explicitly at every diffuse vertex
+//! (next-event estimation), and rays that escape the scene pick up the
+//! scene's ambient color as a uniform environment.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file path_tracer.h
+//! @date 2021-11-01
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef PATH_TRACER_H
+#define PATH_TRACER_H
+
+#include <stdint.h>
+#include "scene.h"
+#include "bvh.h"
+#include "shadows.h"
+
+static const size_t PATH_DEFAULT_MAX_BOUNCES        = 8;
+static const size_t PATH_DEFAULT_ROULETTE_BOUNCES   = 3;
+static const size_t PATH_DEFAULT_SAMPLES_PER_FRAME  = 1;
+static const float  PATH_RAY_OFFSET                 = 1e-3f; ///< Bounces start this far from the surface.
+
+struct PathTracingStats
+{
+    uint64_t samples;    ///< Traced paths.
+    uint64_t segments;   ///< Rays traced along the paths, shadow rays excluded.
+    uint64_t terminated; ///< Paths killed by Russian roulette.
+
+    void     merge(const PathTracingStats& other);
+
+    //--------------------------------------------------------------------------
+    //! @param time Duration the samples have been traced for in milliseconds.
+    //--------------------------------------------------------------------------
+    float    getSamplesPerSecond(float time) const;
+};
+
+//------------------------------------------------------------------------------
+//! @brief Traces paths one by one, owning the random state and shadow cache,
+//!        so an instance must only be used by a single thread.
+//------------------------------------------------------------------------------
+class PathTracer
+{
+public:
+    PathTracer();
+
+    PathTracingStats stats;
+    ShadowCache      shadows;
+
+    //--------------------------------------------------------------------------
+    //! @brief Prepare for tracing paths in the scene.
+    //! 
+    //! @param scene
+    //! @param maxBounces      Paths are cut after this many bounces.
+    //! @param rouletteBounces Paths longer than that survive with probability
+    //!                        of their throughput's largest component.
+    //! @param seed            Non-zero, distinct for every thread and frame.
+    //--------------------------------------------------------------------------
+    void  reset(Scene& scene, size_t maxBounces, size_t rouletteBounces, uint32_t seed);
+
+    //--------------------------------------------------------------------------
+    //! @brief Trace a path starting with the world space ray.
+    //! 
+    //! @param bvh
+    //! @param store
+    //! @param scene
+    //! @param ray      World space, direction is normalized.
+    //! @param bvhStats Optional, traversal counters are added to it.
+    //! 
+    //! @return Radiance along the ray, not clamped.
+    //--------------------------------------------------------------------------
+    Vec3<float> trace(const Bvh& bvh, const PrimitiveStore& store, Scene& scene, const Ray& ray,
+                      BvhTraversalStats* bvhStats = nullptr);
+
+    float getRandom(); ///< Uniform in [0, 1).
+
+private:
+    size_t   m_MaxBounces;
+    size_t   m_RouletteBounces;
+    uint32_t m_RandomState;
+
+    Vec3<float> sampleLights(const Bvh& bvh, const PrimitiveStore& store, Scene& scene, const Hit& hit,
+                             const Vec3<float>& toEye);
+    Vec3<float> sampleCosineHemisphere(const Vec3<float>& normal);
+};
+
+#endif // PATH_TRACER_H
@@ -0,0 +1,142 @@
+//------------------------------------------------------------------------------
+//! @brief Packed, type-segregated storage of scene's primitives in world space
+//!        used by the hot intersection loops.
+//! 
+//! Objects and meshes of @ref Scene stay the authoring front-end, which is
+//! compiled down into contiguous arrays, so that intersection needs neither
+//! pointer chasing nor virtual calls.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file primitive_store.h
+//! @date 2021-10-24
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef PRIMITIVE_STORE_H
+#define PRIMITIVE_STORE_H
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "sml/sml_math.h"
+#include "mappable_array.h"
+#include "scene.h"
+
+static const uint32_t PRIMITIVE_NO_NORMAL = UINT32_MAX;
+
+enum PrimitiveType : uint32_t
+{
+    PRIMITIVE_SPHERE,
+    PRIMITIVE_TRIANGLE
+};
+
+struct PrimitiveRef
+{
+    PrimitiveType type;
+    uint32_t      index; ///< Index in the arrays of the type.
+};
+
+struct Aabb
+{
+    Vec3<float> min;
+    Vec3<float> max;
+
+    static Aabb createEmpty();
+
+    void        grow(const Vec3<float>& point);
+    void        grow(const Aabb& other);
+
+    Vec3<float> getCenter() const;
+    float       getSurfaceArea() const;
+};
+
+struct PrimitiveStore
+{
+    /* Spheres */
+    MappableArray<float>         sphereCenterX;
+    MappableArray<float>         sphereCenterY;
+    MappableArray<float>         sphereCenterZ;
+    MappableArray<float>         sphereRadius;
+    MappableArray<uint32_t>      sphereMaterial;
+
+    /* Triangles, both Triangle objects and mesh faces. Edges are precomputed 
+       for Möller–Trumbore: edge1 = v1 - v0, edge2 = v2 - v0. */
+    MappableArray<Vec3<float>>   triangleV0;
+    MappableArray<Vec3<float>>   triangleEdge1;
+    MappableArray<Vec3<float>>   triangleEdge2;
+    MappableArray<uint32_t>      triangleNormals; ///< 3 indices in normals per triangle or PRIMITIVE_NO_NORMAL.
+    MappableArray<uint32_t>      triangleMaterial;
+
+    MappableArray<Vec3<float>>   normals;
+    std::vector<const Material*> materials;       ///< Scene::materials, so indices are Hit::materialIdx.
+
+    //--------------------------------------------------------------------------
+    //! @brief Rebuild the store from world space values of scene's objects and
+    //!        meshes.
+    //--------------------------------------------------------------------------
+    void         compile(Scene& scene);
+
+    //--------------------------------------------------------------------------
+    //! @brief Empty the store and forget the scene it's been compiled for.
+    //! 
+    //! The arrays can then be mapped to primitives compiled earlier, see
+    //! SceneCache, which stay as they are until the next compile().
+    //--------------------------------------------------------------------------
+    void         clear();
+
+    //--------------------------------------------------------------------------
+    //! @brief Whether the arrays are views of memory the store doesn't own
+    //!        rather than compiled from a scene.
+    //--------------------------------------------------------------------------
+    bool         isMapped() const { return sphereRadius.isMapped(); }
+
+    //--------------------------------------------------------------------------
+    //! @brief Update records of entities changed during the last
+    //!        Scene::updateWorldSpaceValues().
+    //! 
+    //! @param scene
+    //! @param changed Refs of updated primitives. If meshes have changed, all
+    //!                triangles are recompiled and every triangle is listed.
+    //--------------------------------------------------------------------------
+    void         update(Scene& scene, std::vector<PrimitiveRef>* changed);
+
+    //--------------------------------------------------------------------------
+    //! @brief Whether the store has been compiled for as many objects and mesh
+    //!        faces as the scene has now, so that it can be updated.
+    //--------------------------------------------------------------------------
+    bool         isCompiledFor(Scene& scene) const;
+
+    size_t       getSpheresCount() const   { return sphereRadius.size(); }
+    size_t       getTrianglesCount() const { return triangleMaterial.size(); }
+    size_t       getPrimitivesCount() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Bytes taken by the arrays (not counting reserved capacity).
+    //--------------------------------------------------------------------------
+    size_t       getMemoryUsage() const;
+
+    Aabb         getBounds(PrimitiveRef ref) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Intersect a world space ray with the primitive.
+    //! 
+    //! @return Whether it's hit at a positive ray parameter, either side.
+    //--------------------------------------------------------------------------
+    bool         intersect(PrimitiveRef ref, const Ray& ray, Hit* hit) const;
+    bool         intersectSphere(uint32_t sphereIdx, const Ray& ray, Hit* hit) const;
+    bool         intersectTriangle(uint32_t triangleIdx, const Ray& ray, Hit* hit) const;
+
+private:
+    std::unordered_map<const Object3d*, PrimitiveRef> m_ObjectRefs;
+
+    /* Triangle objects come first, then mesh faces */
+    size_t       m_ObjectTrianglesCount = 0;
+    size_t       m_ObjectNormalsCount   = 0;
+
+    void         setSphere(uint32_t sphereIdx, const Sphere& sphere);
+    void         setTriangle(uint32_t triangleIdx, const Triangle& triangle);
+    void         compileMeshes(Scene& scene);
+};
+
+#endif // PRIMITIVE_STORE_H
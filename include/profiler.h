@@ -0,0 +1,135 @@
+//------------------------------------------------------------------------------
+//! @brief Low-overhead instrumentation of the renderer: per-frame counters and
+//!        scoped timers exported as a Chrome trace (chrome://tracing, Perfetto).
+//! 
+//! Everything is used through the PROFILE_* macros, which expand to nothing
+//! unless ENABLE_PROFILING is defined (make Profiling=ON). Counters and events
+//! are kept per thread without any locking and counters are merged by
+//! PROFILE_END_FRAME(), which must be called when no thread is rendering.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file profiler.h
+//! @date 2021-10-28
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+static const size_t PROFILER_MAX_EVENTS_PER_THREAD = 1 << 20; ///< Later events are dropped.
+
+enum ProfileCounter
+{
+    PROFILE_COUNTER_PRIMARY_RAYS,
+    PROFILE_COUNTER_SHADOW_RAYS,
+    PROFILE_COUNTER_INTERSECTION_TESTS, ///< Ray-primitive tests of primary rays, a mesh counts its faces.
+    PROFILE_COUNTER_HITS,               ///< Primary rays that have hit anything.
+    PROFILE_COUNTER_SHADING_CALLS,
+    PROFILE_COUNTER_INPUT_LATENCY,      ///< Microseconds from camera's input to presenting a frame showing it.
+
+    PROFILE_COUNTERS_COUNT
+};
+
+struct ProfileEvent
+{
+    const char* name;     ///< Must be a string literal.
+    uint64_t    start;    ///< Nanoseconds since profiler's creation.
+    uint64_t    duration; ///< Nanoseconds.
+};
+
+struct ProfileFrame
+{
+    uint64_t start;
+    uint64_t end;
+    uint64_t counters[PROFILE_COUNTERS_COUNT];
+
+    uint64_t getRaysCount() const; ///< Primary and shadow rays.
+};
+
+class Profiler
+{
+public:
+    static Profiler&    getInstance();
+
+    Profiler(const Profiler& other) = delete;
+    Profiler& operator=(const Profiler& other) = delete;
+
+    uint64_t            getTime() const;
+
+    void                count(ProfileCounter counter, uint64_t value);
+    void                addEvent(const char* name, uint64_t start, uint64_t end);
+
+    //--------------------------------------------------------------------------
+    //! @brief Sum up and reset counters of all threads into a new frame.
+    //--------------------------------------------------------------------------
+    void                endFrame();
+
+    const ProfileFrame& getLastFrame() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Write all recorded events and per-frame counters as Chrome's
+    //!        trace event format JSON, a track per thread.
+    //! 
+    //! @return Whether the file has been written.
+    //--------------------------------------------------------------------------
+    bool                writeChromeTrace(const char* fileName);
+
+    static const char*  getCounterName(ProfileCounter counter);
+
+private:
+    struct ThreadData
+    {
+        uint32_t                  id;
+        uint64_t                  counters[PROFILE_COUNTERS_COUNT];
+        std::vector<ProfileEvent> events;
+    };
+
+    std::chrono::steady_clock::time_point    m_StartTime;
+    std::mutex                               m_Mutex;
+    std::vector<std::unique_ptr<ThreadData>> m_Threads;
+    std::vector<ProfileFrame>                m_Frames;
+    uint64_t                                 m_FrameStart;
+
+    Profiler();
+
+    ThreadData&         getThreadData();
+};
+
+//------------------------------------------------------------------------------
+//! @brief Records an event spanning its lifetime.
+//------------------------------------------------------------------------------
+class ProfileScope
+{
+public:
+    ProfileScope(const char* name) : m_Name(name), m_Start(Profiler::getInstance().getTime()) {}
+    ~ProfileScope() { Profiler::getInstance().addEvent(m_Name, m_Start, Profiler::getInstance().getTime()); }
+
+private:
+    const char* m_Name;
+    uint64_t    m_Start;
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b)      PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef ENABLE_PROFILING
+#define PROFILE_SCOPE(name)           ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_COUNT(counter, value) Profiler::getInstance().count(counter, value)
+#define PROFILE_END_FRAME()           Profiler::getInstance().endFrame()
+#define PROFILE_WRITE_TRACE(fileName) Profiler::getInstance().writeChromeTrace(fileName)
+#else
+/* Value isn't evaluated, so it may be arbitrarily expensive to compute */
+#define PROFILE_SCOPE(name)           ((void) 0)
+#define PROFILE_COUNT(counter, value) ((void) sizeof(value))
+#define PROFILE_END_FRAME()           ((void) 0)
+#define PROFILE_WRITE_TRACE(fileName) ((void) sizeof(fileName))
+#endif
+
+#endif // PROFILER_H
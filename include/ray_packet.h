@@ -0,0 +1,104 @@
+//------------------------------------------------------------------------------
+//! @brief SoA packets of coherent rays and their intersection with spheres
+//!        using SSE/AVX2 with runtime CPU dispatch.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file ray_packet.h
+//! @date 2021-10-21
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "sml/sml_math.h"
+#include "hit.h"
+
+static const size_t RAY_PACKET_SIZE = 8;
+static const float  RAY_PACKET_MISS = 3.4e38f; ///< rayParameter of lanes without a hit.
+
+struct alignas(32) RayPacket
+{
+    float  fromX[RAY_PACKET_SIZE];
+    float  fromY[RAY_PACKET_SIZE];
+    float  fromZ[RAY_PACKET_SIZE];
+
+    float  directionX[RAY_PACKET_SIZE];
+    float  directionY[RAY_PACKET_SIZE];
+    float  directionZ[RAY_PACKET_SIZE];
+
+    size_t count; ///< Number of valid lanes, the rest are duplicates of lane 0.
+
+    void   setRay(size_t lane, const Ray& ray);
+    Ray    getRay(size_t lane) const;
+};
+
+struct alignas(32) PacketHit
+{
+    float           rayParameter[RAY_PACKET_SIZE];
+
+    float           posX[RAY_PACKET_SIZE];
+    float           posY[RAY_PACKET_SIZE];
+    float           posZ[RAY_PACKET_SIZE];
+
+    float           normalX[RAY_PACKET_SIZE];
+    float           normalY[RAY_PACKET_SIZE];
+    float           normalZ[RAY_PACKET_SIZE];
+
+    const Material* material[RAY_PACKET_SIZE];
+    uint32_t        materialIdx[RAY_PACKET_SIZE];
+
+    //--------------------------------------------------------------------------
+    //! @brief Mark all lanes as missed.
+    //--------------------------------------------------------------------------
+    void reset();
+
+    bool isHit(size_t lane) const { return rayParameter[lane] != RAY_PACKET_MISS; }
+
+    void setHit(size_t lane, const Hit& hit);
+    Hit  getHit(size_t lane) const;
+};
+
+//------------------------------------------------------------------------------
+//! @brief Intersect all rays of the packet with a sphere, updating lanes in 
+//!        which the sphere is hit from outside closer than the current hit.
+//! 
+//! @param packet
+//! @param center   Sphere's center in the same space as the packet.
+//! @param radius
+//! @param material
+//! @param materialIdx
+//! @param hit      Closest hits found so far.
+//------------------------------------------------------------------------------
+typedef void (*IntersectSpherePacketFunction)(const RayPacket& packet,
+                                              const Vec3<float>& center,
+                                              float radius,
+                                              const Material* material,
+                                              uint32_t materialIdx,
+                                              PacketHit* hit);
+
+void intersectSpherePacketScalar(const RayPacket& packet, const Vec3<float>& center, float radius,
+                                 const Material* material, uint32_t materialIdx, PacketHit* hit);
+
+#if defined(__x86_64__) || defined(__i386__)
+void intersectSpherePacketSse(const RayPacket& packet, const Vec3<float>& center, float radius,
+                              const Material* material, uint32_t materialIdx, PacketHit* hit);
+
+void intersectSpherePacketAvx2(const RayPacket& packet, const Vec3<float>& center, float radius,
+                               const Material* material, uint32_t materialIdx, PacketHit* hit);
+#endif
+
+//------------------------------------------------------------------------------
+//! @brief Best implementation supported by the CPU the program runs on.
+//------------------------------------------------------------------------------
+extern const IntersectSpherePacketFunction intersectSpherePacket;
+
+//------------------------------------------------------------------------------
+//! @return Name of the instruction set @ref intersectSpherePacket uses.
+//------------------------------------------------------------------------------
+const char* getRayPacketIsaName();
+
+#endif // RAY_PACKET_H
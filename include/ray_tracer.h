@@ -12,18 +12,226 @@
 #define RAY_TRACER_H
 
 #include "sml/sml_graphics_wrapper.h"
+#include "framebuffer.h"
+#include "accumulation_buffer.h"
 #include "scene.h"
 #include "zbuffer.h"
+#include "tile_scheduler.h"
+#include "ray_packet.h"
+#include "bvh.h"
+#include "shadows.h"
+#include "secondary_rays.h"
+#include "path_tracer.h"
+#include "shading.h"
+#include "gbuffer.h"
+
+enum RenderMode
+{
+    RENDER_MODE_PER_PRIMITIVE, ///< Full-screen pass for each primitive, z-buffer resolves overlaps.
+    RENDER_MODE_PER_PIXEL,     ///< One primary ray per pixel, shaded once at the closest hit.
+    RENDER_MODE_PACKETS,       ///< Same as per-pixel, but spheres are intersected by SIMD ray packets.
+    RENDER_MODE_DEFERRED,      ///< Packets' closest hits go to a G-buffer, which a separate pass shades.
+
+    RENDER_MODES_COUNT
+};
+
+enum AntialiasingMode
+{
+    ANTIALIASING_NONE,     ///< A ray per pixel.
+    ANTIALIASING_ADAPTIVE, ///< Pixels on edges found after a ray per pixel are resampled.
+    ANTIALIASING_UNIFORM,  ///< Every pixel is resampled, the quality adaptive mode approaches.
+
+    ANTIALIASING_MODES_COUNT
+};
+
+enum Integrator
+{
+    INTEGRATOR_WHITTED,      ///< Blinn-Phong at hits, plus reflected and refracted rays.
+    INTEGRATOR_PATH_TRACING, ///< Monte Carlo path tracing, see PathTracer.
+
+    INTEGRATORS_COUNT
+};
+
+static const size_t ANTIALIASING_DEFAULT_SIDE      = 4;
+static const float  ANTIALIASING_DEFAULT_THRESHOLD = 0.1f;
+
+struct AntialiasingStats
+{
+    uint64_t pixels;
+    uint64_t resampledPixels;
+    uint64_t extraRays;
+
+    void     merge(const AntialiasingStats& other);
+
+    float    getRaysPerPixel() const;
+};
+
+static const size_t PROGRESSIVE_DEFAULT_MOTION_STRIDE = 4;
+static const size_t PROGRESSIVE_DEFAULT_MAX_SAMPLES   = 64;
+
+enum ProgressiveState
+{
+    PROGRESSIVE_DISABLED,     ///< No accumulation buffer or render mode isn't per-pixel.
+    PROGRESSIVE_MOTION,       ///< Camera is moving, only every motionStride-th pixel is traced and upsampled.
+    PROGRESSIVE_ACCUMULATING, ///< A jittered sample per pixel is added to the accumulation buffer.
+    PROGRESSIVE_CONVERGED     ///< All samples have been accumulated, nothing is traced.
+};
 
 struct RayTracer
 {
-    RayTracer(Scene* scene = nullptr, BufferedTexture* targetTexture = nullptr, ZBuffer* zbuffer = nullptr);
+    RayTracer(Scene* scene = nullptr, FrameBuffer* target = nullptr, ZBuffer* zbuffer = nullptr,
+              TileScheduler* scheduler = nullptr);
 
     Scene*           scene;  // FIXME: make const (add const iterators)
-    BufferedTexture* targetTexture;
+    FrameBuffer*     target;
     ZBuffer*         zbuffer;
 
+    TileScheduler*   scheduler; ///< If nullptr, the whole screen is rendered on the calling thread.
+    size_t           tileSize;
+
+    NearPlaneGrid    nearPlane; ///< Primary rays' directions, updated at the start of renderScene().
+    ShadingTable     shading;   ///< Lights' and materials' terms, updated at the start of renderScene().
+
+    /* Scene's objects split by type at the start of renderScene() in packet and
+       deferred modes */
+    std::vector<Sphere*>   spheres;
+    std::vector<Object3d*> otherObjects;
+
+    RenderMode       renderMode;
+    float            lastRenderTime; ///< Duration of the last renderScene() call in milliseconds.
+
+    /* Per-pixel mode traces world space rays through BVH over the compiled
+       primitives, both are built once and then only updated with entities
+       changed by the scene's last update, unless they've been mapped from a
+       scene cache and stay as they are */
+    bool              useBvh;
+    bool              traceInWorldSpace; ///< Shade BVH hits in world space too, see needsCameraSpaceValues().
+    PrimitiveStore    primitives;
+    bool              primitivesSynced;  ///< Whether primitives have been updated on every scene's update.
+    std::vector<PrimitiveRef> changedPrimitives;
+    Bvh               bvh;
+    BvhTraversalStats lastBvhStats;
+
+    /* Deferred mode writes every pixel's closest hit to the G-buffer and then
+       runs the lighting pass over it. While the screen, the camera and the
+       scene's objects and meshes stay the same, frames only run the lighting
+       pass over the G-buffer of an earlier frame, e.g. when just lights move */
+    GBuffer           gbuffer;
+    bool              gbufferSynced;     ///< Whether gbuffer has been written on every scene's update.
+    uint64_t          gbufferCameraVersion;
+    bool              gbufferReused;     ///< Whether the last renderScene() has skipped the geometry pass.
+
+    bool              enableShadows;     ///< Trace a shadow ray to every light from each shaded hit.
+    ShadowStats       lastShadowStats;
+
+    /* Reflected and refracted rays of a tile are queued while its primary rays
+       are traced and then traced a depth at a time, see SecondaryRayQueue.
+       Only traced in world space, see isTracingSecondaryRays() */
+    size_t            maxRayDepth;       ///< 0 disables secondary rays.
+    size_t            rouletteDepth;     ///< Deeper rays are subject to Russian roulette.
+    SecondaryRayStats lastSecondaryStats;
+
+    /* Path tracing replaces Whitted's integrator when tracing in world space
+       with an accumulation buffer, see isPathTracing(). While accumulating,
+       every frame adds the average of pathSamplesPerFrame paths per pixel as
+       a single sample, so maxSamplesCount bounds frames rather than paths */
+    Integrator        integrator;
+    size_t            pathSamplesPerFrame;
+    size_t            maxBounces;
+    PathTracingStats  lastPathStats;
+
+    /* Per-pixel mode anti-aliasing, applied unless progressive rendering is on:
+       resampled pixels get antialiasingSide^2 stratified rays instead of one.
+       In adaptive mode a pixel is resampled if its color or material differs
+       from any of its four neighbours' after the first ray per pixel */
+    AntialiasingMode             antialiasing;
+    size_t                       antialiasingSide;
+    float                        antialiasingThreshold; ///< Max difference of a color channel, in [0, 1].
+    std::vector<Color>           primaryColors;         ///< First ray per pixel's results, row-major.
+    std::vector<const Material*> primaryMaterials;      ///< nullptr for pixels that haven't hit anything.
+    AntialiasingStats            lastAntialiasingStats;
+
+    /* Progressive per-pixel rendering, enabled by a non-null accumulation
+       buffer: while the camera moves, frames are traced at reduced resolution,
+       once it stops, jittered samples are accumulated until maxSamplesCount.
+       Accumulation restarts on any camera's change, scene's object or mesh
+       update and light's move */
+    AccumulationBuffer*      accumulation;
+    size_t                   motionStride;     ///< Must divide TILE_ALIGNMENT, so that blocks don't cross tiles.
+    size_t                   maxSamplesCount;
+    ProgressiveState         progressiveState; ///< State of the last renderScene().
+    uint64_t                 accumulatedCameraVersion;
+    std::vector<Vec3<float>> accumulatedLights; ///< Lights' world space positions.
+
+    std::mutex        statsMutex;
+
     void renderScene();
+
+    //--------------------------------------------------------------------------
+    //! @brief Make the next renderScene() start accumulating anew, should be
+    //!        called after changing any of the rendering options.
+    //--------------------------------------------------------------------------
+    void restartAccumulation();
+
+    //--------------------------------------------------------------------------
+    //! @brief Whether the current configuration traces and shades entirely in
+    //!        world space (per-pixel mode with BVH and traceInWorldSpace).
+    //--------------------------------------------------------------------------
+    bool isTracingInWorldSpace() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Whether Scene::updateCameraSpaceValues() has to be called before
+    //!        renderScene(). When tracing in world space, moving the camera
+    //!        doesn't require touching any of the scene's geometry.
+    //--------------------------------------------------------------------------
+    bool needsCameraSpaceValues() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Whether renderScene() anti-aliases the frame, which it doesn't
+    //!        in progressive mode, see progressiveState.
+    //--------------------------------------------------------------------------
+    bool isAntialiasing() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Whether reflected and refracted rays are traced, which requires
+    //!        tracing in world space with Whitted's integrator and a non-zero
+    //!        maxRayDepth.
+    //--------------------------------------------------------------------------
+    bool isTracingSecondaryRays() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Whether pixels are path traced, which requires tracing in world
+    //!        space and an accumulation buffer.
+    //--------------------------------------------------------------------------
+    bool isPathTracing() const;
 };
 
-#endif // RAY_TRACER_H
\ No newline at end of file
+const char* getRenderModeName(RenderMode renderMode);
+const char* getAntialiasingModeName(AntialiasingMode antialiasingMode);
+const char* getIntegratorName(Integrator integrator);
+const char* getProgressiveStateName(ProgressiveState progressiveState);
+
+//------------------------------------------------------------------------------
+//! @brief Blinn-Phong shading of the hit, term by term from the scene's lights
+//!        and the hit's material.
+//! 
+//! Rendering shades with ShadingTable, this is the reference bench_shading
+//! checks its precomputed terms against.
+//! 
+//! @param scene
+//! @param hit
+//! @param space        Space hit is given in, either SPACE_CAMERA or SPACE_WORLD.
+//! @param lightVisible Optional, per light flags, see ShadowCache::lightVisible.
+//!                     Lights that aren't visible only add ambient.
+//! @param eyePos       Optional, origin of the ray that has hit in the same
+//!                     space, the camera's position by default.
+//------------------------------------------------------------------------------
+Vec3<float> calculateColor(Scene& scene, const Hit& hit, Space space = SPACE_CAMERA,
+                           const uint8_t* lightVisible = nullptr, const Vec3<float>* eyePos = nullptr);
+
+//------------------------------------------------------------------------------
+//! @brief Convert a shading result with components in [0, 1] to Color.
+//------------------------------------------------------------------------------
+Color convertToRgba(Vec3<float> rgb);
+
+#endif // RAY_TRACER_H
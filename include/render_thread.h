@@ -0,0 +1,93 @@
+//------------------------------------------------------------------------------
+//! @brief Double-buffered rendering on a thread of its own, so that the frame
+//!        rendered last can be displayed or written while the next one is
+//!        being rendered.
+//! 
+//! The ray tracer renders into the back buffer, finishing a frame swaps the
+//! buffers by index, so handing a frame over doesn't copy it. A frame that
+//! hasn't changed the image (progressive rendering has converged) isn't
+//! swapped in, so the caller can skip uploading it.
+//! 
+//! Graphics calls stay on the caller's thread, as SDL requires them to be
+//! made on the thread that has created the renderer.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file render_thread.h
+//! @date 2021-11-06
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "ray_tracer.h"
+
+class RenderThread
+{
+public:
+    typedef std::function<void()> RenderFunction;
+
+    //--------------------------------------------------------------------------
+    //! @param rayTracer Its target is set to one of the buffers before every
+    //!                  frame.
+    //! @param first     Front buffer until the first frame is finished.
+    //! @param second
+    //--------------------------------------------------------------------------
+    RenderThread(RayTracer& rayTracer, FrameBuffer& first, FrameBuffer& second);
+    ~RenderThread();
+
+    RenderThread(const RenderThread& other) = delete;
+    RenderThread& operator=(const RenderThread& other) = delete;
+
+    //--------------------------------------------------------------------------
+    //! @brief Start rendering a frame into the back buffer on the render thread
+    //!        and return immediately.
+    //!
+    //! @param render Renders the frame, RayTracer::renderScene() if empty.
+    //!
+    //! @warning Neither the ray tracer nor the scene may be accessed until
+    //!          finishFrame(), the front buffer may only be read.
+    //--------------------------------------------------------------------------
+    void               startFrame(const RenderFunction& render = RenderFunction());
+
+    //--------------------------------------------------------------------------
+    //! @brief Wait for the frame started by startFrame().
+    //!
+    //! @return Whether the frame has changed the image, in which case it's the
+    //!         front buffer now.
+    //--------------------------------------------------------------------------
+    bool               finishFrame();
+
+    //--------------------------------------------------------------------------
+    //! @return Whether the frame started by startFrame() is done, so that
+    //!         finishFrame() won't wait.
+    //--------------------------------------------------------------------------
+    bool               isFrameFinished();
+
+    bool               isRendering() const;
+
+    const FrameBuffer& getFrontBuffer() const;
+
+private:
+    RayTracer&              m_RayTracer;
+    FrameBuffer*            m_Buffers[2];
+    size_t                  m_FrontIdx;
+    bool                    m_IsRendering; ///< Whether a frame has been started and not finished yet.
+
+    RenderFunction          m_Render;
+    std::thread             m_Thread;
+    std::mutex              m_Mutex;
+    std::condition_variable m_StartCondition;
+    std::condition_variable m_FinishCondition;
+    bool                    m_FrameRequested;
+    bool                    m_Stopping;
+
+    void threadLoop();
+};
+
+#endif // RENDER_THREAD_H
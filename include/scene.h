@@ -9,6 +9,9 @@
 #ifndef SCENE_H
 #define SCENE_H
 
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
 #include "sml/sml_math.h"
 #include "sml/sml_containers.h"
 #include "light.h"
@@ -18,16 +21,67 @@
 
 struct Scene
 {
-    Scene(Camera& camera) : camera(camera) {}
+    Scene(Camera& camera) : camera(camera), meshesChanged(false), m_ObjectsCount(0), m_MeshFacesCount(0),
+                            m_CameraVersion(0), m_CameraSpaceValid(false) {}
 
     Camera&              camera;
     DynamicArray<Light*> lightSources;
     Vec3<float>          ambientColor; ///< Global ambient used in Blinn-Phong shading
-    List<Object3d*>      objects;
-    List<Mesh*>          meshes;
+    List<Object3d*>      objects;      ///< Add with addObject(), so that its changes are tracked.
+    List<Mesh*>          meshes;       ///< Add with addMesh(), so that its changes are tracked.
 
+    /* Materials of added entities without duplicates, only ever appended to,
+       so that Hit::materialIdx stays valid */
+    std::vector<const Material*> materials;
+
+    /* Entities whose world space values have changed during the last update */
+    std::vector<Object3d*> changedObjects;
+    bool                   meshesChanged;
+
+    void addObject(Object3d* object);
+    void addMesh(Mesh* mesh);
+
+    //--------------------------------------------------------------------------
+    //! @return Index of the material in @ref materials, where it's appended to
+    //!         if it's missing.
+    //--------------------------------------------------------------------------
+    uint32_t addMaterial(const Material* material);
+
+    /* Kept up to date by the add methods and updates, so that callers
+       checking the scene's structure every frame don't walk its lists */
+    size_t getObjectsCount() const   { return m_ObjectsCount;   }
+    size_t getMeshFacesCount() const { return m_MeshFacesCount; }
+
+    //--------------------------------------------------------------------------
+    //! @brief Recalculate world space values of dirty entities only, which
+    //!        mark themselves on the scene's dirty lists, so that static
+    //!        entities aren't visited at all.
+    //! 
+    //! @see SpaceDependent::markDirty()
+    //--------------------------------------------------------------------------
     void updateWorldSpaceValues();
+
+    //--------------------------------------------------------------------------
+    //! @brief Recalculate camera space values of all entities if the camera
+    //!        has changed since the last update, otherwise only of lights and
+    //!        entities changed by the last @ref updateWorldSpaceValues().
+    //--------------------------------------------------------------------------
     void updateCameraSpaceValues();
+
+    //--------------------------------------------------------------------------
+    //! @brief Make the next @ref updateCameraSpaceValues() recalculate all
+    //!        entities, should be called for every update that is skipped.
+    //--------------------------------------------------------------------------
+    void invalidateCameraSpaceValues();
+
+private:
+    std::vector<SpaceDependent*>                  m_DirtyObjects;
+    std::vector<SpaceDependent*>                  m_DirtyMeshes;
+    std::unordered_map<const Material*, uint32_t> m_MaterialIndices;
+    size_t                                        m_ObjectsCount;
+    size_t                                        m_MeshFacesCount;
+    uint64_t                                      m_CameraVersion;
+    bool                                          m_CameraSpaceValid;
 };
 
 #endif // SCENE_H
\ No newline at end of file
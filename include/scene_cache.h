@@ -0,0 +1,83 @@
+//------------------------------------------------------------------------------
+//! @brief Binary scene cache: compiled primitives, materials, lights, camera
+//!        and the flat BVH built over them, in a file that is memory-mapped
+//!        and traced straight from the mapped pages.
+//! 
+//! The file is a versioned header followed by sections aligned to
+//! SCENE_CACHE_ALIGNMENT, each of them holding one of @ref PrimitiveStore's
+//! or @ref Bvh's arrays exactly as they are in memory, so loading is mapping
+//! the file and pointing the arrays at it. Nothing is parsed or copied but
+//! the few lights and the table of material pointers, and pages are only read
+//! from disk as traversal first touches them.
+//! 
+//! Meshes are stored as their compiled triangles, so the cache is only traced
+//! in world space through the BVH (see RayTracer::isTracingInWorldSpace()).
+//! Values are in the writing machine's byte order and layout, which the
+//! header's element sizes and magic check, so a cache is meant to be rebuilt
+//! on the machine it's used on rather than distributed.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file scene_cache.h
+//! @date 2021-11-03
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include <stdint.h>
+#include <vector>
+#include "scene.h"
+#include "primitive_store.h"
+#include "bvh.h"
+
+static const uint32_t SCENE_CACHE_VERSION   = 1;
+static const size_t   SCENE_CACHE_ALIGNMENT = 64; ///< Of every section, a cache line.
+
+//------------------------------------------------------------------------------
+//! @brief Write the scene's lights, ambient color and camera's pose together
+//!        with primitives compiled from it and the hierarchy built over them.
+//! 
+//! @return Whether the file has been written.
+//------------------------------------------------------------------------------
+bool writeSceneCache(const char* fileName, Scene& scene, const PrimitiveStore& store, const Bvh& bvh);
+
+class SceneCache
+{
+public:
+    SceneCache();
+    ~SceneCache();
+
+    SceneCache(const SceneCache& other) = delete;
+    SceneCache& operator=(const SceneCache& other) = delete;
+
+    //--------------------------------------------------------------------------
+    //! @brief Map the file and set the scene up from it: the camera is moved
+    //!        to the cached pose (its view frustum is kept, as it depends on
+    //!        the target's aspect), lights, ambient color and materials are
+    //!        set, and the store and hierarchy become views of the mapped
+    //!        sections.
+    //! 
+    //! @param fileName
+    //! @param scene    Without objects, meshes and lights of its own.
+    //! @param store    See PrimitiveStore::isMapped().
+    //! @param bvh      See Bvh::attach().
+    //! 
+    //! @return Whether the file has been mapped and is a cache of this version
+    //!         written on a compatible machine. If not, nothing is changed.
+    //! 
+    //! @warning Can only be called once. The cache must outlive the scene's,
+    //!          store's and hierarchy's use of it.
+    //--------------------------------------------------------------------------
+    bool   load(const char* fileName, Scene* scene, PrimitiveStore* store, Bvh* bvh);
+
+    size_t getFileSize() const;
+
+private:
+    void*              m_Data;
+    size_t             m_Size;
+    std::vector<Light> m_Lights;
+};
+
+#endif // SCENE_CACHE_H
@@ -0,0 +1,101 @@
+//------------------------------------------------------------------------------
+//! @brief Text scene description, loaded instead of the hard-coded demo scene.
+//! 
+//! A statement per line, numbers are decimal, "#" starts a comment:
+//! @code
+//! camera   X Y Z PITCH YAW
+//! frustum  FOV NEAR FAR
+//! ambient  R G B
+//! material NAME  AR AG AB  DR DG DB  SR SG SB  SHININESS  [REFLECTIVITY TRANSPARENCY REFRACTIVE_INDEX]
+//! light    X Y Z  DR DG DB  SR SG SB  [BRIGHTNESS]
+//! sphere   MATERIAL  X Y Z  RADIUS
+//! triangle MATERIAL  X0 Y0 Z0  X1 Y1 Z1  X2 Y2 Z2
+//! mesh     MATERIAL  FILE
+//! @endcode
+//! 
+//! Materials have to be defined before they're used, mesh files are OBJ, see
+//! loadObj(), with paths relative to the scene file.
+//! 
+//! The file is memory-mapped and read in two streaming passes, without an
+//! intermediate representation: the first one counts entities of each type,
+//! so that their arrays are allocated exactly once, the second one parses
+//! them straight into the arrays.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file scene_file.h
+//! @date 2021-11-04
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "scene.h"
+
+struct SceneFileStats
+{
+    size_t fileSize;  ///< In bytes, not counting mesh files.
+    size_t materials;
+    size_t lights;
+    size_t spheres;
+    size_t triangles; ///< Triangle statements, not counting meshes' faces.
+    size_t meshes;
+    size_t faces;     ///< Of all meshes.
+    float  loadTime;  ///< Milliseconds from opening the file to having the scene, meshes included.
+};
+
+struct SceneFile
+{
+    //--------------------------------------------------------------------------
+    //! @param viewFrustum Camera's frustum, the file's "frustum" statement
+    //!                    only changes its field of view and planes, keeping
+    //!                    the aspect.
+    //--------------------------------------------------------------------------
+    SceneFile(const ViewFrustum& viewFrustum);
+
+    SceneFile(const SceneFile& other) = delete;
+    SceneFile& operator=(const SceneFile& other) = delete;
+
+    Camera camera;
+    Scene  scene;
+
+    //--------------------------------------------------------------------------
+    //! @brief Load the file's entities into the scene.
+    //! 
+    //! @param fileName
+    //! @param stats    Optional, filled if the scene has been loaded.
+    //! 
+    //! @return Whether the file and its meshes have been read and are valid,
+    //!         otherwise see getErrorLine().
+    //! 
+    //! @warning Can only be called once.
+    //--------------------------------------------------------------------------
+    bool   load(const char* fileName, SceneFileStats* stats = nullptr);
+
+    //--------------------------------------------------------------------------
+    //! @return Line of the statement the last load() has failed at, 0 if it
+    //!         hasn't failed or has failed to read the file at all.
+    //--------------------------------------------------------------------------
+    size_t getErrorLine() const;
+
+private:
+    float                                   m_Aspect;
+    size_t                                  m_ErrorLine;
+
+    std::vector<Material>                   m_Materials;
+    std::unordered_map<std::string, size_t> m_MaterialIndices;
+    std::vector<Light>                      m_Lights;
+    std::vector<Sphere>                     m_Spheres;
+    std::vector<Triangle>                   m_Triangles;
+    std::vector<std::unique_ptr<Mesh>>      m_Meshes;
+
+    bool   parseStatement(const char* str, const char* end, const std::string& directory);
+    bool   parseMaterialName(const char** str, const char* end, const Material** material);
+};
+
+#endif // SCENE_FILE_H
@@ -0,0 +1,119 @@
+//------------------------------------------------------------------------------
+//! @brief Reflected and refracted rays, traced breadth-first: every ray of a
+//!        depth is intersected before any of them is shaded, which spawns the
+//!        next depth's rays, instead of recursing into each ray on its own.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file secondary_rays.h
+//! @date 2021-10-31
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef SECONDARY_RAYS_H
+#define SECONDARY_RAYS_H
+
+#include <stdint.h>
+#include <vector>
+#include "scene.h"
+#include "bvh.h"
+#include "shadows.h"
+#include "shading.h"
+
+static const size_t SECONDARY_DEFAULT_MAX_DEPTH      = 4;
+static const size_t SECONDARY_DEFAULT_ROULETTE_DEPTH = 2;
+static const size_t SECONDARY_RAYS_PER_SLOT          = 2;     ///< Queue's capacity per color it's traced for.
+static const float  SECONDARY_RAY_OFFSET             = 1e-3f; ///< Rays start this far from the surface.
+
+struct SecondaryRay
+{
+    Ray         ray;    ///< World space, direction is normalized.
+    Vec3<float> weight; ///< Fraction of the ray's color added to its slot.
+    uint32_t    slot;   ///< Index of the color the ray contributes to.
+    uint32_t    depth;  ///< 1 for rays spawned by primary hits.
+};
+
+struct SecondaryRayStats
+{
+    uint64_t rays;       ///< Traced rays.
+    uint64_t reflected;  ///< Spawned reflected rays.
+    uint64_t refracted;  ///< Spawned refracted rays.
+    uint64_t terminated; ///< Rays killed by Russian roulette.
+    uint64_t dropped;    ///< Rays that haven't fit into the queue.
+
+    void     merge(const SecondaryRayStats& other);
+};
+
+class SecondaryRayQueue
+{
+public:
+    SecondaryRayQueue();
+
+    SecondaryRayStats stats;
+
+    //--------------------------------------------------------------------------
+    //! @brief Drop all queued rays and prepare for a new batch of slots.
+    //! 
+    //! @param capacity      Max number of rays of a single depth, the rest are
+    //!                      dropped, which bounds the memory and time spent.
+    //! @param maxDepth      Rays of this depth don't spawn anything.
+    //! @param rouletteDepth Rays deeper than that survive with probability of
+    //!                      their weight's largest component.
+    //! @param seed          Russian roulette's, non-zero.
+    //--------------------------------------------------------------------------
+    void reset(size_t capacity, size_t maxDepth, size_t rouletteDepth, uint32_t seed);
+
+    //--------------------------------------------------------------------------
+    //! @brief Queue rays reflected and refracted by the hit's material, if any.
+    //! 
+    //! @param ray    World space ray that has hit.
+    //! @param hit    World space hit, normal faces outwards.
+    //! @param weight Fraction of the ray's color in its slot.
+    //! @param slot
+    //! @param depth  Depth of the rays to spawn.
+    //--------------------------------------------------------------------------
+    void spawn(const Ray& ray, const Hit& hit, const Vec3<float>& weight, uint32_t slot, uint32_t depth);
+
+    //--------------------------------------------------------------------------
+    //! @brief Trace all queued rays and the rays they spawn, a depth at a time,
+    //!        adding their weighted colors to the slots.
+    //! 
+    //! @param bvh
+    //! @param store
+    //! @param scene
+    //! @param shading  Updated for the scene's current frame.
+    //! @param shadows  Optional, if nullptr no shadow rays are traced.
+    //! @param colors   Indexed by slots.
+    //! @param bvhStats Optional, traversal counters are added to it.
+    //--------------------------------------------------------------------------
+    void trace(const Bvh& bvh, const PrimitiveStore& store, Scene& scene, const ShadingTable& shading,
+               ShadowCache* shadows, Vec3<float>* colors, BvhTraversalStats* bvhStats = nullptr);
+
+    bool isEmpty() const;
+
+private:
+    std::vector<SecondaryRay> m_Rays;     ///< Current depth's.
+    std::vector<SecondaryRay> m_NextRays; ///< Spawned by the current depth's.
+    std::vector<Hit>          m_Hits;
+    std::vector<uint8_t>      m_IsHit;
+
+    size_t                    m_Capacity;
+    size_t                    m_MaxDepth;
+    size_t                    m_RouletteDepth;
+    uint32_t                  m_RandomState;
+
+    void  push(const Ray& ray, Vec3<float> weight, uint32_t slot, uint32_t depth);
+    float getRandom(); ///< Uniform in [0, 1).
+};
+
+//------------------------------------------------------------------------------
+//! @brief Schlick's approximation of Fresnel reflectance of a dielectric in
+//!        vacuum.
+//! 
+//! @param cosine          Cosine of the angle between the normal and the ray
+//!                        outside the dielectric.
+//! @param refractiveIndex
+//------------------------------------------------------------------------------
+float getSchlickReflectance(float cosine, float refractiveIndex);
+
+#endif // SECONDARY_RAYS_H
@@ -0,0 +1,118 @@
+//------------------------------------------------------------------------------
+//! @brief Blinn-Phong shading with terms precomputed once per frame.
+//! 
+//! calculateColor() multiplies every light's colors by the hit material's and
+//! raises the specular term to the shininess with powf() for every hit.
+//! ShadingTable does the products once per frame for every pair of a light and
+//! a material and picks a cheaper specular power per material, so that shading
+//! a hit is a loop over the lights without branches, which packets of hits and
+//! blocks of a G-buffer run for several lanes at once.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file shading.h
+//! @date 2021-11-08
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef SHADING_H
+#define SHADING_H
+
+#include <stdint.h>
+#include <vector>
+#include "scene.h"
+#include "ray_packet.h"
+#include "gbuffer.h"
+
+static const float SHADING_MAX_SQUARED_EXPONENT = 1024; ///< Integer shininess up to this is raised by squaring.
+static const float SHADING_MIN_POWER_LOG2       = -64;  ///< Less specular powers are zero, never denormals.
+
+enum SpecularPower
+{
+    SPECULAR_POWER_SQUARING, ///< Integer shininess, exact power by squaring.
+    SPECULAR_POWER_GENERAL   ///< Any other, powf(), which is faster than the approximation hit by hit.
+};
+
+/* Light's colors multiplied by a material's */
+struct LightTerms
+{
+    Vec3<float> diffuse;
+    Vec3<float> specular;
+};
+
+struct MaterialTerms
+{
+    Vec3<float>   ambient;    ///< Scene's ambient multiplied by the material's, capped.
+    float         shininess;
+    uint32_t      exponent;   ///< Shininess if power is SPECULAR_POWER_SQUARING.
+    float         minBase;    ///< Least base whose power isn't below 2^SHADING_MIN_POWER_LOG2.
+    SpecularPower power;
+    size_t        lightTerms; ///< Index of the first light's terms, the rest lights' follow.
+};
+
+class ShadingTable
+{
+public:
+    ShadingTable();
+
+    //--------------------------------------------------------------------------
+    //! @brief Precompute terms of the scene's lights for every material in
+    //!        Scene::materials, must be called after the scene's update and
+    //!        before any shading of the frame.
+    //!
+    //! Terms of a material alone are computed once, when it's added to the
+    //! scene, only its products with the lights and ambient are redone.
+    //--------------------------------------------------------------------------
+    void update(Scene& scene);
+
+    //--------------------------------------------------------------------------
+    //! @brief Blinn-Phong shading of a hit of the scene's material with the
+    //!        precomputed terms, calculateColor() gives the same result term by
+    //!        term.
+    //! 
+    //! @param hit
+    //! @param space        Space hit is given in, either SPACE_CAMERA or
+    //!                     SPACE_WORLD.
+    //! @param lightVisible Optional, per light flags, see
+    //!                     ShadowCache::lightVisible.
+    //! @param eyePos       Optional, origin of the ray that has hit in the
+    //!                     same space, the camera's position by default.
+    //--------------------------------------------------------------------------
+    Vec3<float> shade(const Hit& hit, Space space = SPACE_CAMERA, const uint8_t* lightVisible = nullptr,
+                      const Vec3<float>* eyePos = nullptr) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Same as shadeBlock() for hits of a packet.
+    //--------------------------------------------------------------------------
+    void shadePacket(const PacketHit& hits, size_t count, Space space, const float* visibility,
+                     Vec3<float>* colors) const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Shade the first count lanes of the block with a single loop over
+    //!        the lights, which runs for four lanes at once with SSE. Lanes are
+    //!        seen from the camera and, whatever their materials, specular power
+    //!        is approximated as exp2(shininess * log2(x)) with polynomials.
+    //! 
+    //! @param block
+    //! @param count
+    //! @param space      Space block's positions and normals are given in.
+    //! @param visibility Optional, RAY_PACKET_SIZE lanes' visibility, 0 or 1,
+    //!                   per light.
+    //! @param colors     Left untouched for lanes without a hit.
+    //--------------------------------------------------------------------------
+    void shadeBlock(const GBufferBlock& block, size_t count, Space space, const float* visibility,
+                    Vec3<float>* colors) const;
+
+private:
+    const Scene*               m_Scene;
+    size_t                     m_LightsCount;
+    std::vector<Vec3<float>>   m_LightPositions[2];  ///< World and camera space.
+    Vec3<float>                m_CameraPositions[2];
+    std::vector<MaterialTerms> m_Materials;          ///< Indexed by Hit::materialIdx.
+    std::vector<LightTerms>    m_LightTerms;
+
+    void   addMaterial(const Material& material);
+    size_t getSpaceIdx(Space space) const;
+};
+
+#endif // SHADING_H
@@ -0,0 +1,76 @@
+//------------------------------------------------------------------------------
+//! @brief Hard shadows: per light visibility of hits tested with shadow rays.
+//! 
+//! Shadow rays only need to know whether anything blocks the light, so they
+//! stop at the first occluder found. Neighbouring pixels are usually blocked
+//! by the same primitive, so the last occluder of each light is remembered
+//! and tested before anything else.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file shadows.h
+//! @date 2021-10-25
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <stdint.h>
+#include <vector>
+#include "scene.h"
+#include "bvh.h"
+
+static const float    SHADOW_RAY_OFFSET  = 1e-3f; ///< Shadow rays start this far from the surface along its normal.
+static const uint32_t SHADOW_NO_OCCLUDER = UINT32_MAX;
+
+struct ShadowStats
+{
+    uint64_t rays;
+    uint64_t occluded;
+    uint64_t cacheHits; ///< Rays blocked by the light's last occluder.
+
+    void     merge(const ShadowStats& other);
+    float    getCacheHitRate() const; ///< Fraction of occluded rays resolved by the cache.
+};
+
+//------------------------------------------------------------------------------
+//! @brief Shadow rays' state local to a tile, so it's only touched by a single
+//!        thread.
+//------------------------------------------------------------------------------
+struct ShadowCache
+{
+    std::vector<uint8_t>      lightVisible;        ///< Result of the last traceShadows(), per light.
+
+    /* Last occluder per light, one is used depending on the space traced in */
+    std::vector<PrimitiveRef> lastOccluders;       ///< World space, index is SHADOW_NO_OCCLUDER if none.
+    std::vector<Hittable*>    lastObjectOccluders; ///< Camera space, nullptr if none.
+
+    ShadowStats               stats;
+
+    void reset(size_t lightsCount);
+};
+
+//------------------------------------------------------------------------------
+//! @brief Test visibility of every light from a world space hit using BVH.
+//! 
+//! @param bvh   Hierarchy built over the store.
+//! @param store
+//! @param scene Provides lights.
+//! @param hit   Hit in world space.
+//! @param cache Result is written to cache->lightVisible.
+//------------------------------------------------------------------------------
+void traceShadows(const Bvh& bvh, const PrimitiveStore& store, Scene& scene, const Hit& hit,
+                  ShadowCache* cache);
+
+//------------------------------------------------------------------------------
+//! @brief Test visibility of every light from a camera space hit against all
+//!        scene's objects and meshes.
+//! 
+//! @param scene
+//! @param hit   Hit in camera space.
+//! @param cache Result is written to cache->lightVisible.
+//------------------------------------------------------------------------------
+void traceShadows(Scene& scene, const Hit& hit, ShadowCache* cache);
+
+#endif // SHADOWS_H
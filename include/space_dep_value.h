@@ -9,6 +9,15 @@
 #ifndef SPACE_DEP_VALUE_H
 #define SPACE_DEP_VALUE_H
 
+#include <vector>
+
+enum Space
+{
+    SPACE_MODEL,
+    SPACE_WORLD,
+    SPACE_CAMERA
+};
+
 //------------------------------------------------------------------------------
 //! @brief Space-dependent value, i.e. value that varies between model and 
 //!        camera spaces.
@@ -30,6 +39,16 @@ struct SpaceDepValue
         modelSpace = modelSpaceValue;
     }
 
+    const T& get(Space space) const
+    {
+        switch (space)
+        {
+            case SPACE_MODEL: { return modelSpace; }
+            case SPACE_WORLD: { return worldSpace; }
+            default:          { return cameraSpace; }
+        }
+    }
+
     T modelSpace;
     T worldSpace;
     T cameraSpace;
@@ -40,6 +59,12 @@ class Camera;
 class SpaceDependent
 {
 public:
+    SpaceDependent() = default;
+
+    /* A copy isn't on the original's dirty list, see setDirtyList() */
+    SpaceDependent(const SpaceDependent&) : m_Dirty(true), m_DirtyList(nullptr) {}
+    SpaceDependent& operator=(const SpaceDependent&) { markDirty(); return *this; }
+
     //--------------------------------------------------------------------------
     //! @brief Convert all space-dependent values to world space. 
     //--------------------------------------------------------------------------
@@ -50,6 +75,46 @@ public:
     //! @warning Supposed to be called after @ref toWorldSpace().
     //--------------------------------------------------------------------------
     virtual void toCameraSpace(const Camera& camera) = 0;
+
+    //--------------------------------------------------------------------------
+    //! @brief Mark world space values as outdated, so that the scene calls
+    //!        @ref toWorldSpace() on its next update.
+    //! 
+    //! Setters do it automatically, it's only needed after changing public 
+    //! fields directly. The entity is added to its dirty list, if it has one,
+    //! once until the flag is cleared.
+    //--------------------------------------------------------------------------
+    void markDirty()
+    {
+        if (!m_Dirty && m_DirtyList != nullptr)
+        {
+            m_DirtyList->push_back(this);
+        }
+
+        m_Dirty = true;
+    }
+
+    void clearDirty()    { m_Dirty = false; }
+    bool isDirty() const { return m_Dirty;  }
+
+    //--------------------------------------------------------------------------
+    //! @brief Set the list markDirty() adds the entity to, so that its owner
+    //!        only visits entities that have changed. The entity is added
+    //!        right away if it's already dirty.
+    //--------------------------------------------------------------------------
+    void setDirtyList(std::vector<SpaceDependent*>* dirtyList)
+    {
+        m_DirtyList = dirtyList;
+
+        if (m_Dirty && m_DirtyList != nullptr)
+        {
+            m_DirtyList->push_back(this);
+        }
+    }
+
+protected:
+    bool                          m_Dirty     = true;
+    std::vector<SpaceDependent*>* m_DirtyList = nullptr;
 };
 
 #endif // SPACE_DEP_VALUE_H
\ No newline at end of file
@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+//! @brief Tile-based parallel scheduler with work-stealing.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file tile_scheduler.h
+//! @date 2021-10-20
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <stdlib.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/** Tile width should be a multiple of this value, so that neighbouring tiles
+ *  don't share cache lines of 32-bit per-pixel buffers whose rows start on
+ *  cache lines, see FrameBuffer::stride. */
+static const size_t TILE_ALIGNMENT    = 16;
+static const size_t TILE_DEFAULT_SIZE = 32;
+
+struct Tile
+{
+    size_t x0, y0; ///< Top-left corner (inclusive).
+    size_t x1, y1; ///< Bottom-right corner (exclusive).
+};
+
+class TileScheduler
+{
+public:
+    //--------------------------------------------------------------------------
+    //! @param threadsCount Number of threads rendering tiles (including the one
+    //!                     calling @ref run()). 0 means one per hardware core.
+    //--------------------------------------------------------------------------
+    TileScheduler(size_t threadsCount = 0);
+    ~TileScheduler();
+
+    TileScheduler(const TileScheduler& other) = delete;
+    TileScheduler& operator=(const TileScheduler& other) = delete;
+
+    typedef std::function<void(const Tile& tile, size_t workerIdx)> TileFunction;
+
+    size_t getThreadsCount() const;
+
+    //--------------------------------------------------------------------------
+    //! @brief Split width x height area into tiles and process all of them with
+    //!        function, blocking until every tile is done.
+    //! 
+    //! Each worker starts with a contiguous range of tiles and, once it runs out
+    //! of them, steals tiles from the back of other workers' queues.
+    //! 
+    //! @param width
+    //! @param height
+    //! @param tileSize Tile's side in pixels (rounded up to @ref TILE_ALIGNMENT).
+    //! @param function Called exactly once for each tile.
+    //--------------------------------------------------------------------------
+    void run(size_t width, size_t height, size_t tileSize, const TileFunction& function);
+
+private:
+    struct alignas(64) WorkerQueue
+    {
+        std::mutex         mutex;
+        std::deque<size_t> tiles;
+    };
+
+    std::vector<std::thread>  m_Threads;
+    std::vector<WorkerQueue>  m_Queues;
+    std::vector<Tile>         m_Tiles;
+    const TileFunction*       m_Function;
+
+    std::mutex                m_Mutex;
+    std::condition_variable   m_StartCondition;
+    std::condition_variable   m_FinishCondition;
+    uint64_t                  m_Generation;
+    size_t                    m_ActiveWorkers;
+    bool                      m_Stopping;
+
+    void workerLoop(size_t workerIdx);
+    void processTiles(size_t workerIdx);
+    bool popTile(size_t workerIdx, size_t* tileIdx);
+};
+
+#endif // TILE_SCHEDULER_H
@@ -0,0 +1,90 @@
+//------------------------------------------------------------------------------
+//! @brief Lock-free handoff of the latest value from one writer thread to one
+//!        reader thread, neither of which ever waits for the other.
+//! 
+//! Each side owns a slot of its own and they trade slots through the third,
+//! shared one with a single atomic exchange, so a value is never read while
+//! it's being written and the reader always gets the latest complete one.
+//! T must be copy-assignable.
+//! 
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file triple_buffer.h
+//! @date 2021-11-07
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+static const size_t TRIPLE_BUFFER_ALIGNMENT = 64;
+
+template<typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer(const T& value = T()) : m_Slots{{value}, {value}, {value}}, m_Shared(1), m_WriteIdx(0),
+                                         m_ReadIdx(2) {}
+
+    TripleBuffer(const TripleBuffer& other) = delete;
+    TripleBuffer& operator=(const TripleBuffer& other) = delete;
+
+    //--------------------------------------------------------------------------
+    //! @brief Publish value, replacing the one published last if it hasn't
+    //!        been read yet. Must only be called by the writer thread.
+    //--------------------------------------------------------------------------
+    void write(const T& value)
+    {
+        m_Slots[m_WriteIdx].value = value;
+
+        uint32_t previous = m_Shared.exchange(m_WriteIdx | FRESH_FLAG, std::memory_order_acq_rel);
+        m_WriteIdx        = previous & INDEX_MASK;
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief Must only be called by the reader thread.
+    //! 
+    //! @param isFresh Optional, whether the value has been published since the
+    //!                last read().
+    //! 
+    //! @return The value published last, valid until the next read().
+    //--------------------------------------------------------------------------
+    const T& read(bool* isFresh = nullptr)
+    {
+        bool fresh = (m_Shared.load(std::memory_order_relaxed) & FRESH_FLAG) != 0;
+
+        if (fresh)
+        {
+            uint32_t previous = m_Shared.exchange(m_ReadIdx, std::memory_order_acq_rel);
+            m_ReadIdx         = previous & INDEX_MASK;
+        }
+
+        if (isFresh != nullptr)
+        {
+            *isFresh = fresh;
+        }
+
+        return m_Slots[m_ReadIdx].value;
+    }
+
+private:
+    static const uint32_t INDEX_MASK = 0x3;
+    static const uint32_t FRESH_FLAG = 0x4;
+
+    /* Slots are on separate cache lines, so that the threads don't share any */
+    struct alignas(TRIPLE_BUFFER_ALIGNMENT) Slot
+    {
+        T value;
+    };
+
+    Slot                  m_Slots[3];
+    std::atomic<uint32_t> m_Shared;   ///< Index of the shared slot and whether it holds an unread value.
+    uint32_t              m_WriteIdx; ///< Owned by the writer.
+    uint32_t              m_ReadIdx;  ///< Owned by the reader.
+};
+
+#endif // TRIPLE_BUFFER_H
@@ -1,4 +1,16 @@
 //------------------------------------------------------------------------------
+//! @brief Depth buffer laid out in ZBUFFER_TILE_SIZE x ZBUFFER_TILE_SIZE
+//!        tiles and cleared lazily.
+//! 
+//! Each tile is stamped with the generation it has last been cleared in, so
+//! reset() only starts a new generation and a tile is cleared by the first
+//! write to it in that generation. Tiles of the render scheduler are aligned
+//! to tiles of the buffer (see TILE_ALIGNMENT), so a tile is only ever
+//! written by one thread at a time with setDepth(). Writers that may share
+//! pixels use setDepthAtomic() instead.
+//! 
+//! Empty pixels have ZBUFFER_EMPTY_DEPTH, so a depth test is a single compare.
+//! 
 //! @author Nikita Mochalov (github.com/tralf-strues)
 //! @file zbuffer.h
 //! @date 2021-09-26
@@ -9,22 +21,110 @@
 #ifndef ZBUFFER_H
 #define ZBUFFER_H
 
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+static const size_t ZBUFFER_ALIGNMENT   = 64;
+static const size_t ZBUFFER_TILE_SIZE   = 16; ///< Same as TILE_ALIGNMENT, so a tile takes 1 KiB.
+static const float  ZBUFFER_EMPTY_DEPTH = INFINITY;
+
 struct ZBuffer
 {
     const size_t width;
     const size_t height;
-    float*       depths;
 
     ZBuffer(size_t width, size_t height);
     ~ZBuffer();
 
-    float getDepth(size_t x, size_t y) const;
-    bool  setDepth(size_t x, size_t y, float depth);
+    ZBuffer(const ZBuffer& other) = delete;
+    ZBuffer& operator=(const ZBuffer& other) = delete;
+
+    //--------------------------------------------------------------------------
+    //! @return Pixel's depth or ZBUFFER_EMPTY_DEPTH if nothing has been written
+    //!         to it since the last reset().
+    //--------------------------------------------------------------------------
+    float getDepth(size_t x, size_t y) const
+    {
+        size_t tileIdx = getTileIdx(x, y);
+
+        if (m_TileGenerations[tileIdx] != m_Generation)
+        {
+            return ZBUFFER_EMPTY_DEPTH;
+        }
+
+        return m_Tiles[tileIdx].depths[getIdxInTile(x, y)];
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief Depth test, the depth is written if it's less than the pixel's.
+    //! 
+    //! @warning Pixels of a tile mustn't be written by several threads at a
+    //!          time.
+    //! 
+    //! @return Whether the depth has been written.
+    //--------------------------------------------------------------------------
+    bool  setDepth(size_t x, size_t y, float depth)
+    {
+        size_t tileIdx = getTileIdx(x, y);
+
+        if (m_TileGenerations[tileIdx] != m_Generation)
+        {
+            clearTile(tileIdx);
+        }
+
+        float& pixel = m_Tiles[tileIdx].depths[getIdxInTile(x, y)];
 
+        if (depth < pixel)
+        {
+            pixel = depth;
+            return true;
+        }
+
+        return false;
+    }
+
+    //--------------------------------------------------------------------------
+    //! @brief Same as setDepth(), but safe for any number of concurrent writers
+    //!        to any pixels.
+    //--------------------------------------------------------------------------
+    bool  setDepthAtomic(size_t x, size_t y, float depth);
+
+    //--------------------------------------------------------------------------
+    //! @brief Make all pixels empty in constant time.
+    //! 
+    //! @warning Mustn't be called concurrently with writes.
+    //--------------------------------------------------------------------------
     void  reset();
+
     bool  isFilled(size_t x, size_t y) const;
+
+private:
+    struct alignas(ZBUFFER_ALIGNMENT) DepthTile
+    {
+        float depths[ZBUFFER_TILE_SIZE * ZBUFFER_TILE_SIZE];
+    };
+
+    /* Plain values, so that setDepth() compiles to plain loads and stores,
+       setDepthAtomic() accesses them with atomic builtins */
+    const size_t m_TilesPerRow;
+    const size_t m_TilesCount;
+    DepthTile*   m_Tiles;
+    uint32_t*    m_TileGenerations; ///< Generation each tile has last been cleared in.
+    uint32_t     m_Generation;
+
+    size_t getTileIdx(size_t x, size_t y) const
+    {
+        return (y / ZBUFFER_TILE_SIZE) * m_TilesPerRow + x / ZBUFFER_TILE_SIZE;
+    }
+
+    size_t getIdxInTile(size_t x, size_t y) const
+    {
+        return (y % ZBUFFER_TILE_SIZE) * ZBUFFER_TILE_SIZE + x % ZBUFFER_TILE_SIZE;
+    }
+
+    void   clearTile(size_t tileIdx);
+    void   clearTileAtomic(size_t tileIdx);
 };
 
-#endif // ZBUFFER_H
\ No newline at end of file
+#endif // ZBUFFER_H
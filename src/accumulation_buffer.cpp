@@ -0,0 +1,26 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file accumulation_buffer.cpp
+//! @date 2021-10-29
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include "accumulation_buffer.h"
+
+AccumulationBuffer::AccumulationBuffer(size_t width, size_t height) :
+                                       width(width), height(height), samplesCount(0)
+{
+    /* Cache-line aligned for the same reason as ZBuffer */
+    size_t bytes = (width * height * sizeof(Vec3<float>) + ACCUMULATION_BUFFER_ALIGNMENT - 1) /
+                   ACCUMULATION_BUFFER_ALIGNMENT * ACCUMULATION_BUFFER_ALIGNMENT;
+
+    pixels = (Vec3<float>*) aligned_alloc(ACCUMULATION_BUFFER_ALIGNMENT, bytes);
+    assert(pixels);
+}
+
+AccumulationBuffer::~AccumulationBuffer()
+{
+    free(pixels);
+}
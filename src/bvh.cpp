@@ -0,0 +1,615 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file bvh.cpp
+//! @date 2021-10-23
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <float.h>
+#include <chrono>
+#include <utility>
+#include "bvh.h"
+
+static_assert(sizeof(BvhNode) == 32, "BvhNode is supposed to take half of a cache line");
+
+//------------------------------BvhTraversalStats-------------------------------
+void BvhTraversalStats::merge(const BvhTraversalStats& other)
+{
+    rays           += other.rays;
+    nodesVisited   += other.nodesVisited;
+    primitiveTests += other.primitiveTests;
+}
+
+float BvhTraversalStats::getNodesPerRay() const
+{
+    return rays != 0 ? (float) nodesVisited / (float) rays : 0;
+}
+
+float BvhTraversalStats::getTestsPerRay() const
+{
+    return rays != 0 ? (float) primitiveTests / (float) rays : 0;
+}
+//------------------------------------------------------------------------------
+
+//-------------------------------------Bvh--------------------------------------
+Bvh::Bvh() : m_Store(nullptr), m_NodesUsed(0), m_BuildTime(0), m_RefitTime(0) {}
+
+void Bvh::build(const PrimitiveStore& store)
+{
+    auto startTime = std::chrono::steady_clock::now();
+
+    m_Store = &store;
+
+    m_Primitives.clear();
+    m_Bounds.clear();
+    m_Centroids.clear();
+
+    size_t spheresCount   = store.getSpheresCount();
+    size_t trianglesCount = store.getTrianglesCount();
+
+    m_Primitives.reserve(spheresCount + trianglesCount);
+    m_Bounds.reserve(spheresCount + trianglesCount);
+    m_Centroids.reserve(spheresCount + trianglesCount);
+
+    for (uint32_t sphereIdx = 0; sphereIdx < spheresCount; sphereIdx++)
+    {
+        addPrimitive({PRIMITIVE_SPHERE, sphereIdx});
+    }
+
+    for (uint32_t triangleIdx = 0; triangleIdx < trianglesCount; triangleIdx++)
+    {
+        addPrimitive({PRIMITIVE_TRIANGLE, triangleIdx});
+    }
+
+    /* A binary tree with N leaves has 2N - 1 nodes, one more is skipped to
+       align sibling pairs */
+    size_t primitivesCount = m_Primitives.size();
+    m_Nodes.resize(primitivesCount > 0 ? 2 * primitivesCount : 1);
+    m_Parents.assign(m_Nodes.size(), BVH_NO_PARENT);
+
+    BvhNode& root   = m_Nodes[0];
+    root.leftOrFirst = 0;
+    root.count       = (uint32_t) primitivesCount;
+    m_NodesUsed      = 2;
+
+    if (primitivesCount > 0)
+    {
+        updateNodeBounds(0);
+        subdivide(0, 1);
+    }
+    else
+    {
+        root.boundsMin = Aabb::createEmpty().min;
+        root.boundsMax = Aabb::createEmpty().max;
+    }
+
+    /* Remember where every primitive has ended up for refitting */
+    m_PrimitiveLeaves.resize(primitivesCount);
+    m_SphereSlots.resize(spheresCount);
+    m_TriangleSlots.resize(trianglesCount);
+
+    for (uint32_t nodeIdx = 0; nodeIdx < m_NodesUsed; nodeIdx++)
+    {
+        const BvhNode& node = m_Nodes[nodeIdx];
+        if (nodeIdx == 1 || !node.isLeaf())
+        {
+            continue;
+        }
+
+        for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; i++)
+        {
+            m_PrimitiveLeaves[i] = nodeIdx;
+
+            if (m_Primitives[i].type == PRIMITIVE_SPHERE)
+            {
+                m_SphereSlots[m_Primitives[i].index] = i;
+            }
+            else
+            {
+                m_TriangleSlots[m_Primitives[i].index] = i;
+            }
+        }
+    }
+
+    std::chrono::duration<float, std::milli> buildTime = std::chrono::steady_clock::now() - startTime;
+    m_BuildTime = buildTime.count();
+}
+
+void Bvh::addPrimitive(PrimitiveRef primitive)
+{
+    Aabb bounds = m_Store->getBounds(primitive);
+
+    m_Primitives.push_back(primitive);
+    m_Bounds.push_back(bounds);
+    m_Centroids.push_back(bounds.getCenter());
+}
+
+void Bvh::updateNodeBounds(uint32_t nodeIdx)
+{
+    BvhNode& node   = m_Nodes[nodeIdx];
+    Aabb     bounds = Aabb::createEmpty();
+
+    for (uint32_t i = 0; i < node.count; i++)
+    {
+        bounds.grow(m_Bounds[node.leftOrFirst + i]);
+    }
+
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+}
+
+float Bvh::findBestSplit(const BvhNode& node, size_t* axis, float* splitPos) const
+{
+    assert(axis);
+    assert(splitPos);
+
+    float bestCost = FLT_MAX;
+
+    Aabb centroidBounds = Aabb::createEmpty();
+    for (uint32_t i = 0; i < node.count; i++)
+    {
+        centroidBounds.grow(m_Centroids[node.leftOrFirst + i]);
+    }
+
+    for (size_t curAxis = 0; curAxis < 3; curAxis++)
+    {
+        float boundsMin = centroidBounds.min.getCoord(curAxis);
+        float boundsMax = centroidBounds.max.getCoord(curAxis);
+
+        if (boundsMin == boundsMax)
+        {
+            continue;
+        }
+
+        Aabb     binBounds[BVH_BINS_COUNT];
+        uint32_t binCounts[BVH_BINS_COUNT] = {};
+
+        for (size_t bin = 0; bin < BVH_BINS_COUNT; bin++)
+        {
+            binBounds[bin] = Aabb::createEmpty();
+        }
+
+        float scale = BVH_BINS_COUNT / (boundsMax - boundsMin);
+        for (uint32_t i = 0; i < node.count; i++)
+        {
+            uint32_t primitiveIdx = node.leftOrFirst + i;
+            size_t   bin          = (size_t) ((m_Centroids[primitiveIdx].getCoord(curAxis) - boundsMin) * scale);
+
+            bin = bin < BVH_BINS_COUNT ? bin : BVH_BINS_COUNT - 1;
+
+            binCounts[bin]++;
+            binBounds[bin].grow(m_Bounds[primitiveIdx]);
+        }
+
+        /* Sweep from both sides to get areas and counts of every split's halves */
+        float    leftAreas[BVH_BINS_COUNT - 1]   = {};
+        float    rightAreas[BVH_BINS_COUNT - 1]  = {};
+        uint32_t leftCounts[BVH_BINS_COUNT - 1]  = {};
+        uint32_t rightCounts[BVH_BINS_COUNT - 1] = {};
+
+        Aabb     leftBounds  = Aabb::createEmpty();
+        Aabb     rightBounds = Aabb::createEmpty();
+        uint32_t leftSum     = 0;
+        uint32_t rightSum    = 0;
+
+        for (size_t i = 0; i < BVH_BINS_COUNT - 1; i++)
+        {
+            leftSum += binCounts[i];
+            leftBounds.grow(binBounds[i]);
+            leftCounts[i] = leftSum;
+            leftAreas[i]  = leftBounds.getSurfaceArea();
+
+            rightSum += binCounts[BVH_BINS_COUNT - 1 - i];
+            rightBounds.grow(binBounds[BVH_BINS_COUNT - 1 - i]);
+            rightCounts[BVH_BINS_COUNT - 2 - i] = rightSum;
+            rightAreas[BVH_BINS_COUNT - 2 - i]  = rightBounds.getSurfaceArea();
+        }
+
+        for (size_t i = 0; i < BVH_BINS_COUNT - 1; i++)
+        {
+            float cost = leftCounts[i] * leftAreas[i] + rightCounts[i] * rightAreas[i];
+
+            if (leftCounts[i] != 0 && rightCounts[i] != 0 && cost < bestCost)
+            {
+                bestCost  = cost;
+                *axis     = curAxis;
+                *splitPos = boundsMin + (float) (i + 1) / scale;
+            }
+        }
+    }
+
+    return bestCost;
+}
+
+void Bvh::subdivide(uint32_t nodeIdx, size_t depth)
+{
+    BvhNode& node = m_Nodes[nodeIdx];
+
+    if (node.count <= BVH_MAX_LEAF_SIZE || depth >= BVH_MAX_DEPTH)
+    {
+        return;
+    }
+
+    size_t axis     = 0;
+    float  splitPos = 0;
+    float  cost     = findBestSplit(node, &axis, &splitPos);
+
+    Aabb bounds = {node.boundsMin, node.boundsMax};
+    if (cost >= node.count * bounds.getSurfaceArea())
+    {
+        return;
+    }
+
+    /* Partition primitives by the split plane */
+    uint32_t first = node.leftOrFirst;
+    uint32_t last  = node.leftOrFirst + node.count;
+    uint32_t mid   = first;
+
+    for (uint32_t i = first; i < last; i++)
+    {
+        if (m_Centroids[i].getCoord(axis) < splitPos)
+        {
+            std::swap(m_Primitives[i], m_Primitives[mid]);
+            std::swap(m_Bounds[i],     m_Bounds[mid]);
+            std::swap(m_Centroids[i],  m_Centroids[mid]);
+            mid++;
+        }
+    }
+
+    if (mid == first || mid == last)
+    {
+        return;
+    }
+
+    uint32_t leftIdx  = m_NodesUsed;
+    uint32_t rightIdx = m_NodesUsed + 1;
+    m_NodesUsed += 2;
+
+    m_Nodes[leftIdx].leftOrFirst  = first;
+    m_Nodes[leftIdx].count        = mid - first;
+    m_Nodes[rightIdx].leftOrFirst = mid;
+    m_Nodes[rightIdx].count       = last - mid;
+
+    node.leftOrFirst = leftIdx;
+    node.count       = 0;
+
+    m_Parents[leftIdx]  = nodeIdx;
+    m_Parents[rightIdx] = nodeIdx;
+
+    updateNodeBounds(leftIdx);
+    updateNodeBounds(rightIdx);
+
+    subdivide(leftIdx,  depth + 1);
+    subdivide(rightIdx, depth + 1);
+}
+
+void Bvh::refit(const std::vector<PrimitiveRef>& changed)
+{
+    assert(!m_Nodes.isMapped() && "Attached hierarchies can't be refitted");
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    if (m_Primitives.empty() || changed.empty())
+    {
+        m_RefitTime = 0;
+        return;
+    }
+
+    /* Walks up from many leaves revisit the same upper nodes over and over,
+       a single bottom-up pass is cheaper then */
+    bool refitWhole = changed.size() * BVH_MAX_DEPTH > m_Primitives.size();
+
+    for (PrimitiveRef ref : changed)
+    {
+        uint32_t primitiveIdx = ref.type == PRIMITIVE_SPHERE ? m_SphereSlots[ref.index]
+                                                             : m_TriangleSlots[ref.index];
+
+        m_Bounds[primitiveIdx] = m_Store->getBounds(ref);
+
+        if (!refitWhole)
+        {
+            for (uint32_t nodeIdx = m_PrimitiveLeaves[primitiveIdx]; nodeIdx != BVH_NO_PARENT;
+                 nodeIdx = m_Parents[nodeIdx])
+            {
+                refitNode(nodeIdx);
+            }
+        }
+    }
+
+    if (refitWhole)
+    {
+        refitAll();
+    }
+
+    std::chrono::duration<float, std::milli> refitTime = std::chrono::steady_clock::now() - startTime;
+    m_RefitTime = refitTime.count();
+}
+
+void Bvh::attach(const PrimitiveStore& store, const BvhNode* nodes, size_t nodesCount,
+                 const PrimitiveRef* primitives, size_t primitivesCount)
+{
+    assert(nodes);
+    assert(primitives || primitivesCount == 0);
+
+    m_Store     = &store;
+    m_NodesUsed = (uint32_t) nodesCount + 1;
+    m_BuildTime = 0;
+    m_RefitTime = 0;
+
+    m_Nodes.map(nodes, nodesCount + 1);
+    m_Primitives.map(primitives, primitivesCount);
+
+    /* Only needed for refitting */
+    m_Bounds.clear();
+    m_Centroids.clear();
+    m_PrimitiveLeaves.clear();
+    m_Parents.clear();
+    m_SphereSlots.clear();
+    m_TriangleSlots.clear();
+}
+
+bool Bvh::isBuiltFor(const PrimitiveStore& store) const
+{
+    return !m_Nodes.empty() && !m_Nodes.isMapped() && m_Store == &store &&
+           m_SphereSlots.size()   == store.getSpheresCount() &&
+           m_TriangleSlots.size() == store.getTrianglesCount();
+}
+
+//------------------------------------------------------------------------------
+//! @brief Recalculate node's bounds from its primitives or its children.
+//------------------------------------------------------------------------------
+void Bvh::refitNode(uint32_t nodeIdx)
+{
+    BvhNode& node = m_Nodes[nodeIdx];
+
+    if (node.isLeaf())
+    {
+        updateNodeBounds(nodeIdx);
+        return;
+    }
+
+    Aabb bounds = {m_Nodes[node.leftOrFirst].boundsMin, m_Nodes[node.leftOrFirst].boundsMax};
+    bounds.grow({m_Nodes[node.leftOrFirst + 1].boundsMin, m_Nodes[node.leftOrFirst + 1].boundsMax});
+
+    node.boundsMin = bounds.min;
+    node.boundsMax = bounds.max;
+}
+
+void Bvh::refitAll()
+{
+    /* Children are always allocated after their parents */
+    for (uint32_t nodeIdx = m_NodesUsed - 1; nodeIdx != 1; nodeIdx--)
+    {
+        refitNode(nodeIdx);
+    }
+
+    refitNode(0);
+}
+
+//------------------------------------------------------------------------------
+//! @return Ray parameter at which the ray enters the node's box or FLT_MAX if
+//!         it misses the box or enters it farther than maxRayParameter.
+//------------------------------------------------------------------------------
+static inline float intersectNode(const BvhNode& node, const Ray& ray, const Vec3<float>& invDirection,
+                                  float maxRayParameter)
+{
+    float tx1  = (node.boundsMin.x - ray.from.x) * invDirection.x;
+    float tx2  = (node.boundsMax.x - ray.from.x) * invDirection.x;
+    float tMin = fminf(tx1, tx2);
+    float tMax = fmaxf(tx1, tx2);
+
+    float ty1  = (node.boundsMin.y - ray.from.y) * invDirection.y;
+    float ty2  = (node.boundsMax.y - ray.from.y) * invDirection.y;
+    tMin       = fmaxf(tMin, fminf(ty1, ty2));
+    tMax       = fminf(tMax, fmaxf(ty1, ty2));
+
+    float tz1  = (node.boundsMin.z - ray.from.z) * invDirection.z;
+    float tz2  = (node.boundsMax.z - ray.from.z) * invDirection.z;
+    tMin       = fmaxf(tMin, fminf(tz1, tz2));
+    tMax       = fminf(tMax, fmaxf(tz1, tz2));
+
+    if (tMax >= tMin && tMax > 0 && tMin < maxRayParameter)
+    {
+        return tMin;
+    }
+
+    return FLT_MAX;
+}
+
+bool Bvh::intersect(const Ray& ray, Hit* hit, BvhTraversalStats* stats, bool cullBackFaces) const
+{
+    assert(hit);
+
+    if (m_Primitives.empty())
+    {
+        return false;
+    }
+
+    Vec3<float> invDirection = {1 / ray.direction.x, 1 / ray.direction.y, 1 / ray.direction.z};
+
+    uint32_t stack[BVH_MAX_DEPTH] = {};
+    size_t   stackSize            = 0;
+
+    float    closest              = FLT_MAX;
+    bool     found                = false;
+
+    uint64_t nodesVisited         = 0;
+    uint64_t primitiveTests       = 0;
+
+    const BvhNode* node = &m_Nodes[0];
+    if (intersectNode(*node, ray, invDirection, closest) == FLT_MAX)
+    {
+        node = nullptr;
+    }
+
+    while (node != nullptr)
+    {
+        nodesVisited++;
+
+        if (node->isLeaf())
+        {
+            for (uint32_t i = 0; i < node->count; i++)
+            {
+                primitiveTests++;
+
+                /* Only front faces are visible */
+                Hit curHit = {};
+                if (m_Store->intersect(m_Primitives[node->leftOrFirst + i], ray, &curHit) &&
+                    curHit.rayParameter < closest &&
+                    (!cullBackFaces || dotProduct(ray.direction, curHit.normal) <= 0))
+                {
+                    closest = curHit.rayParameter;
+                    *hit    = curHit;
+                    found   = true;
+                }
+            }
+
+            node = stackSize > 0 ? &m_Nodes[stack[--stackSize]] : nullptr;
+            continue;
+        }
+
+        /* Visit the nearer child first, postpone the farther one */
+        uint32_t nearIdx  = node->leftOrFirst;
+        uint32_t farIdx   = node->leftOrFirst + 1;
+        float    nearDist = intersectNode(m_Nodes[nearIdx], ray, invDirection, closest);
+        float    farDist  = intersectNode(m_Nodes[farIdx],  ray, invDirection, closest);
+
+        if (farDist < nearDist)
+        {
+            std::swap(nearIdx,  farIdx);
+            std::swap(nearDist, farDist);
+        }
+
+        if (nearDist == FLT_MAX)
+        {
+            node = stackSize > 0 ? &m_Nodes[stack[--stackSize]] : nullptr;
+            continue;
+        }
+
+        node = &m_Nodes[nearIdx];
+        if (farDist != FLT_MAX)
+        {
+            assert(stackSize < BVH_MAX_DEPTH);
+            stack[stackSize++] = farIdx;
+        }
+    }
+
+    if (stats != nullptr)
+    {
+        stats->rays++;
+        stats->nodesVisited   += nodesVisited;
+        stats->primitiveTests += primitiveTests;
+    }
+
+    return found;
+}
+
+bool Bvh::intersectAny(const Ray& ray, float maxRayParameter, PrimitiveRef* occluder,
+                       BvhTraversalStats* stats) const
+{
+    if (m_Primitives.empty())
+    {
+        return false;
+    }
+
+    Vec3<float> invDirection = {1 / ray.direction.x, 1 / ray.direction.y, 1 / ray.direction.z};
+
+    uint32_t stack[BVH_MAX_DEPTH] = {};
+    size_t   stackSize            = 0;
+    bool     found                = false;
+
+    uint64_t nodesVisited         = 0;
+    uint64_t primitiveTests       = 0;
+
+    /* No ordering of children, since any hit will do */
+    if (intersectNode(m_Nodes[0], ray, invDirection, maxRayParameter) != FLT_MAX)
+    {
+        stack[stackSize++] = 0;
+    }
+
+    while (stackSize > 0 && !found)
+    {
+        const BvhNode& node = m_Nodes[stack[--stackSize]];
+        nodesVisited++;
+
+        if (node.isLeaf())
+        {
+            for (uint32_t i = 0; i < node.count; i++)
+            {
+                primitiveTests++;
+
+                PrimitiveRef primitive = m_Primitives[node.leftOrFirst + i];
+                Hit          hit       = {};
+
+                if (m_Store->intersect(primitive, ray, &hit) && hit.rayParameter < maxRayParameter)
+                {
+                    if (occluder != nullptr)
+                    {
+                        *occluder = primitive;
+                    }
+
+                    found = true;
+                    break;
+                }
+            }
+
+            continue;
+        }
+
+        for (uint32_t childIdx = node.leftOrFirst; childIdx < node.leftOrFirst + 2; childIdx++)
+        {
+            if (intersectNode(m_Nodes[childIdx], ray, invDirection, maxRayParameter) != FLT_MAX)
+            {
+                assert(stackSize < BVH_MAX_DEPTH);
+                stack[stackSize++] = childIdx;
+            }
+        }
+    }
+
+    if (stats != nullptr)
+    {
+        stats->rays++;
+        stats->nodesVisited   += nodesVisited;
+        stats->primitiveTests += primitiveTests;
+    }
+
+    return found;
+}
+
+bool Bvh::isEmpty() const
+{
+    return m_Primitives.empty();
+}
+
+size_t Bvh::getNodesCount() const
+{
+    return m_NodesUsed - 1;
+}
+
+size_t Bvh::getPrimitivesCount() const
+{
+    return m_Primitives.size();
+}
+
+const BvhNode* Bvh::getNodes() const
+{
+    return m_Nodes.data();
+}
+
+const PrimitiveRef* Bvh::getPrimitives() const
+{
+    return m_Primitives.data();
+}
+
+float Bvh::getBuildTime() const
+{
+    return m_BuildTime;
+}
+
+float Bvh::getRefitTime() const
+{
+    return m_RefitTime;
+}
+//------------------------------------------------------------------------------
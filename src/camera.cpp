@@ -26,7 +26,7 @@ ViewFrustum::ViewFrustum(float verticalFOV, float aspect, float near, float far)
 
 Camera::Camera(const ViewFrustum& viewFrustum, const Vec3<float>& pos, 
                float pitchVertical, float yawHorizontal) :
-               m_ViewFrustum(viewFrustum)
+               m_ViewFrustum(viewFrustum), m_Version(0)
 {
     setPitchVertical(pitchVertical);
     setYawHorizontal(yawHorizontal);
@@ -79,6 +79,12 @@ const ViewFrustum& Camera::getViewFrustum() const
 void Camera::setViewFrustum(const ViewFrustum& viewFrustum)
 {
     m_ViewFrustum = viewFrustum;
+    m_Version++;
+}
+
+uint64_t Camera::getVersion() const
+{
+    return m_Version;
 }
 
 void Camera::updateViewMatrix()
@@ -89,6 +95,31 @@ void Camera::updateViewMatrix()
     Vec3<float> direction = rotationMatrix * originalDirection;
 
     m_ViewMatrix = lookAt(m_Pos.worldSpace, direction);
+    m_Version++;
+
+    Vec3<float> origin = m_ViewMatrix * m_Pos.worldSpace;
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        Vec3<float> worldAxis = {0, 0, 0};
+        worldAxis.getCoord(axis) = 1;
+
+        m_WorldAxes[axis] = m_ViewMatrix * (m_Pos.worldSpace + worldAxis) - origin;
+    }
+}
+
+Vec3<float> Camera::toWorldDirection(const Vec3<float>& cameraDirection) const
+{
+    // Rotation is orthonormal, so its inverse is the transpose
+    return {dotProduct(m_WorldAxes[0], cameraDirection),
+            dotProduct(m_WorldAxes[1], cameraDirection),
+            dotProduct(m_WorldAxes[2], cameraDirection)};
+}
+
+Vec3<float> Camera::toCameraDirection(const Vec3<float>& worldDirection) const
+{
+    return worldDirection.x * m_WorldAxes[0] + 
+           worldDirection.y * m_WorldAxes[1] + 
+           worldDirection.z * m_WorldAxes[2];
 }
 
 Vec2<float> toPixel(const Vec3<float>& point,
@@ -116,4 +147,40 @@ Vec3<float> toViewFrustumPoint(const Vec2<float>& pixel,
     point.z = frustum.near;
 
     return point; 
+}
+
+NearPlaneGrid::NearPlaneGrid() : near(0), pixelWidth(0), pixelHeight(0), m_Frustum(0, 0, 0, 0, 0, 0) {}
+
+bool NearPlaneGrid::update(size_t width, size_t height, const ViewFrustum& frustum)
+{
+    if (xs.size()          == width          && ys.size()        == height        &&
+        m_Frustum.left     == frustum.left   && m_Frustum.right  == frustum.right &&
+        m_Frustum.bottom   == frustum.bottom && m_Frustum.top    == frustum.top   &&
+        m_Frustum.near     == frustum.near)
+    {
+        return false;
+    }
+
+    m_Frustum = frustum;
+    near      = frustum.near;
+
+    float fwidth  = (float) width;
+    float fheight = (float) height;
+
+    pixelWidth  = (frustum.right - frustum.left)   / fwidth;
+    pixelHeight = (frustum.top   - frustum.bottom) / fheight;
+
+    xs.resize(width);
+    for (size_t x = 0; x < width; x++)
+    {
+        xs[x] = toViewFrustumPoint({(float) x, 0}, fwidth, fheight, frustum).x;
+    }
+
+    ys.resize(height);
+    for (size_t y = 0; y < height; y++)
+    {
+        ys[y] = toViewFrustumPoint({0, (float) y}, fwidth, fheight, frustum).y;
+    }
+
+    return true;
 }
\ No newline at end of file
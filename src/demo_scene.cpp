@@ -0,0 +1,74 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file demo_scene.cpp
+//! @date 2021-10-26
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include "demo_scene.h"
+
+static const Vec3<float> LIGHT1_DIFFUSE  = {0.9f, 0.9f, 0.6f};
+static const Vec3<float> LIGHT1_SPECULAR = {0.1f, 0.1f, 0.1f};
+
+static const Vec3<float> LIGHT2_DIFFUSE  = {0.6f, 0.6f, 1.0f};
+static const Vec3<float> LIGHT2_SPECULAR = {0.4f, 0.4f, 0.8f};
+
+static const Vec3<float> AMBIENT_COLOR   = {0.5f, 0.5f, 0.5f};
+
+static const Material    SPHERE_MATERIAL = {{0.3f, 0.1f, 0.1f},
+                                            {0.9f, 0.7f, 0.7f},
+                                            {0.5f, 0.5f, 0.5f},
+                                            50};
+
+static const Material    MIRROR_MATERIAL = {{0.1f, 0.1f, 0.1f},
+                                            {0.3f, 0.3f, 0.3f},
+                                            {0.9f, 0.9f, 0.9f},
+                                            200, 0.7f};
+
+static const Material    GLASS_MATERIAL  = {{0.0f, 0.0f, 0.0f},
+                                            {0.1f, 0.1f, 0.1f},
+                                            {0.9f, 0.9f, 0.9f},
+                                            200, 0, 0.9f, 1.5f};
+
+DemoScene::DemoScene(const ViewFrustum& viewFrustum) :
+                     camera(viewFrustum), sphere1(&SPHERE_MATERIAL), sphere2(&MIRROR_MATERIAL),
+                     sphere3(&GLASS_MATERIAL),
+                     scene(camera), m_Light1Rotation(createRotationMatrixYZ(0.1f)),
+                     m_Light2Rotation(createRotationMatrixZX(0.05f))
+{
+    /* ================ Entities ================ */
+    sphere1.setPos({25, 0, 0});
+    sphere1.setScale(5);
+
+    sphere2.setPos({25, 3, 10});
+    sphere2.setScale(3);
+
+    sphere3.setPos({15, -2, -6});
+    sphere3.setScale(2);
+
+    /* ================ Lights ================ */
+    light1.pos.worldSpace = {0, 50, 10};
+    light1.brightness     = 1;
+    light1.diffuse        = LIGHT1_DIFFUSE;
+    light1.specular       = LIGHT1_SPECULAR;
+
+    light2.pos.worldSpace = {50, 0, 0};
+    light2.brightness     = 1;
+    light2.diffuse        = LIGHT2_DIFFUSE;
+    light2.specular       = LIGHT2_SPECULAR;
+
+    /* ================ Scene ================ */
+    scene.lightSources.insert(&light1);
+    scene.lightSources.insert(&light2);
+    scene.addObject(&sphere1);
+    scene.addObject(&sphere2);
+    scene.addObject(&sphere3);
+    scene.ambientColor = AMBIENT_COLOR;
+}
+
+void DemoScene::animate()
+{
+    light1.pos.worldSpace = m_Light1Rotation * light1.pos.worldSpace;
+    light2.pos.worldSpace = m_Light2Rotation * light2.pos.worldSpace;
+}
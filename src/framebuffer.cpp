@@ -0,0 +1,37 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file framebuffer.cpp
+//! @date 2021-10-26
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include "framebuffer.h"
+
+/* Rows are padded to whole cache lines, so that tiles, whose widths are
+   multiples of TILE_ALIGNMENT, don't share lines with their neighbours
+   whatever the frame's width is */
+FrameBuffer::FrameBuffer(size_t width, size_t height)
+    : width(width), height(height),
+      stride((width * sizeof(Color) + FRAMEBUFFER_ALIGNMENT - 1) / FRAMEBUFFER_ALIGNMENT *
+             FRAMEBUFFER_ALIGNMENT / sizeof(Color))
+{
+    pixels = (Color*) aligned_alloc(FRAMEBUFFER_ALIGNMENT, stride * height * sizeof(Color));
+    assert(pixels);
+
+    clear(COLOR_BLACK);
+}
+
+FrameBuffer::~FrameBuffer()
+{
+    free(pixels);
+}
+
+void FrameBuffer::clear(Color color)
+{
+    for (size_t i = 0; i < stride * height; i++)
+    {
+        pixels[i] = color;
+    }
+}
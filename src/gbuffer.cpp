@@ -0,0 +1,76 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file gbuffer.cpp
+//! @date 2021-11-09
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include "gbuffer.h"
+
+//--------------------------------GBufferBlock----------------------------------
+void GBufferBlock::reset()
+{
+    for (size_t lane = 0; lane < RAY_PACKET_SIZE; lane++)
+    {
+        depth[lane]    = GBUFFER_EMPTY_DEPTH;
+
+        posX[lane]     = 0;
+        posY[lane]     = 0;
+        posZ[lane]     = 0;
+
+        normalX[lane]  = 0;
+        normalY[lane]  = 0;
+        normalZ[lane]  = 0;
+
+        material[lane] = GBUFFER_NO_MATERIAL;
+    }
+}
+
+void GBufferBlock::setHit(size_t lane, const Hit& hit)
+{
+    assert(lane < RAY_PACKET_SIZE);
+
+    depth[lane]    = hit.pos.z;
+
+    posX[lane]     = hit.pos.x;
+    posY[lane]     = hit.pos.y;
+    posZ[lane]     = hit.pos.z;
+
+    normalX[lane]  = hit.normal.x;
+    normalY[lane]  = hit.normal.y;
+    normalZ[lane]  = hit.normal.z;
+
+    material[lane] = hit.materialIdx;
+}
+
+Hit GBufferBlock::getHit(size_t lane) const
+{
+    assert(lane < RAY_PACKET_SIZE);
+
+    Hit hit = {};
+    hit.pos    = {posX[lane],    posY[lane],    posZ[lane]};
+    hit.normal = {normalX[lane], normalY[lane], normalZ[lane]};
+
+    return hit;
+}
+//------------------------------------------------------------------------------
+
+GBuffer::GBuffer() : width(0), height(0), blocksPerRow(0) {}
+
+bool GBuffer::update(size_t screenWidth, size_t screenHeight)
+{
+    if (width == screenWidth && height == screenHeight)
+    {
+        return false;
+    }
+
+    width        = screenWidth;
+    height       = screenHeight;
+    blocksPerRow = (width + RAY_PACKET_SIZE - 1) / RAY_PACKET_SIZE;
+
+    blocks.resize(blocksPerRow * height);
+
+    return true;
+}
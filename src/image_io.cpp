@@ -0,0 +1,331 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file image_io.cpp
+//! @date 2021-10-26
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "image_io.h"
+
+static const size_t PNG_MAX_STORED_BLOCK = 65535;
+
+static const char*  IMAGE_EXTENSIONS[IMAGE_FORMAT_UNKNOWN] = {".ppm", ".png", ".exr"};
+
+//------------------------------------------------------------------------------
+//! @brief Color's channel, 0 is red, 1 is green, 2 is blue, 3 is alpha.
+//------------------------------------------------------------------------------
+static inline uint8_t getChannel(Color color, size_t channel)
+{
+    return (uint8_t) (color >> (24 - 8 * channel));
+}
+
+ImageFormat getImageFormat(const char* fileName)
+{
+    assert(fileName);
+
+    const char* extension = strrchr(fileName, '.');
+    if (extension == nullptr)
+    {
+        return IMAGE_FORMAT_UNKNOWN;
+    }
+
+    for (size_t format = 0; format < IMAGE_FORMAT_UNKNOWN; format++)
+    {
+        if (strcmp(extension, IMAGE_EXTENSIONS[format]) == 0)
+        {
+            return (ImageFormat) format;
+        }
+    }
+
+    return IMAGE_FORMAT_UNKNOWN;
+}
+
+bool writeImage(const FrameBuffer& image, const char* fileName)
+{
+    switch (getImageFormat(fileName))
+    {
+        case IMAGE_FORMAT_PPM: { return writePpm(image, fileName); }
+        case IMAGE_FORMAT_PNG: { return writePng(image, fileName); }
+        case IMAGE_FORMAT_EXR: { return writeExr(image, fileName); }
+
+        default: { return false; }
+    }
+}
+
+//------------------------------------------------------------------------------
+//! @brief Write the whole buffer to a new file.
+//------------------------------------------------------------------------------
+static bool writeFile(const char* fileName, const std::vector<uint8_t>& data)
+{
+    FILE* file = fopen(fileName, "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+    return fclose(file) == 0 && written;
+}
+
+//-------------------------------------PPM--------------------------------------
+bool writePpm(const FrameBuffer& image, const char* fileName)
+{
+    char header[64] = {};
+    int  headerSize = snprintf(header, sizeof(header), "P6\n%zu %zu\n255\n", image.width, image.height);
+
+    std::vector<uint8_t> data(header, header + headerSize);
+    data.reserve(headerSize + 3 * image.width * image.height);
+
+    for (size_t y = 0; y < image.height; y++)
+    {
+        const Color* row = image[y];
+
+        for (size_t x = 0; x < image.width; x++)
+        {
+            data.push_back(getChannel(row[x], 0));
+            data.push_back(getChannel(row[x], 1));
+            data.push_back(getChannel(row[x], 2));
+        }
+    }
+
+    return writeFile(fileName, data);
+}
+//------------------------------------------------------------------------------
+
+//-------------------------------------PNG--------------------------------------
+static void pushBigEndian32(std::vector<uint8_t>& data, uint32_t value)
+{
+    data.push_back((uint8_t) (value >> 24));
+    data.push_back((uint8_t) (value >> 16));
+    data.push_back((uint8_t) (value >> 8));
+    data.push_back((uint8_t) value);
+}
+
+static uint32_t updateCrc32(uint32_t crc, const uint8_t* bytes, size_t size)
+{
+    static uint32_t table[256] = {};
+    static bool     tableReady = false;
+
+    if (!tableReady)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t value = i;
+            for (size_t bit = 0; bit < 8; bit++)
+            {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+
+            table[i] = value;
+        }
+
+        tableReady = true;
+    }
+
+    for (size_t i = 0; i < size; i++)
+    {
+        crc = table[(crc ^ bytes[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static void pushPngChunk(std::vector<uint8_t>& data, const char* type, const std::vector<uint8_t>& content)
+{
+    pushBigEndian32(data, (uint32_t) content.size());
+
+    size_t typeStart = data.size();
+    data.insert(data.end(), type, type + 4);
+    data.insert(data.end(), content.begin(), content.end());
+
+    uint32_t crc = updateCrc32(0xFFFFFFFFu, data.data() + typeStart, data.size() - typeStart);
+    pushBigEndian32(data, crc ^ 0xFFFFFFFFu);
+}
+
+bool writePng(const FrameBuffer& image, const char* fileName)
+{
+    static const uint8_t SIGNATURE[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+    std::vector<uint8_t> data(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+
+    /* Header: 8-bit RGB, no interlacing */
+    std::vector<uint8_t> header;
+    pushBigEndian32(header, (uint32_t) image.width);
+    pushBigEndian32(header, (uint32_t) image.height);
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    pushPngChunk(data, "IHDR", header);
+
+    /* Scanlines, each starting with filter type 0 (none) */
+    std::vector<uint8_t> raw;
+    raw.reserve((1 + 3 * image.width) * image.height);
+
+    for (size_t y = 0; y < image.height; y++)
+    {
+        const Color* row = image[y];
+
+        raw.push_back(0);
+        for (size_t x = 0; x < image.width; x++)
+        {
+            raw.push_back(getChannel(row[x], 0));
+            raw.push_back(getChannel(row[x], 1));
+            raw.push_back(getChannel(row[x], 2));
+        }
+    }
+
+    /* Zlib stream of stored deflate blocks followed by Adler-32 */
+    std::vector<uint8_t> zlib = {0x78, 0x01};
+    zlib.reserve(raw.size() + raw.size() / PNG_MAX_STORED_BLOCK * 5 + 16);
+
+    size_t offset = 0;
+    do
+    {
+        size_t   blockSize = raw.size() - offset < PNG_MAX_STORED_BLOCK ? raw.size() - offset : PNG_MAX_STORED_BLOCK;
+        bool     isLast    = offset + blockSize == raw.size();
+        uint16_t length    = (uint16_t) blockSize;
+
+        zlib.push_back(isLast ? 1 : 0);
+        zlib.push_back((uint8_t) length);
+        zlib.push_back((uint8_t) (length >> 8));
+        zlib.push_back((uint8_t) ~length);
+        zlib.push_back((uint8_t) (~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+
+        offset += blockSize;
+    } while (offset < raw.size());
+
+    uint32_t adlerA = 1;
+    uint32_t adlerB = 0;
+    for (uint8_t byte : raw)
+    {
+        adlerA = (adlerA + byte) % 65521;
+        adlerB = (adlerB + adlerA) % 65521;
+    }
+
+    pushBigEndian32(zlib, adlerB << 16 | adlerA);
+
+    pushPngChunk(data, "IDAT", zlib);
+    pushPngChunk(data, "IEND", {});
+
+    return writeFile(fileName, data);
+}
+//------------------------------------------------------------------------------
+
+//-------------------------------------EXR--------------------------------------
+static void pushLittleEndian32(std::vector<uint8_t>& data, uint32_t value)
+{
+    data.push_back((uint8_t) value);
+    data.push_back((uint8_t) (value >> 8));
+    data.push_back((uint8_t) (value >> 16));
+    data.push_back((uint8_t) (value >> 24));
+}
+
+static void pushLittleEndian64(std::vector<uint8_t>& data, uint64_t value)
+{
+    pushLittleEndian32(data, (uint32_t) value);
+    pushLittleEndian32(data, (uint32_t) (value >> 32));
+}
+
+static void pushLittleEndianFloat(std::vector<uint8_t>& data, float value)
+{
+    uint32_t bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+
+    pushLittleEndian32(data, bits);
+}
+
+static void pushExrAttribute(std::vector<uint8_t>& data, const char* name, const char* type, uint32_t size)
+{
+    data.insert(data.end(), name, name + strlen(name) + 1);
+    data.insert(data.end(), type, type + strlen(type) + 1);
+    pushLittleEndian32(data, size);
+}
+
+bool writeExr(const FrameBuffer& image, const char* fileName)
+{
+    static const uint32_t EXR_MAGIC            = 20000630;
+    static const uint32_t EXR_VERSION          = 2;
+    static const uint32_t EXR_PIXEL_TYPE_FLOAT = 2;
+
+    /* Channels must be sorted by name, they are stored as B, G, R */
+    static const char*    CHANNEL_NAMES[]      = {"B", "G", "R"};
+    static const size_t   CHANNEL_COLORS[]     = {2, 1, 0};
+    static const size_t   CHANNELS_COUNT       = 3;
+
+    std::vector<uint8_t> data;
+    pushLittleEndian32(data, EXR_MAGIC);
+    pushLittleEndian32(data, EXR_VERSION);
+
+    pushExrAttribute(data, "channels", "chlist", CHANNELS_COUNT * 18 + 1);
+    for (size_t channel = 0; channel < CHANNELS_COUNT; channel++)
+    {
+        data.insert(data.end(), CHANNEL_NAMES[channel], CHANNEL_NAMES[channel] + 2);
+        pushLittleEndian32(data, EXR_PIXEL_TYPE_FLOAT);
+        data.insert(data.end(), {0, 0, 0, 0}); // pLinear and reserved
+        pushLittleEndian32(data, 1);           // xSampling
+        pushLittleEndian32(data, 1);           // ySampling
+    }
+    data.push_back(0);
+
+    pushExrAttribute(data, "compression", "compression", 1);
+    data.push_back(0);
+
+    for (const char* window : {"dataWindow", "displayWindow"})
+    {
+        pushExrAttribute(data, window, "box2i", 16);
+        pushLittleEndian32(data, 0);
+        pushLittleEndian32(data, 0);
+        pushLittleEndian32(data, (uint32_t) image.width - 1);
+        pushLittleEndian32(data, (uint32_t) image.height - 1);
+    }
+
+    pushExrAttribute(data, "lineOrder", "lineOrder", 1);
+    data.push_back(0); // Increasing y
+
+    pushExrAttribute(data, "pixelAspectRatio", "float", 4);
+    pushLittleEndianFloat(data, 1);
+
+    pushExrAttribute(data, "screenWindowCenter", "v2f", 8);
+    pushLittleEndianFloat(data, 0);
+    pushLittleEndianFloat(data, 0);
+
+    pushExrAttribute(data, "screenWindowWidth", "float", 4);
+    pushLittleEndianFloat(data, 1);
+
+    data.push_back(0); // End of header
+
+    /* Offset table, a scanline per chunk */
+    uint32_t lineBytes  = (uint32_t) (CHANNELS_COUNT * image.width * sizeof(float));
+    uint64_t lineOffset = data.size() + image.height * sizeof(uint64_t);
+
+    for (size_t y = 0; y < image.height; y++)
+    {
+        pushLittleEndian64(data, lineOffset);
+        lineOffset += 2 * sizeof(int32_t) + lineBytes;
+    }
+
+    data.reserve(lineOffset);
+
+    for (size_t y = 0; y < image.height; y++)
+    {
+        const Color* row = image[y];
+
+        pushLittleEndian32(data, (uint32_t) y);
+        pushLittleEndian32(data, lineBytes);
+
+        for (size_t channel = 0; channel < CHANNELS_COUNT; channel++)
+        {
+            for (size_t x = 0; x < image.width; x++)
+            {
+                pushLittleEndianFloat(data, getChannel(row[x], CHANNEL_COLORS[channel]) / 255.0f);
+            }
+        }
+    }
+
+    return writeFile(fileName, data);
+}
+//------------------------------------------------------------------------------
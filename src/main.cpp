@@ -6,14 +6,24 @@
 //! @copyright Copyright (c) 2021
 //------------------------------------------------------------------------------
 
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include "sml/sml_graphics_wrapper.h"
 #include "ray_tracer.h"
+#include "render_thread.h"
+#include "triple_buffer.h"
+#include "demo_scene.h"
+#include "scene_file.h"
+#include "profiler.h"
 
 static const size_t      WINDOW_WIDTH              = 1200;
 static const size_t      WINDOW_HEIGHT             = 800;
 static const char*       WINDOW_TITLE              = "Ray-tracing";
-static const size_t      MAX_WINDOW_TITLE_LENGTH   = 128;
-static const Color       BACKGROUND_COLOR          = 0x2F'69'AA'FF; 
+static const size_t      MAX_WINDOW_TITLE_LENGTH   = 256;
+static const char*       TRACE_FILE_NAME           = "ray_tracer_trace.json"; // With ENABLE_PROFILING only
 
 static const float       FOV                       = 0.78f; // Approx 45 degrees
 static const float       ASPECT                    = (float) WINDOW_WIDTH / (float) WINDOW_HEIGHT;
@@ -21,29 +31,53 @@ static const float       NEAR                      = 1;
 static const float       FAR                       = 600;
 static const ViewFrustum VIEW_FRUSTUM              = {FOV, ASPECT, NEAR, FAR};
 
-static const Vec3<float> LIGHT1_DIFFUSE            = {0.9f, 0.9f, 0.6f};
-static const Vec3<float> LIGHT1_SPECULAR           = {0.1f, 0.1f, 0.1f};
+static const size_t      RENDER_THREADS_COUNT      = 0; // One per hardware core
+static const size_t      RENDER_TILE_SIZE          = 32;
 
-static const Vec3<float> LIGHT2_DIFFUSE            = {0.6f, 0.6f, 1.0f};
-static const Vec3<float> LIGHT2_SPECULAR           = {0.4f, 0.4f, 0.8f};
+static const size_t      INPUT_RATE                = 500;   // Camera's input is sampled this many times a second
+static const float       CAMERA_VELOCITY           = 10.0f; // Per second
+static const float       MOUSE_SENSITIVITY         = 3e-4f; // Radians per pixel of mouse motion
+static const float       CAMERA_VERTICAL_ANGLE_MAX = 1.2f;
 
-static const Vec3<float> AMBIENT_COLOR             = {0.5f, 0.5f, 0.5f};
+typedef std::chrono::steady_clock Clock;
 
-static const Material    SPHERE_MATERIAL           = {{0.3f, 0.1f, 0.1f},
-                                                      {0.9f, 0.7f, 0.7f},
-                                                      {0.5f, 0.5f, 0.5f},
-                                                      50};
+//------------------------------------------------------------------------------
+//! @brief Camera's position and orientation integrated by the input loop and
+//!        handed over to the render thread at the start of each frame.
+//------------------------------------------------------------------------------
+struct CameraPose
+{
+    Vec3<float>       pos;
+    float             pitch;
+    float             yaw;
+    Clock::time_point inputTime; ///< When the input that has moved the camera here was sampled.
+};
+
+bool processKeyboard(CameraPose* pose, float deltaTime);
+bool processMouse(const SDL_Event& event, CameraPose* pose);
+void processKey(SDL_Scancode key, RayTracer& rayTracer, AccumulationBuffer& accumulation, bool* animate);
+void updateFpsTitle(Window& window, float frameTime, float inputLatency, const RayTracer& rayTracer);
+void uploadFrame(const FrameBuffer& frame, BufferedTexture& texture);
 
-static const float       CAMERA_VELOCITY           = 10.0f;
-static const float       MOUSE_SENSITIVITY         = 1e-2f;
-static const float       CAMERA_VERTICAL_ANGLE_MAX = 1.2f;
+//------------------------------------------------------------------------------
+//! @brief Usage: ray-tracer.out [SCENE], where SCENE is a scene description
+//!        rendered instead of the demo scene, see SceneFile.
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    /* ================ Scene ================ */
+    DemoScene demo(VIEW_FRUSTUM);
+    SceneFile sceneFile(VIEW_FRUSTUM);
 
-void processKeyboard(const Window& window, Scene& scene, uint32_t deltaTime);
-void processMouse(const SDL_Event& event, Scene& scene, uint32_t deltaTime);
-void updateFpsTitle(Window& window, uint32_t frameTime);
+    bool      fromFile = argc > 1;
+    Scene&    scene    = fromFile ? sceneFile.scene : demo.scene;
+
+    if (fromFile && !sceneFile.load(argv[1]))
+    {
+        fprintf(stderr, "Couldn't load scene '%s' (line %zu)\n", argv[1], sceneFile.getErrorLine());
+        return -1;
+    }
 
-int main()
-{
     initGraphics();
 
     if (SDL_SetRelativeMouseMode(SDL_TRUE) != 0)
@@ -54,56 +88,82 @@ int main()
     Window window(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE);
     Renderer renderer(window);
 
-    /* ================ Entities ================ */
-    Sphere sphere1(&SPHERE_MATERIAL);
-    sphere1.pos.worldSpace = {25, 0, 0};
-    sphere1.scale          = 5;
-
-    Sphere sphere2(&SPHERE_MATERIAL);
-    sphere2.pos.worldSpace = {25, 3, 10};
-    sphere2.scale          = 3;
-
-    /* ================ Scene ================ */
-    Camera camera(VIEW_FRUSTUM);
-    
-    Light light1;
-    light1.pos.worldSpace = {0, 50, 10};
-    light1.brightness     = 1;
-    light1.diffuse        = LIGHT1_DIFFUSE;
-    light1.specular       = LIGHT1_SPECULAR;
-    Mat4<float> light1Rot = createRotationMatrixYZ(0.1f);
-
-    Light light2;
-    light2.pos.worldSpace = {50, 0, 0};
-    light2.brightness     = 1;
-    light2.diffuse        = LIGHT2_DIFFUSE;
-    light2.specular       = LIGHT2_SPECULAR;
-    Mat4<float> light2Rot = createRotationMatrixZX(0.05f);
-
-    Scene scene(camera);
-    scene.lightSources.insert(&light1);
-    scene.lightSources.insert(&light2);
-    scene.objects.pushBack(&sphere1);
-    scene.objects.pushBack(&sphere2);
-    scene.ambientColor = AMBIENT_COLOR;
-
     /* ================ Ray tracer ================ */
     BufferedTexture bufferedTexture(renderer, WINDOW_WIDTH, WINDOW_HEIGHT);
+    FrameBuffer firstFrame(WINDOW_WIDTH, WINDOW_HEIGHT);
+    FrameBuffer secondFrame(WINDOW_WIDTH, WINDOW_HEIGHT);
+    AccumulationBuffer accumulation(WINDOW_WIDTH, WINDOW_HEIGHT);
     ZBuffer zbuffer(WINDOW_WIDTH, WINDOW_HEIGHT);
-    RayTracer rayTracer = {&scene, &bufferedTexture, &zbuffer};
+    TileScheduler scheduler(RENDER_THREADS_COUNT);
+    RayTracer rayTracer = {&scene, &firstFrame, &zbuffer, &scheduler};
+    rayTracer.tileSize          = RENDER_TILE_SIZE;
+    rayTracer.useBvh            = true;
+    rayTracer.traceInWorldSpace = true;
+    rayTracer.enableShadows     = true;
+    rayTracer.accumulation      = &accumulation;
+
+    RenderThread renderThread(rayTracer, firstFrame, secondFrame);
 
     /* ================ Main loop ================ */
-    SDL_Event event     = {};
-    bool      running   = true;
-    uint32_t  deltaTime = 0;
+    /* The main thread samples input at INPUT_RATE and keeps moving the camera
+       while a frame is being rendered, the render thread takes the latest pose
+       once the next frame starts */
+    const Clock::duration inputTick = std::chrono::microseconds(1000000 / INPUT_RATE);
+    const float           tickTime  = 1.0f / INPUT_RATE;
 
-    while (running)
+    CameraPose pose = {scene.camera.getPos().worldSpace, scene.camera.getPitchVertical(),
+                       scene.camera.getYawHorizontal(), Clock::now()};
+
+    TripleBuffer<CameraPose> latestPose(pose);
+    Clock::time_point        frameInputTime = pose.inputTime; // Of the pose the last frame has been rendered with
+
+    /* Called on the render thread */
+    auto renderFrame = [&latestPose, &frameInputTime, &scene, &zbuffer, &rayTracer]()
     {
-        // SDL_WarpMouseInWindow(window.getNativeWindow(), WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2);
-        uint32_t frameStartTime = SDL_GetTicks();
+        bool              isFresh     = false;
+        const CameraPose& currentPose = latestPose.read(&isFresh);
+
+        /* Only set on changes, as setting the camera restarts accumulation */
+        if (isFresh)
+        {
+            scene.camera.setPos(currentPose.pos);
+            scene.camera.setPitchVertical(currentPose.pitch);
+            scene.camera.setYawHorizontal(currentPose.yaw);
+        }
+
+        frameInputTime = currentPose.inputTime;
+
+        scene.updateWorldSpaceValues();
+
+        if (rayTracer.needsCameraSpaceValues())
+        {
+            scene.updateCameraSpaceValues();
+        }
+        else
+        {
+            scene.invalidateCameraSpaceValues();
+        }
 
+        zbuffer.reset();
+        rayTracer.renderScene();
+    };
+
+    SDL_Event                 event          = {};
+    bool                      running        = true;
+    bool                      animate        = true;
+    std::vector<SDL_Scancode> pendingKeys;   // Change rendering options, so are applied between frames
+    Clock::time_point         shownInputTime = pose.inputTime;
+    float                     inputLatency   = 0;
+    float                     frameTime      = 0;
+    Clock::time_point         lastPresent    = Clock::now();
+    Clock::time_point         nextTick       = Clock::now();
+
+    renderThread.startFrame(renderFrame);
+
+    while (running)
+    {
         /* ================ Process events ================ */
-        processKeyboard(window, scene, deltaTime);
+        bool moved = false;
 
         while (SDL_PollEvent(&event))
         {
@@ -121,13 +181,17 @@ int main()
                     {
                         running = false;
                     }
+                    else
+                    {
+                        pendingKeys.push_back(event.key.keysym.scancode);
+                    }
 
                     break;
                 }
 
                 case SDL_MOUSEMOTION:
                 {
-                    processMouse(event, scene, deltaTime);
+                    moved |= processMouse(event, &pose);
                     break;
                 }
 
@@ -135,80 +199,142 @@ int main()
             }
         }
 
-        /* ================ Update objects ================ */
-        light1.pos.worldSpace = light1Rot * light1.pos.worldSpace;
-        light2.pos.worldSpace = light2Rot * light2.pos.worldSpace;
+        /* ================ Move camera ================ */
+        /* A fixed step per elapsed tick, so that speed doesn't depend on frames */
+        Clock::time_point now = Clock::now();
+        for (; nextTick <= now; nextTick += inputTick)
+        {
+            moved |= processKeyboard(&pose, tickTime);
+        }
+
+        if (moved)
+        {
+            pose.inputTime = now;
+            latestPose.write(pose);
+        }
 
         /* ================ Rendering ================ */
-        renderer.setColor(BACKGROUND_COLOR);
-        renderer.clear();
+        if (renderThread.isFrameFinished())
+        {
+            bool              newFrame          = renderThread.finishFrame();
+            Clock::time_point renderedInputTime = frameInputTime;
 
-        scene.updateWorldSpaceValues();
-        scene.updateCameraSpaceValues();
+            PROFILE_END_FRAME();
 
-        zbuffer.reset();
-        rayTracer.renderScene();
-        bufferedTexture.updateTexture();
+            /* The ray tracer is idle until the next frame starts */
+            updateFpsTitle(window, frameTime, inputLatency, rayTracer);
+
+            for (SDL_Scancode key : pendingKeys)
+            {
+                processKey(key, rayTracer, accumulation, &animate);
+            }
+
+            pendingKeys.clear();
+
+            if (animate && !fromFile)
+            {
+                demo.animate();
+            }
+
+            renderThread.startFrame(renderFrame);
+
+            /* The frame just finished is presented while the next one is being
+               rendered, the texture covers the whole window, so it isn't cleared */
+            if (newFrame)
+            {
+                uploadFrame(renderThread.getFrontBuffer(), bufferedTexture);
+            }
+
+            {
+                PROFILE_SCOPE("present");
+                renderer.renderTexture(bufferedTexture.getTexture(), {0, 0});
+                renderer.present();
+            }
+
+            Clock::time_point presentTime = Clock::now();
 
-        renderer.renderTexture(bufferedTexture.getTexture(), {0, 0});
-        renderer.present();
+            /* Only frames showing the camera moved by new input are measured */
+            if (newFrame && renderedInputTime != shownInputTime)
+            {
+                std::chrono::duration<float, std::milli> latency = presentTime - renderedInputTime;
+
+                inputLatency   = latency.count();
+                shownInputTime = renderedInputTime;
+                PROFILE_COUNT(PROFILE_COUNTER_INPUT_LATENCY, (uint64_t) (1e3f * inputLatency));
+            }
 
-        /* ================ Update fps title ================ */
-        deltaTime = SDL_GetTicks() - frameStartTime;
-        updateFpsTitle(window, deltaTime);
+            std::chrono::duration<float, std::milli> presentInterval = presentTime - lastPresent;
+
+            frameTime   = presentInterval.count();
+            lastPresent = presentTime;
+        }
+
+        std::this_thread::sleep_until(nextTick);
+    }
+
+    if (renderThread.isRendering())
+    {
+        renderThread.finishFrame();
     }
 
     quitGraphics();
 
+    PROFILE_WRITE_TRACE(TRACE_FILE_NAME);
+
     return 0;
 }
 
-void processKeyboard(const Window& window, Scene& scene, uint32_t deltaTime)
+bool processKeyboard(CameraPose* pose, float deltaTime)
 {
+    assert(pose);
+
     const uint8_t* keystate = SDL_GetKeyboardState(nullptr);
     assert(keystate);
 
     Vec3<float> velocityDirection = {0};
-    Vec3<float> forward = createRotationMatrix(scene.camera.getPitchVertical(), 
-                                               scene.camera.getYawHorizontal(), 
-                                               0) * 
-                          Vec3{1.0f, 0.0f, 0.0f};
+    Vec3<float> forward = createRotationMatrix(pose->pitch, pose->yaw, 0) * Vec3{1.0f, 0.0f, 0.0f};
+    bool        moved   = false;
 
     if (keystate[SDL_SCANCODE_W])
     {
         velocityDirection += normalize(forward);
+        moved = true;
     } 
     
     if (keystate[SDL_SCANCODE_S])
     {
         velocityDirection -= normalize(forward);
+        moved = true;
     }
 
     if (keystate[SDL_SCANCODE_D])
     {
         velocityDirection += crossProduct(Vec3<float>{0, 1, 0}, 
                                           normalize(forward));
+        moved = true;
     }
 
     if (keystate[SDL_SCANCODE_A])
     {
         velocityDirection -= crossProduct(Vec3<float>{0, 1, 0}, 
                                           normalize(forward));
+        moved = true;
     }
 
-    scene.camera.setPos(scene.camera.getPos().worldSpace + 
-                        velocityDirection * ((float) deltaTime / 1e3f) * CAMERA_VELOCITY);
+    pose->pos += velocityDirection * deltaTime * CAMERA_VELOCITY;
+
+    return moved;
 }
 
-void processMouse(const SDL_Event& event, Scene& scene, uint32_t deltaTime)
+bool processMouse(const SDL_Event& event, CameraPose* pose)
 {
-    Camera& camera = scene.camera;
+    assert(pose);
 
+    /* Motion is a distance already, so it isn't scaled by time */
     Vec2<float> mouseDelta = {event.motion.xrel, -event.motion.yrel};
-    mouseDelta *= MOUSE_SENSITIVITY * ((float) deltaTime / 1e3f);
+    mouseDelta *= MOUSE_SENSITIVITY;
 
-    float newPitch = camera.getPitchVertical() + mouseDelta.y;
-    float newYaw   = camera.getYawHorizontal() + mouseDelta.x;
+    float newPitch = pose->pitch + mouseDelta.y;
 
     if (newPitch > CAMERA_VERTICAL_ANGLE_MAX)
     {
@@ -219,17 +345,144 @@ void processMouse(const SDL_Event& event, Scene& scene, uint32_t deltaTime)
         newPitch = -CAMERA_VERTICAL_ANGLE_MAX;
     }
 
-    camera.setPitchVertical(newPitch);
-    camera.setYawHorizontal(newYaw);
+    pose->pitch = newPitch;
+    pose->yaw  += mouseDelta.x;
+
+    return event.motion.xrel != 0 || event.motion.yrel != 0;
 }
 
-void updateFpsTitle(Window& window, uint32_t frameTime)
+void processKey(SDL_Scancode key, RayTracer& rayTracer, AccumulationBuffer& accumulation, bool* animate)
+{
+    assert(animate);
+
+    if (key == SDL_SCANCODE_M)
+    {
+        rayTracer.renderMode = (RenderMode) ((rayTracer.renderMode + 1) % RENDER_MODES_COUNT);
+    }
+    else if (key == SDL_SCANCODE_B)
+    {
+        rayTracer.useBvh = !rayTracer.useBvh;
+    }
+    else if (key == SDL_SCANCODE_V)
+    {
+        rayTracer.traceInWorldSpace = !rayTracer.traceInWorldSpace;
+    }
+    else if (key == SDL_SCANCODE_H)
+    {
+        rayTracer.enableShadows = !rayTracer.enableShadows;
+    }
+    else if (key == SDL_SCANCODE_N)
+    {
+        rayTracer.antialiasing = (AntialiasingMode) ((rayTracer.antialiasing + 1) % ANTIALIASING_MODES_COUNT);
+    }
+    else if (key == SDL_SCANCODE_R)
+    {
+        rayTracer.maxRayDepth = (rayTracer.maxRayDepth + 1) % (SECONDARY_DEFAULT_MAX_DEPTH + 1);
+    }
+    else if (key == SDL_SCANCODE_I)
+    {
+        rayTracer.integrator = (Integrator) ((rayTracer.integrator + 1) % INTEGRATORS_COUNT);
+    }
+    else if (key == SDL_SCANCODE_P)
+    {
+        rayTracer.accumulation = rayTracer.accumulation == nullptr ? &accumulation : nullptr;
+    }
+    else if (key == SDL_SCANCODE_L)
+    {
+        *animate = !*animate;
+    }
+
+    /* Any of the options above changes the image */
+    rayTracer.restartAccumulation();
+}
+
+void updateFpsTitle(Window& window, float frameTime, float inputLatency, const RayTracer& rayTracer)
 {
     static char windowTitle[MAX_WINDOW_TITLE_LENGTH] = {};
 
     // Time is in milliseconds, that's why use 1e3 - to convert into seconds
-    uint32_t fps = 1e3 / frameTime;
-    snprintf(windowTitle, MAX_WINDOW_TITLE_LENGTH, "%s [%" PRIu32 " fps]", WINDOW_TITLE, fps);
+    float fps = frameTime > 0 ? 1e3f / frameTime : 0;
+    int length = snprintf(windowTitle, MAX_WINDOW_TITLE_LENGTH,
+                          "%s [%s, render %.1f ms] [%.1f fps, input latency %.1f ms]", WINDOW_TITLE,
+                          getRenderModeName(rayTracer.renderMode), rayTracer.lastRenderTime, fps, inputLatency);
+
+    if (rayTracer.useBvh && rayTracer.renderMode == RENDER_MODE_PER_PIXEL && length > 0 &&
+        (size_t) length < MAX_WINDOW_TITLE_LENGTH)
+    {
+        length += snprintf(windowTitle + length, MAX_WINDOW_TITLE_LENGTH - length,
+                           " [bvh, %s space: build %.2f ms, refit %.2f ms, %.1f nodes/ray, %.1f tests/ray]",
+                           rayTracer.isTracingInWorldSpace() ? "world" : "camera",
+                           rayTracer.bvh.getBuildTime(), rayTracer.bvh.getRefitTime(),
+                           rayTracer.lastBvhStats.getNodesPerRay(),
+                           rayTracer.lastBvhStats.getTestsPerRay());
+    }
+
+    if (rayTracer.renderMode == RENDER_MODE_DEFERRED && length > 0 && (size_t) length < MAX_WINDOW_TITLE_LENGTH)
+    {
+        length += snprintf(windowTitle + length, MAX_WINDOW_TITLE_LENGTH - length, " [deferred: %s]",
+                           rayTracer.gbufferReused ? "lighting pass only" : "geometry and lighting passes");
+    }
+
+    if (rayTracer.isAntialiasing() && length > 0 && (size_t) length < MAX_WINDOW_TITLE_LENGTH)
+    {
+        length += snprintf(windowTitle + length, MAX_WINDOW_TITLE_LENGTH - length,
+                           " [%s aa: %" PRIu64 " pixels resampled, %.2f rays/pixel]",
+                           getAntialiasingModeName(rayTracer.antialiasing),
+                           rayTracer.lastAntialiasingStats.resampledPixels,
+                           rayTracer.lastAntialiasingStats.getRaysPerPixel());
+    }
+
+    if (rayTracer.isPathTracing() && length > 0 && (size_t) length < MAX_WINDOW_TITLE_LENGTH)
+    {
+        length += snprintf(windowTitle + length, MAX_WINDOW_TITLE_LENGTH - length,
+                           " [path tracing: %.2f Msamples/s, %.1f segments/sample]",
+                           rayTracer.lastPathStats.getSamplesPerSecond(rayTracer.lastRenderTime) / 1e6f,
+                           rayTracer.lastPathStats.samples > 0 ? (float) rayTracer.lastPathStats.segments /
+                                                                 (float) rayTracer.lastPathStats.samples : 0);
+    }
+
+    if (rayTracer.progressiveState != PROGRESSIVE_DISABLED && length > 0 &&
+        (size_t) length < MAX_WINDOW_TITLE_LENGTH)
+    {
+        length += snprintf(windowTitle + length, MAX_WINDOW_TITLE_LENGTH - length, " [%s, %zu samples]",
+                           getProgressiveStateName(rayTracer.progressiveState),
+                           rayTracer.accumulation->samplesCount);
+    }
+
+    if (rayTracer.enableShadows && length > 0 && (size_t) length < MAX_WINDOW_TITLE_LENGTH)
+    {
+        length += snprintf(windowTitle + length, MAX_WINDOW_TITLE_LENGTH - length,
+                           " [shadows: %" PRIu64 " rays, %.0f%% occluded hit cache]",
+                           rayTracer.lastShadowStats.rays, 100 * rayTracer.lastShadowStats.getCacheHitRate());
+    }
+
+    if (rayTracer.isTracingSecondaryRays() && length > 0 && (size_t) length < MAX_WINDOW_TITLE_LENGTH)
+    {
+        length += snprintf(windowTitle + length, MAX_WINDOW_TITLE_LENGTH - length,
+                           " [depth %zu: %" PRIu64 " secondary rays, %" PRIu64 " terminated, %" PRIu64 " dropped]",
+                           rayTracer.maxRayDepth, rayTracer.lastSecondaryStats.rays,
+                           rayTracer.lastSecondaryStats.terminated, rayTracer.lastSecondaryStats.dropped);
+    }
+
+#ifdef ENABLE_PROFILING
+    if (rayTracer.lastRenderTime > 0 && length > 0 && (size_t) length < MAX_WINDOW_TITLE_LENGTH)
+    {
+        snprintf(windowTitle + length, MAX_WINDOW_TITLE_LENGTH - length, " [%.1f Mrays/s]",
+                 (float) Profiler::getInstance().getLastFrame().getRaysCount() / rayTracer.lastRenderTime / 1e3f);
+    }
+#endif
 
     window.updateTitle(windowTitle);
+}
+
+void uploadFrame(const FrameBuffer& frame, BufferedTexture& texture)
+{
+    PROFILE_SCOPE("uploadFrame");
+
+    for (size_t y = 0; y < frame.height; y++)
+    {
+        memcpy(texture[y], frame[y], frame.width * sizeof(Color));
+    }
+
+    texture.updateTexture();
 }
\ No newline at end of file
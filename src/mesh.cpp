@@ -0,0 +1,127 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file mesh.cpp
+//! @date 2021-10-22
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include "mesh.h"
+#include "camera.h"
+
+bool intersectTriangle(const Vec3<float>& v0, const Vec3<float>& v1, const Vec3<float>& v2,
+                       const Ray& ray, float* rayParameter, float* u, float* v)
+{
+    assert(rayParameter);
+    assert(u);
+    assert(v);
+
+    return intersectTriangleEdges(v0, v1 - v0, v2 - v0, ray, rayParameter, u, v);
+}
+
+Mesh::Mesh(const Material* material, size_t facesCount, size_t verticesCount,
+           size_t uvCount, size_t normalsCount) :
+           material(material), materialIdx(MATERIAL_NO_INDEX), faces(facesCount), vertices(verticesCount),
+           uv(uvCount), normals(normalsCount) {}
+
+//------------------------------------------------------------------------------
+//! @brief Implementation of @ref Mesh::intersectFace() for any kind of vertex
+//!        and normal arrays.
+//------------------------------------------------------------------------------
+template<typename VertexArray, typename NormalArray>
+static bool intersectFaceImpl(const Face& face, const VertexArray& vertices, const NormalArray& normals,
+                              size_t normalsCount, const Material* material, uint32_t materialIdx,
+                              const Ray& ray, Hit* hit)
+{
+    assert(hit);
+
+    const Vec3<float>& v0 = vertices[face.idxVertices.x];
+    const Vec3<float>& v1 = vertices[face.idxVertices.y];
+    const Vec3<float>& v2 = vertices[face.idxVertices.z];
+
+    float rayParameter = 0;
+    float u            = 0;
+    float v            = 0;
+
+    if (!intersectTriangle(v0, v1, v2, ray, &rayParameter, &u, &v))
+    {
+        return false;
+    }
+
+    if (face.idxNormals.x >= 0 && normalsCount != 0)
+    {
+        hit->normal = normalize((1 - u - v) * normals[face.idxNormals.x] + 
+                                u           * normals[face.idxNormals.y] + 
+                                v           * normals[face.idxNormals.z]);
+    }
+    else
+    {
+        hit->normal = normalize(crossProduct(v1 - v0, v2 - v0));
+    }
+
+    hit->rayParameter = rayParameter;
+    hit->pos          = ray.at(rayParameter);
+    hit->material     = material;
+    hit->materialIdx  = materialIdx;
+
+    return true;
+}
+
+bool Mesh::intersectFace(size_t faceIdx, const Ray& ray, Hit* hit, Space space) const
+{
+    assert(space == SPACE_WORLD || space == SPACE_CAMERA);
+
+    if (space == SPACE_WORLD)
+    {
+        return intersectFaceImpl(faces[faceIdx], vertices, normals, normals.getSize(), material, materialIdx,
+                                 ray, hit);
+    }
+
+    return intersectFaceImpl(faces[faceIdx], cameraSpaceVertices, cameraSpaceNormals,
+                             cameraSpaceNormals.size(), material, materialIdx, ray, hit);
+}
+
+void Mesh::toWorldSpace() {}
+
+void Mesh::toCameraSpace(const Camera& camera)
+{
+    const Mat4<float>& viewMatrix = camera.getViewMatrix();
+    Vec3<float>        origin     = viewMatrix * Vec3<float>{0, 0, 0};
+
+    size_t verticesCount = vertices.getSize();
+    size_t normalsCount  = normals.getSize();
+
+    cameraSpaceVertices.resize(verticesCount);
+    for (size_t i = 0; i < verticesCount; i++)
+    {
+        cameraSpaceVertices[i] = viewMatrix * vertices[i];
+    }
+
+    /* Normals are directions, so the view matrix' translation is cancelled out */
+    cameraSpaceNormals.resize(normalsCount);
+    for (size_t i = 0; i < normalsCount; i++)
+    {
+        cameraSpaceNormals[i] = viewMatrix * normals[i] - origin;
+    }
+}
+
+bool Mesh::intersect(const Ray& ray, Hit* hit)
+{
+    assert(hit);
+
+    size_t facesCount = faces.getSize();
+    bool   found      = false;
+
+    for (size_t faceIdx = 0; faceIdx < facesCount; faceIdx++)
+    {
+        Hit curHit = {};
+        if (intersectFace(faceIdx, ray, &curHit) && (!found || curHit.rayParameter < hit->rayParameter))
+        {
+            *hit  = curHit;
+            found = true;
+        }
+    }
+
+    return found;
+}
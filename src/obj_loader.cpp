@@ -0,0 +1,618 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file obj_loader.cpp
+//! @date 2021-11-02
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "obj_loader.h"
+
+static const size_t OBJ_MIN_CHUNK_SIZE      = 1 << 20; ///< Smaller chunks aren't worth a thread.
+static const int    OBJ_MAX_MANTISSA_DIGITS = 19;      ///< Fit into uint64_t.
+
+/* Exactly representable in double */
+static const double POWERS_OF_TEN[]         = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                               1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                               1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static const int    MAX_EXACT_POWER         = sizeof(POWERS_OF_TEN) / sizeof(POWERS_OF_TEN[0]) - 1;
+
+struct ObjCounts
+{
+    size_t vertices;
+    size_t uv;
+    size_t normals;
+    size_t faces; ///< Triangles, after triangulating polygons.
+};
+
+struct ObjChunk
+{
+    const char* begin;
+    const char* end;     ///< Past the chunk's last '\n' or the file's end.
+    ObjCounts   counts;  ///< Filled by the counting pass.
+    ObjCounts   offsets; ///< Where the chunk's elements go in the mesh' arrays.
+    bool        valid;
+};
+
+/* Corner of a face, indices are zero-based and absolute, -1 if missing */
+struct ObjCorner
+{
+    int32_t vertex;
+    int32_t uv;
+    int32_t normal;
+};
+
+void mapChunks(const char* data, size_t size, size_t chunksCount, std::vector<ObjChunk>* chunks);
+void runChunks(std::vector<ObjChunk>& chunks, void (*function)(ObjChunk& chunk, Mesh* mesh), Mesh* mesh);
+void countChunk(ObjChunk& chunk, Mesh* mesh);
+void parseChunk(ObjChunk& chunk, Mesh* mesh);
+const char* parseIndex(const char* str, const char* end, int64_t* index);
+const char* parseCorner(const char* str, const char* end, const ObjCounts& running, const Mesh& mesh,
+                        ObjCorner* corner);
+bool resolveIndex(int64_t index, size_t running, size_t total, int32_t* resolved);
+size_t getPeakMemory();
+
+std::unique_ptr<Mesh> loadObj(const char* fileName, const Material* material, size_t threadsCount,
+                              ObjLoadStats* stats)
+{
+    assert(fileName);
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    /* ================ Map ================ */
+    int file = open(fileName, O_RDONLY);
+    if (file < 0)
+    {
+        return nullptr;
+    }
+
+    struct stat fileStat = {};
+    if (fstat(file, &fileStat) != 0 || fileStat.st_size <= 0)
+    {
+        close(file);
+        return nullptr;
+    }
+
+    size_t size = (size_t) fileStat.st_size;
+    void*  data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    /* The mapping keeps the file referenced */
+    close(file);
+
+    if (data == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    madvise(data, size, MADV_WILLNEED);
+
+    auto mapTime = std::chrono::steady_clock::now();
+
+    /* ================ Count ================ */
+    if (threadsCount == 0)
+    {
+        threadsCount = std::thread::hardware_concurrency() != 0 ? std::thread::hardware_concurrency() : 1;
+    }
+
+    size_t chunksCount = size / OBJ_MIN_CHUNK_SIZE + 1;
+    if (chunksCount > threadsCount)
+    {
+        chunksCount = threadsCount;
+    }
+
+    std::vector<ObjChunk> chunks;
+    mapChunks((const char*) data, size, chunksCount, &chunks);
+
+    runChunks(chunks, countChunk, nullptr);
+
+    ObjCounts total = {};
+    bool      valid = true;
+
+    for (ObjChunk& chunk : chunks)
+    {
+        chunk.offsets   = total;
+
+        total.vertices += chunk.counts.vertices;
+        total.uv       += chunk.counts.uv;
+        total.normals  += chunk.counts.normals;
+        total.faces    += chunk.counts.faces;
+
+        valid = valid && chunk.valid;
+    }
+
+    /* Faces' indices are 32-bit */
+    valid = valid && total.vertices <= INT32_MAX && total.uv <= INT32_MAX && total.normals <= INT32_MAX;
+
+    auto countTime = std::chrono::steady_clock::now();
+
+    /* ================ Parse ================ */
+    std::unique_ptr<Mesh> mesh = nullptr;
+
+    if (valid)
+    {
+        mesh = std::make_unique<Mesh>(material, total.faces, total.vertices, total.uv, total.normals);
+
+        runChunks(chunks, parseChunk, mesh.get());
+
+        for (const ObjChunk& chunk : chunks)
+        {
+            valid = valid && chunk.valid;
+        }
+    }
+
+    munmap(data, size);
+
+    if (!valid)
+    {
+        return nullptr;
+    }
+
+    auto parseTime = std::chrono::steady_clock::now();
+
+    if (stats != nullptr)
+    {
+        stats->fileSize    = size;
+        stats->chunksCount = chunks.size();
+        stats->mapTime     = std::chrono::duration<float, std::milli>(mapTime   - startTime).count();
+        stats->countTime   = std::chrono::duration<float, std::milli>(countTime - mapTime).count();
+        stats->parseTime   = std::chrono::duration<float, std::milli>(parseTime - countTime).count();
+        stats->totalTime   = std::chrono::duration<float, std::milli>(parseTime - startTime).count();
+        stats->peakMemory  = getPeakMemory();
+    }
+
+    return mesh;
+}
+
+const char* parseFloat(const char* str, const char* end, float* value)
+{
+    assert(str);
+    assert(end);
+    assert(value);
+
+    str = skipBlanks(str, end);
+
+    bool negative = false;
+    if (str < end && (*str == '-' || *str == '+'))
+    {
+        negative = *str == '-';
+        str++;
+    }
+
+    uint64_t mantissa    = 0;
+    int      digitsCount = 0; ///< Significant ones in mantissa.
+    int      exponent    = 0;
+    bool     hasDigits   = false;
+
+    for (; str < end && *str >= '0' && *str <= '9'; str++)
+    {
+        hasDigits = true;
+
+        if (digitsCount < OBJ_MAX_MANTISSA_DIGITS)
+        {
+            mantissa = 10 * mantissa + (uint64_t) (*str - '0');
+            digitsCount += mantissa != 0;
+        }
+        else
+        {
+            exponent++;
+        }
+    }
+
+    if (str < end && *str == '.')
+    {
+        for (str++; str < end && *str >= '0' && *str <= '9'; str++)
+        {
+            hasDigits = true;
+
+            if (digitsCount < OBJ_MAX_MANTISSA_DIGITS)
+            {
+                mantissa = 10 * mantissa + (uint64_t) (*str - '0');
+                digitsCount += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (!hasDigits)
+    {
+        return nullptr;
+    }
+
+    if (str < end && (*str == 'e' || *str == 'E'))
+    {
+        const char* exponentStr      = str + 1;
+        bool        negativeExponent = false;
+
+        if (exponentStr < end && (*exponentStr == '-' || *exponentStr == '+'))
+        {
+            negativeExponent = *exponentStr == '-';
+            exponentStr++;
+        }
+
+        /* "1e" is 1 followed by garbage, as strtof() reads it */
+        if (exponentStr < end && *exponentStr >= '0' && *exponentStr <= '9')
+        {
+            int explicitExponent = 0;
+            for (; exponentStr < end && *exponentStr >= '0' && *exponentStr <= '9'; exponentStr++)
+            {
+                if (explicitExponent < 1000)
+                {
+                    explicitExponent = 10 * explicitExponent + (*exponentStr - '0');
+                }
+            }
+
+            exponent += negativeExponent ? -explicitExponent : explicitExponent;
+            str       = exponentStr;
+        }
+    }
+
+    double result = (double) mantissa;
+
+    for (; exponent > MAX_EXACT_POWER && result != 0; exponent -= MAX_EXACT_POWER)
+    {
+        result *= POWERS_OF_TEN[MAX_EXACT_POWER];
+    }
+
+    for (; exponent < -MAX_EXACT_POWER && result != 0; exponent += MAX_EXACT_POWER)
+    {
+        result /= POWERS_OF_TEN[MAX_EXACT_POWER];
+    }
+
+    if (exponent > 0)
+    {
+        result *= POWERS_OF_TEN[exponent];
+    }
+    else if (exponent < 0)
+    {
+        result /= POWERS_OF_TEN[-exponent];
+    }
+
+    *value = (float) (negative ? -result : result);
+
+    return str;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Split data into chunksCount chunks of about the same size, each
+//!        ending at a line's end.
+//------------------------------------------------------------------------------
+void mapChunks(const char* data, size_t size, size_t chunksCount, std::vector<ObjChunk>* chunks)
+{
+    assert(chunksCount > 0);
+    assert(chunks);
+
+    const char* end   = data + size;
+    const char* begin = data;
+
+    chunks->clear();
+
+    for (size_t i = 1; i <= chunksCount && begin < end; i++)
+    {
+        const char* chunkEnd = end;
+
+        if (i < chunksCount)
+        {
+            chunkEnd = data + size * i / chunksCount;
+            chunkEnd = chunkEnd > begin ? chunkEnd : begin;
+
+            const char* lineEnd = (const char*) memchr(chunkEnd, '\n', (size_t) (end - chunkEnd));
+            chunkEnd = lineEnd != nullptr ? lineEnd + 1 : end;
+        }
+
+        chunks->push_back({begin, chunkEnd, {}, {}, true});
+        begin = chunkEnd;
+    }
+}
+
+//------------------------------------------------------------------------------
+//! @brief Call function for every chunk, each on its own thread, the calling
+//!        one included, and wait for all of them.
+//------------------------------------------------------------------------------
+void runChunks(std::vector<ObjChunk>& chunks, void (*function)(ObjChunk& chunk, Mesh* mesh), Mesh* mesh)
+{
+    std::vector<std::thread> threads;
+    threads.reserve(chunks.size());
+
+    for (size_t i = 1; i < chunks.size(); i++)
+    {
+        threads.emplace_back(function, std::ref(chunks[i]), mesh);
+    }
+
+    if (!chunks.empty())
+    {
+        function(chunks[0], mesh);
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+//------------------------------------------------------------------------------
+//! @brief Counting pass: fill chunk.counts, only looking at statements' names
+//!        and faces' corners.
+//------------------------------------------------------------------------------
+void countChunk(ObjChunk& chunk, Mesh*)
+{
+    ObjCounts&  counts = chunk.counts;
+    const char* line   = chunk.begin;
+
+    while (line < chunk.end)
+    {
+        const char* lineEnd = (const char*) memchr(line, '\n', (size_t) (chunk.end - line));
+        lineEnd = lineEnd != nullptr ? lineEnd : chunk.end;
+
+        const char* str = skipBlanks(line, lineEnd);
+
+        if (lineEnd - str >= 2 && str[0] == 'v')
+        {
+            counts.vertices += str[1] == ' ' || str[1] == '\t';
+            counts.uv       += str[1] == 't';
+            counts.normals  += str[1] == 'n';
+        }
+        else if (lineEnd - str >= 2 && str[0] == 'f' && (str[1] == ' ' || str[1] == '\t'))
+        {
+            size_t cornersCount = 0;
+
+            for (str = skipBlanks(str + 1, lineEnd); str < lineEnd; str = skipBlanks(str, lineEnd))
+            {
+                while (str < lineEnd && *str != ' ' && *str != '\t' && *str != '\r')
+                {
+                    str++;
+                }
+
+                cornersCount++;
+            }
+
+            if (cornersCount < 3)
+            {
+                chunk.valid = false;
+                return;
+            }
+
+            counts.faces += cornersCount - 2;
+        }
+
+        line = lineEnd + 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+//! @brief Parsing pass: write the chunk's elements into the mesh starting at
+//!        chunk.offsets.
+//------------------------------------------------------------------------------
+void parseChunk(ObjChunk& chunk, Mesh* mesh)
+{
+    assert(mesh);
+
+    ObjCounts   running = chunk.offsets; ///< Elements parsed so far in the whole file.
+    const char* line    = chunk.begin;
+
+    while (line < chunk.end && chunk.valid)
+    {
+        const char* lineEnd = (const char*) memchr(line, '\n', (size_t) (chunk.end - line));
+        lineEnd = lineEnd != nullptr ? lineEnd : chunk.end;
+
+        const char* str = skipBlanks(line, lineEnd);
+
+        if (lineEnd - str >= 2 && str[0] == 'v' && (str[1] == ' ' || str[1] == '\t'))
+        {
+            Vec3<float>& vertex = mesh->vertices[running.vertices++];
+
+            str = parseFloat(str + 1, lineEnd, &vertex.x);
+            str = str != nullptr ? parseFloat(str, lineEnd, &vertex.y) : nullptr;
+            str = str != nullptr ? parseFloat(str, lineEnd, &vertex.z) : nullptr;
+
+            chunk.valid = str != nullptr;
+        }
+        else if (lineEnd - str >= 2 && str[0] == 'v' && str[1] == 'n')
+        {
+            Vec3<float>& normal = mesh->normals[running.normals++];
+
+            str = parseFloat(str + 2, lineEnd, &normal.x);
+            str = str != nullptr ? parseFloat(str, lineEnd, &normal.y) : nullptr;
+            str = str != nullptr ? parseFloat(str, lineEnd, &normal.z) : nullptr;
+
+            chunk.valid = str != nullptr;
+        }
+        else if (lineEnd - str >= 2 && str[0] == 'v' && str[1] == 't')
+        {
+            Vec3<float>& uv = mesh->uv[running.uv++];
+            uv = {0, 0, 0};
+
+            /* Only u is required */
+            str = parseFloat(str + 2, lineEnd, &uv.x);
+
+            const char* next = str != nullptr ? parseFloat(str, lineEnd, &uv.y) : nullptr;
+            if (next != nullptr)
+            {
+                parseFloat(next, lineEnd, &uv.z);
+            }
+
+            chunk.valid = str != nullptr;
+        }
+        else if (lineEnd - str >= 2 && str[0] == 'f' && (str[1] == ' ' || str[1] == '\t'))
+        {
+            ObjCorner first    = {};
+            ObjCorner previous = {};
+            ObjCorner current  = {};
+            size_t    corner   = 0;
+
+            for (str = skipBlanks(str + 1, lineEnd); str < lineEnd && chunk.valid; str = skipBlanks(str, lineEnd))
+            {
+                str = parseCorner(str, lineEnd, running, *mesh, &current);
+                if (str == nullptr)
+                {
+                    chunk.valid = false;
+                    break;
+                }
+
+                if (corner == 0)
+                {
+                    first = current;
+                }
+                else if (corner >= 2)
+                {
+                    /* Fan triangulation */
+                    bool hasUv      = first.uv     >= 0 && previous.uv     >= 0 && current.uv     >= 0;
+                    bool hasNormals = first.normal >= 0 && previous.normal >= 0 && current.normal >= 0;
+
+                    Face& face = mesh->faces[running.faces++];
+
+                    face.idxVertices = {first.vertex, previous.vertex, current.vertex};
+                    face.idxUV       = hasUv      ? Vec3<int32_t>{first.uv, previous.uv, current.uv}
+                                                  : Vec3<int32_t>{-1, -1, -1};
+                    face.idxNormals  = hasNormals ? Vec3<int32_t>{first.normal, previous.normal, current.normal}
+                                                  : Vec3<int32_t>{-1, -1, -1};
+                }
+
+                previous = current;
+                corner++;
+            }
+        }
+
+        line = lineEnd + 1;
+    }
+}
+
+const char* skipBlanks(const char* str, const char* end)
+{
+    while (str < end && (*str == ' ' || *str == '\t' || *str == '\r'))
+    {
+        str++;
+    }
+
+    return str;
+}
+
+//------------------------------------------------------------------------------
+//! @return Pointer past the index, or nullptr if there's no integer at str.
+//------------------------------------------------------------------------------
+const char* parseIndex(const char* str, const char* end, int64_t* index)
+{
+    bool negative = str < end && *str == '-';
+    str += negative;
+
+    if (str >= end || *str < '0' || *str > '9')
+    {
+        return nullptr;
+    }
+
+    int64_t value = 0;
+    for (; str < end && *str >= '0' && *str <= '9'; str++)
+    {
+        if (value <= INT32_MAX)
+        {
+            value = 10 * value + (*str - '0');
+        }
+    }
+
+    *index = negative ? -value : value;
+
+    return str;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Parse a face's corner "v", "v/vt", "v//vn" or "v/vt/vn".
+//! 
+//! @param str
+//! @param end
+//! @param running Elements defined before the face, relative indices count
+//!                back from them.
+//! @param mesh    Provides the total number of elements.
+//! @param corner
+//! 
+//! @return Pointer past the corner, or nullptr if it's malformed or any of its
+//!         indices is out of range.
+//------------------------------------------------------------------------------
+const char* parseCorner(const char* str, const char* end, const ObjCounts& running, const Mesh& mesh,
+                        ObjCorner* corner)
+{
+    int64_t index = 0;
+
+    str = parseIndex(str, end, &index);
+    if (str == nullptr || !resolveIndex(index, running.vertices, mesh.vertices.getSize(), &corner->vertex))
+    {
+        return nullptr;
+    }
+
+    corner->uv     = -1;
+    corner->normal = -1;
+
+    if (str < end && *str == '/')
+    {
+        str++;
+
+        if (str < end && *str != '/')
+        {
+            str = parseIndex(str, end, &index);
+            if (str == nullptr || !resolveIndex(index, running.uv, mesh.uv.getSize(), &corner->uv))
+            {
+                return nullptr;
+            }
+        }
+
+        if (str < end && *str == '/')
+        {
+            str = parseIndex(str + 1, end, &index);
+            if (str == nullptr || !resolveIndex(index, running.normals, mesh.normals.getSize(), &corner->normal))
+            {
+                return nullptr;
+            }
+        }
+    }
+
+    /* Anything else glued to the corner */
+    if (str < end && *str != ' ' && *str != '\t' && *str != '\r')
+    {
+        return nullptr;
+    }
+
+    return str;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Convert a one-based (or negative, relative to running) OBJ index to
+//!        a zero-based one.
+//! 
+//! @return Whether the index refers to one of the total elements.
+//------------------------------------------------------------------------------
+bool resolveIndex(int64_t index, size_t running, size_t total, int32_t* resolved)
+{
+    int64_t absolute = index > 0 ? index - 1 : (int64_t) running + index;
+
+    if (index == 0 || absolute < 0 || absolute >= (int64_t) total)
+    {
+        return false;
+    }
+
+    *resolved = (int32_t) absolute;
+    return true;
+}
+
+//------------------------------------------------------------------------------
+//! @return Peak resident set size of the process in bytes.
+//------------------------------------------------------------------------------
+size_t getPeakMemory()
+{
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+
+    // ru_maxrss is in kilobytes on Linux
+    return (size_t) usage.ru_maxrss * 1024;
+}
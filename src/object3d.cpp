@@ -7,9 +7,22 @@
 //------------------------------------------------------------------------------
 
 #include "object3d.h"
+#include "mesh.h"
 
 //-----------------------------------Object3d-----------------------------------
-Object3d::Object3d(const Material* material) : material(material) {}
+Object3d::Object3d(const Material* material) : material(material), materialIdx(MATERIAL_NO_INDEX) {}
+
+void Object3d::setPos(const Vec3<float>& worldPos)
+{
+    pos.worldSpace = worldPos;
+    markDirty();
+}
+
+void Object3d::setScale(float newScale)
+{
+    scale = newScale;
+    markDirty();
+}
 //------------------------------------------------------------------------------
 
 //------------------------------------Sphere------------------------------------
@@ -27,6 +40,12 @@ void Sphere::toCameraSpace(const Camera& camera)
 }
 
 bool Sphere::intersect(const Ray& ray, Hit* hit)
+{
+    return intersectSphere(pos.cameraSpace, radius.cameraSpace, material, materialIdx, ray, hit);
+}
+
+bool intersectSphere(const Vec3<float>& center, float radius, const Material* material,
+                     uint32_t materialIdx, const Ray& ray, Hit* hit)
 {
     /** 
      * Solving a quadratic equation 
@@ -34,20 +53,18 @@ bool Sphere::intersect(const Ray& ray, Hit* hit)
      * 
      * where 
      * D = ray.direction
-     * C = pos.cameraSpace
-     * R = radius.cameraSpace
+     * C = center - ray.from
+     * R = radius
      */
 
     float rayParameter1 = 0;
     float rayParameter2 = 0;
 
-    float directionLen  = length(ray.direction);
-    float a             = directionLen * directionLen;
-
-    float b             = -2 * dotProduct(ray.direction, pos.cameraSpace);
+    Vec3<float> toCenter = center - ray.from;
 
-    float posLen        = length(pos.cameraSpace);
-    float c             = posLen * posLen - radius.cameraSpace * radius.cameraSpace;
+    float a             = dotProduct(ray.direction, ray.direction);
+    float b             = -2 * dotProduct(ray.direction, toCenter);
+    float c             = dotProduct(toCenter, toCenter) - radius * radius;
 
     int32_t solutions   = solveQuadraticEquation(a, b, c, &rayParameter1, &rayParameter2);
 
@@ -68,9 +85,10 @@ bool Sphere::intersect(const Ray& ray, Hit* hit)
         return false;
     }
 
-    hit->pos      = ray.at(hit->rayParameter);
-    hit->normal   = normalize(hit->pos - pos.cameraSpace);
-    hit->material = material;
+    hit->pos         = ray.at(hit->rayParameter);
+    hit->normal      = normalize(hit->pos - center);
+    hit->material    = material;
+    hit->materialIdx = materialIdx;
 
     return true;
 }
@@ -79,58 +97,66 @@ bool Sphere::intersect(const Ray& ray, Hit* hit)
 //-----------------------------------Triangle-----------------------------------
 Triangle::Triangle(const Material* material) : Object3d(material) {}
 
+void Triangle::setRotation(const Vec3<float>& newRotation)
+{
+    rotation = newRotation;
+    markDirty();
+}
+
 void Triangle::toWorldSpace()
 {
-    Mat4<float> worldMatrix = createTranslationMatrix(pos.worldSpace) *
-                              createScaleMatrix(scale) *
-                              createRotationMatrix(rotation.x, rotation.y, rotation.z);
+    Mat4<float> rotationMatrix = createRotationMatrix(rotation.x, rotation.y, rotation.z);
+    Mat4<float> worldMatrix    = createTranslationMatrix(pos.worldSpace) *
+                                 createScaleMatrix(scale) *
+                                 rotationMatrix;
 
-    v0.pos.worldSpace    = worldMatrix * v0.pos.modelSpace;
-    v0.normal.worldSpace = worldMatrix * v0.normal.modelSpace;
+    v0.pos.worldSpace    = worldMatrix    * v0.pos.modelSpace;
+    v0.normal.worldSpace = rotationMatrix * v0.normal.modelSpace;
 
-    v1.pos.worldSpace    = worldMatrix * v1.pos.modelSpace;
-    v1.normal.worldSpace = worldMatrix * v1.normal.modelSpace;
+    v1.pos.worldSpace    = worldMatrix    * v1.pos.modelSpace;
+    v1.normal.worldSpace = rotationMatrix * v1.normal.modelSpace;
 
-    v2.pos.worldSpace    = worldMatrix * v2.pos.modelSpace;
-    v2.normal.worldSpace = worldMatrix * v2.normal.modelSpace;
+    v2.pos.worldSpace    = worldMatrix    * v2.pos.modelSpace;
+    v2.normal.worldSpace = rotationMatrix * v2.normal.modelSpace;
 }
 
 void Triangle::toCameraSpace(const Camera& camera)
 {
     const Mat4<float>& viewMatrix = camera.getViewMatrix();
 
+    /* Normals are directions, so the view matrix' translation is cancelled out */
+    Vec3<float> origin = viewMatrix * Vec3<float>{0, 0, 0};
+
     v0.pos.cameraSpace    = viewMatrix * v0.pos.worldSpace;
-    v0.normal.cameraSpace = viewMatrix * v0.normal.worldSpace;
+    v0.normal.cameraSpace = viewMatrix * v0.normal.worldSpace - origin;
 
     v1.pos.cameraSpace    = viewMatrix * v1.pos.worldSpace;
-    v1.normal.cameraSpace = viewMatrix * v1.normal.worldSpace;
+    v1.normal.cameraSpace = viewMatrix * v1.normal.worldSpace - origin;
 
     v2.pos.cameraSpace    = viewMatrix * v2.pos.worldSpace;
-    v2.normal.cameraSpace = viewMatrix * v2.normal.worldSpace;
+    v2.normal.cameraSpace = viewMatrix * v2.normal.worldSpace - origin;
 }
 
 bool Triangle::intersect(const Ray& ray, Hit* hit)
 {
-    Vec3<float> direction = ray.direction;
-    Vec3<float> side0     = v0.pos.cameraSpace - v1.pos.cameraSpace;
-    Vec3<float> side1     = v0.pos.cameraSpace - v2.pos.cameraSpace;
-
-    Mat4<float> matrix    = {{direction.x, side0.x, side1.x, 0,
-                              direction.y, side0.y, side1.y, 0,
-                              direction.z, side0.z, side1.z, 0,
-                              0,           0,       0,       1}};
-
-    float determinant = determinant3x3(matrix);
-    
-    // determinant == 0 <=> ray is parallel to the triangle's surface
-    // determinant <  0 <=> the triangle is back-facing FIXME: WHY? 
-    if (cmpFloat(determinant, 0) <= 0)
+    float rayParameter = 0;
+    float u            = 0;
+    float v            = 0;
+
+    if (!intersectTriangle(v0.pos.cameraSpace, v1.pos.cameraSpace, v2.pos.cameraSpace,
+                           ray, &rayParameter, &u, &v))
     {
         return false;
     }
 
-    
+    hit->rayParameter = rayParameter;
+    hit->pos          = ray.at(rayParameter);
+    hit->normal       = normalize((1 - u - v) * v0.normal.cameraSpace + 
+                                  u           * v1.normal.cameraSpace + 
+                                  v           * v2.normal.cameraSpace);
+    hit->material     = material;
+    hit->materialIdx  = materialIdx;
 
-    return false;
+    return true;
 }
 //------------------------------------------------------------------------------
\ No newline at end of file
@@ -0,0 +1,212 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file path_tracer.cpp
+//! @date 2021-11-01
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <math.h>
+#include "path_tracer.h"
+#include "secondary_rays.h"
+
+static const float PI = 3.14159265f;
+
+//-------------------------------PathTracingStats-------------------------------
+void PathTracingStats::merge(const PathTracingStats& other)
+{
+    samples    += other.samples;
+    segments   += other.segments;
+    terminated += other.terminated;
+}
+
+float PathTracingStats::getSamplesPerSecond(float time) const
+{
+    // Time is in milliseconds
+    return time > 0 ? 1e3f * (float) samples / time : 0;
+}
+//------------------------------------------------------------------------------
+
+//----------------------------------PathTracer----------------------------------
+PathTracer::PathTracer() : stats{}, shadows{}, m_MaxBounces(0), m_RouletteBounces(0), m_RandomState(1) {}
+
+void PathTracer::reset(Scene& scene, size_t maxBounces, size_t rouletteBounces, uint32_t seed)
+{
+    assert(seed != 0);
+
+    shadows.reset(scene.lightSources.getSize());
+
+    m_MaxBounces      = maxBounces;
+    m_RouletteBounces = rouletteBounces;
+    m_RandomState     = seed;
+}
+
+Vec3<float> PathTracer::trace(const Bvh& bvh, const PrimitiveStore& store, Scene& scene, const Ray& ray,
+                              BvhTraversalStats* bvhStats)
+{
+    Vec3<float> radiance   = {0, 0, 0};
+    Vec3<float> throughput = {1, 1, 1};
+    Ray         current    = ray;
+
+    stats.samples++;
+
+    for (size_t bounce = 0; bounce <= m_MaxBounces; bounce++)
+    {
+        /* Primary rays cull back faces the same way the rest of per-pixel mode does */
+        Hit hit = {};
+        stats.segments++;
+
+        if (!bvh.intersect(current, &hit, bvhStats, bounce == 0))
+        {
+            radiance += componentMultiply(throughput, scene.ambientColor);
+            break;
+        }
+
+        const Material& material    = *hit.material;
+        Vec3<float>     direction   = current.direction;
+        float           cosIncident = -dotProduct(direction, hit.normal);
+        bool            entering    = cosIncident > 0;
+
+        /* Scatter on the side the ray comes from */
+        if (!entering)
+        {
+            hit.normal  = -1.0f * hit.normal;
+            cosIncident = -cosIncident;
+        }
+
+        /* Lobes are chosen with probabilities equal to their weights, which
+           cancel out of the throughput */
+        float lobe = getRandom();
+
+        if (lobe < material.reflectivity)
+        {
+            current.from      = hit.pos + PATH_RAY_OFFSET * hit.normal;
+            current.direction = direction + (2 * cosIncident) * hit.normal;
+        }
+        else if (lobe < material.reflectivity + material.transparency)
+        {
+            float eta        = entering ? 1 / material.refractiveIndex : material.refractiveIndex;
+            float sinSquared = eta * eta * (1 - cosIncident * cosIncident);
+            bool  reflect    = sinSquared >= 1;
+
+            if (!reflect)
+            {
+                float cosRefracted = sqrtf(1 - sinSquared);
+                float fresnel      = getSchlickReflectance(entering ? cosIncident : cosRefracted,
+                                                           material.refractiveIndex);
+
+                reflect = getRandom() < fresnel;
+
+                if (!reflect)
+                {
+                    current.from      = hit.pos - PATH_RAY_OFFSET * hit.normal;
+                    current.direction = normalize(eta * direction + (eta * cosIncident - cosRefracted) * hit.normal);
+                }
+            }
+
+            if (reflect)
+            {
+                current.from      = hit.pos + PATH_RAY_OFFSET * hit.normal;
+                current.direction = direction + (2 * cosIncident) * hit.normal;
+            }
+        }
+        else
+        {
+            radiance += componentMultiply(throughput, sampleLights(bvh, store, scene, hit, -1.0f * direction));
+
+            current.from      = hit.pos + PATH_RAY_OFFSET * hit.normal;
+            current.direction = sampleCosineHemisphere(hit.normal);
+
+            /* Lambertian BRDF's cosine and 1 / pi cancel out with the pdf */
+            throughput = componentMultiply(throughput, material.diffuse);
+        }
+
+        if (bounce >= m_RouletteBounces)
+        {
+            float survival = fmaxf(throughput.x, fmaxf(throughput.y, throughput.z));
+            if (survival < 1)
+            {
+                if (getRandom() >= survival)
+                {
+                    stats.terminated++;
+                    break;
+                }
+
+                throughput = (1 / survival) * throughput;
+            }
+        }
+    }
+
+    return radiance;
+}
+
+float PathTracer::getRandom()
+{
+    /* Xorshift32 */
+    m_RandomState ^= m_RandomState << 13;
+    m_RandomState ^= m_RandomState >> 17;
+    m_RandomState ^= m_RandomState << 5;
+
+    return (float) (m_RandomState >> 8) / (float) (1 << 24);
+}
+
+//------------------------------------------------------------------------------
+//! @brief Direct lighting of a diffuse hit by every visible light, with the
+//!        same terms as calculateColor() except for clamping, so that path
+//!        traced images only differ from the preview by indirect light.
+//------------------------------------------------------------------------------
+Vec3<float> PathTracer::sampleLights(const Bvh& bvh, const PrimitiveStore& store, Scene& scene, const Hit& hit,
+                                     const Vec3<float>& toEye)
+{
+    traceShadows(bvh, store, scene, hit, &shadows);
+
+    Vec3<float> color       = {0, 0, 0};
+    size_t      lightsCount = scene.lightSources.getSize();
+
+    for (size_t i = 0; i < lightsCount; i++)
+    {
+        if (!shadows.lightVisible[i])
+        {
+            continue;
+        }
+
+        const Light& light   = *scene.lightSources[i];
+        Vec3<float>  toLight = normalize(light.pos.worldSpace - hit.pos);
+
+        /* Lights behind the surface are never visible */
+        color += dotProduct(hit.normal, toLight) * componentMultiply(light.diffuse, hit.material->diffuse);
+
+        float dotNormalHalfway = dotProduct(hit.normal, normalize(toEye + toLight));
+        if (dotNormalHalfway > 0)
+        {
+            color += powf(dotNormalHalfway, hit.material->shiness) *
+                     componentMultiply(light.specular, hit.material->specular);
+        }
+    }
+
+    return color;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Direction in the normal's hemisphere with pdf cos(theta) / pi.
+//------------------------------------------------------------------------------
+Vec3<float> PathTracer::sampleCosineHemisphere(const Vec3<float>& normal)
+{
+    float radius = sqrtf(getRandom());
+    float angle  = 2 * PI * getRandom();
+    float x      = radius * cosf(angle);
+    float y      = radius * sinf(angle);
+    float z      = sqrtf(fmaxf(0, 1 - x * x - y * y));
+
+    /* Orthonormal basis around the normal (Duff et al., 2017) */
+    float sign   = copysignf(1, normal.z);
+    float a      = -1 / (sign + normal.z);
+    float b      = normal.x * normal.y * a;
+
+    Vec3<float> tangent   = {1 + sign * normal.x * normal.x * a, sign * b, -sign * normal.x};
+    Vec3<float> bitangent = {b, sign + normal.y * normal.y * a, -normal.y};
+
+    return x * tangent + y * bitangent + z * normal;
+}
+//------------------------------------------------------------------------------
@@ -0,0 +1,375 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file primitive_store.cpp
+//! @date 2021-10-24
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <float.h>
+#include "primitive_store.h"
+#include "mesh.h"
+
+//-------------------------------------Aabb-------------------------------------
+Aabb Aabb::createEmpty()
+{
+    return {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+}
+
+void Aabb::grow(const Vec3<float>& point)
+{
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        min.getCoord(axis) = fminf(min.getCoord(axis), point.getCoord(axis));
+        max.getCoord(axis) = fmaxf(max.getCoord(axis), point.getCoord(axis));
+    }
+}
+
+void Aabb::grow(const Aabb& other)
+{
+    for (size_t axis = 0; axis < 3; axis++)
+    {
+        min.getCoord(axis) = fminf(min.getCoord(axis), other.min.getCoord(axis));
+        max.getCoord(axis) = fmaxf(max.getCoord(axis), other.max.getCoord(axis));
+    }
+}
+
+Vec3<float> Aabb::getCenter() const
+{
+    return 0.5f * (min + max);
+}
+
+float Aabb::getSurfaceArea() const
+{
+    if (min.x > max.x)
+    {
+        return 0;
+    }
+
+    Vec3<float> extent = max - min;
+    return 2 * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+//------------------------------------------------------------------------------
+
+//--------------------------------PrimitiveStore--------------------------------
+void PrimitiveStore::compile(Scene& scene)
+{
+    clear();
+
+    /* Primitives keep their entities' indices, so hits index the same table */
+    materials = scene.materials;
+
+    for (auto object : scene.objects)
+    {
+        if (const Sphere* sphere = dynamic_cast<const Sphere*>(object))
+        {
+            uint32_t sphereIdx = (uint32_t) getSpheresCount();
+
+            sphereCenterX.push_back(0);
+            sphereCenterY.push_back(0);
+            sphereCenterZ.push_back(0);
+            sphereRadius.push_back(0);
+            sphereMaterial.push_back(0);
+
+            setSphere(sphereIdx, *sphere);
+            m_ObjectRefs[object] = {PRIMITIVE_SPHERE, sphereIdx};
+        }
+        else if (const Triangle* triangle = dynamic_cast<const Triangle*>(object))
+        {
+            uint32_t triangleIdx = (uint32_t) getTrianglesCount();
+            uint32_t normalIdx   = (uint32_t) normals.size();
+
+            triangleV0.push_back({});
+            triangleEdge1.push_back({});
+            triangleEdge2.push_back({});
+            triangleMaterial.push_back(0);
+
+            for (uint32_t vertex = 0; vertex < 3; vertex++)
+            {
+                triangleNormals.push_back(normalIdx + vertex);
+                normals.push_back({});
+            }
+
+            setTriangle(triangleIdx, *triangle);
+            m_ObjectRefs[object] = {PRIMITIVE_TRIANGLE, triangleIdx};
+        }
+        else
+        {
+            assert(!"Primitive type isn't supported by PrimitiveStore");
+        }
+    }
+
+    m_ObjectTrianglesCount = getTrianglesCount();
+    m_ObjectNormalsCount   = normals.size();
+
+    compileMeshes(scene);
+}
+
+void PrimitiveStore::clear()
+{
+    sphereCenterX.clear();
+    sphereCenterY.clear();
+    sphereCenterZ.clear();
+    sphereRadius.clear();
+    sphereMaterial.clear();
+
+    triangleV0.clear();
+    triangleEdge1.clear();
+    triangleEdge2.clear();
+    triangleNormals.clear();
+    triangleMaterial.clear();
+
+    normals.clear();
+    materials.clear();
+
+    m_ObjectRefs.clear();
+
+    m_ObjectTrianglesCount = 0;
+    m_ObjectNormalsCount   = 0;
+}
+
+void PrimitiveStore::compileMeshes(Scene& scene)
+{
+    size_t facesCount = 0;
+    for (auto mesh : scene.meshes)
+    {
+        facesCount += mesh->faces.getSize();
+    }
+
+    size_t trianglesCount = m_ObjectTrianglesCount + facesCount;
+
+    triangleV0.resize(m_ObjectTrianglesCount);
+    triangleEdge1.resize(m_ObjectTrianglesCount);
+    triangleEdge2.resize(m_ObjectTrianglesCount);
+    triangleNormals.resize(3 * m_ObjectTrianglesCount);
+    triangleMaterial.resize(m_ObjectTrianglesCount);
+    normals.resize(m_ObjectNormalsCount);
+
+    triangleV0.reserve(trianglesCount);
+    triangleEdge1.reserve(trianglesCount);
+    triangleEdge2.reserve(trianglesCount);
+    triangleNormals.reserve(3 * trianglesCount);
+    triangleMaterial.reserve(trianglesCount);
+
+    for (auto mesh : scene.meshes)
+    {
+        uint32_t normalsOffset = (uint32_t) normals.size();
+        uint32_t material      = mesh->materialIdx;
+        size_t   normalsCount  = mesh->normals.getSize();
+
+        for (size_t i = 0; i < normalsCount; i++)
+        {
+            normals.push_back(mesh->normals[i]);
+        }
+
+        size_t meshFacesCount = mesh->faces.getSize();
+        for (size_t faceIdx = 0; faceIdx < meshFacesCount; faceIdx++)
+        {
+            const Face&        face = mesh->faces[faceIdx];
+            const Vec3<float>& v0   = mesh->vertices[face.idxVertices.x];
+
+            triangleV0.push_back(v0);
+            triangleEdge1.push_back(mesh->vertices[face.idxVertices.y] - v0);
+            triangleEdge2.push_back(mesh->vertices[face.idxVertices.z] - v0);
+            triangleMaterial.push_back(material);
+
+            bool hasNormals = face.idxNormals.x >= 0 && normalsCount != 0;
+
+            triangleNormals.push_back(hasNormals ? normalsOffset + face.idxNormals.x : PRIMITIVE_NO_NORMAL);
+            triangleNormals.push_back(hasNormals ? normalsOffset + face.idxNormals.y : PRIMITIVE_NO_NORMAL);
+            triangleNormals.push_back(hasNormals ? normalsOffset + face.idxNormals.z : PRIMITIVE_NO_NORMAL);
+        }
+    }
+}
+
+void PrimitiveStore::update(Scene& scene, std::vector<PrimitiveRef>* changed)
+{
+    assert(changed);
+
+    changed->clear();
+
+    for (const Object3d* object : scene.changedObjects)
+    {
+        auto found = m_ObjectRefs.find(object);
+        assert(found != m_ObjectRefs.end());
+
+        PrimitiveRef ref = found->second;
+        if (ref.type == PRIMITIVE_SPHERE)
+        {
+            setSphere(ref.index, *(const Sphere*) object);
+        }
+        else
+        {
+            setTriangle(ref.index, *(const Triangle*) object);
+        }
+
+        changed->push_back(ref);
+    }
+
+    if (scene.meshesChanged)
+    {
+        compileMeshes(scene);
+
+        for (size_t triangleIdx = m_ObjectTrianglesCount; triangleIdx < getTrianglesCount(); triangleIdx++)
+        {
+            changed->push_back({PRIMITIVE_TRIANGLE, (uint32_t) triangleIdx});
+        }
+    }
+}
+
+bool PrimitiveStore::isCompiledFor(Scene& scene) const
+{
+    return scene.getObjectsCount()   == m_ObjectRefs.size() &&
+           scene.getMeshFacesCount() == getTrianglesCount() - m_ObjectTrianglesCount;
+}
+
+size_t PrimitiveStore::getPrimitivesCount() const
+{
+    return getSpheresCount() + getTrianglesCount();
+}
+
+size_t PrimitiveStore::getMemoryUsage() const
+{
+    return getSpheresCount()   * (4 * sizeof(float) + sizeof(uint32_t)) +
+           getTrianglesCount() * (3 * sizeof(Vec3<float>) + 4 * sizeof(uint32_t)) +
+           normals.size()      * sizeof(Vec3<float>) + 
+           materials.size()    * sizeof(const Material*);
+}
+
+Aabb PrimitiveStore::getBounds(PrimitiveRef ref) const
+{
+    Aabb bounds = Aabb::createEmpty();
+
+    if (ref.type == PRIMITIVE_SPHERE)
+    {
+        Vec3<float> center = {sphereCenterX[ref.index], sphereCenterY[ref.index], sphereCenterZ[ref.index]};
+        float       radius = sphereRadius[ref.index];
+
+        bounds.grow(center - Vec3<float>{radius, radius, radius});
+        bounds.grow(center + Vec3<float>{radius, radius, radius});
+    }
+    else
+    {
+        const Vec3<float>& v0 = triangleV0[ref.index];
+
+        bounds.grow(v0);
+        bounds.grow(v0 + triangleEdge1[ref.index]);
+        bounds.grow(v0 + triangleEdge2[ref.index]);
+    }
+
+    return bounds;
+}
+
+bool PrimitiveStore::intersect(PrimitiveRef ref, const Ray& ray, Hit* hit) const
+{
+    if (ref.type == PRIMITIVE_SPHERE)
+    {
+        return intersectSphere(ref.index, ray, hit);
+    }
+
+    return intersectTriangle(ref.index, ray, hit);
+}
+
+bool PrimitiveStore::intersectSphere(uint32_t sphereIdx, const Ray& ray, Hit* hit) const
+{
+    assert(hit);
+
+    /* Same as ::intersectSphere(), but in the form of ray_packet.cpp */
+    float toCenterX    = sphereCenterX[sphereIdx] - ray.from.x;
+    float toCenterY    = sphereCenterY[sphereIdx] - ray.from.y;
+    float toCenterZ    = sphereCenterZ[sphereIdx] - ray.from.z;
+    float radius       = sphereRadius[sphereIdx];
+
+    float a            = dotProduct(ray.direction, ray.direction);
+    float halfB        = ray.direction.x * toCenterX + ray.direction.y * toCenterY + ray.direction.z * toCenterZ;
+    float c            = toCenterX * toCenterX + toCenterY * toCenterY + toCenterZ * toCenterZ - radius * radius;
+
+    float discriminant = halfB * halfB - a * c;
+    if (discriminant < 0)
+    {
+        return false;
+    }
+
+    /* The far root is used when the ray starts inside the sphere */
+    float sqrtDiscriminant = sqrtf(discriminant);
+    float rayParameter     = (halfB - sqrtDiscriminant) / a;
+    if (rayParameter < 0)
+    {
+        rayParameter = (halfB + sqrtDiscriminant) / a;
+    }
+
+    if (rayParameter < 0)
+    {
+        return false;
+    }
+
+    hit->rayParameter = rayParameter;
+    hit->pos          = ray.at(rayParameter);
+    hit->normal       = (hit->pos - Vec3<float>{sphereCenterX[sphereIdx], sphereCenterY[sphereIdx], 
+                                                sphereCenterZ[sphereIdx]}) / radius;
+    hit->material     = materials[sphereMaterial[sphereIdx]];
+    hit->materialIdx  = sphereMaterial[sphereIdx];
+
+    return true;
+}
+
+bool PrimitiveStore::intersectTriangle(uint32_t triangleIdx, const Ray& ray, Hit* hit) const
+{
+    assert(hit);
+
+    const Vec3<float>& edge1 = triangleEdge1[triangleIdx];
+    const Vec3<float>& edge2 = triangleEdge2[triangleIdx];
+
+    float rayParameter = 0;
+    float u            = 0;
+    float v            = 0;
+    if (!intersectTriangleEdges(triangleV0[triangleIdx], edge1, edge2, ray, &rayParameter, &u, &v))
+    {
+        return false;
+    }
+
+    const uint32_t* normalIdx = &triangleNormals[3 * triangleIdx];
+    if (normalIdx[0] != PRIMITIVE_NO_NORMAL)
+    {
+        hit->normal = normalize((1 - u - v) * normals[normalIdx[0]] + 
+                                u           * normals[normalIdx[1]] + 
+                                v           * normals[normalIdx[2]]);
+    }
+    else
+    {
+        hit->normal = normalize(crossProduct(edge1, edge2));
+    }
+
+    hit->rayParameter = rayParameter;
+    hit->pos          = ray.at(rayParameter);
+    hit->material     = materials[triangleMaterial[triangleIdx]];
+    hit->materialIdx  = triangleMaterial[triangleIdx];
+
+    return true;
+}
+
+void PrimitiveStore::setSphere(uint32_t sphereIdx, const Sphere& sphere)
+{
+    sphereCenterX[sphereIdx]  = sphere.pos.worldSpace.x;
+    sphereCenterY[sphereIdx]  = sphere.pos.worldSpace.y;
+    sphereCenterZ[sphereIdx]  = sphere.pos.worldSpace.z;
+    sphereRadius[sphereIdx]   = sphere.radius.worldSpace;
+    sphereMaterial[sphereIdx] = sphere.materialIdx;
+}
+
+void PrimitiveStore::setTriangle(uint32_t triangleIdx, const Triangle& triangle)
+{
+    const Vec3<float>& v0 = triangle.v0.pos.worldSpace;
+
+    triangleV0[triangleIdx]       = v0;
+    triangleEdge1[triangleIdx]    = triangle.v1.pos.worldSpace - v0;
+    triangleEdge2[triangleIdx]    = triangle.v2.pos.worldSpace - v0;
+    triangleMaterial[triangleIdx] = triangle.materialIdx;
+
+    const uint32_t* normalIdx = &triangleNormals[3 * triangleIdx];
+    normals[normalIdx[0]] = triangle.v0.normal.worldSpace;
+    normals[normalIdx[1]] = triangle.v1.normal.worldSpace;
+    normals[normalIdx[2]] = triangle.v2.normal.worldSpace;
+}
+//------------------------------------------------------------------------------
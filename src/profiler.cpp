@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file profiler.cpp
+//! @date 2021-10-28
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "profiler.h"
+
+static const char* PROFILE_COUNTER_NAMES[PROFILE_COUNTERS_COUNT] = {"primary rays", "shadow rays",
+                                                                    "intersection tests", "hits",
+                                                                    "shading calls", "input latency us"};
+
+//---------------------------------ProfileFrame---------------------------------
+uint64_t ProfileFrame::getRaysCount() const
+{
+    return counters[PROFILE_COUNTER_PRIMARY_RAYS] + counters[PROFILE_COUNTER_SHADOW_RAYS];
+}
+//------------------------------------------------------------------------------
+
+//-----------------------------------Profiler-----------------------------------
+Profiler::Profiler() : m_StartTime(std::chrono::steady_clock::now()), m_FrameStart(0) {}
+
+Profiler& Profiler::getInstance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+uint64_t Profiler::getTime() const
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                m_StartTime).count();
+}
+
+Profiler::ThreadData& Profiler::getThreadData()
+{
+    /* Owned by the profiler, so events outlive threads that have recorded them */
+    thread_local ThreadData* threadData = nullptr;
+
+    if (threadData == nullptr)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        m_Threads.push_back(std::make_unique<ThreadData>());
+        threadData     = m_Threads.back().get();
+        threadData->id = (uint32_t) m_Threads.size();
+        threadData->events.reserve(1024);
+
+        for (size_t counter = 0; counter < PROFILE_COUNTERS_COUNT; counter++)
+        {
+            threadData->counters[counter] = 0;
+        }
+    }
+
+    return *threadData;
+}
+
+void Profiler::count(ProfileCounter counter, uint64_t value)
+{
+    assert(counter < PROFILE_COUNTERS_COUNT);
+    getThreadData().counters[counter] += value;
+}
+
+void Profiler::addEvent(const char* name, uint64_t start, uint64_t end)
+{
+    ThreadData& threadData = getThreadData();
+
+    if (threadData.events.size() < PROFILER_MAX_EVENTS_PER_THREAD)
+    {
+        threadData.events.push_back({name, start, end - start});
+    }
+}
+
+void Profiler::endFrame()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    ProfileFrame frame = {};
+    frame.start = m_FrameStart;
+    frame.end   = getTime();
+
+    for (auto& threadData : m_Threads)
+    {
+        for (size_t counter = 0; counter < PROFILE_COUNTERS_COUNT; counter++)
+        {
+            frame.counters[counter]     += threadData->counters[counter];
+            threadData->counters[counter] = 0;
+        }
+    }
+
+    m_Frames.push_back(frame);
+    m_FrameStart = frame.end;
+}
+
+const ProfileFrame& Profiler::getLastFrame() const
+{
+    static const ProfileFrame EMPTY_FRAME = {};
+    return m_Frames.empty() ? EMPTY_FRAME : m_Frames.back();
+}
+
+bool Profiler::writeChromeTrace(const char* fileName)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+
+    FILE* file = fopen(fileName, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\": [\n");
+
+    bool first = true;
+    for (auto& threadData : m_Threads)
+    {
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %" PRIu32 ", "
+                      "\"args\": {\"name\": \"%s %" PRIu32 "\"}}",
+                first ? "" : ",\n", threadData->id, threadData->id == 1 ? "main" : "thread", threadData->id);
+        first = false;
+
+        for (const ProfileEvent& event : threadData->events)
+        {
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %" PRIu32 ", "
+                          "\"ts\": %.3f, \"dur\": %.3f}",
+                    event.name, threadData->id, event.start / 1e3, event.duration / 1e3);
+        }
+    }
+
+    for (const ProfileFrame& frame : m_Frames)
+    {
+        for (size_t counter = 0; counter < PROFILE_COUNTERS_COUNT; counter++)
+        {
+            fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"C\", \"pid\": 1, \"ts\": %.3f, "
+                          "\"args\": {\"count\": %" PRIu64 "}}",
+                    first ? "" : ",\n", PROFILE_COUNTER_NAMES[counter], frame.start / 1e3, frame.counters[counter]);
+            first = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    return fclose(file) == 0;
+}
+
+const char* Profiler::getCounterName(ProfileCounter counter)
+{
+    assert(counter < PROFILE_COUNTERS_COUNT);
+    return PROFILE_COUNTER_NAMES[counter];
+}
+//------------------------------------------------------------------------------
@@ -0,0 +1,370 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file ray_packet.cpp
+//! @date 2021-10-21
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <math.h>
+#include "ray_packet.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+//----------------------------------RayPacket-----------------------------------
+void RayPacket::setRay(size_t lane, const Ray& ray)
+{
+    assert(lane < RAY_PACKET_SIZE);
+
+    fromX[lane]      = ray.from.x;
+    fromY[lane]      = ray.from.y;
+    fromZ[lane]      = ray.from.z;
+
+    directionX[lane] = ray.direction.x;
+    directionY[lane] = ray.direction.y;
+    directionZ[lane] = ray.direction.z;
+}
+
+Ray RayPacket::getRay(size_t lane) const
+{
+    assert(lane < RAY_PACKET_SIZE);
+
+    Ray ray = {};
+    ray.from      = {fromX[lane],      fromY[lane],      fromZ[lane]};
+    ray.direction = {directionX[lane], directionY[lane], directionZ[lane]};
+
+    return ray;
+}
+//------------------------------------------------------------------------------
+
+//----------------------------------PacketHit-----------------------------------
+void PacketHit::reset()
+{
+    for (size_t lane = 0; lane < RAY_PACKET_SIZE; lane++)
+    {
+        rayParameter[lane] = RAY_PACKET_MISS;
+        material[lane]     = nullptr;
+        materialIdx[lane]  = MATERIAL_NO_INDEX;
+    }
+}
+
+void PacketHit::setHit(size_t lane, const Hit& hit)
+{
+    assert(lane < RAY_PACKET_SIZE);
+
+    rayParameter[lane] = hit.rayParameter;
+
+    posX[lane]         = hit.pos.x;
+    posY[lane]         = hit.pos.y;
+    posZ[lane]         = hit.pos.z;
+
+    normalX[lane]      = hit.normal.x;
+    normalY[lane]      = hit.normal.y;
+    normalZ[lane]      = hit.normal.z;
+
+    material[lane]     = hit.material;
+    materialIdx[lane]  = hit.materialIdx;
+}
+
+Hit PacketHit::getHit(size_t lane) const
+{
+    assert(lane < RAY_PACKET_SIZE);
+
+    Hit hit = {};
+    hit.pos          = {posX[lane],    posY[lane],    posZ[lane]};
+    hit.rayParameter = rayParameter[lane];
+    hit.normal       = {normalX[lane], normalY[lane], normalZ[lane]};
+    hit.material     = material[lane];
+    hit.materialIdx  = materialIdx[lane];
+
+    return hit;
+}
+//------------------------------------------------------------------------------
+
+/**
+ * All implementations solve
+ * t^2 * (D, D) - 2 * t * (D, C - O) + |C - O|^2 - R^2 = 0
+ * 
+ * using half of the linear coefficient, so the closest root is
+ * t = ((D, C - O) - sqrt((D, C - O)^2 - (D, D) * (|C - O|^2 - R^2))) / (D, D)
+ * 
+ * and the unit normal is (hit - C) / R, which needs no square root.
+ */
+
+//------------------------------------Scalar------------------------------------
+void intersectSpherePacketScalar(const RayPacket& packet, const Vec3<float>& center, float radius,
+                                 const Material* material, uint32_t materialIdx, PacketHit* hit)
+{
+    assert(hit);
+
+    float invRadius = 1 / radius;
+
+    for (size_t lane = 0; lane < packet.count; lane++)
+    {
+        float toCenterX = center.x - packet.fromX[lane];
+        float toCenterY = center.y - packet.fromY[lane];
+        float toCenterZ = center.z - packet.fromZ[lane];
+
+        float dirX      = packet.directionX[lane];
+        float dirY      = packet.directionY[lane];
+        float dirZ      = packet.directionZ[lane];
+
+        float a         = dirX * dirX + dirY * dirY + dirZ * dirZ;
+        float halfB     = dirX * toCenterX + dirY * toCenterY + dirZ * toCenterZ;
+        float c         = toCenterX * toCenterX + toCenterY * toCenterY + toCenterZ * toCenterZ -
+                          radius * radius;
+
+        float discriminant = halfB * halfB - a * c;
+        if (discriminant < 0)
+        {
+            continue;
+        }
+
+        float rayParameter = (halfB - sqrtf(discriminant)) / a;
+        if (rayParameter <= 0 || rayParameter >= hit->rayParameter[lane])
+        {
+            continue;
+        }
+
+        hit->rayParameter[lane] = rayParameter;
+
+        hit->posX[lane]         = packet.fromX[lane] + dirX * rayParameter;
+        hit->posY[lane]         = packet.fromY[lane] + dirY * rayParameter;
+        hit->posZ[lane]         = packet.fromZ[lane] + dirZ * rayParameter;
+
+        hit->normalX[lane]      = (hit->posX[lane] - center.x) * invRadius;
+        hit->normalY[lane]      = (hit->posY[lane] - center.y) * invRadius;
+        hit->normalZ[lane]      = (hit->posZ[lane] - center.z) * invRadius;
+
+        hit->material[lane]     = material;
+        hit->materialIdx[lane]  = materialIdx;
+    }
+}
+//------------------------------------------------------------------------------
+
+#if defined(__x86_64__) || defined(__i386__)
+
+//-------------------------------------SSE--------------------------------------
+static inline __m128 selectSse(__m128 mask, __m128 ifTrue, __m128 ifFalse)
+{
+    return _mm_or_ps(_mm_and_ps(mask, ifTrue), _mm_andnot_ps(mask, ifFalse));
+}
+
+/* All bits of lane i are set if bit i of laneMask is */
+static inline __m128 expandLaneMaskSse(int laneMask)
+{
+    const __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+
+    return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(laneMask), laneBits), laneBits));
+}
+
+void intersectSpherePacketSse(const RayPacket& packet, const Vec3<float>& center, float radius,
+                              const Material* material, uint32_t materialIdx, PacketHit* hit)
+{
+    assert(hit);
+
+    const __m128 centerX   = _mm_set1_ps(center.x);
+    const __m128 centerY   = _mm_set1_ps(center.y);
+    const __m128 centerZ   = _mm_set1_ps(center.z);
+    const __m128 radiusSqr = _mm_set1_ps(radius * radius);
+    const __m128 invRadius = _mm_set1_ps(1 / radius);
+    const __m128 zero      = _mm_setzero_ps();
+
+    for (size_t first = 0; first < packet.count; first += 4)
+    {
+        __m128 fromX     = _mm_load_ps(packet.fromX + first);
+        __m128 fromY     = _mm_load_ps(packet.fromY + first);
+        __m128 fromZ     = _mm_load_ps(packet.fromZ + first);
+
+        __m128 dirX      = _mm_load_ps(packet.directionX + first);
+        __m128 dirY      = _mm_load_ps(packet.directionY + first);
+        __m128 dirZ      = _mm_load_ps(packet.directionZ + first);
+
+        __m128 toCenterX = _mm_sub_ps(centerX, fromX);
+        __m128 toCenterY = _mm_sub_ps(centerY, fromY);
+        __m128 toCenterZ = _mm_sub_ps(centerZ, fromZ);
+
+        __m128 a         = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dirX, dirX), _mm_mul_ps(dirY, dirY)),
+                                      _mm_mul_ps(dirZ, dirZ));
+        __m128 halfB     = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dirX, toCenterX), _mm_mul_ps(dirY, toCenterY)),
+                                      _mm_mul_ps(dirZ, toCenterZ));
+        __m128 c         = _mm_sub_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(toCenterX, toCenterX),
+                                                            _mm_mul_ps(toCenterY, toCenterY)),
+                                                 _mm_mul_ps(toCenterZ, toCenterZ)),
+                                      radiusSqr);
+
+        __m128 discriminant = _mm_sub_ps(_mm_mul_ps(halfB, halfB), _mm_mul_ps(a, c));
+        __m128 mask         = _mm_cmpge_ps(discriminant, zero);
+
+        __m128 rayParameter = _mm_div_ps(_mm_sub_ps(halfB, _mm_sqrt_ps(_mm_max_ps(discriminant, zero))), a);
+        __m128 closest      = _mm_load_ps(hit->rayParameter + first);
+
+        mask = _mm_and_ps(mask, _mm_cmpgt_ps(rayParameter, zero));
+        mask = _mm_and_ps(mask, _mm_cmplt_ps(rayParameter, closest));
+
+        /* Lanes beyond packet.count are never reported as hit */
+        size_t lanesCount = packet.count - first < 4 ? packet.count - first : 4;
+
+        int laneMask = _mm_movemask_ps(mask) & ((1 << lanesCount) - 1);
+        if (laneMask == 0)
+        {
+            continue;
+        }
+
+        mask = expandLaneMaskSse(laneMask);
+
+        __m128 posX = _mm_add_ps(fromX, _mm_mul_ps(dirX, rayParameter));
+        __m128 posY = _mm_add_ps(fromY, _mm_mul_ps(dirY, rayParameter));
+        __m128 posZ = _mm_add_ps(fromZ, _mm_mul_ps(dirZ, rayParameter));
+
+        _mm_store_ps(hit->rayParameter + first, selectSse(mask, rayParameter, closest));
+
+        _mm_store_ps(hit->posX + first, selectSse(mask, posX, _mm_load_ps(hit->posX + first)));
+        _mm_store_ps(hit->posY + first, selectSse(mask, posY, _mm_load_ps(hit->posY + first)));
+        _mm_store_ps(hit->posZ + first, selectSse(mask, posZ, _mm_load_ps(hit->posZ + first)));
+
+        _mm_store_ps(hit->normalX + first, selectSse(mask, _mm_mul_ps(_mm_sub_ps(posX, centerX), invRadius),
+                                                     _mm_load_ps(hit->normalX + first)));
+        _mm_store_ps(hit->normalY + first, selectSse(mask, _mm_mul_ps(_mm_sub_ps(posY, centerY), invRadius),
+                                                     _mm_load_ps(hit->normalY + first)));
+        _mm_store_ps(hit->normalZ + first, selectSse(mask, _mm_mul_ps(_mm_sub_ps(posZ, centerZ), invRadius),
+                                                     _mm_load_ps(hit->normalZ + first)));
+
+        for (size_t lane = 0; lane < 4; lane++)
+        {
+            if (laneMask & (1 << lane))
+            {
+                hit->material[first + lane]    = material;
+                hit->materialIdx[first + lane] = materialIdx;
+            }
+        }
+    }
+}
+//------------------------------------------------------------------------------
+
+//-------------------------------------AVX2-------------------------------------
+/* All bits of lane i are set if bit i of laneMask is */
+__attribute__((target("avx2,fma")))
+static inline __m256 expandLaneMaskAvx2(int laneMask)
+{
+    const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+
+    return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(laneMask), laneBits),
+                                                  laneBits));
+}
+
+__attribute__((target("avx2,fma")))
+void intersectSpherePacketAvx2(const RayPacket& packet, const Vec3<float>& center, float radius,
+                               const Material* material, uint32_t materialIdx, PacketHit* hit)
+{
+    assert(hit);
+
+    const __m256 centerX   = _mm256_set1_ps(center.x);
+    const __m256 centerY   = _mm256_set1_ps(center.y);
+    const __m256 centerZ   = _mm256_set1_ps(center.z);
+    const __m256 radiusSqr = _mm256_set1_ps(radius * radius);
+    const __m256 invRadius = _mm256_set1_ps(1 / radius);
+    const __m256 zero      = _mm256_setzero_ps();
+
+    __m256 fromX     = _mm256_load_ps(packet.fromX);
+    __m256 fromY     = _mm256_load_ps(packet.fromY);
+    __m256 fromZ     = _mm256_load_ps(packet.fromZ);
+
+    __m256 dirX      = _mm256_load_ps(packet.directionX);
+    __m256 dirY      = _mm256_load_ps(packet.directionY);
+    __m256 dirZ      = _mm256_load_ps(packet.directionZ);
+
+    __m256 toCenterX = _mm256_sub_ps(centerX, fromX);
+    __m256 toCenterY = _mm256_sub_ps(centerY, fromY);
+    __m256 toCenterZ = _mm256_sub_ps(centerZ, fromZ);
+
+    __m256 a         = _mm256_fmadd_ps(dirZ, dirZ, _mm256_fmadd_ps(dirY, dirY, _mm256_mul_ps(dirX, dirX)));
+    __m256 halfB     = _mm256_fmadd_ps(dirZ, toCenterZ, 
+                                       _mm256_fmadd_ps(dirY, toCenterY, _mm256_mul_ps(dirX, toCenterX)));
+    __m256 c         = _mm256_fmadd_ps(toCenterZ, toCenterZ,
+                                       _mm256_fmadd_ps(toCenterY, toCenterY,
+                                                       _mm256_fmsub_ps(toCenterX, toCenterX, radiusSqr)));
+
+    __m256 discriminant = _mm256_fmsub_ps(halfB, halfB, _mm256_mul_ps(a, c));
+    __m256 mask         = _mm256_cmp_ps(discriminant, zero, _CMP_GE_OQ);
+
+    __m256 rayParameter = _mm256_div_ps(_mm256_sub_ps(halfB, _mm256_sqrt_ps(_mm256_max_ps(discriminant, zero))), a);
+    __m256 closest      = _mm256_load_ps(hit->rayParameter);
+
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(rayParameter, zero,    _CMP_GT_OQ));
+    mask = _mm256_and_ps(mask, _mm256_cmp_ps(rayParameter, closest, _CMP_LT_OQ));
+
+    /* Lanes beyond packet.count are never reported as hit */
+    int laneMask = _mm256_movemask_ps(mask) & ((1 << packet.count) - 1);
+    if (laneMask == 0)
+    {
+        return;
+    }
+
+    mask = expandLaneMaskAvx2(laneMask);
+
+    __m256 posX = _mm256_fmadd_ps(dirX, rayParameter, fromX);
+    __m256 posY = _mm256_fmadd_ps(dirY, rayParameter, fromY);
+    __m256 posZ = _mm256_fmadd_ps(dirZ, rayParameter, fromZ);
+
+    _mm256_store_ps(hit->rayParameter, _mm256_blendv_ps(closest, rayParameter, mask));
+
+    _mm256_store_ps(hit->posX, _mm256_blendv_ps(_mm256_load_ps(hit->posX), posX, mask));
+    _mm256_store_ps(hit->posY, _mm256_blendv_ps(_mm256_load_ps(hit->posY), posY, mask));
+    _mm256_store_ps(hit->posZ, _mm256_blendv_ps(_mm256_load_ps(hit->posZ), posZ, mask));
+
+    _mm256_store_ps(hit->normalX, _mm256_blendv_ps(_mm256_load_ps(hit->normalX),
+                                                   _mm256_mul_ps(_mm256_sub_ps(posX, centerX), invRadius), mask));
+    _mm256_store_ps(hit->normalY, _mm256_blendv_ps(_mm256_load_ps(hit->normalY),
+                                                   _mm256_mul_ps(_mm256_sub_ps(posY, centerY), invRadius), mask));
+    _mm256_store_ps(hit->normalZ, _mm256_blendv_ps(_mm256_load_ps(hit->normalZ),
+                                                   _mm256_mul_ps(_mm256_sub_ps(posZ, centerZ), invRadius), mask));
+
+    for (size_t lane = 0; lane < RAY_PACKET_SIZE; lane++)
+    {
+        if (laneMask & (1 << lane))
+        {
+            hit->material[lane]    = material;
+            hit->materialIdx[lane] = materialIdx;
+        }
+    }
+}
+//------------------------------------------------------------------------------
+
+#endif
+
+//-----------------------------------Dispatch-----------------------------------
+static const char* s_RayPacketIsaName = "scalar";
+
+static IntersectSpherePacketFunction selectIntersectSpherePacket()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        s_RayPacketIsaName = "avx2";
+        return intersectSpherePacketAvx2;
+    }
+
+    if (__builtin_cpu_supports("sse2"))
+    {
+        s_RayPacketIsaName = "sse";
+        return intersectSpherePacketSse;
+    }
+#endif
+
+    s_RayPacketIsaName = "scalar";
+    return intersectSpherePacketScalar;
+}
+
+const IntersectSpherePacketFunction intersectSpherePacket = selectIntersectSpherePacket();
+
+const char* getRayPacketIsaName()
+{
+    return s_RayPacketIsaName;
+}
+//------------------------------------------------------------------------------
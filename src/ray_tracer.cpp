@@ -6,71 +6,1374 @@
 //! @copyright Copyright (c) 2021
 //------------------------------------------------------------------------------
 
+#include <algorithm>
+#include <chrono>
 #include "ray_tracer.h"
 #include "hit.h"
+#include "profiler.h"
 
 const Vec3<float> CAMERA_POS = {0, 0, 0};
 
-void renderPrimitive(RayTracer& rayTracer, Object3d& primitive);
+static const char* RENDER_MODE_NAMES[RENDER_MODES_COUNT] = {"per-primitive", "per-pixel", "packets", "deferred"};
+static const char* ANTIALIASING_MODE_NAMES[ANTIALIASING_MODES_COUNT] = {"none", "adaptive", "uniform"};
+static const char* INTEGRATOR_NAMES[INTEGRATORS_COUNT] = {"whitted", "path-tracing"};
+static const char* PROGRESSIVE_STATE_NAMES[] = {"disabled", "motion", "accumulating", "converged"};
+
+/* Counted locally while rendering a tile and submitted to the profiler once */
+struct TileCounters
+{
+    uint64_t primaryRays;
+    uint64_t hits;
+    uint64_t shadingCalls;
+};
+
+//------------------------------------------------------------------------------
+//! @brief Traces primary rays of a tile in per-pixel mode one by one and
+//!        accumulates the tile's statistics, which are merged by submit().
+//------------------------------------------------------------------------------
+struct PixelTracer
+{
+    //--------------------------------------------------------------------------
+    //! @param rayTracer
+    //! @param tile       Seeds secondary rays' Russian roulette.
+    //! @param slotsCount Number of colors secondary rays are traced for.
+    //--------------------------------------------------------------------------
+    PixelTracer(RayTracer& rayTracer, const Tile& tile, size_t slotsCount);
+
+    RayTracer&        rayTracer;
+    Space             shadingSpace;
+    BvhTraversalStats bvhStats;
+    ShadowCache       shadows;
+    SecondaryRayQueue secondaryRays;
+    TileCounters      counters;
+
+    //--------------------------------------------------------------------------
+    //! @brief Find the closest hit of the primary ray and shade it.
+    //! 
+    //! @param direction Camera space direction of the ray from the camera.
+    //! @param hit       Closest hit in shadingSpace.
+    //! @param rgb       Color of the hit, left untouched if nothing is hit.
+    //!                  Only the surface's share if secondary rays are queued.
+    //! @param slot      Index of rgb in traceSecondaryRays()' colors.
+    //! 
+    //! @return Whether anything has been hit.
+    //--------------------------------------------------------------------------
+    bool trace(const Vec3<float>& direction, Hit* hit, Vec3<float>* rgb, uint32_t slot = 0);
+
+    //--------------------------------------------------------------------------
+    //! @brief Trace secondary rays queued by trace() calls, adding their
+    //!        contributions to colors.
+    //--------------------------------------------------------------------------
+    void traceSecondaryRays(Vec3<float>* colors);
+
+    void submit();
+};
+
+void renderTile(RayTracer& rayTracer, const Tile& tile);
+void renderPrimitive(RayTracer& rayTracer, Hittable& primitive, const Tile& tile);
+void renderPixelMajor(RayTracer& rayTracer, const Tile& tile);
+void renderPathTraced(RayTracer& rayTracer, const Tile& tile);
+void renderPixelPackets(RayTracer& rayTracer, const Tile& tile);
+void setPrimaryRays(const NearPlaneGrid& nearPlane, size_t xFirst, size_t y, RayPacket* packet);
+void intersectPacket(RayTracer& rayTracer, const RayPacket& packet, PacketHit* hits);
+void fillGBuffer(RayTracer& rayTracer, const Tile& tile);
+void shadeGBuffer(RayTracer& rayTracer, const Tile& tile);
+void antialiasTile(RayTracer& rayTracer, const Tile& tile);
+bool isOnEdge(const RayTracer& rayTracer, size_t x, size_t y);
+Vec2<float> getStratifiedOffset(size_t x, size_t y, size_t sample, size_t side);
+bool intersectClosest(Scene& scene, const Ray& ray, Hit* hit);
+const uint8_t* getLightVisibility(const RayTracer& rayTracer, const ShadowCache& shadows);
+void mergeShadowStats(RayTracer& rayTracer, const ShadowCache& shadows);
+Hit toCameraSpace(const Hit& worldHit, const Camera& camera);
 bool capNormalized(Vec3<float>& color);
-Color convertToRgba(Vec3<float> rgb);
-Vec3<float> calculateColor(Scene& scene, const Hit& hit);
+ProgressiveState updateProgressiveState(RayTracer& rayTracer);
+bool haveLightsMoved(RayTracer& rayTracer);
+bool canReuseGBuffer(RayTracer& rayTracer, bool frustumChanged);
+Vec2<float> getSampleJitter(size_t sampleIdx);
+float getRadicalInverse(size_t idx, size_t base);
+Vec3<float> accumulateSample(AccumulationBuffer& accumulation, size_t x, size_t y, const Vec3<float>& sample);
+void fillBlock(FrameBuffer& target, const Tile& tile, size_t x, size_t y, size_t side, Color color);
+size_t getTestsCount(const Hittable& primitive);
+size_t getTestsPerRay(Scene& scene);
+void submitCounters(const TileCounters& counters, const ShadowCache& shadows);
+
+//------------------------------AntialiasingStats-------------------------------
+void AntialiasingStats::merge(const AntialiasingStats& other)
+{
+    pixels          += other.pixels;
+    resampledPixels += other.resampledPixels;
+    extraRays       += other.extraRays;
+}
+
+float AntialiasingStats::getRaysPerPixel() const
+{
+    return pixels != 0 ? (float) (pixels + extraRays) / (float) pixels : 0;
+}
+//------------------------------------------------------------------------------
+
+RayTracer::RayTracer(Scene* scene, FrameBuffer* target, ZBuffer* zbuffer,
+                     TileScheduler* scheduler) :
+                     scene(scene), target(target), zbuffer(zbuffer),
+                     scheduler(scheduler), tileSize(TILE_DEFAULT_SIZE),
+                     renderMode(RENDER_MODE_PER_PIXEL), lastRenderTime(0),
+                     useBvh(false), traceInWorldSpace(false), primitivesSynced(false),
+                     lastBvhStats{}, gbufferSynced(false), gbufferCameraVersion(0), gbufferReused(false),
+                     enableShadows(false), lastShadowStats{},
+                     maxRayDepth(SECONDARY_DEFAULT_MAX_DEPTH), rouletteDepth(SECONDARY_DEFAULT_ROULETTE_DEPTH),
+                     lastSecondaryStats{}, integrator(INTEGRATOR_WHITTED),
+                     pathSamplesPerFrame(PATH_DEFAULT_SAMPLES_PER_FRAME), maxBounces(PATH_DEFAULT_MAX_BOUNCES),
+                     lastPathStats{},
+                     antialiasing(ANTIALIASING_NONE), antialiasingSide(ANTIALIASING_DEFAULT_SIDE),
+                     antialiasingThreshold(ANTIALIASING_DEFAULT_THRESHOLD), lastAntialiasingStats{},
+                     accumulation(nullptr), motionStride(PROGRESSIVE_DEFAULT_MOTION_STRIDE),
+                     maxSamplesCount(PROGRESSIVE_DEFAULT_MAX_SAMPLES),
+                     progressiveState(PROGRESSIVE_DISABLED), accumulatedCameraVersion(0) {}
+
+void RayTracer::renderScene()
+{
+    PROFILE_SCOPE("renderScene");
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    size_t width  = target->width;
+    size_t height = target->height;
+
+    bool frustumChanged = nearPlane.update(width, height, scene->camera.getViewFrustum());
+
+    if (renderMode == RENDER_MODE_PER_PRIMITIVE)
+    {
+        target->clear(COLOR_BLACK);
+    }
+
+    if (renderMode == RENDER_MODE_PER_PIXEL && useBvh)
+    {
+        PROFILE_SCOPE("updatePrimitives");
+
+        if (primitives.isMapped())
+        {
+            /* Loaded from a scene cache along with the BVH, see SceneCache */
+        }
+        else if (primitivesSynced && primitives.isCompiledFor(*scene) && bvh.isBuiltFor(primitives))
+        {
+            primitives.update(*scene, &changedPrimitives);
+            bvh.refit(changedPrimitives);
+        }
+        else
+        {
+            primitives.compile(*scene);
+            bvh.build(primitives);
+        }
+
+        primitivesSynced = true;
+        lastBvhStats     = {};
+    }
+    else
+    {
+        /* Scene's changes of this frame are going to be missed */
+        primitivesSynced = false;
+    }
+
+    if (renderMode == RENDER_MODE_DEFERRED)
+    {
+        gbufferReused = canReuseGBuffer(*this, frustumChanged);
+    }
+    else
+    {
+        /* Same as with primitives */
+        gbufferSynced = false;
+        gbufferReused = false;
+    }
+
+    {
+        PROFILE_SCOPE("updateShading");
+        shading.update(*scene);
+    }
+
+    lastShadowStats       = {};
+    lastAntialiasingStats = {};
+    lastSecondaryStats    = {};
+    lastPathStats         = {};
+    progressiveState      = updateProgressiveState(*this);
+
+    if (isAntialiasing())
+    {
+        primaryColors.resize(width * height);
+        primaryMaterials.resize(width * height);
+    }
+
+    if (renderMode == RENDER_MODE_PACKETS || (renderMode == RENDER_MODE_DEFERRED && !gbufferReused))
+    {
+        spheres.clear();
+        otherObjects.clear();
 
-RayTracer::RayTracer(Scene* scene, BufferedTexture* targetTexture, ZBuffer* zbuffer) :
-                     scene(scene), targetTexture(targetTexture), zbuffer(zbuffer) {}
+        for (auto primitive : scene->objects)
+        {
+            if (Sphere* sphere = dynamic_cast<Sphere*>(primitive))
+            {
+                spheres.push_back(sphere);
+            }
+            else
+            {
+                otherObjects.push_back(primitive);
+            }
+        }
+    }
+
+    if (progressiveState == PROGRESSIVE_CONVERGED)
+    {
+        /* Target already holds the final image */
+    }
+    else if (scheduler != nullptr)
+    {
+        scheduler->run(width, height, tileSize, [this](const Tile& tile, size_t) {
+            PROFILE_SCOPE("tile");
+            renderTile(*this, tile);
+        });
+    }
+    else
+    {
+        renderTile(*this, {0, 0, width, height});
+    }
+
+    if (progressiveState == PROGRESSIVE_ACCUMULATING)
+    {
+        accumulation->samplesCount++;
+    }
+
+    /* Needs the whole frame's first pass done to look at tiles' neighbours */
+    if (isAntialiasing() && scheduler != nullptr)
+    {
+        scheduler->run(width, height, tileSize, [this](const Tile& tile, size_t) {
+            PROFILE_SCOPE("antialiasTile");
+            antialiasTile(*this, tile);
+        });
+    }
+    else if (isAntialiasing())
+    {
+        antialiasTile(*this, {0, 0, width, height});
+    }
+
+    std::chrono::duration<float, std::milli> renderTime = std::chrono::steady_clock::now() - startTime;
+    lastRenderTime = renderTime.count();
+}
+
+void RayTracer::restartAccumulation()
+{
+    if (accumulation != nullptr)
+    {
+        accumulation->reset();
+    }
+}
+
+bool RayTracer::isAntialiasing() const
+{
+    return renderMode == RENDER_MODE_PER_PIXEL && antialiasing != ANTIALIASING_NONE &&
+           progressiveState == PROGRESSIVE_DISABLED;
+}
+
+bool RayTracer::isTracingSecondaryRays() const
+{
+    return isTracingInWorldSpace() && maxRayDepth > 0 && !isPathTracing();
+}
+
+bool RayTracer::isPathTracing() const
+{
+    return integrator == INTEGRATOR_PATH_TRACING && isTracingInWorldSpace() && accumulation != nullptr;
+}
+
+bool RayTracer::isTracingInWorldSpace() const
+{
+    return renderMode == RENDER_MODE_PER_PIXEL && useBvh && traceInWorldSpace;
+}
+
+bool RayTracer::needsCameraSpaceValues() const
+{
+    return !isTracingInWorldSpace();
+}
+
+const char* getRenderModeName(RenderMode renderMode)
+{
+    assert(renderMode < RENDER_MODES_COUNT);
+    return RENDER_MODE_NAMES[renderMode];
+}
+
+const char* getAntialiasingModeName(AntialiasingMode antialiasingMode)
+{
+    assert(antialiasingMode < ANTIALIASING_MODES_COUNT);
+    return ANTIALIASING_MODE_NAMES[antialiasingMode];
+}
+
+const char* getIntegratorName(Integrator integrator)
+{
+    assert(integrator < INTEGRATORS_COUNT);
+    return INTEGRATOR_NAMES[integrator];
+}
+
+const char* getProgressiveStateName(ProgressiveState progressiveState)
+{
+    assert(progressiveState <= PROGRESSIVE_CONVERGED);
+    return PROGRESSIVE_STATE_NAMES[progressiveState];
+}
+
+//------------------------------------------------------------------------------
+//! @brief Render pixels of the tile using rayTracer's current render mode.
+//! 
+//! @note Called concurrently for different tiles, so it mustn't touch anything
+//!       outside of the tile's region of the framebuffer and z-buffer.
+//------------------------------------------------------------------------------
+void renderTile(RayTracer& rayTracer, const Tile& tile)
+{
+    switch (rayTracer.renderMode)
+    {
+        case RENDER_MODE_PER_PRIMITIVE:
+        {
+            for (auto primitive : rayTracer.scene->objects)
+            {
+                renderPrimitive(rayTracer, *primitive, tile);
+            }
+
+            for (auto mesh : rayTracer.scene->meshes)
+            {
+                renderPrimitive(rayTracer, *mesh, tile);
+            }
+
+            break;
+        }
+
+        case RENDER_MODE_PER_PIXEL:
+        {
+            if (rayTracer.isPathTracing())
+            {
+                renderPathTraced(rayTracer, tile);
+            }
+            else
+            {
+                renderPixelMajor(rayTracer, tile);
+            }
+
+            break;
+        }
+
+        case RENDER_MODE_PACKETS:
+        {
+            renderPixelPackets(rayTracer, tile);
+            break;
+        }
+
+        case RENDER_MODE_DEFERRED:
+        {
+            if (!rayTracer.gbufferReused)
+            {
+                fillGBuffer(rayTracer, tile);
+            }
+
+            shadeGBuffer(rayTracer, tile);
+            break;
+        }
+
+        default: { assert(!"Invalid render mode"); break; }
+    }
+}
+
+void renderPrimitive(RayTracer& rayTracer, Hittable& primitive, const Tile& tile)
+{
+    Scene& scene = *rayTracer.scene;
+    Camera& camera = scene.camera;
+
+    const NearPlaneGrid& nearPlane = rayTracer.nearPlane;
+    ShadowCache          shadows   = {};
+    TileCounters         counters  = {};
+
+    if (rayTracer.enableShadows)
+    {
+        shadows.reset(scene.lightSources.getSize());
+    }
+
+    counters.primaryRays = (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    PROFILE_COUNT(PROFILE_COUNTER_INTERSECTION_TESTS, counters.primaryRays * getTestsCount(primitive));
+    
+    for (size_t yScreen = tile.y0; yScreen < tile.y1; yScreen++)
+    {
+        Color* row = (*rayTracer.target)[yScreen];
+
+        for (size_t xScreen = tile.x0; xScreen < tile.x1; xScreen++)
+        {
+            Ray ray = {};
+            ray.direction = nearPlane.getDirection(xScreen, yScreen);
+
+            Hit hit = {};
+            if (primitive.intersect(ray, &hit) &&
+                dotProduct(hit.pos - camera.getPos().cameraSpace, hit.normal) <= 0 &&
+                rayTracer.zbuffer->setDepth(xScreen, yScreen, hit.pos.z))
+            {
+                if (rayTracer.enableShadows)
+                {
+                    traceShadows(scene, hit, &shadows);
+                }
+
+                row[xScreen] = convertToRgba(rayTracer.shading.shade(hit, SPACE_CAMERA,
+                                                                     getLightVisibility(rayTracer, shadows)));
+                counters.hits++;
+                counters.shadingCalls++;
+            }
+        }
+    }
+
+    mergeShadowStats(rayTracer, shadows);
+    submitCounters(counters, shadows);
+}
+
+PixelTracer::PixelTracer(RayTracer& rayTracer, const Tile& tile, size_t slotsCount) :
+                         rayTracer(rayTracer),
+                         shadingSpace(rayTracer.isTracingInWorldSpace() ? SPACE_WORLD : SPACE_CAMERA),
+                         bvhStats{}, shadows{}, secondaryRays{}, counters{}
+{
+    if (rayTracer.enableShadows)
+    {
+        shadows.reset(rayTracer.scene->lightSources.getSize());
+    }
+
+    if (rayTracer.isTracingSecondaryRays())
+    {
+        /* Any non-zero seed, distinct per tile */
+        uint32_t seed = (uint32_t) (tile.x0 * 73856093u ^ tile.y0 * 19349663u) | 1u;
+
+        secondaryRays.reset(SECONDARY_RAYS_PER_SLOT * slotsCount, rayTracer.maxRayDepth,
+                            rayTracer.rouletteDepth, seed);
+    }
+}
+
+bool PixelTracer::trace(const Vec3<float>& direction, Hit* hit, Vec3<float>* rgb, uint32_t slot)
+{
+    assert(hit);
+    assert(rgb);
+
+    Scene& scene = *rayTracer.scene;
+    Camera& camera = scene.camera;
+
+    bool isHit = false;
+    counters.primaryRays++;
+
+    if (rayTracer.useBvh)
+    {
+        Ray worldRay = {};
+        worldRay.from      = camera.getPos().worldSpace;
+        worldRay.direction = camera.toWorldDirection(direction);
+
+        isHit = rayTracer.bvh.intersect(worldRay, hit, &bvhStats);
+
+        /* Shadow rays are traced through BVH too, so before converting */
+        if (isHit && rayTracer.enableShadows)
+        {
+            traceShadows(rayTracer.bvh, rayTracer.primitives, scene, *hit, &shadows);
+        }
+
+        if (isHit && !rayTracer.traceInWorldSpace)
+        {
+            *hit = toCameraSpace(*hit, camera);
+        }
+    }
+    else
+    {
+        Ray ray = {};
+        ray.direction = direction;
+
+        isHit = intersectClosest(scene, ray, hit);
+
+        if (isHit && rayTracer.enableShadows)
+        {
+            traceShadows(scene, *hit, &shadows);
+        }
+    }
+
+    if (isHit)
+    {
+        *rgb = rayTracer.shading.shade(*hit, shadingSpace, getLightVisibility(rayTracer, shadows));
+        counters.hits++;
+        counters.shadingCalls++;
+
+        if (rayTracer.isTracingSecondaryRays())
+        {
+            Ray worldRay = {};
+            worldRay.from      = camera.getPos().worldSpace;
+            worldRay.direction = normalize(camera.toWorldDirection(direction));
+
+            *rgb = getSurfaceWeight(*hit->material) * (*rgb);
+            secondaryRays.spawn(worldRay, *hit, {1, 1, 1}, slot, 1);
+        }
+    }
+
+    return isHit;
+}
+
+void PixelTracer::traceSecondaryRays(Vec3<float>* colors)
+{
+    if (!rayTracer.isTracingSecondaryRays() || secondaryRays.isEmpty())
+    {
+        return;
+    }
+
+    PROFILE_SCOPE("secondaryRays");
+
+    secondaryRays.trace(rayTracer.bvh, rayTracer.primitives, *rayTracer.scene, rayTracer.shading,
+                        rayTracer.enableShadows ? &shadows : nullptr, colors, &bvhStats);
+}
+
+void PixelTracer::submit()
+{
+    if (rayTracer.useBvh)
+    {
+        std::lock_guard<std::mutex> lock(rayTracer.statsMutex);
+        rayTracer.lastBvhStats.merge(bvhStats);
+        rayTracer.lastSecondaryStats.merge(secondaryRays.stats);
+    }
+
+    PROFILE_COUNT(PROFILE_COUNTER_INTERSECTION_TESTS, rayTracer.useBvh ? bvhStats.primitiveTests :
+                                                      counters.primaryRays * getTestsPerRay(*rayTracer.scene));
+
+    mergeShadowStats(rayTracer, shadows);
+    submitCounters(counters, shadows);
+}
+
+//------------------------------------------------------------------------------
+//! @brief Trace each primary ray once, find the closest front-facing hit among
+//!        all primitives and shade only it.
+//! 
+//! Unlike renderPrimitive() no fragment is shaded just to be overwritten by a
+//! closer primitive later, and the framebuffer doesn't need to be cleared
+//! beforehand, since every pixel is written exactly once.
+//! 
+//! In progressive mode either only the top-left pixel of each motionStride
+//! sided block is traced and its color fills the whole block, or the ray is
+//! jittered within the pixel and the color is averaged with previous samples.
+//! When anti-aliasing, results are also kept for antialiasTile().
+//------------------------------------------------------------------------------
+void renderPixelMajor(RayTracer& rayTracer, const Tile& tile)
+{
+    const NearPlaneGrid& nearPlane    = rayTracer.nearPlane;
+
+    ProgressiveState     progressive  = rayTracer.progressiveState;
+    bool                 accumulate   = progressive == PROGRESSIVE_ACCUMULATING;
+    size_t               stride       = progressive == PROGRESSIVE_MOTION ? rayTracer.motionStride : 1;
+    Vec2<float>          jitter       = accumulate ? getSampleJitter(rayTracer.accumulation->samplesCount)
+                                                   : Vec2<float>{0, 0};
+    bool                 antialiasing = rayTracer.isAntialiasing();
+
+    /* A slot per traced pixel */
+    size_t columns = (tile.x1 - tile.x0 + stride - 1) / stride;
+    size_t rows    = (tile.y1 - tile.y0 + stride - 1) / stride;
+
+    PixelTracer                  tracer(rayTracer, tile, columns * rows);
+    std::vector<Vec3<float>>     colors(columns * rows, Vec3<float>{0, 0, 0});
+    std::vector<const Material*> materials(columns * rows, nullptr);
+
+    /* Primary rays first, secondary ones are only queued meanwhile */
+    for (size_t row = 0; row < rows; row++)
+    {
+        for (size_t column = 0; column < columns; column++)
+        {
+            size_t xScreen = tile.x0 + column * stride;
+            size_t yScreen = tile.y0 + row    * stride;
+            size_t slot    = row * columns + column;
+
+            Hit hit = {};
+            if (tracer.trace(nearPlane.getDirection(xScreen, yScreen, jitter.x, jitter.y), &hit, &colors[slot],
+                             (uint32_t) slot))
+            {
+                // Primary rays' directions have z = near in camera space
+                rayTracer.zbuffer->setDepth(xScreen, yScreen, hit.rayParameter * nearPlane.near);
+                materials[slot] = hit.material;
+            }
+        }
+    }
+
+    tracer.traceSecondaryRays(colors.data());
+
+    for (size_t row = 0; row < rows; row++)
+    {
+        for (size_t column = 0; column < columns; column++)
+        {
+            size_t      xScreen = tile.x0 + column * stride;
+            size_t      yScreen = tile.y0 + row    * stride;
+            size_t      slot    = row * columns + column;
+            Vec3<float> rgb     = colors[slot];
+            Color       color   = COLOR_BLACK;
+
+            capNormalized(rgb);
+
+            if (materials[slot] != nullptr)
+            {
+                color = convertToRgba(rgb);
+            }
+
+            if (accumulate)
+            {
+                color = convertToRgba(accumulateSample(*rayTracer.accumulation, xScreen, yScreen, rgb));
+            }
+
+            if (antialiasing)
+            {
+                size_t idx = yScreen * rayTracer.target->width + xScreen;
+
+                rayTracer.primaryColors[idx]    = color;
+                rayTracer.primaryMaterials[idx] = materials[slot];
+            }
+
+            if (stride == 1)
+            {
+                (*rayTracer.target)[yScreen][xScreen] = color;
+            }
+            else
+            {
+                fillBlock(*rayTracer.target, tile, xScreen, yScreen, stride, color);
+            }
+        }
+    }
+
+    tracer.submit();
+}
+
+//------------------------------------------------------------------------------
+//! @brief Path trace the tile's pixels, pathSamplesPerFrame paths per pixel
+//!        with uniformly jittered primary rays while accumulating, a single
+//!        unjittered one per motionStride block while the camera moves.
+//! 
+//! Radiance is accumulated unclamped, only the displayed average is clamped.
+//! The z-buffer isn't written.
+//------------------------------------------------------------------------------
+void renderPathTraced(RayTracer& rayTracer, const Tile& tile)
+{
+    const NearPlaneGrid& nearPlane    = rayTracer.nearPlane;
+    Scene&               scene        = *rayTracer.scene;
+    Camera&              camera       = scene.camera;
+    AccumulationBuffer&  accumulation = *rayTracer.accumulation;
+
+    bool   accumulate   = rayTracer.progressiveState == PROGRESSIVE_ACCUMULATING;
+    size_t stride       = accumulate ? 1 : rayTracer.motionStride;
+    size_t samplesCount = accumulate ? rayTracer.pathSamplesPerFrame : 1;
+
+    assert(samplesCount > 0);
+
+    /* The random state is local to the tile, so the thread tracing it, and
+       distinct for every frame of accumulation */
+    uint32_t seed = (uint32_t) (tile.x0 * 73856093u ^ tile.y0 * 19349663u ^
+                                accumulation.samplesCount * 83492791u) | 1u;
+
+    PathTracer        tracer;
+    BvhTraversalStats bvhStats = {};
+    TileCounters      counters = {};
+
+    tracer.reset(scene, rayTracer.maxBounces, PATH_DEFAULT_ROULETTE_BOUNCES, seed);
+
+    Ray ray = {};
+    ray.from = camera.getPos().worldSpace;
+
+    for (size_t yScreen = tile.y0; yScreen < tile.y1; yScreen += stride)
+    {
+        for (size_t xScreen = tile.x0; xScreen < tile.x1; xScreen += stride)
+        {
+            Vec3<float> sum = {0, 0, 0};
+
+            for (size_t sample = 0; sample < samplesCount; sample++)
+            {
+                float dx = accumulate ? tracer.getRandom() - 0.5f : 0;
+                float dy = accumulate ? tracer.getRandom() - 0.5f : 0;
+
+                ray.direction = normalize(camera.toWorldDirection(nearPlane.getDirection(xScreen, yScreen, dx, dy)));
+                sum += tracer.trace(rayTracer.bvh, rayTracer.primitives, scene, ray, &bvhStats);
+            }
+
+            Vec3<float> rgb = (1.0f / (float) samplesCount) * sum;
+
+            if (accumulate)
+            {
+                rgb = accumulateSample(accumulation, xScreen, yScreen, rgb);
+            }
+
+            capNormalized(rgb);
+
+            if (stride == 1)
+            {
+                (*rayTracer.target)[yScreen][xScreen] = convertToRgba(rgb);
+            }
+            else
+            {
+                fillBlock(*rayTracer.target, tile, xScreen, yScreen, stride, convertToRgba(rgb));
+            }
+        }
+    }
+
+    counters.primaryRays = tracer.stats.samples;
+
+    {
+        std::lock_guard<std::mutex> lock(rayTracer.statsMutex);
+        rayTracer.lastBvhStats.merge(bvhStats);
+        rayTracer.lastShadowStats.merge(tracer.shadows.stats);
+        rayTracer.lastPathStats.merge(tracer.stats);
+    }
+
+    PROFILE_COUNT(PROFILE_COUNTER_INTERSECTION_TESTS, bvhStats.primitiveTests);
+    submitCounters(counters, tracer.shadows);
+}
+
+//------------------------------------------------------------------------------
+//! @brief Second pass of anti-aliasing: replace colors of the tile's pixels
+//!        that need it with averages of antialiasingSide^2 stratified samples.
+//! 
+//! Edges are detected on the first pass' results, which aren't modified, so
+//! pixels of neighbouring tiles can be read safely.
+//------------------------------------------------------------------------------
+void antialiasTile(RayTracer& rayTracer, const Tile& tile)
+{
+    const NearPlaneGrid& nearPlane = rayTracer.nearPlane;
+    AntialiasingStats    stats     = {};
+
+    size_t side         = rayTracer.antialiasingSide;
+    size_t samplesCount = side * side;
+
+    /* Screen coordinates of the pixels to resample */
+    std::vector<Vec2<size_t>> pixels;
+
+    for (size_t yScreen = tile.y0; yScreen < tile.y1; yScreen++)
+    {
+        for (size_t xScreen = tile.x0; xScreen < tile.x1; xScreen++)
+        {
+            if (rayTracer.antialiasing == ANTIALIASING_UNIFORM || isOnEdge(rayTracer, xScreen, yScreen))
+            {
+                pixels.push_back({xScreen, yScreen});
+            }
+        }
+    }
+
+    /* A slot per sample */
+    PixelTracer              tracer(rayTracer, tile, pixels.size() * samplesCount);
+    std::vector<Vec3<float>> colors(pixels.size() * samplesCount, Vec3<float>{0, 0, 0});
+
+    for (size_t pixel = 0; pixel < pixels.size(); pixel++)
+    {
+        for (size_t sample = 0; sample < samplesCount; sample++)
+        {
+            size_t      slot   = pixel * samplesCount + sample;
+            Vec2<float> offset = getStratifiedOffset(pixels[pixel].x, pixels[pixel].y, sample, side);
+            Hit         hit    = {};
+
+            tracer.trace(nearPlane.getDirection(pixels[pixel].x, pixels[pixel].y, offset.x, offset.y), &hit,
+                         &colors[slot], (uint32_t) slot);
+        }
+    }
+
+    tracer.traceSecondaryRays(colors.data());
+
+    for (size_t pixel = 0; pixel < pixels.size(); pixel++)
+    {
+        Vec3<float> sum = {0, 0, 0};
+
+        for (size_t sample = 0; sample < samplesCount; sample++)
+        {
+            Vec3<float> rgb = colors[pixel * samplesCount + sample];
+            capNormalized(rgb);
+
+            sum += rgb;
+        }
+
+        (*rayTracer.target)[pixels[pixel].y][pixels[pixel].x] = convertToRgba((1.0f / samplesCount) * sum);
+    }
+
+    tracer.submit();
+
+    stats.pixels          = (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    stats.resampledPixels = pixels.size();
+    stats.extraRays       = pixels.size() * samplesCount;
+
+    std::lock_guard<std::mutex> lock(rayTracer.statsMutex);
+    rayTracer.lastAntialiasingStats.merge(stats);
+}
 
-void RayTracer::renderScene()
+//------------------------------------------------------------------------------
+//! @brief Whether the pixel's color or material differs from any of its four
+//!        neighbours' after the first pass.
+//------------------------------------------------------------------------------
+bool isOnEdge(const RayTracer& rayTracer, size_t x, size_t y)
 {
-    targetTexture->clearBuffer(COLOR_BLACK);
+    size_t width  = rayTracer.target->width;
+    size_t height = rayTracer.target->height;
+    size_t idx    = y * width + x;
 
-    for (auto primitive : scene->objects)
-    {
-        renderPrimitive(*this, *primitive);
-    }
+    const std::vector<Color>&           colors    = rayTracer.primaryColors;
+    const std::vector<const Material*>& materials = rayTracer.primaryMaterials;
+
+    /* In 0..255 units of color channels */
+    int threshold = (int) (rayTracer.antialiasingThreshold * 0xFF);
+
+    auto differs = [&](size_t neighbour) {
+        if (materials[neighbour] != materials[idx])
+        {
+            return true;
+        }
+
+        for (int shift = 8; shift < 32; shift += 8)
+        {
+            int channel          = (int) ((colors[idx]       >> shift) & 0xFF);
+            int neighbourChannel = (int) ((colors[neighbour] >> shift) & 0xFF);
+
+            if (abs(channel - neighbourChannel) > threshold)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    };
+
+    return (x > 0          && differs(idx - 1))     || (x + 1 < width  && differs(idx + 1)) ||
+           (y > 0          && differs(idx - width)) || (y + 1 < height && differs(idx + width));
 }
 
-void renderPrimitive(RayTracer& rayTracer, Object3d& primitive)
+//------------------------------------------------------------------------------
+//! @return Offset of the sample from the pixel's ray in fractions of a pixel,
+//!         within its cell of side x side grid centered at the ray. Position
+//!         inside the cell is a hash of the pixel and sample, so that samples
+//!         of neighbouring pixels don't line up.
+//------------------------------------------------------------------------------
+Vec2<float> getStratifiedOffset(size_t x, size_t y, size_t sample, size_t side)
 {
-    size_t width  = rayTracer.targetTexture->getTexture().getWidth();
-    size_t height = rayTracer.targetTexture->getTexture().getHeight();
+    uint32_t hash = (uint32_t) (x * 73856093u) ^ (uint32_t) (y * 19349663u) ^ (uint32_t) (sample * 83492791u);
+
+    /* Murmur3's finalizer */
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
 
-    float fwidth  = (float) width;
-    float fheight = (float) height;
+    float u = (float) (hash & 0xFFFF) / 0x10000;
+    float v = (float) (hash >> 16)    / 0x10000;
 
+    return {((float) (sample % side) + u) / (float) side - 0.5f,
+            ((float) (sample / side) + v) / (float) side - 0.5f};
+}
+
+//------------------------------------------------------------------------------
+//! @brief Same as renderPixelMajor(), but consecutive pixels of a row are
+//!        traced together as a @ref RayPacket, so that spheres are intersected
+//!        with SIMD. Other primitives are still intersected one ray at a time.
+//------------------------------------------------------------------------------
+void renderPixelPackets(RayTracer& rayTracer, const Tile& tile)
+{
     Scene& scene = *rayTracer.scene;
-    Camera& camera = scene.camera;
 
-    const ViewFrustum& frustum = camera.getViewFrustum();
-    
-    for (size_t xScreen = 0; xScreen < width; xScreen++)
+    RayPacket          packet   = {};
+    PacketHit          hits     = {};
+    ShadowCache        shadows  = {};
+    TileCounters       counters = {};
+    Vec3<float>        colors[RAY_PACKET_SIZE];
+    std::vector<float> visibility; ///< Lanes' visibility per light, see ShadingTable::shadePacket().
+
+    if (rayTracer.enableShadows)
+    {
+        size_t lightsCount = scene.lightSources.getSize();
+
+        shadows.reset(lightsCount);
+        visibility.resize(lightsCount * RAY_PACKET_SIZE);
+    }
+
+    counters.primaryRays = (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    PROFILE_COUNT(PROFILE_COUNTER_INTERSECTION_TESTS, counters.primaryRays * getTestsPerRay(scene));
+
+    for (size_t yScreen = tile.y0; yScreen < tile.y1; yScreen++)
     {
-        for (size_t yScreen = 0; yScreen < height; yScreen++)
+        Color* row = (*rayTracer.target)[yScreen];
+
+        for (size_t xFirst = tile.x0; xFirst < tile.x1; xFirst += RAY_PACKET_SIZE)
         {
-            Vec3<float> curPoint = toViewFrustumPoint({xScreen, yScreen}, 
-                                                      fwidth, fheight, 
-                                                      frustum);
+            packet.count = tile.x1 - xFirst < RAY_PACKET_SIZE ? tile.x1 - xFirst : RAY_PACKET_SIZE;
 
-            Ray ray = {};
-            ray.direction = curPoint;
+            setPrimaryRays(rayTracer.nearPlane, xFirst, yScreen, &packet);
+            intersectPacket(rayTracer, packet, &hits);
+
+            for (size_t lane = 0; lane < packet.count; lane++)
+            {
+                if (hits.isHit(lane))
+                {
+                    Hit hit = hits.getHit(lane);
+
+                    rayTracer.zbuffer->setDepth(xFirst + lane, yScreen, hit.pos.z);
+
+                    if (rayTracer.enableShadows)
+                    {
+                        traceShadows(scene, hit, &shadows);
+
+                        for (size_t i = 0; i < shadows.lightVisible.size(); i++)
+                        {
+                            visibility[i * RAY_PACKET_SIZE + lane] = shadows.lightVisible[i];
+                        }
+                    }
+
+                    counters.hits++;
+                    counters.shadingCalls++;
+                }
+            }
+
+            /* All lanes at once, after every lane's closest hit is known */
+            rayTracer.shading.shadePacket(hits, packet.count, SPACE_CAMERA,
+                                          rayTracer.enableShadows ? visibility.data() : nullptr, colors);
+
+            for (size_t lane = 0; lane < packet.count; lane++)
+            {
+                row[xFirst + lane] = hits.isHit(lane) ? convertToRgba(colors[lane]) : COLOR_BLACK;
+            }
+        }
+    }
+
+    mergeShadowStats(rayTracer, shadows);
+    submitCounters(counters, shadows);
+}
+
+//------------------------------------------------------------------------------
+//! @brief Camera space primary rays through packet->count pixels of row y
+//!        starting at xFirst, the rest lanes duplicate the first one.
+//------------------------------------------------------------------------------
+void setPrimaryRays(const NearPlaneGrid& nearPlane, size_t xFirst, size_t y, RayPacket* packet)
+{
+    assert(packet);
+    assert(packet->count <= RAY_PACKET_SIZE);
+
+    for (size_t lane = 0; lane < RAY_PACKET_SIZE; lane++)
+    {
+        Ray ray = {};
+        ray.direction = nearPlane.getDirection(xFirst + (lane < packet->count ? lane : 0), y);
+
+        packet->setRay(lane, ray);
+    }
+}
+
+//------------------------------------------------------------------------------
+//! @brief Find the closest front-facing hits of the packet's rays, spheres are
+//!        intersected with SIMD, other primitives one ray at a time.
+//------------------------------------------------------------------------------
+void intersectPacket(RayTracer& rayTracer, const RayPacket& packet, PacketHit* hits)
+{
+    assert(hits);
+
+    Scene&             scene     = *rayTracer.scene;
+    const Vec3<float>& cameraPos = scene.camera.getPos().cameraSpace;
 
-            Vec3<float> color = {0};
-            bool updateColor = false;
+    hits->reset();
 
+    for (Sphere* sphere : rayTracer.spheres)
+    {
+        intersectSpherePacket(packet, sphere->pos.cameraSpace, sphere->radius.cameraSpace,
+                              sphere->material, sphere->materialIdx, hits);
+    }
+
+    for (size_t lane = 0; lane < packet.count; lane++)
+    {
+        Ray ray = packet.getRay(lane);
+
+        auto tryPrimitive = [&](Hittable& primitive) {
             Hit hit = {};
             if (primitive.intersect(ray, &hit) &&
-                dotProduct(hit.pos - camera.getPos().cameraSpace, hit.normal) <= 0 &&
-                rayTracer.zbuffer->setDepth(xScreen, yScreen, hit.pos.z))
+                dotProduct(hit.pos - cameraPos, hit.normal) <= 0 &&
+                hit.rayParameter < hits->rayParameter[lane])
+            {
+                hits->setHit(lane, hit);
+            }
+        };
+
+        for (Object3d* primitive : rayTracer.otherObjects)
+        {
+            tryPrimitive(*primitive);
+        }
+
+        for (auto mesh : scene.meshes)
+        {
+            tryPrimitive(*mesh);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+//! @brief Geometry pass of deferred mode: write the closest hits of the tile's
+//!        primary rays, found the same way as in renderPixelPackets(), to the
+//!        G-buffer without shading any of them.
+//------------------------------------------------------------------------------
+void fillGBuffer(RayTracer& rayTracer, const Tile& tile)
+{
+    PROFILE_SCOPE("geometryPass");
+
+    assert(tile.x0 % RAY_PACKET_SIZE == 0);
+
+    RayPacket    packet   = {};
+    PacketHit    hits     = {};
+    TileCounters counters = {};
+
+    counters.primaryRays = (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    PROFILE_COUNT(PROFILE_COUNTER_INTERSECTION_TESTS, counters.primaryRays * getTestsPerRay(*rayTracer.scene));
+
+    for (size_t yScreen = tile.y0; yScreen < tile.y1; yScreen++)
+    {
+        for (size_t xFirst = tile.x0; xFirst < tile.x1; xFirst += RAY_PACKET_SIZE)
+        {
+            packet.count = tile.x1 - xFirst < RAY_PACKET_SIZE ? tile.x1 - xFirst : RAY_PACKET_SIZE;
+
+            setPrimaryRays(rayTracer.nearPlane, xFirst, yScreen, &packet);
+            intersectPacket(rayTracer, packet, &hits);
+
+            GBufferBlock& block = rayTracer.gbuffer.getBlock(xFirst, yScreen);
+            block.reset();
+
+            for (size_t lane = 0; lane < packet.count; lane++)
+            {
+                if (!hits.isHit(lane))
+                {
+                    continue;
+                }
+
+                block.setHit(lane, hits.getHit(lane));
+                counters.hits++;
+            }
+        }
+    }
+
+    PROFILE_COUNT(PROFILE_COUNTER_PRIMARY_RAYS, counters.primaryRays);
+    PROFILE_COUNT(PROFILE_COUNTER_HITS,         counters.hits);
+}
+
+//------------------------------------------------------------------------------
+//! @brief Lighting pass of deferred mode: shade the tile's G-buffer blocks in
+//!        memory order, each with a single ShadingTable::shadeBlock() call,
+//!        after tracing shadow rays from its hits if shadows are on.
+//! 
+//! The z-buffer is reset every frame, unlike the G-buffer, so hits' depths are
+//! written to it here rather than in the geometry pass.
+//------------------------------------------------------------------------------
+void shadeGBuffer(RayTracer& rayTracer, const Tile& tile)
+{
+    PROFILE_SCOPE("lightingPass");
+
+    assert(tile.x0 % RAY_PACKET_SIZE == 0);
+
+    Scene&         scene   = *rayTracer.scene;
+    const GBuffer& gbuffer = rayTracer.gbuffer;
+
+    ShadowCache        shadows  = {};
+    TileCounters       counters = {};
+    Vec3<float>        colors[RAY_PACKET_SIZE];
+    std::vector<float> visibility; ///< Lanes' visibility per light, see ShadingTable::shadeBlock().
+
+    if (rayTracer.enableShadows)
+    {
+        size_t lightsCount = scene.lightSources.getSize();
+
+        shadows.reset(lightsCount);
+        visibility.resize(lightsCount * RAY_PACKET_SIZE);
+    }
+
+    for (size_t yScreen = tile.y0; yScreen < tile.y1; yScreen++)
+    {
+        Color* row = (*rayTracer.target)[yScreen];
+
+        for (size_t xFirst = tile.x0; xFirst < tile.x1; xFirst += RAY_PACKET_SIZE)
+        {
+            const GBufferBlock& block     = gbuffer.getBlock(xFirst, yScreen);
+            size_t              count     = tile.x1 - xFirst < RAY_PACKET_SIZE ? tile.x1 - xFirst : RAY_PACKET_SIZE;
+            size_t              hitsCount = 0;
+
+            for (size_t lane = 0; lane < count; lane++)
+            {
+                if (!block.isHit(lane))
+                {
+                    continue;
+                }
+
+                hitsCount++;
+
+                rayTracer.zbuffer->setDepth(xFirst + lane, yScreen, block.depth[lane]);
+
+                if (rayTracer.enableShadows)
+                {
+                    traceShadows(scene, block.getHit(lane), &shadows);
+
+                    for (size_t i = 0; i < shadows.lightVisible.size(); i++)
+                    {
+                        visibility[i * RAY_PACKET_SIZE + lane] = shadows.lightVisible[i];
+                    }
+                }
+
+                counters.shadingCalls++;
+            }
+
+            /* Background usually takes whole blocks */
+            if (hitsCount == 0)
             {
-                color = calculateColor(scene, hit);
-                updateColor = true;
+                std::fill(row + xFirst, row + xFirst + count, COLOR_BLACK);
+                continue;
             }
 
-            if (updateColor)
+            rayTracer.shading.shadeBlock(block, count, SPACE_CAMERA,
+                                         rayTracer.enableShadows ? visibility.data() : nullptr, colors);
+
+            for (size_t lane = 0; lane < count; lane++)
             {
-                (*rayTracer.targetTexture)[yScreen][xScreen] = convertToRgba(color);
+                row[xFirst + lane] = block.isHit(lane) ? convertToRgba(colors[lane]) : COLOR_BLACK;
             }
         }
     }
+
+    mergeShadowStats(rayTracer, shadows);
+    submitCounters(counters, shadows);
+}
+
+//------------------------------------------------------------------------------
+//! @return Lights' visibility for ShadingTable::shade(), nullptr if shadows are
+//!         off.
+//------------------------------------------------------------------------------
+const uint8_t* getLightVisibility(const RayTracer& rayTracer, const ShadowCache& shadows)
+{
+    return rayTracer.enableShadows ? shadows.lightVisible.data() : nullptr;
+}
+
+void mergeShadowStats(RayTracer& rayTracer, const ShadowCache& shadows)
+{
+    if (rayTracer.enableShadows)
+    {
+        std::lock_guard<std::mutex> lock(rayTracer.statsMutex);
+        rayTracer.lastShadowStats.merge(shadows.stats);
+    }
+}
+
+//------------------------------------------------------------------------------
+//! @brief Decide what the frame renders in progressive mode, restarting
+//!        accumulation if the camera or scene has changed since the last one.
+//------------------------------------------------------------------------------
+ProgressiveState updateProgressiveState(RayTracer& rayTracer)
+{
+    AccumulationBuffer* accumulation = rayTracer.accumulation;
+    if (accumulation == nullptr)
+    {
+        return PROGRESSIVE_DISABLED;
+    }
+
+    if (rayTracer.renderMode != RENDER_MODE_PER_PIXEL)
+    {
+        /* Changes aren't tracked meanwhile */
+        accumulation->reset();
+        return PROGRESSIVE_DISABLED;
+    }
+
+    assert(accumulation->width == rayTracer.target->width && accumulation->height == rayTracer.target->height);
+    assert(rayTracer.motionStride > 0 && TILE_ALIGNMENT % rayTracer.motionStride == 0);
+
+    Scene&   scene         = *rayTracer.scene;
+    uint64_t cameraVersion = scene.camera.getVersion();
+    bool     cameraMoved   = cameraVersion != rayTracer.accumulatedCameraVersion;
+    bool     lightsMoved   = haveLightsMoved(rayTracer);
+    bool     sceneChanged  = lightsMoved || !scene.changedObjects.empty() || scene.meshesChanged;
+
+    rayTracer.accumulatedCameraVersion = cameraVersion;
+
+    if (cameraMoved || sceneChanged)
+    {
+        accumulation->reset();
+    }
+
+    if (cameraMoved)
+    {
+        return PROGRESSIVE_MOTION;
+    }
+
+    return accumulation->samplesCount < rayTracer.maxSamplesCount ? PROGRESSIVE_ACCUMULATING
+                                                                  : PROGRESSIVE_CONVERGED;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Compare lights' world space positions with the ones accumulation has
+//!        been started with and remember the current ones.
+//------------------------------------------------------------------------------
+bool haveLightsMoved(RayTracer& rayTracer)
+{
+    Scene&                    scene     = *rayTracer.scene;
+    std::vector<Vec3<float>>& positions = rayTracer.accumulatedLights;
+    size_t                    count     = scene.lightSources.getSize();
+    bool                      moved     = positions.size() != count;
+
+    positions.resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const Vec3<float>& pos = scene.lightSources[i]->pos.worldSpace;
+
+        if (pos.x != positions[i].x || pos.y != positions[i].y || pos.z != positions[i].z)
+        {
+            positions[i] = pos;
+            moved        = true;
+        }
+    }
+
+    return moved;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Decide whether the frame can skip deferred mode's geometry pass,
+//!        which it can if the G-buffer holds hits of the same screen, camera
+//!        and scene's geometry, and resize the G-buffer otherwise.
+//------------------------------------------------------------------------------
+bool canReuseGBuffer(RayTracer& rayTracer, bool frustumChanged)
+{
+    Scene&   scene         = *rayTracer.scene;
+    uint64_t cameraVersion = scene.camera.getVersion();
+    bool     resized       = rayTracer.gbuffer.update(rayTracer.target->width, rayTracer.target->height);
+    bool     sceneChanged  = !scene.changedObjects.empty() || scene.meshesChanged;
+
+    bool     reusable      = rayTracer.gbufferSynced && !resized && !frustumChanged && !sceneChanged &&
+                             cameraVersion == rayTracer.gbufferCameraVersion;
+
+    rayTracer.gbufferSynced        = true;
+    rayTracer.gbufferCameraVersion = cameraVersion;
+
+    return reusable;
+}
+
+//------------------------------------------------------------------------------
+//! @return Offset of the sample's ray from the pixel's one in fractions of a
+//!         pixel, the first sample isn't offset, the rest follow Halton (2, 3)
+//!         sequence, which covers the pixel evenly for any number of samples.
+//------------------------------------------------------------------------------
+Vec2<float> getSampleJitter(size_t sampleIdx)
+{
+    if (sampleIdx == 0)
+    {
+        return {0, 0};
+    }
+
+    return {getRadicalInverse(sampleIdx, 2) - 0.5f, getRadicalInverse(sampleIdx, 3) - 0.5f};
+}
+
+float getRadicalInverse(size_t idx, size_t base)
+{
+    float inverse = 0;
+    float digit   = 1.0f / (float) base;
+
+    for (; idx > 0; idx /= base, digit /= (float) base)
+    {
+        inverse += (float) (idx % base) * digit;
+    }
+
+    return inverse;
+}
+
+//------------------------------------------------------------------------------
+//! @return Average of all the pixel's samples including the new one.
+//------------------------------------------------------------------------------
+Vec3<float> accumulateSample(AccumulationBuffer& accumulation, size_t x, size_t y, const Vec3<float>& sample)
+{
+    Vec3<float>& sum = accumulation[y][x];
+    sum = accumulation.samplesCount == 0 ? sample : sum + sample;
+
+    return (1.0f / (float) (accumulation.samplesCount + 1)) * sum;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Fill side x side block with top-left corner (x, y), clipped by tile.
+//------------------------------------------------------------------------------
+void fillBlock(FrameBuffer& target, const Tile& tile, size_t x, size_t y, size_t side, Color color)
+{
+    size_t x1 = x + side < tile.x1 ? x + side : tile.x1;
+    size_t y1 = y + side < tile.y1 ? y + side : tile.y1;
+
+    for (size_t yBlock = y; yBlock < y1; yBlock++)
+    {
+        Color* row = target[yBlock];
+
+        for (size_t xBlock = x; xBlock < x1; xBlock++)
+        {
+            row[xBlock] = color;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+//! @return Number of ray-primitive tests a ray does against the primitive.
+//------------------------------------------------------------------------------
+size_t getTestsCount(const Hittable& primitive)
+{
+    const Mesh* mesh = dynamic_cast<const Mesh*>(&primitive);
+    return mesh != nullptr ? mesh->faces.getSize() : 1;
+}
+
+//------------------------------------------------------------------------------
+//! @return Number of ray-primitive tests a ray does in intersectClosest().
+//------------------------------------------------------------------------------
+size_t getTestsPerRay(Scene& scene)
+{
+    size_t testsCount = 0;
+
+    for (auto primitive : scene.objects)
+    {
+        testsCount += getTestsCount(*primitive);
+    }
+
+    for (auto mesh : scene.meshes)
+    {
+        testsCount += getTestsCount(*mesh);
+    }
+
+    return testsCount;
+}
+
+void submitCounters(const TileCounters& counters, const ShadowCache& shadows)
+{
+    PROFILE_COUNT(PROFILE_COUNTER_PRIMARY_RAYS,  counters.primaryRays);
+    PROFILE_COUNT(PROFILE_COUNTER_SHADOW_RAYS,   shadows.stats.rays);
+    PROFILE_COUNT(PROFILE_COUNTER_HITS,          counters.hits);
+    PROFILE_COUNT(PROFILE_COUNTER_SHADING_CALLS, counters.shadingCalls);
+}
+
+//------------------------------------------------------------------------------
+//! @brief Find the closest front-facing hit of the ray among scene's objects
+//!        and meshes.
+//! 
+//! @return Whether anything has been hit.
+//------------------------------------------------------------------------------
+bool intersectClosest(Scene& scene, const Ray& ray, Hit* hit)
+{
+    assert(hit);
+
+    const Vec3<float>& cameraPos = scene.camera.getPos().cameraSpace;
+    bool               found     = false;
+
+    auto tryPrimitive = [&](Hittable& primitive) {
+        Hit curHit = {};
+        if (primitive.intersect(ray, &curHit) &&
+            dotProduct(curHit.pos - cameraPos, curHit.normal) <= 0 &&
+            (!found || curHit.rayParameter < hit->rayParameter))
+        {
+            *hit  = curHit;
+            found = true;
+        }
+    };
+
+    for (auto primitive : scene.objects)
+    {
+        tryPrimitive(*primitive);
+    }
+
+    for (auto mesh : scene.meshes)
+    {
+        tryPrimitive(*mesh);
+    }
+
+    return found;
+}
+
+Hit toCameraSpace(const Hit& worldHit, const Camera& camera)
+{
+    Hit hit = worldHit;
+
+    hit.pos    = camera.getViewMatrix() * worldHit.pos;
+    hit.normal = camera.toCameraDirection(worldHit.normal);
+
+    return hit;
 }
 
 bool capNormalized(Vec3<float>& color)
@@ -95,19 +1398,26 @@ Color convertToRgba(Vec3<float> rgb)
     return rgbaColor(rgb.x, rgb.y, rgb.z, 0xFF);
 }
 
-Vec3<float> calculateColor(Scene& scene, const Hit& hit)
+Vec3<float> calculateColor(Scene& scene, const Hit& hit, Space space, const uint8_t* lightVisible,
+                           const Vec3<float>* eyePos)
 {
     assert(hit.material);
 
     Vec3<float> color       = componentMultiply(scene.ambientColor, hit.material->ambient);
     size_t      lightsCount = scene.lightSources.getSize();
-    Vec3<float> toCamera    = normalize(CAMERA_POS - hit.pos);
+    Vec3<float> cameraPos   = space == SPACE_WORLD ? scene.camera.getPos().worldSpace : CAMERA_POS;
+    Vec3<float> toCamera    = normalize((eyePos != nullptr ? *eyePos : cameraPos) - hit.pos);
 
     capNormalized(color);
 
     for (size_t i = 0; i < lightsCount; i++)
     {
-        Vec3<float> toLight = normalize(scene.lightSources[i]->pos.cameraSpace - hit.pos);
+        if (lightVisible != nullptr && !lightVisible[i])
+        {
+            continue;
+        }
+
+        Vec3<float> toLight = normalize(scene.lightSources[i]->pos.get(space) - hit.pos);
 
         /* Diffuse component */
         Vec3<float> diffuse = {0};
@@ -127,7 +1437,8 @@ Vec3<float> calculateColor(Scene& scene, const Hit& hit)
         {
             float dotNormalHalfway = dotProduct(hit.normal, normalize(halfway));
 
-            if (dotNormalHalfway)
+            /* Surfaces facing away from the halfway vector have no highlight */
+            if (dotNormalHalfway > 0)
             {
                 specular = powf(dotNormalHalfway, hit.material->shiness) * 
                            componentMultiply(scene.lightSources[i]->specular, 
@@ -0,0 +1,125 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file render_thread.cpp
+//! @date 2021-11-06
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include "render_thread.h"
+#include "profiler.h"
+
+RenderThread::RenderThread(RayTracer& rayTracer, FrameBuffer& first, FrameBuffer& second)
+    : m_RayTracer(rayTracer), m_Buffers{&first, &second}, m_FrontIdx(0), m_IsRendering(false),
+      m_FrameRequested(false), m_Stopping(false)
+{
+    assert(first.width == second.width && first.height == second.height);
+
+    m_Thread = std::thread(&RenderThread::threadLoop, this);
+}
+
+RenderThread::~RenderThread()
+{
+    if (m_IsRendering)
+    {
+        finishFrame();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+
+    m_StartCondition.notify_one();
+    m_Thread.join();
+}
+
+void RenderThread::startFrame(const RenderFunction& render)
+{
+    assert(!m_IsRendering);
+
+    m_RayTracer.target = m_Buffers[1 - m_FrontIdx];
+    m_IsRendering      = true;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Render         = render;
+        m_FrameRequested = true;
+    }
+
+    m_StartCondition.notify_one();
+}
+
+bool RenderThread::finishFrame()
+{
+    assert(m_IsRendering);
+
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_FinishCondition.wait(lock, [this]() { return !m_FrameRequested; });
+    }
+
+    m_IsRendering = false;
+
+    /* Nothing has been traced, the back buffer holds an older image */
+    if (m_RayTracer.progressiveState == PROGRESSIVE_CONVERGED)
+    {
+        return false;
+    }
+
+    m_FrontIdx = 1 - m_FrontIdx;
+    return true;
+}
+
+bool RenderThread::isFrameFinished()
+{
+    assert(m_IsRendering);
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return !m_FrameRequested;
+}
+
+bool RenderThread::isRendering() const
+{
+    return m_IsRendering;
+}
+
+const FrameBuffer& RenderThread::getFrontBuffer() const
+{
+    return *m_Buffers[m_FrontIdx];
+}
+
+void RenderThread::threadLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+
+    while (true)
+    {
+        m_StartCondition.wait(lock, [this]() { return m_FrameRequested || m_Stopping; });
+
+        if (m_Stopping)
+        {
+            return;
+        }
+
+        lock.unlock();
+
+        {
+            PROFILE_SCOPE("renderFrame");
+
+            if (m_Render)
+            {
+                m_Render();
+            }
+            else
+            {
+                m_RayTracer.renderScene();
+            }
+        }
+
+        lock.lock();
+        m_FrameRequested = false;
+        m_FinishCondition.notify_one();
+    }
+}
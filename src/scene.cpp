@@ -6,30 +6,132 @@
 //! @copyright Copyright (c) 2021
 //------------------------------------------------------------------------------
 
+#include <assert.h>
 #include "scene.h"
+#include "profiler.h"
+
+void Scene::addObject(Object3d* object)
+{
+    assert(object);
+
+    objects.pushBack(object);
+    object->setDirtyList(&m_DirtyObjects);
+    object->materialIdx = addMaterial(object->material);
+    m_ObjectsCount++;
+}
+
+void Scene::addMesh(Mesh* mesh)
+{
+    assert(mesh);
+
+    meshes.pushBack(mesh);
+    mesh->setDirtyList(&m_DirtyMeshes);
+    mesh->materialIdx = addMaterial(mesh->material);
+    m_MeshFacesCount += mesh->faces.getSize();
+}
+
+uint32_t Scene::addMaterial(const Material* material)
+{
+    assert(material);
+
+    auto found = m_MaterialIndices.find(material);
+    if (found != m_MaterialIndices.end())
+    {
+        return found->second;
+    }
+
+    uint32_t materialIdx = (uint32_t) materials.size();
+
+    materials.push_back(material);
+    m_MaterialIndices[material] = materialIdx;
+
+    return materialIdx;
+}
 
 void Scene::updateWorldSpaceValues()
 {
+    PROFILE_SCOPE("updateWorldSpaceValues");
+
+    changedObjects.clear();
+    meshesChanged = false;
+
     for (auto light : lightSources)
     {
         light->toWorldSpace();
     }
 
-    for (auto object : objects)
+    /* Only objects are on the list, see addObject() */
+    for (SpaceDependent* entity : m_DirtyObjects)
     {
+        Object3d* object = static_cast<Object3d*>(entity);
+
         object->toWorldSpace();
+        object->clearDirty();
+
+        changedObjects.push_back(object);
+    }
+
+    for (SpaceDependent* mesh : m_DirtyMeshes)
+    {
+        mesh->toWorldSpace();
+        mesh->clearDirty();
+
+        meshesChanged = true;
     }
+
+    /* Faces may have been edited, meshes are few compared to their faces */
+    if (meshesChanged)
+    {
+        m_MeshFacesCount = 0;
+        for (auto mesh : meshes)
+        {
+            m_MeshFacesCount += mesh->faces.getSize();
+        }
+    }
+
+    m_DirtyObjects.clear();
+    m_DirtyMeshes.clear();
 }
 
 void Scene::updateCameraSpaceValues()
 {
+    PROFILE_SCOPE("updateCameraSpaceValues");
+
+    bool cameraChanged = !m_CameraSpaceValid || camera.getVersion() != m_CameraVersion;
+
+    m_CameraVersion    = camera.getVersion();
+    m_CameraSpaceValid = true;
+
     for (auto light : lightSources)
     {
         light->toCameraSpace(camera);
     }
 
-    for (auto object : objects)
+    if (!cameraChanged)
+    {
+        for (auto object : changedObjects)
+        {
+            object->toCameraSpace(camera);
+        }
+    }
+    else
+    {
+        for (auto object : objects)
+        {
+            object->toCameraSpace(camera);
+        }
+    }
+
+    if (cameraChanged || meshesChanged)
     {
-        object->toCameraSpace(camera);
+        for (auto mesh : meshes)
+        {
+            mesh->toCameraSpace(camera);
+        }
     }
+}
+
+void Scene::invalidateCameraSpaceValues()
+{
+    m_CameraSpaceValid = false;
 }
\ No newline at end of file
@@ -0,0 +1,369 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file scene_cache.cpp
+//! @date 2021-11-03
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "scene_cache.h"
+
+static const uint32_t SCENE_CACHE_MAGIC = 0x43535452; ///< "RTSC" in little-endian files.
+
+enum SceneCacheSection
+{
+    SECTION_MATERIALS,
+    SECTION_LIGHTS,
+
+    SECTION_SPHERE_CENTER_X,
+    SECTION_SPHERE_CENTER_Y,
+    SECTION_SPHERE_CENTER_Z,
+    SECTION_SPHERE_RADIUS,
+    SECTION_SPHERE_MATERIAL,
+
+    SECTION_TRIANGLE_V0,
+    SECTION_TRIANGLE_EDGE1,
+    SECTION_TRIANGLE_EDGE2,
+    SECTION_TRIANGLE_NORMALS,
+    SECTION_TRIANGLE_MATERIAL,
+    SECTION_NORMALS,
+
+    SECTION_BVH_NODES,
+    SECTION_BVH_PRIMITIVES,
+
+    SECTIONS_COUNT
+};
+
+struct SceneCacheSectionInfo
+{
+    uint64_t offset;      ///< From the file's start, a multiple of SCENE_CACHE_ALIGNMENT.
+    uint64_t count;
+    uint64_t elementSize; ///< Checked against the reader's, catching layout changes.
+};
+
+struct SceneCacheHeader
+{
+    uint32_t              magic;
+    uint32_t              version;
+    uint64_t              fileSize;
+
+    Vec3<float>           cameraPos;
+    float                 cameraPitch;
+    float                 cameraYaw;
+    Vec3<float>           ambientColor;
+
+    SceneCacheSectionInfo sections[SECTIONS_COUNT];
+};
+
+/* Light's space-independent part, positions are in world space */
+struct SceneCacheLight
+{
+    Vec3<float> pos;
+    float       brightness;
+    Vec3<float> diffuse;
+    Vec3<float> specular;
+};
+
+/* Where a section's elements are taken from when writing */
+struct SectionSource
+{
+    const void* data;
+    size_t      count;
+};
+
+static const size_t SECTION_ELEMENT_SIZES[SECTIONS_COUNT] = {
+    sizeof(Material),    sizeof(SceneCacheLight),
+    sizeof(float),       sizeof(float),       sizeof(float),       sizeof(float),    sizeof(uint32_t),
+    sizeof(Vec3<float>), sizeof(Vec3<float>), sizeof(Vec3<float>), sizeof(uint32_t), sizeof(uint32_t),
+    sizeof(Vec3<float>),
+    sizeof(BvhNode),     sizeof(PrimitiveRef)
+};
+
+size_t alignSection(size_t offset);
+bool writePadding(FILE* file, size_t bytes);
+bool isValidHeader(const SceneCacheHeader& header, size_t fileSize);
+
+template<typename T>
+const T* getSection(const void* data, const SceneCacheHeader& header, SceneCacheSection section)
+{
+    return (const T*) ((const uint8_t*) data + header.sections[section].offset);
+}
+
+template<typename T>
+void mapSection(MappableArray<T>* array, const void* data, const SceneCacheHeader& header,
+                SceneCacheSection section)
+{
+    array->map(getSection<T>(data, header, section), header.sections[section].count);
+}
+
+bool writeSceneCache(const char* fileName, Scene& scene, const PrimitiveStore& store, const Bvh& bvh)
+{
+    assert(fileName);
+
+    std::vector<Material> materials;
+    for (const Material* material : store.materials)
+    {
+        materials.push_back(*material);
+    }
+
+    std::vector<SceneCacheLight> lights;
+    for (size_t i = 0; i < scene.lightSources.getSize(); i++)
+    {
+        const Light& light = *scene.lightSources[i];
+        lights.push_back({light.pos.worldSpace, light.brightness, light.diffuse, light.specular});
+    }
+
+    SectionSource sources[SECTIONS_COUNT] = {
+        {materials.data(),              materials.size()},
+        {lights.data(),                 lights.size()},
+
+        {store.sphereCenterX.data(),    store.getSpheresCount()},
+        {store.sphereCenterY.data(),    store.getSpheresCount()},
+        {store.sphereCenterZ.data(),    store.getSpheresCount()},
+        {store.sphereRadius.data(),     store.getSpheresCount()},
+        {store.sphereMaterial.data(),   store.getSpheresCount()},
+
+        {store.triangleV0.data(),       store.getTrianglesCount()},
+        {store.triangleEdge1.data(),    store.getTrianglesCount()},
+        {store.triangleEdge2.data(),    store.getTrianglesCount()},
+        {store.triangleNormals.data(),  3 * store.getTrianglesCount()},
+        {store.triangleMaterial.data(), store.getTrianglesCount()},
+        {store.normals.data(),          store.normals.size()},
+
+        {bvh.getNodes(),                bvh.getNodesCount() + 1},
+        {bvh.getPrimitives(),           bvh.getPrimitivesCount()}
+    };
+
+    SceneCacheHeader header = {};
+    header.magic        = SCENE_CACHE_MAGIC;
+    header.version      = SCENE_CACHE_VERSION;
+    header.cameraPos    = scene.camera.getPos().worldSpace;
+    header.cameraPitch  = scene.camera.getPitchVertical();
+    header.cameraYaw    = scene.camera.getYawHorizontal();
+    header.ambientColor = scene.ambientColor;
+
+    size_t offset = alignSection(sizeof(header));
+    for (size_t section = 0; section < SECTIONS_COUNT; section++)
+    {
+        header.sections[section].offset      = offset;
+        header.sections[section].count       = sources[section].count;
+        header.sections[section].elementSize = SECTION_ELEMENT_SIZES[section];
+
+        offset = alignSection(offset + sources[section].count * SECTION_ELEMENT_SIZES[section]);
+    }
+
+    header.fileSize = offset;
+
+    FILE* file = fopen(fileName, "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    bool   written = fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t end     = sizeof(header);
+
+    for (size_t section = 0; section < SECTIONS_COUNT && written; section++)
+    {
+        size_t bytes = sources[section].count * SECTION_ELEMENT_SIZES[section];
+
+        written = writePadding(file, header.sections[section].offset - end) &&
+                  (bytes == 0 || fwrite(sources[section].data, bytes, 1, file) == 1);
+
+        end = header.sections[section].offset + bytes;
+    }
+
+    written = written && writePadding(file, header.fileSize - end);
+
+    return fclose(file) == 0 && written;
+}
+
+//----------------------------------SceneCache----------------------------------
+SceneCache::SceneCache() : m_Data(nullptr), m_Size(0) {}
+
+SceneCache::~SceneCache()
+{
+    if (m_Data != nullptr)
+    {
+        munmap(m_Data, m_Size);
+    }
+}
+
+bool SceneCache::load(const char* fileName, Scene* scene, PrimitiveStore* store, Bvh* bvh)
+{
+    assert(fileName);
+    assert(scene);
+    assert(store);
+    assert(bvh);
+    assert(m_Data == nullptr && "The cache has already been loaded");
+    assert(scene->lightSources.getSize() == 0);
+    assert(scene->materials.empty());
+
+    int file = open(fileName, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat = {};
+    if (fstat(file, &fileStat) != 0 || (size_t) fileStat.st_size < sizeof(SceneCacheHeader))
+    {
+        close(file);
+        return false;
+    }
+
+    size_t size = (size_t) fileStat.st_size;
+    void*  data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    close(file);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const SceneCacheHeader& header = *(const SceneCacheHeader*) data;
+    if (!isValidHeader(header, size))
+    {
+        munmap(data, size);
+        return false;
+    }
+
+    /* Pages are read ahead in the background while the first frame starts */
+    madvise(data, size, MADV_WILLNEED);
+
+    m_Data = data;
+    m_Size = size;
+
+    /* ================ Camera and lights ================ */
+    scene->camera.setPos(header.cameraPos);
+    scene->camera.setPitchVertical(header.cameraPitch);
+    scene->camera.setYawHorizontal(header.cameraYaw);
+    scene->ambientColor = header.ambientColor;
+
+    const SceneCacheLight* lights      = getSection<SceneCacheLight>(data, header, SECTION_LIGHTS);
+    size_t                 lightsCount = header.sections[SECTION_LIGHTS].count;
+
+    /* Resized once, so that pointers given to the scene stay valid */
+    m_Lights.resize(lightsCount);
+    for (size_t i = 0; i < lightsCount; i++)
+    {
+        m_Lights[i].pos.worldSpace = lights[i].pos;
+        m_Lights[i].brightness     = lights[i].brightness;
+        m_Lights[i].diffuse        = lights[i].diffuse;
+        m_Lights[i].specular       = lights[i].specular;
+
+        scene->lightSources.insert(&m_Lights[i]);
+    }
+
+    /* ================ Primitives ================ */
+    store->clear();
+
+    /* Cached materials are distinct, so the scene indexes them the same way
+       as the mapped primitives do */
+    const Material* materials = getSection<Material>(data, header, SECTION_MATERIALS);
+    for (size_t i = 0; i < header.sections[SECTION_MATERIALS].count; i++)
+    {
+        scene->addMaterial(&materials[i]);
+    }
+
+    store->materials = scene->materials;
+
+    mapSection(&store->sphereCenterX,    data, header, SECTION_SPHERE_CENTER_X);
+    mapSection(&store->sphereCenterY,    data, header, SECTION_SPHERE_CENTER_Y);
+    mapSection(&store->sphereCenterZ,    data, header, SECTION_SPHERE_CENTER_Z);
+    mapSection(&store->sphereRadius,     data, header, SECTION_SPHERE_RADIUS);
+    mapSection(&store->sphereMaterial,   data, header, SECTION_SPHERE_MATERIAL);
+
+    mapSection(&store->triangleV0,       data, header, SECTION_TRIANGLE_V0);
+    mapSection(&store->triangleEdge1,    data, header, SECTION_TRIANGLE_EDGE1);
+    mapSection(&store->triangleEdge2,    data, header, SECTION_TRIANGLE_EDGE2);
+    mapSection(&store->triangleNormals,  data, header, SECTION_TRIANGLE_NORMALS);
+    mapSection(&store->triangleMaterial, data, header, SECTION_TRIANGLE_MATERIAL);
+    mapSection(&store->normals,          data, header, SECTION_NORMALS);
+
+    /* ================ BVH ================ */
+    bvh->attach(*store, getSection<BvhNode>(data, header, SECTION_BVH_NODES),
+                header.sections[SECTION_BVH_NODES].count - 1,
+                getSection<PrimitiveRef>(data, header, SECTION_BVH_PRIMITIVES),
+                header.sections[SECTION_BVH_PRIMITIVES].count);
+
+    return true;
+}
+
+size_t SceneCache::getFileSize() const
+{
+    return m_Size;
+}
+//------------------------------------------------------------------------------
+
+size_t alignSection(size_t offset)
+{
+    return (offset + SCENE_CACHE_ALIGNMENT - 1) / SCENE_CACHE_ALIGNMENT * SCENE_CACHE_ALIGNMENT;
+}
+
+bool writePadding(FILE* file, size_t bytes)
+{
+    static const uint8_t ZEROS[SCENE_CACHE_ALIGNMENT] = {};
+
+    assert(bytes < SCENE_CACHE_ALIGNMENT);
+
+    return bytes == 0 || fwrite(ZEROS, bytes, 1, file) == 1;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Check the header and that sections lie inside the file and agree
+//!        on the number of primitives. Sections' contents aren't checked, so
+//!        that loading doesn't touch their pages.
+//------------------------------------------------------------------------------
+bool isValidHeader(const SceneCacheHeader& header, size_t fileSize)
+{
+    if (header.magic != SCENE_CACHE_MAGIC || header.version != SCENE_CACHE_VERSION ||
+        header.fileSize != fileSize)
+    {
+        return false;
+    }
+
+    for (size_t section = 0; section < SECTIONS_COUNT; section++)
+    {
+        const SceneCacheSectionInfo& info = header.sections[section];
+
+        if (info.elementSize != SECTION_ELEMENT_SIZES[section] || info.offset % SCENE_CACHE_ALIGNMENT != 0 ||
+            info.offset < sizeof(header) || info.offset > fileSize ||
+            info.count > (fileSize - info.offset) / info.elementSize)
+        {
+            return false;
+        }
+    }
+
+    const SceneCacheSectionInfo* sections       = header.sections;
+    uint64_t                     spheresCount   = sections[SECTION_SPHERE_RADIUS].count;
+    uint64_t                     trianglesCount = sections[SECTION_TRIANGLE_MATERIAL].count;
+
+    for (size_t section = SECTION_SPHERE_CENTER_X; section <= SECTION_SPHERE_MATERIAL; section++)
+    {
+        if (sections[section].count != spheresCount)
+        {
+            return false;
+        }
+    }
+
+    for (size_t section = SECTION_TRIANGLE_V0; section < SECTION_TRIANGLE_NORMALS; section++)
+    {
+        if (sections[section].count != trianglesCount)
+        {
+            return false;
+        }
+    }
+
+    /* The root and its skipped sibling are always there */
+    return sections[SECTION_TRIANGLE_NORMALS].count == 3 * trianglesCount &&
+           sections[SECTION_BVH_PRIMITIVES].count   == spheresCount + trianglesCount &&
+           sections[SECTION_BVH_NODES].count        >= 2;
+}
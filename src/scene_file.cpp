@@ -0,0 +1,442 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file scene_file.cpp
+//! @date 2021-11-04
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <chrono>
+#include "scene_file.h"
+#include "obj_loader.h"
+
+static const size_t MATERIAL_VALUES_COUNT           = 10;
+static const size_t MATERIAL_SECONDARY_VALUES_COUNT = 3;
+static const size_t LIGHT_VALUES_COUNT              = 9;
+
+const char* findTokenEnd(const char* str, const char* end);
+bool isKeyword(const char* token, const char* tokenEnd, const char* keyword);
+const char* parseFloats(const char* str, const char* end, float* values, size_t count);
+bool isBlank(const char* str, const char* end);
+
+SceneFile::SceneFile(const ViewFrustum& viewFrustum) :
+                     camera(viewFrustum), scene(camera),
+                     m_Aspect((viewFrustum.right - viewFrustum.left) / (viewFrustum.top - viewFrustum.bottom)),
+                     m_ErrorLine(0) {}
+
+bool SceneFile::load(const char* fileName, SceneFileStats* stats)
+{
+    assert(fileName);
+    assert(m_Materials.empty() && m_Lights.empty() && m_Spheres.empty() && m_Triangles.empty() &&
+           m_Meshes.empty() && "The scene file has already been loaded");
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    m_ErrorLine = 0;
+
+    /* ================ Map ================ */
+    int file = open(fileName, O_RDONLY);
+    if (file < 0)
+    {
+        return false;
+    }
+
+    struct stat fileStat = {};
+    if (fstat(file, &fileStat) != 0)
+    {
+        close(file);
+        return false;
+    }
+
+    size_t size = (size_t) fileStat.st_size;
+    void*  data = size > 0 ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0) : nullptr;
+
+    /* The mapping keeps the file referenced */
+    close(file);
+
+    if (data == MAP_FAILED)
+    {
+        return false;
+    }
+
+    if (data != nullptr)
+    {
+        madvise(data, size, MADV_SEQUENTIAL);
+    }
+
+    const char* begin = (const char*) data;
+    const char* end   = begin + size;
+
+    /* ================ Count ================ */
+    size_t materialsCount = 0;
+    size_t lightsCount    = 0;
+    size_t spheresCount   = 0;
+    size_t trianglesCount = 0;
+
+    for (const char* line = begin; line < end;)
+    {
+        const char* lineEnd  = (const char*) memchr(line, '\n', (size_t) (end - line));
+        lineEnd              = lineEnd != nullptr ? lineEnd : end;
+
+        const char* token    = skipBlanks(line, lineEnd);
+        const char* tokenEnd = findTokenEnd(token, lineEnd);
+
+        materialsCount += isKeyword(token, tokenEnd, "material");
+        lightsCount    += isKeyword(token, tokenEnd, "light");
+        spheresCount   += isKeyword(token, tokenEnd, "sphere");
+        trianglesCount += isKeyword(token, tokenEnd, "triangle");
+
+        line = lineEnd + 1;
+    }
+
+    /* Scene refers to entities by pointers, so arrays must never reallocate */
+    m_Materials.reserve(materialsCount);
+    m_Lights.reserve(lightsCount);
+    m_Spheres.reserve(spheresCount);
+    m_Triangles.reserve(trianglesCount);
+
+    /* ================ Parse ================ */
+    std::string directory = fileName;
+    directory.erase(directory.find_last_of('/') + 1);
+
+    size_t lineNumber = 1;
+    bool   valid      = true;
+
+    for (const char* line = begin; line < end && valid; lineNumber++)
+    {
+        const char* lineEnd      = (const char*) memchr(line, '\n', (size_t) (end - line));
+        lineEnd                  = lineEnd != nullptr ? lineEnd : end;
+
+        const char* commentStart = (const char*) memchr(line, '#', (size_t) (lineEnd - line));
+        valid = parseStatement(line, commentStart != nullptr ? commentStart : lineEnd, directory);
+
+        line = lineEnd + 1;
+    }
+
+    if (data != nullptr)
+    {
+        munmap(data, size);
+    }
+
+    if (!valid)
+    {
+        m_ErrorLine = lineNumber - 1;
+        return false;
+    }
+
+    if (stats != nullptr)
+    {
+        std::chrono::duration<float, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+
+        stats->fileSize  = size;
+        stats->materials = m_Materials.size();
+        stats->lights    = m_Lights.size();
+        stats->spheres   = m_Spheres.size();
+        stats->triangles = m_Triangles.size();
+        stats->meshes    = m_Meshes.size();
+        stats->faces     = 0;
+        stats->loadTime  = loadTime.count();
+
+        for (const auto& mesh : m_Meshes)
+        {
+            stats->faces += mesh->faces.getSize();
+        }
+    }
+
+    return true;
+}
+
+size_t SceneFile::getErrorLine() const
+{
+    return m_ErrorLine;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Add the statement's entity to the scene.
+//! 
+//! @param str       Line's start.
+//! @param end       Line's or its comment's start, whichever comes first.
+//! @param directory Scene file's, with a trailing '/', or empty.
+//! 
+//! @return Whether the statement is valid or there's none.
+//------------------------------------------------------------------------------
+bool SceneFile::parseStatement(const char* str, const char* end, const std::string& directory)
+{
+    const char* keyword    = skipBlanks(str, end);
+    const char* keywordEnd = findTokenEnd(keyword, end);
+
+    str = keywordEnd;
+
+    if (keyword == keywordEnd)
+    {
+        return true;
+    }
+
+    if (isKeyword(keyword, keywordEnd, "sphere"))
+    {
+        const Material* material  = nullptr;
+        float           values[4] = {};
+
+        if (!parseMaterialName(&str, end, &material) || (str = parseFloats(str, end, values, 4)) == nullptr ||
+            values[3] <= 0)
+        {
+            return false;
+        }
+
+        m_Spheres.emplace_back(material, values[3]);
+
+        Sphere& sphere = m_Spheres.back();
+        sphere.setPos({values[0], values[1], values[2]});
+        sphere.setScale(1);
+
+        scene.addObject(&sphere);
+    }
+    else if (isKeyword(keyword, keywordEnd, "triangle"))
+    {
+        const Material* material  = nullptr;
+        float           values[9] = {};
+
+        if (!parseMaterialName(&str, end, &material) || (str = parseFloats(str, end, values, 9)) == nullptr)
+        {
+            return false;
+        }
+
+        Vec3<float> v0     = {values[0], values[1], values[2]};
+        Vec3<float> v1     = {values[3], values[4], values[5]};
+        Vec3<float> v2     = {values[6], values[7], values[8]};
+        Vec3<float> normal = crossProduct(v1 - v0, v2 - v0);
+
+        /* Degenerate triangles have no normal */
+        if (dotProduct(normal, normal) == 0)
+        {
+            return false;
+        }
+
+        normal = normalize(normal);
+
+        m_Triangles.emplace_back(material);
+
+        Triangle& triangle = m_Triangles.back();
+        triangle.v0.pos.setValue(v0);
+        triangle.v1.pos.setValue(v1);
+        triangle.v2.pos.setValue(v2);
+        triangle.v0.normal.setValue(normal);
+        triangle.v1.normal.setValue(normal);
+        triangle.v2.normal.setValue(normal);
+        triangle.setPos({0, 0, 0});
+        triangle.setScale(1);
+        triangle.setRotation({0, 0, 0});
+
+        scene.addObject(&triangle);
+    }
+    else if (isKeyword(keyword, keywordEnd, "mesh"))
+    {
+        const Material* material = nullptr;
+        if (!parseMaterialName(&str, end, &material))
+        {
+            return false;
+        }
+
+        /* The rest of the line, which may have blanks inside */
+        const char* pathStart = skipBlanks(str, end);
+        const char* pathEnd   = end;
+        while (pathEnd > pathStart && (pathEnd[-1] == ' ' || pathEnd[-1] == '\t' || pathEnd[-1] == '\r'))
+        {
+            pathEnd--;
+        }
+
+        if (pathStart == pathEnd)
+        {
+            return false;
+        }
+
+        std::string path(pathStart, pathEnd);
+        if (path[0] != '/')
+        {
+            path.insert(0, directory);
+        }
+
+        std::unique_ptr<Mesh> mesh = loadObj(path.c_str(), material);
+        if (mesh == nullptr)
+        {
+            return false;
+        }
+
+        scene.addMesh(mesh.get());
+        m_Meshes.push_back(std::move(mesh));
+
+        str = end;
+    }
+    else if (isKeyword(keyword, keywordEnd, "material"))
+    {
+        const char* name    = skipBlanks(str, end);
+        const char* nameEnd = findTokenEnd(name, end);
+        float       values[MATERIAL_VALUES_COUNT + MATERIAL_SECONDARY_VALUES_COUNT] = {};
+
+        if (name == nameEnd || (str = parseFloats(nameEnd, end, values, MATERIAL_VALUES_COUNT)) == nullptr)
+        {
+            return false;
+        }
+
+        /* Reflectivity, transparency and refractive index go together */
+        values[MATERIAL_VALUES_COUNT + 2] = 1;
+        if (!isBlank(str, end) &&
+            (str = parseFloats(str, end, values + MATERIAL_VALUES_COUNT, MATERIAL_SECONDARY_VALUES_COUNT)) == nullptr)
+        {
+            return false;
+        }
+
+        if (!m_MaterialIndices.emplace(std::string(name, nameEnd), m_Materials.size()).second)
+        {
+            return false;
+        }
+
+        m_Materials.push_back({{values[0], values[1], values[2]},
+                               {values[3], values[4], values[5]},
+                               {values[6], values[7], values[8]},
+                               values[9], values[10], values[11], values[12]});
+    }
+    else if (isKeyword(keyword, keywordEnd, "light"))
+    {
+        float values[LIGHT_VALUES_COUNT + 1] = {};
+
+        if ((str = parseFloats(str, end, values, LIGHT_VALUES_COUNT)) == nullptr)
+        {
+            return false;
+        }
+
+        values[LIGHT_VALUES_COUNT] = 1;
+        if (!isBlank(str, end) && (str = parseFloats(str, end, values + LIGHT_VALUES_COUNT, 1)) == nullptr)
+        {
+            return false;
+        }
+
+        m_Lights.emplace_back();
+
+        Light& light = m_Lights.back();
+        light.pos.worldSpace = {values[0], values[1], values[2]};
+        light.diffuse        = {values[3], values[4], values[5]};
+        light.specular       = {values[6], values[7], values[8]};
+        light.brightness     = values[9];
+
+        scene.lightSources.insert(&light);
+    }
+    else if (isKeyword(keyword, keywordEnd, "camera"))
+    {
+        float values[5] = {};
+        if ((str = parseFloats(str, end, values, 5)) == nullptr)
+        {
+            return false;
+        }
+
+        camera.setPos({values[0], values[1], values[2]});
+        camera.setPitchVertical(values[3]);
+        camera.setYawHorizontal(values[4]);
+    }
+    else if (isKeyword(keyword, keywordEnd, "frustum"))
+    {
+        float values[3] = {};
+        if ((str = parseFloats(str, end, values, 3)) == nullptr || values[0] <= 0 || values[1] <= 0 ||
+            values[2] <= values[1])
+        {
+            return false;
+        }
+
+        camera.setViewFrustum(ViewFrustum(values[0], m_Aspect, values[1], values[2]));
+    }
+    else if (isKeyword(keyword, keywordEnd, "ambient"))
+    {
+        float values[3] = {};
+        if ((str = parseFloats(str, end, values, 3)) == nullptr)
+        {
+            return false;
+        }
+
+        scene.ambientColor = {values[0], values[1], values[2]};
+    }
+    else
+    {
+        return false;
+    }
+
+    return isBlank(str, end);
+}
+
+//------------------------------------------------------------------------------
+//! @brief Parse the name of a material defined earlier.
+//! 
+//! @param str      Moved past the name.
+//! @param end
+//! @param material
+//! 
+//! @return Whether there's a name and such a material.
+//------------------------------------------------------------------------------
+bool SceneFile::parseMaterialName(const char** str, const char* end, const Material** material)
+{
+    assert(str);
+    assert(material);
+
+    const char* name    = skipBlanks(*str, end);
+    const char* nameEnd = findTokenEnd(name, end);
+
+    auto found = m_MaterialIndices.find(std::string(name, nameEnd));
+    if (found == m_MaterialIndices.end())
+    {
+        return false;
+    }
+
+    *str      = nameEnd;
+    *material = &m_Materials[found->second];
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+//! @return Pointer to the first blank character at or after str, or end.
+//------------------------------------------------------------------------------
+const char* findTokenEnd(const char* str, const char* end)
+{
+    while (str < end && *str != ' ' && *str != '\t' && *str != '\r')
+    {
+        str++;
+    }
+
+    return str;
+}
+
+bool isKeyword(const char* token, const char* tokenEnd, const char* keyword)
+{
+    size_t length = strlen(keyword);
+    return (size_t) (tokenEnd - token) == length && memcmp(token, keyword, length) == 0;
+}
+
+//------------------------------------------------------------------------------
+//! @return Pointer past the last number, or nullptr if there are fewer than
+//!         count numbers at str.
+//------------------------------------------------------------------------------
+const char* parseFloats(const char* str, const char* end, float* values, size_t count)
+{
+    for (size_t i = 0; i < count && str != nullptr; i++)
+    {
+        str = parseFloat(str, end, &values[i]);
+
+        /* Numbers must be separated */
+        if (str != nullptr && str < end && *str != ' ' && *str != '\t' && *str != '\r')
+        {
+            str = nullptr;
+        }
+    }
+
+    return str;
+}
+
+bool isBlank(const char* str, const char* end)
+{
+    return skipBlanks(str, end) == end;
+}
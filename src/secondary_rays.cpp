@@ -0,0 +1,223 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file secondary_rays.cpp
+//! @date 2021-10-31
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <math.h>
+#include "secondary_rays.h"
+#include "ray_tracer.h"
+
+//------------------------------SecondaryRayStats-------------------------------
+void SecondaryRayStats::merge(const SecondaryRayStats& other)
+{
+    rays       += other.rays;
+    reflected  += other.reflected;
+    refracted  += other.refracted;
+    terminated += other.terminated;
+    dropped    += other.dropped;
+}
+//------------------------------------------------------------------------------
+
+//------------------------------SecondaryRayQueue-------------------------------
+SecondaryRayQueue::SecondaryRayQueue() : stats{}, m_Capacity(0), m_MaxDepth(0), m_RouletteDepth(0),
+                                         m_RandomState(1) {}
+
+void SecondaryRayQueue::reset(size_t capacity, size_t maxDepth, size_t rouletteDepth, uint32_t seed)
+{
+    assert(seed != 0);
+
+    m_Rays.clear();
+    m_NextRays.clear();
+
+    m_Capacity      = capacity;
+    m_MaxDepth      = maxDepth;
+    m_RouletteDepth = rouletteDepth;
+    m_RandomState   = seed;
+}
+
+void SecondaryRayQueue::spawn(const Ray& ray, const Hit& hit, const Vec3<float>& weight, uint32_t slot,
+                              uint32_t depth)
+{
+    assert(hit.material);
+
+    const Material& material = *hit.material;
+    if (depth > m_MaxDepth || (material.reflectivity <= 0 && material.transparency <= 0))
+    {
+        return;
+    }
+
+    Vec3<float> direction   = normalize(ray.direction);
+    Vec3<float> normal      = hit.normal;
+    float       cosIncident = -dotProduct(direction, normal);
+    bool        entering    = cosIncident > 0;
+
+    /* Orient the normal against the ray, which is inside when leaving */
+    if (!entering)
+    {
+        normal      = -1.0f * normal;
+        cosIncident = -cosIncident;
+    }
+
+    float eta          = entering ? 1 / material.refractiveIndex : material.refractiveIndex;
+    float sinSquared   = eta * eta * (1 - cosIncident * cosIncident);
+    float reflected    = material.reflectivity;
+    float refracted    = 0;
+    float cosRefracted = 0;
+
+    if (material.transparency > 0)
+    {
+        if (sinSquared >= 1)
+        {
+            /* Total internal reflection */
+            reflected += material.transparency;
+        }
+        else
+        {
+            cosRefracted = sqrtf(1 - sinSquared);
+
+            /* Schlick's approximation is symmetric if the larger angle is used */
+            float fresnel = getSchlickReflectance(entering ? cosIncident : cosRefracted, material.refractiveIndex);
+
+            reflected += material.transparency * fresnel;
+            refracted  = material.transparency * (1 - fresnel);
+        }
+    }
+
+    if (reflected > 0)
+    {
+        Ray reflectedRay = {};
+        reflectedRay.from      = hit.pos + SECONDARY_RAY_OFFSET * normal;
+        reflectedRay.direction = direction + (2 * cosIncident) * normal;
+
+        stats.reflected++;
+        push(reflectedRay, reflected * weight, slot, depth);
+    }
+
+    if (refracted > 0)
+    {
+        Ray refractedRay = {};
+        refractedRay.from      = hit.pos - SECONDARY_RAY_OFFSET * normal;
+        refractedRay.direction = normalize(eta * direction + (eta * cosIncident - cosRefracted) * normal);
+
+        stats.refracted++;
+        push(refractedRay, refracted * weight, slot, depth);
+    }
+}
+
+void SecondaryRayQueue::trace(const Bvh& bvh, const PrimitiveStore& store, Scene& scene,
+                              const ShadingTable& shading, ShadowCache* shadows, Vec3<float>* colors,
+                              BvhTraversalStats* bvhStats)
+{
+    assert(colors);
+
+    while (!m_NextRays.empty())
+    {
+        std::swap(m_Rays, m_NextRays);
+        m_NextRays.clear();
+
+        size_t raysCount = m_Rays.size();
+        m_Hits.resize(raysCount);
+        m_IsHit.resize(raysCount);
+
+        /* Intersect the whole depth first, so that traversal runs back to back */
+        for (size_t i = 0; i < raysCount; i++)
+        {
+            m_IsHit[i] = bvh.intersect(m_Rays[i].ray, &m_Hits[i], bvhStats, false);
+        }
+
+        stats.rays += raysCount;
+
+        /* Then shade the hits, spawning the next depth */
+        for (size_t i = 0; i < raysCount; i++)
+        {
+            if (!m_IsHit[i])
+            {
+                continue;
+            }
+
+            const SecondaryRay& secondary = m_Rays[i];
+            const Hit&          hit       = m_Hits[i];
+            const Material&     material  = *hit.material;
+            float               weight    = getSurfaceWeight(material);
+
+            if (weight > 0)
+            {
+                /* Shaded from the side the ray comes from */
+                Hit facingHit = hit;
+                if (dotProduct(secondary.ray.direction, hit.normal) > 0)
+                {
+                    facingHit.normal = -1.0f * hit.normal;
+                }
+
+                const uint8_t* lightVisible = nullptr;
+                if (shadows != nullptr)
+                {
+                    traceShadows(bvh, store, scene, facingHit, shadows);
+                    lightVisible = shadows->lightVisible.data();
+                }
+
+                Vec3<float> color = shading.shade(facingHit, SPACE_WORLD, lightVisible, &secondary.ray.from);
+
+                colors[secondary.slot] += componentMultiply(weight * secondary.weight, color);
+            }
+
+            spawn(secondary.ray, hit, secondary.weight, secondary.slot, secondary.depth + 1);
+        }
+    }
+}
+
+bool SecondaryRayQueue::isEmpty() const
+{
+    return m_NextRays.empty();
+}
+
+void SecondaryRayQueue::push(const Ray& ray, Vec3<float> weight, uint32_t slot, uint32_t depth)
+{
+    /* Russian roulette keeps the expected contribution */
+    if (depth > m_RouletteDepth)
+    {
+        float survival = fmaxf(weight.x, fmaxf(weight.y, weight.z));
+        if (survival < 1)
+        {
+            if (getRandom() >= survival)
+            {
+                stats.terminated++;
+                return;
+            }
+
+            weight = (1 / survival) * weight;
+        }
+    }
+
+    if (m_NextRays.size() >= m_Capacity)
+    {
+        stats.dropped++;
+        return;
+    }
+
+    m_NextRays.push_back({ray, weight, slot, depth});
+}
+
+float SecondaryRayQueue::getRandom()
+{
+    /* Xorshift32 */
+    m_RandomState ^= m_RandomState << 13;
+    m_RandomState ^= m_RandomState >> 17;
+    m_RandomState ^= m_RandomState << 5;
+
+    return (float) (m_RandomState >> 8) / (float) (1 << 24);
+}
+//------------------------------------------------------------------------------
+
+float getSchlickReflectance(float cosine, float refractiveIndex)
+{
+    float r0 = (1 - refractiveIndex) / (1 + refractiveIndex);
+    r0 *= r0;
+
+    float complement = 1 - cosine;
+    return r0 + (1 - r0) * complement * complement * complement * complement * complement;
+}
@@ -0,0 +1,470 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file shading.cpp
+//! @date 2021-11-08
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include <float.h>
+#include <math.h>
+#include <algorithm>
+#include "shading.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+static const float SQRT_2 = 1.41421356f;
+static const float LOG2_E = 1.44269504f;
+static const float LN_2   = 0.69314718f;
+
+//------------------------------------------------------------------------------
+//! @brief Lanes of a packet being shaded, the current light's terms are
+//!        gathered from the lanes' materials before adding the light.
+//------------------------------------------------------------------------------
+struct alignas(32) PacketLanes
+{
+    float toCameraX[RAY_PACKET_SIZE];
+    float toCameraY[RAY_PACKET_SIZE];
+    float toCameraZ[RAY_PACKET_SIZE];
+    float shininess[RAY_PACKET_SIZE];
+
+    float colorR[RAY_PACKET_SIZE];
+    float colorG[RAY_PACKET_SIZE];
+    float colorB[RAY_PACKET_SIZE];
+
+    float diffuseR[RAY_PACKET_SIZE];
+    float diffuseG[RAY_PACKET_SIZE];
+    float diffuseB[RAY_PACKET_SIZE];
+    float specularR[RAY_PACKET_SIZE];
+    float specularG[RAY_PACKET_SIZE];
+    float specularB[RAY_PACKET_SIZE];
+    float visible[RAY_PACKET_SIZE];
+};
+
+void addPacketLight(const GBufferBlock& block, const Vec3<float>& light, PacketLanes* lanes);
+float getPowerBySquaring(float x, uint32_t exponent);
+float getSpecularPower(float dotNormalHalfway, const MaterialTerms& material);
+
+ShadingTable::ShadingTable() : m_Scene(nullptr), m_LightsCount(0), m_CameraPositions{} {}
+
+void ShadingTable::update(Scene& scene)
+{
+    /* Scene's materials are only ever appended to */
+    if (m_Scene != &scene || m_Materials.size() > scene.materials.size())
+    {
+        m_Materials.clear();
+    }
+
+    m_Scene       = &scene;
+    m_LightsCount = scene.lightSources.getSize();
+
+    m_LightPositions[0].resize(m_LightsCount);
+    m_LightPositions[1].resize(m_LightsCount);
+
+    for (size_t i = 0; i < m_LightsCount; i++)
+    {
+        m_LightPositions[0][i] = scene.lightSources[i]->pos.worldSpace;
+        m_LightPositions[1][i] = scene.lightSources[i]->pos.cameraSpace;
+    }
+
+    m_CameraPositions[0] = scene.camera.getPos().worldSpace;
+    m_CameraPositions[1] = {0, 0, 0}; // Camera is at the origin of its space
+
+    for (size_t materialIdx = m_Materials.size(); materialIdx < scene.materials.size(); materialIdx++)
+    {
+        addMaterial(*scene.materials[materialIdx]);
+    }
+
+    /* Lights and ambient may have changed, as well as the number of lights */
+    m_LightTerms.resize(m_Materials.size() * m_LightsCount);
+
+    for (size_t materialIdx = 0; materialIdx < m_Materials.size(); materialIdx++)
+    {
+        const Material& material = *scene.materials[materialIdx];
+        MaterialTerms&  terms    = m_Materials[materialIdx];
+
+        terms.ambient    = componentMultiply(scene.ambientColor, material.ambient);
+        terms.lightTerms = materialIdx * m_LightsCount;
+
+        for (size_t coord = 0; coord < 3; coord++)
+        {
+            terms.ambient.getCoord(coord) = std::min(terms.ambient.getCoord(coord), 1.0f);
+        }
+
+        for (size_t i = 0; i < m_LightsCount; i++)
+        {
+            const Light& light = *scene.lightSources[i];
+            m_LightTerms[terms.lightTerms + i] = {componentMultiply(light.diffuse,  material.diffuse),
+                                                  componentMultiply(light.specular, material.specular)};
+        }
+    }
+}
+
+Vec3<float> ShadingTable::shade(const Hit& hit, Space space, const uint8_t* lightVisible,
+                                const Vec3<float>* eyePos) const
+{
+    assert(hit.materialIdx < m_Materials.size());
+
+    size_t               spaceIdx = getSpaceIdx(space);
+    const Vec3<float>*   lights   = m_LightPositions[spaceIdx].data();
+    const MaterialTerms& material = m_Materials[hit.materialIdx];
+    const LightTerms*    terms    = &m_LightTerms[material.lightTerms];
+    Vec3<float>          toCamera = normalize((eyePos != nullptr ? *eyePos : m_CameraPositions[spaceIdx]) - hit.pos);
+    Vec3<float>          color    = material.ambient;
+
+    for (size_t i = 0; i < m_LightsCount; i++)
+    {
+        if (lightVisible != nullptr && !lightVisible[i])
+        {
+            continue;
+        }
+
+        Vec3<float> toLight          = normalize(lights[i] - hit.pos);
+        Vec3<float> halfway          = toCamera + toLight;
+        float       halfwayLength    = length(halfway);
+
+        float       dotNormalLight   = std::max(dotProduct(hit.normal, toLight), 0.0f);
+        float       dotNormalHalfway = halfwayLength != 0 ? dotProduct(hit.normal, halfway) / halfwayLength : 0;
+        float       specularPower    = getSpecularPower(dotNormalHalfway, material);
+
+        for (size_t coord = 0; coord < 3; coord++)
+        {
+            float diffuse  = std::min(dotNormalLight * terms[i].diffuse.getCoord(coord), 1.0f);
+            float specular = std::min(specularPower  * terms[i].specular.getCoord(coord), 1.0f);
+
+            color.getCoord(coord) = std::min(color.getCoord(coord) + diffuse + specular, 1.0f);
+        }
+    }
+
+    return color;
+}
+
+void ShadingTable::shadePacket(const PacketHit& hits, size_t count, Space space, const float* visibility,
+                               Vec3<float>* colors) const
+{
+    assert(count <= RAY_PACKET_SIZE);
+    assert(colors);
+
+    GBufferBlock block = {};
+    block.reset();
+
+    for (size_t lane = 0; lane < count; lane++)
+    {
+        if (hits.isHit(lane))
+        {
+            block.setHit(lane, hits.getHit(lane));
+        }
+    }
+
+    shadeBlock(block, count, space, visibility, colors);
+}
+
+void ShadingTable::shadeBlock(const GBufferBlock& block, size_t count, Space space, const float* visibility,
+                              Vec3<float>* colors) const
+{
+    assert(count <= RAY_PACKET_SIZE);
+    assert(colors);
+
+    size_t             spaceIdx = getSpaceIdx(space);
+    const Vec3<float>* lights   = m_LightPositions[spaceIdx].data();
+    const Vec3<float>& eye      = m_CameraPositions[spaceIdx];
+
+    /* Lanes without a hit are shaded with zero terms and then skipped */
+    const MaterialTerms* materials[RAY_PACKET_SIZE] = {};
+    size_t               lanesCount                 = 0;
+    PacketLanes          lanes                      = {};
+
+    for (size_t lane = 0; lane < count; lane++)
+    {
+        if (!block.isHit(lane))
+        {
+            continue;
+        }
+
+        assert(block.material[lane] < m_Materials.size());
+
+        const MaterialTerms* terms    = &m_Materials[block.material[lane]];
+        Vec3<float>          toCamera = normalize(eye - Vec3<float>(block.posX[lane], block.posY[lane],
+                                                                    block.posZ[lane]));
+
+        lanesCount++;
+        materials[lane]       = terms;
+        lanes.shininess[lane] = terms->shininess;
+        lanes.colorR[lane]    = terms->ambient.x;
+        lanes.colorG[lane]    = terms->ambient.y;
+        lanes.colorB[lane]    = terms->ambient.z;
+        lanes.toCameraX[lane] = toCamera.x;
+        lanes.toCameraY[lane] = toCamera.y;
+        lanes.toCameraZ[lane] = toCamera.z;
+    }
+
+    if (lanesCount == 0)
+    {
+        return;
+    }
+
+    for (size_t i = 0; i < m_LightsCount; i++)
+    {
+        /* Lanes are usually all lit or all shadowed */
+        const float* visible = visibility != nullptr ? visibility + i * RAY_PACKET_SIZE : nullptr;
+        if (visible != nullptr && std::count(visible, visible + count, 0.0f) == (ptrdiff_t) count)
+        {
+            continue;
+        }
+
+        for (size_t lane = 0; lane < RAY_PACKET_SIZE; lane++)
+        {
+            /* Zero terms leave the lane's color as it is */
+            LightTerms terms = {};
+            if (materials[lane] != nullptr)
+            {
+                terms = m_LightTerms[materials[lane]->lightTerms + i];
+            }
+
+            lanes.diffuseR[lane]  = terms.diffuse.x;
+            lanes.diffuseG[lane]  = terms.diffuse.y;
+            lanes.diffuseB[lane]  = terms.diffuse.z;
+            lanes.specularR[lane] = terms.specular.x;
+            lanes.specularG[lane] = terms.specular.y;
+            lanes.specularB[lane] = terms.specular.z;
+            lanes.visible[lane]   = visible != nullptr ? visible[lane] : 1;
+        }
+
+        addPacketLight(block, lights[i], &lanes);
+    }
+
+    for (size_t lane = 0; lane < count; lane++)
+    {
+        if (materials[lane] != nullptr)
+        {
+            colors[lane] = {lanes.colorR[lane], lanes.colorG[lane], lanes.colorB[lane]};
+        }
+    }
+}
+
+void ShadingTable::addMaterial(const Material& material)
+{
+    MaterialTerms terms = {};
+    terms.shininess = material.shiness;
+
+    if (material.shiness >= 0 && material.shiness <= SHADING_MAX_SQUARED_EXPONENT &&
+        material.shiness == floorf(material.shiness))
+    {
+        terms.power    = SPECULAR_POWER_SQUARING;
+        terms.exponent = (uint32_t) material.shiness;
+    }
+    else
+    {
+        terms.power    = SPECULAR_POWER_GENERAL;
+        terms.exponent = 0;
+    }
+
+    terms.minBase = material.shiness > 0 ? exp2f(SHADING_MIN_POWER_LOG2 / material.shiness) : 0;
+
+    m_Materials.push_back(terms);
+}
+
+size_t ShadingTable::getSpaceIdx(Space space) const
+{
+    assert(space == SPACE_WORLD || space == SPACE_CAMERA);
+    return space == SPACE_WORLD ? 0 : 1;
+}
+
+#if defined(__SSE2__)
+//------------------------------------------------------------------------------
+//! @brief x^exponent of four lanes, x in [0, 1], as exp2(exponent * log2(x)),
+//!        zero if it's below 2^SHADING_MIN_POWER_LOG2. Relative error is
+//!        within 1e-5.
+//! 
+//! log2 splits x into an exponent and a mantissa m in [sqrt(2) / 2, sqrt(2)]
+//! and sums the series ln(m) = 2 * atanh((m - 1) / (m + 1)), exp2 splits its
+//! argument into an integer and f in [-0.5, 0.5] and sums Taylor's series of
+//! e^(f * ln(2)).
+//------------------------------------------------------------------------------
+__m128 getPowerApproxSse(__m128 x, __m128 exponent)
+{
+    const __m128 one  = _mm_set1_ps(1);
+    const __m128 minY = _mm_set1_ps(SHADING_MIN_POWER_LOG2);
+
+    __m128i bits      = _mm_castps_si128(_mm_max_ps(x, _mm_set1_ps(FLT_MIN)));
+    __m128  exponentX = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+    __m128  mantissa  = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                                                      _mm_set1_epi32(0x3F800000)));
+
+    __m128  isLarge   = _mm_cmpgt_ps(mantissa, _mm_set1_ps(SQRT_2));
+    mantissa          = _mm_or_ps(_mm_and_ps(isLarge, _mm_mul_ps(mantissa, _mm_set1_ps(0.5f))),
+                                  _mm_andnot_ps(isLarge, mantissa));
+    exponentX         = _mm_add_ps(exponentX, _mm_and_ps(isLarge, one));
+
+    __m128  t         = _mm_div_ps(_mm_sub_ps(mantissa, one), _mm_add_ps(mantissa, one));
+    __m128  tSqr      = _mm_mul_ps(t, t);
+    __m128  series    = _mm_add_ps(_mm_set1_ps(1.0f / 5), _mm_mul_ps(tSqr, _mm_set1_ps(1.0f / 7)));
+    series            = _mm_add_ps(_mm_set1_ps(1.0f / 3), _mm_mul_ps(tSqr, series));
+    series            = _mm_add_ps(one, _mm_mul_ps(tSqr, series));
+
+    __m128  log2X     = _mm_add_ps(exponentX, _mm_mul_ps(_mm_mul_ps(t, series), _mm_set1_ps(2 * LOG2_E)));
+    __m128  y         = _mm_max_ps(_mm_mul_ps(exponent, log2X), minY);
+
+    /* y <= 0, so truncating 0.5 - y rounds -y */
+    __m128i integer   = _mm_sub_epi32(_mm_setzero_si128(), _mm_cvttps_epi32(_mm_sub_ps(_mm_set1_ps(0.5f), y)));
+    __m128  z         = _mm_mul_ps(_mm_sub_ps(y, _mm_cvtepi32_ps(integer)), _mm_set1_ps(LN_2));
+    __m128  expZ      = _mm_add_ps(_mm_set1_ps(1.0f / 120), _mm_mul_ps(z, _mm_set1_ps(1.0f / 720)));
+    expZ              = _mm_add_ps(_mm_set1_ps(1.0f / 24), _mm_mul_ps(z, expZ));
+    expZ              = _mm_add_ps(_mm_set1_ps(1.0f / 6),  _mm_mul_ps(z, expZ));
+    expZ              = _mm_add_ps(_mm_set1_ps(1.0f / 2),  _mm_mul_ps(z, expZ));
+    expZ              = _mm_add_ps(one, _mm_mul_ps(z, expZ));
+    expZ              = _mm_add_ps(one, _mm_mul_ps(z, expZ));
+
+    __m128  scale     = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(integer, _mm_set1_epi32(127)), 23));
+
+    return _mm_and_ps(_mm_cmpgt_ps(y, minY), _mm_mul_ps(expZ, scale));
+}
+
+void addPacketLight(const GBufferBlock& block, const Vec3<float>& light, PacketLanes* lanes)
+{
+    assert(lanes);
+
+    const __m128 zero   = _mm_setzero_ps();
+    const __m128 one    = _mm_set1_ps(1);
+    const __m128 lightX = _mm_set1_ps(light.x);
+    const __m128 lightY = _mm_set1_ps(light.y);
+    const __m128 lightZ = _mm_set1_ps(light.z);
+
+    float* colors[]     = {lanes->colorR,    lanes->colorG,    lanes->colorB};
+    float* diffuse[]    = {lanes->diffuseR,  lanes->diffuseG,  lanes->diffuseB};
+    float* specular[]   = {lanes->specularR, lanes->specularG, lanes->specularB};
+
+    for (size_t first = 0; first < RAY_PACKET_SIZE; first += 4)
+    {
+        __m128 normalX    = _mm_load_ps(block.normalX + first);
+        __m128 normalY    = _mm_load_ps(block.normalY + first);
+        __m128 normalZ    = _mm_load_ps(block.normalZ + first);
+
+        __m128 toLightX   = _mm_sub_ps(lightX, _mm_load_ps(block.posX + first));
+        __m128 toLightY   = _mm_sub_ps(lightY, _mm_load_ps(block.posY + first));
+        __m128 toLightZ   = _mm_sub_ps(lightZ, _mm_load_ps(block.posZ + first));
+
+        __m128 lengthSqr  = _mm_add_ps(_mm_mul_ps(toLightX, toLightX),
+                                       _mm_add_ps(_mm_mul_ps(toLightY, toLightY), _mm_mul_ps(toLightZ, toLightZ)));
+        __m128 invLength  = _mm_div_ps(one, _mm_sqrt_ps(lengthSqr));
+        toLightX          = _mm_mul_ps(toLightX, invLength);
+        toLightY          = _mm_mul_ps(toLightY, invLength);
+        toLightZ          = _mm_mul_ps(toLightZ, invLength);
+
+        __m128 halfwayX   = _mm_add_ps(_mm_load_ps(lanes->toCameraX + first), toLightX);
+        __m128 halfwayY   = _mm_add_ps(_mm_load_ps(lanes->toCameraY + first), toLightY);
+        __m128 halfwayZ   = _mm_add_ps(_mm_load_ps(lanes->toCameraZ + first), toLightZ);
+        __m128 halfwaySqr = _mm_add_ps(_mm_mul_ps(halfwayX, halfwayX),
+                                       _mm_add_ps(_mm_mul_ps(halfwayY, halfwayY), _mm_mul_ps(halfwayZ, halfwayZ)));
+
+        __m128 dotNormalLight   = _mm_add_ps(_mm_mul_ps(normalX, toLightX),
+                                             _mm_add_ps(_mm_mul_ps(normalY, toLightY), _mm_mul_ps(normalZ, toLightZ)));
+        __m128 dotNormalHalfway = _mm_add_ps(_mm_mul_ps(normalX, halfwayX),
+                                             _mm_add_ps(_mm_mul_ps(normalY, halfwayY), _mm_mul_ps(normalZ, halfwayZ)));
+
+        /* Halfway is zero if the light is exactly opposite to the camera */
+        __m128 hasHalfway = _mm_cmpgt_ps(halfwaySqr, zero);
+        dotNormalLight    = _mm_max_ps(dotNormalLight, zero);
+        dotNormalHalfway  = _mm_and_ps(hasHalfway,
+                                       _mm_div_ps(_mm_max_ps(dotNormalHalfway, zero),
+                                                  _mm_sqrt_ps(_mm_max_ps(halfwaySqr, _mm_set1_ps(FLT_MIN)))));
+
+        __m128 power      = getPowerApproxSse(dotNormalHalfway, _mm_load_ps(lanes->shininess + first));
+        __m128 visible    = _mm_load_ps(lanes->visible + first);
+
+        for (size_t coord = 0; coord < 3; coord++)
+        {
+            __m128 diffuseTerm  = _mm_min_ps(_mm_mul_ps(dotNormalLight, _mm_load_ps(diffuse[coord] + first)), one);
+            __m128 specularTerm = _mm_min_ps(_mm_mul_ps(power, _mm_load_ps(specular[coord] + first)), one);
+            __m128 color        = _mm_add_ps(_mm_load_ps(colors[coord] + first),
+                                             _mm_mul_ps(visible, _mm_add_ps(diffuseTerm, specularTerm)));
+
+            _mm_store_ps(colors[coord] + first, _mm_min_ps(color, one));
+        }
+    }
+}
+#else
+void addPacketLight(const GBufferBlock& block, const Vec3<float>& light, PacketLanes* lanes)
+{
+    assert(lanes);
+
+    float* colors[]   = {lanes->colorR,    lanes->colorG,    lanes->colorB};
+    float* diffuse[]  = {lanes->diffuseR,  lanes->diffuseG,  lanes->diffuseB};
+    float* specular[] = {lanes->specularR, lanes->specularG, lanes->specularB};
+
+    for (size_t lane = 0; lane < RAY_PACKET_SIZE; lane++)
+    {
+        Vec3<float> normal        = {block.normalX[lane], block.normalY[lane], block.normalZ[lane]};
+        Vec3<float> pos           = {block.posX[lane], block.posY[lane], block.posZ[lane]};
+        Vec3<float> toCamera      = {lanes->toCameraX[lane], lanes->toCameraY[lane], lanes->toCameraZ[lane]};
+        Vec3<float> toLight       = normalize(light - pos);
+        Vec3<float> halfway       = toCamera + toLight;
+        float       halfwayLength = length(halfway);
+
+        float dotNormalLight   = std::max(dotProduct(normal, toLight), 0.0f);
+        float dotNormalHalfway = halfwayLength != 0 ? dotProduct(normal, halfway) / halfwayLength : 0;
+        float power            = powf(std::max(dotNormalHalfway, 0.0f), lanes->shininess[lane]);
+
+        for (size_t coord = 0; coord < 3; coord++)
+        {
+            float diffuseTerm  = std::min(dotNormalLight * diffuse[coord][lane], 1.0f);
+            float specularTerm = std::min(power * specular[coord][lane], 1.0f);
+
+            colors[coord][lane] = std::min(colors[coord][lane] + lanes->visible[lane] * (diffuseTerm + specularTerm),
+                                           1.0f);
+        }
+    }
+}
+#endif
+
+//------------------------------------------------------------------------------
+//! @brief x^exponent for x in [0, 1], squares never go beyond the exponent's
+//!        highest bit.
+//------------------------------------------------------------------------------
+float getPowerBySquaring(float x, uint32_t exponent)
+{
+    float power = 1;
+
+    while (exponent != 0)
+    {
+        if (exponent & 1)
+        {
+            power *= x;
+        }
+
+        exponent >>= 1;
+        if (exponent != 0)
+        {
+            x *= x;
+        }
+    }
+
+    return power;
+}
+
+//------------------------------------------------------------------------------
+//! @brief Zero if the power is below 2^SHADING_MIN_POWER_LOG2, so that none of
+//!        the products is a denormal, which are far slower than normal floats.
+//------------------------------------------------------------------------------
+float getSpecularPower(float dotNormalHalfway, const MaterialTerms& material)
+{
+    float x = std::max(dotNormalHalfway, 0.0f);
+
+    if (x < material.minBase)
+    {
+        return 0;
+    }
+
+    switch (material.power)
+    {
+        case SPECULAR_POWER_SQUARING: { return getPowerBySquaring(x, material.exponent); }
+        case SPECULAR_POWER_GENERAL:  { return powf(x, material.shininess); }
+
+        default: { assert(!"Invalid specular power"); }
+    }
+
+    return 0;
+}
@@ -0,0 +1,155 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file shadows.cpp
+//! @date 2021-10-25
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include "shadows.h"
+
+//---------------------------------ShadowStats----------------------------------
+void ShadowStats::merge(const ShadowStats& other)
+{
+    rays      += other.rays;
+    occluded  += other.occluded;
+    cacheHits += other.cacheHits;
+}
+
+float ShadowStats::getCacheHitRate() const
+{
+    return occluded != 0 ? (float) cacheHits / (float) occluded : 0;
+}
+//------------------------------------------------------------------------------
+
+//---------------------------------ShadowCache----------------------------------
+void ShadowCache::reset(size_t lightsCount)
+{
+    lightVisible.assign(lightsCount, 1);
+    lastOccluders.assign(lightsCount, {PRIMITIVE_SPHERE, SHADOW_NO_OCCLUDER});
+    lastObjectOccluders.assign(lightsCount, nullptr);
+    stats = {};
+}
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+//! @brief Create a ray from just above the surface to the light, so that the
+//!        light is at the ray parameter 1.
+//! 
+//! @return Whether the surface faces the light at all.
+//------------------------------------------------------------------------------
+static inline bool createShadowRay(const Hit& hit, const Vec3<float>& lightPos, Ray* ray)
+{
+    Vec3<float> toLight = lightPos - hit.pos;
+    if (dotProduct(toLight, hit.normal) <= 0)
+    {
+        return false;
+    }
+
+    ray->from      = hit.pos + SHADOW_RAY_OFFSET * hit.normal;
+    ray->direction = lightPos - ray->from;
+
+    return true;
+}
+
+void traceShadows(const Bvh& bvh, const PrimitiveStore& store, Scene& scene, const Hit& hit,
+                  ShadowCache* cache)
+{
+    assert(cache);
+
+    size_t lightsCount = scene.lightSources.getSize();
+    assert(cache->lightVisible.size() == lightsCount);
+
+    for (size_t i = 0; i < lightsCount; i++)
+    {
+        Ray ray = {};
+        if (!createShadowRay(hit, scene.lightSources[i]->pos.worldSpace, &ray))
+        {
+            cache->lightVisible[i] = 0;
+            continue;
+        }
+
+        cache->stats.rays++;
+
+        PrimitiveRef& lastOccluder = cache->lastOccluders[i];
+        Hit           occluderHit  = {};
+
+        if (lastOccluder.index != SHADOW_NO_OCCLUDER && store.intersect(lastOccluder, ray, &occluderHit) &&
+            occluderHit.rayParameter < 1)
+        {
+            cache->lightVisible[i] = 0;
+            cache->stats.occluded++;
+            cache->stats.cacheHits++;
+            continue;
+        }
+
+        bool occluded = bvh.intersectAny(ray, 1, &lastOccluder);
+
+        cache->lightVisible[i] = !occluded;
+        cache->stats.occluded += occluded;
+    }
+}
+
+void traceShadows(Scene& scene, const Hit& hit, ShadowCache* cache)
+{
+    assert(cache);
+
+    size_t lightsCount = scene.lightSources.getSize();
+    assert(cache->lightVisible.size() == lightsCount);
+
+    for (size_t i = 0; i < lightsCount; i++)
+    {
+        Ray ray = {};
+        if (!createShadowRay(hit, scene.lightSources[i]->pos.cameraSpace, &ray))
+        {
+            cache->lightVisible[i] = 0;
+            continue;
+        }
+
+        cache->stats.rays++;
+
+        Hittable*& lastOccluder = cache->lastObjectOccluders[i];
+
+        auto isOccluder = [&](Hittable* primitive) {
+            Hit occluderHit = {};
+            return primitive->intersect(ray, &occluderHit) && occluderHit.rayParameter < 1;
+        };
+
+        if (lastOccluder != nullptr && isOccluder(lastOccluder))
+        {
+            cache->lightVisible[i] = 0;
+            cache->stats.occluded++;
+            cache->stats.cacheHits++;
+            continue;
+        }
+
+        bool occluded = false;
+
+        for (auto primitive : scene.objects)
+        {
+            if (primitive != lastOccluder && isOccluder(primitive))
+            {
+                lastOccluder = primitive;
+                occluded     = true;
+                break;
+            }
+        }
+
+        if (!occluded)
+        {
+            for (auto mesh : scene.meshes)
+            {
+                if (mesh != lastOccluder && isOccluder(mesh))
+                {
+                    lastOccluder = mesh;
+                    occluded     = true;
+                    break;
+                }
+            }
+        }
+
+        cache->lightVisible[i] = !occluded;
+        cache->stats.occluded += occluded;
+    }
+}
@@ -0,0 +1,178 @@
+//------------------------------------------------------------------------------
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file tile_scheduler.cpp
+//! @date 2021-10-20
+//! 
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <assert.h>
+#include "tile_scheduler.h"
+
+TileScheduler::TileScheduler(size_t threadsCount) :
+                             m_Function(nullptr), m_Generation(0),
+                             m_ActiveWorkers(0), m_Stopping(false)
+{
+    if (threadsCount == 0)
+    {
+        threadsCount = std::thread::hardware_concurrency();
+    }
+
+    if (threadsCount == 0)
+    {
+        threadsCount = 1;
+    }
+
+    m_Queues = std::vector<WorkerQueue>(threadsCount);
+
+    // Worker 0 is the thread calling run()
+    for (size_t i = 1; i < threadsCount; i++)
+    {
+        m_Threads.emplace_back(&TileScheduler::workerLoop, this, i);
+    }
+}
+
+TileScheduler::~TileScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stopping = true;
+    }
+
+    m_StartCondition.notify_all();
+
+    for (auto& thread : m_Threads)
+    {
+        thread.join();
+    }
+}
+
+size_t TileScheduler::getThreadsCount() const
+{
+    return m_Queues.size();
+}
+
+void TileScheduler::run(size_t width, size_t height, size_t tileSize, const TileFunction& function)
+{
+    assert(tileSize > 0);
+
+    tileSize = (tileSize + TILE_ALIGNMENT - 1) / TILE_ALIGNMENT * TILE_ALIGNMENT;
+
+    m_Tiles.clear();
+    for (size_t y0 = 0; y0 < height; y0 += tileSize)
+    {
+        for (size_t x0 = 0; x0 < width; x0 += tileSize)
+        {
+            size_t x1 = x0 + tileSize < width  ? x0 + tileSize : width;
+            size_t y1 = y0 + tileSize < height ? y0 + tileSize : height;
+
+            m_Tiles.push_back({x0, y0, x1, y1});
+        }
+    }
+
+    /* Give each worker a contiguous range, so that initially it walks memory linearly */
+    size_t workersCount = getThreadsCount();
+    size_t tilesCount   = m_Tiles.size();
+
+    for (size_t worker = 0; worker < workersCount; worker++)
+    {
+        size_t first = tilesCount * worker       / workersCount;
+        size_t last  = tilesCount * (worker + 1) / workersCount;
+
+        std::lock_guard<std::mutex> lock(m_Queues[worker].mutex);
+        for (size_t tile = first; tile < last; tile++)
+        {
+            m_Queues[worker].tiles.push_back(tile);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Function      = &function;
+        m_ActiveWorkers = workersCount;
+        m_Generation++;
+    }
+
+    m_StartCondition.notify_all();
+
+    processTiles(0);
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_ActiveWorkers--;
+    m_FinishCondition.wait(lock, [this] { return m_ActiveWorkers == 0; });
+    m_Function = nullptr;
+}
+
+void TileScheduler::workerLoop(size_t workerIdx)
+{
+    uint64_t lastGeneration = 0;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_StartCondition.wait(lock, [this, lastGeneration] {
+                return m_Stopping || m_Generation != lastGeneration;
+            });
+
+            if (m_Stopping)
+            {
+                return;
+            }
+
+            lastGeneration = m_Generation;
+        }
+
+        processTiles(workerIdx);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        if (--m_ActiveWorkers == 0)
+        {
+            m_FinishCondition.notify_one();
+        }
+    }
+}
+
+void TileScheduler::processTiles(size_t workerIdx)
+{
+    size_t tileIdx = 0;
+    while (popTile(workerIdx, &tileIdx))
+    {
+        (*m_Function)(m_Tiles[tileIdx], workerIdx);
+    }
+}
+
+bool TileScheduler::popTile(size_t workerIdx, size_t* tileIdx)
+{
+    assert(tileIdx);
+
+    /* Own queue is consumed from the front */
+    {
+        WorkerQueue& queue = m_Queues[workerIdx];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+
+        if (!queue.tiles.empty())
+        {
+            *tileIdx = queue.tiles.front();
+            queue.tiles.pop_front();
+            return true;
+        }
+    }
+
+    /* Others' queues are stolen from the back, the farthest from their owners */
+    size_t workersCount = getThreadsCount();
+    for (size_t i = 1; i < workersCount; i++)
+    {
+        WorkerQueue& victim = m_Queues[(workerIdx + i) % workersCount];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (!victim.tiles.empty())
+        {
+            *tileIdx = victim.tiles.back();
+            victim.tiles.pop_back();
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -6,31 +6,63 @@
 //! @copyright Copyright (c) 2021
 //------------------------------------------------------------------------------
 
+#include <assert.h>
+#include <thread>
 #include "zbuffer.h"
 
-ZBuffer::ZBuffer(size_t width, size_t height) : width(width), height(height)
+/* Marks a tile being cleared by setDepthAtomic(), never used as a generation */
+static const uint32_t ZBUFFER_CLEARING_GENERATION = UINT32_MAX;
+
+/* Tiles start stamped with it, so that the first generation finds them stale */
+static const uint32_t ZBUFFER_NEVER_CLEARED       = 0;
+
+ZBuffer::ZBuffer(size_t width, size_t height)
+    : width(width), height(height),
+      m_TilesPerRow((width + ZBUFFER_TILE_SIZE - 1) / ZBUFFER_TILE_SIZE),
+      m_TilesCount(m_TilesPerRow * ((height + ZBUFFER_TILE_SIZE - 1) / ZBUFFER_TILE_SIZE)),
+      m_Generation(ZBUFFER_NEVER_CLEARED + 1)
 {
-    depths = new float[width * height]{0.0f};
+    /* Cache-line aligned, so that tiles of the render scheduler don't share lines */
+    m_Tiles = (DepthTile*) aligned_alloc(ZBUFFER_ALIGNMENT, m_TilesCount * sizeof(DepthTile));
+    assert(m_Tiles);
+
+    m_TileGenerations = new uint32_t[m_TilesCount];
+    for (size_t i = 0; i < m_TilesCount; i++)
+    {
+        m_TileGenerations[i] = ZBUFFER_NEVER_CLEARED;
+    }
 }
 
 ZBuffer::~ZBuffer()
 {
-    delete[] depths;
+    free(m_Tiles);
+    delete[] m_TileGenerations;
 }
 
-float ZBuffer::getDepth(size_t x, size_t y) const
+bool ZBuffer::setDepthAtomic(size_t x, size_t y, float depth)
 {
-    return depths[y * width + x];
-}
+    assert(x < width);
+    assert(y < height);
 
-bool ZBuffer::setDepth(size_t x, size_t y, float depth)
-{
-    size_t pos = y * width + x;
+    size_t tileIdx = getTileIdx(x, y);
 
-    if (depths[pos] > depth || depths[pos] == 0.0f)
+    if (__atomic_load_n(&m_TileGenerations[tileIdx], __ATOMIC_ACQUIRE) != m_Generation)
     {
-        depths[pos] = depth;
-        return true;
+        clearTileAtomic(tileIdx);
+    }
+
+    float* pixel   = &m_Tiles[tileIdx].depths[getIdxInTile(x, y)];
+    float  current = 0;
+
+    __atomic_load(pixel, &current, __ATOMIC_RELAXED);
+
+    /* Atomic min, a failed exchange reloads the current depth */
+    while (depth < current)
+    {
+        if (__atomic_compare_exchange(pixel, &current, &depth, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        {
+            return true;
+        }
     }
 
     return false;
@@ -38,13 +70,51 @@ bool ZBuffer::setDepth(size_t x, size_t y, float depth)
 
 void ZBuffer::reset()
 {
-    for (size_t i = 0; i < width * height; i++)
+    m_Generation++;
+
+    /* Stamps of 2^32 frames ago would look current, so start over */
+    if (m_Generation == ZBUFFER_CLEARING_GENERATION)
     {
-        depths[i] = 0.0f;
+        for (size_t i = 0; i < m_TilesCount; i++)
+        {
+            m_TileGenerations[i] = ZBUFFER_NEVER_CLEARED;
+        }
+
+        m_Generation = ZBUFFER_NEVER_CLEARED + 1;
     }
 }
 
 bool ZBuffer::isFilled(size_t x, size_t y) const
 {
-    return getDepth(x, y) != 0.0f;
-}
\ No newline at end of file
+    return getDepth(x, y) != ZBUFFER_EMPTY_DEPTH;
+}
+
+void ZBuffer::clearTile(size_t tileIdx)
+{
+    for (float& depth : m_Tiles[tileIdx].depths)
+    {
+        depth = ZBUFFER_EMPTY_DEPTH;
+    }
+
+    __atomic_store_n(&m_TileGenerations[tileIdx], m_Generation, __ATOMIC_RELEASE);
+}
+
+void ZBuffer::clearTileAtomic(size_t tileIdx)
+{
+    uint32_t* generation = &m_TileGenerations[tileIdx];
+    uint32_t  stamp      = __atomic_load_n(generation, __ATOMIC_ACQUIRE);
+
+    /* The first writer to claim a stale tile clears it, the others wait for it */
+    if (stamp != m_Generation && stamp != ZBUFFER_CLEARING_GENERATION &&
+        __atomic_compare_exchange_n(generation, &stamp, ZBUFFER_CLEARING_GENERATION, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+    {
+        clearTile(tileIdx);
+        return;
+    }
+
+    while (__atomic_load_n(generation, __ATOMIC_ACQUIRE) != m_Generation)
+    {
+        std::this_thread::yield();
+    }
+}
@@ -0,0 +1,204 @@
+//------------------------------------------------------------------------------
+//! @brief Generator of synthetic stress scenes in the SceneFile format:
+//!        spheres and triangles scattered in a cube in front of the default
+//!        camera, with a constant density however many of them there are.
+//!
+//! Usage: generate_scene.out [options]
+//!   --spheres N      Number of spheres, 100000 by default.
+//!   --triangles N    Number of triangles, 0 by default.
+//!   --materials N    Number of random materials, 16 by default, every
+//!                    eighth is a mirror and every eighth glass.
+//!   --lights N       Number of lights above the cube, 2 by default.
+//!   --seed N         Seed of the generator, the same seed gives the same
+//!                    scene.
+//!   --output FILE    "stress.scene" by default.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file generate_scene.cpp
+//! @date 2021-11-04
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+static const size_t DEFAULT_SPHERES_COUNT   = 100000;
+static const size_t DEFAULT_MATERIALS_COUNT = 16;
+static const size_t DEFAULT_LIGHTS_COUNT    = 2;
+static const char*  DEFAULT_OUTPUT          = "stress.scene";
+
+static const float  CELL_SIZE               = 2;  ///< Side of the cube per primitive.
+static const float  CUBE_DISTANCE           = 10; ///< From the camera to the cube's near face.
+static const float  MAX_SPHERE_RADIUS       = 0.6f;
+static const float  MIN_SPHERE_RADIUS       = 0.2f;
+static const float  TRIANGLE_SIZE           = 1.5f;
+
+struct Options
+{
+    size_t      spheresCount   = DEFAULT_SPHERES_COUNT;
+    size_t      trianglesCount = 0;
+    size_t      materialsCount = DEFAULT_MATERIALS_COUNT;
+    size_t      lightsCount    = DEFAULT_LIGHTS_COUNT;
+    uint32_t    seed           = 1;
+    const char* output         = DEFAULT_OUTPUT;
+};
+
+void printUsage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [--spheres N] [--triangles N] [--materials N] [--lights N] [--seed N]\n"
+                    "       [--output FILE]\n", program);
+}
+
+//------------------------------------------------------------------------------
+//! @return Whether all arguments are valid.
+//------------------------------------------------------------------------------
+bool parseOptions(int argc, char* argv[], Options* options)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const char* arg   = argv[i];
+        const char* value = argv[i + 1];
+
+        if (strcmp(arg, "--spheres") == 0)
+        {
+            options->spheresCount = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--triangles") == 0)
+        {
+            options->trianglesCount = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--materials") == 0)
+        {
+            options->materialsCount = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--lights") == 0)
+        {
+            options->lightsCount = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--seed") == 0)
+        {
+            options->seed = (uint32_t) strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--output") == 0)
+        {
+            options->output = value;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    /* Xorshift's state must be non-zero */
+    return argc % 2 == 1 && options->materialsCount > 0 && options->seed != 0;
+}
+
+//------------------------------------------------------------------------------
+//! @return Uniformly distributed number in [min, max).
+//------------------------------------------------------------------------------
+float getRandom(uint32_t* state, float min = 0, float max = 1)
+{
+    /* Xorshift32 */
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return min + (max - min) * (float) (*state >> 8) / (float) (1 << 24);
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, &options))
+    {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    FILE* file = fopen(options.output, "w");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Couldn't open '%s'\n", options.output);
+        return -1;
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    uint32_t state = options.seed;
+    size_t   count = options.spheresCount + options.trianglesCount;
+    float    side  = CELL_SIZE * cbrtf((float) (count > 0 ? count : 1));
+
+    fprintf(file, "# %zu spheres, %zu triangles, seed %u\n", options.spheresCount, options.trianglesCount,
+            options.seed);
+    fprintf(file, "frustum 0.78 1 %.0f\n", 4 * side + 2 * CUBE_DISTANCE);
+    fprintf(file, "camera 0 0 0 0 0\n");
+    fprintf(file, "ambient 0.2 0.2 0.2\n");
+
+    /* ================ Materials ================ */
+    for (size_t i = 0; i < options.materialsCount; i++)
+    {
+        float r = getRandom(&state);
+        float g = getRandom(&state);
+        float b = getRandom(&state);
+
+        float reflectivity = i % 8 == 1 ? 0.7f : 0;
+        float transparency = i % 8 == 2 ? 0.9f : 0;
+
+        fprintf(file, "material m%zu %.3f %.3f %.3f %.3f %.3f %.3f 0.5 0.5 0.5 %.0f %.1f %.1f %.1f\n", i,
+                0.2f * r, 0.2f * g, 0.2f * b, r, g, b, getRandom(&state, 10, 200), reflectivity, transparency,
+                transparency > 0 ? 1.5f : 1);
+    }
+
+    /* ================ Lights ================ */
+    for (size_t i = 0; i < options.lightsCount; i++)
+    {
+        fprintf(file, "light %.2f %.2f %.2f 0.6 0.6 0.6 0.3 0.3 0.3\n", getRandom(&state, -side, side),
+                side, CUBE_DISTANCE + getRandom(&state, 0, side));
+    }
+
+    /* ================ Primitives ================ */
+    for (size_t i = 0; i < count; i++)
+    {
+        float  x        = getRandom(&state, -side / 2, side / 2);
+        float  y        = getRandom(&state, -side / 2, side / 2);
+        float  z        = getRandom(&state, CUBE_DISTANCE, CUBE_DISTANCE + side);
+        size_t material = (size_t) getRandom(&state, 0, (float) options.materialsCount) % options.materialsCount;
+
+        if (i < options.spheresCount)
+        {
+            fprintf(file, "sphere m%zu %.3f %.3f %.3f %.3f\n", material, x, y, z,
+                    getRandom(&state, MIN_SPHERE_RADIUS, MAX_SPHERE_RADIUS));
+            continue;
+        }
+
+        fprintf(file, "triangle m%zu", material);
+        for (size_t vertex = 0; vertex < 3; vertex++)
+        {
+            fprintf(file, " %.3f %.3f %.3f", x + getRandom(&state, -TRIANGLE_SIZE, TRIANGLE_SIZE) / 2,
+                    y + getRandom(&state, -TRIANGLE_SIZE, TRIANGLE_SIZE) / 2,
+                    z + getRandom(&state, -TRIANGLE_SIZE, TRIANGLE_SIZE) / 2);
+        }
+
+        fprintf(file, "\n");
+    }
+
+    long size = ftell(file);
+
+    if (fclose(file) != 0)
+    {
+        fprintf(stderr, "Couldn't write '%s'\n", options.output);
+        return -1;
+    }
+
+    std::chrono::duration<float, std::milli> writeTime = std::chrono::steady_clock::now() - startTime;
+    printf("%s: %zu spheres, %zu triangles, %zu materials, %zu lights, %.1f MiB in %.1f ms\n", options.output,
+           options.spheresCount, options.trianglesCount, options.materialsCount, options.lightsCount,
+           (float) size / (1 << 20), writeTime.count());
+
+    return 0;
+}
@@ -0,0 +1,572 @@
+//------------------------------------------------------------------------------
+//! @brief Offline renderer of the demo scene: no window, no display, frames
+//!        are written to image files.
+//!
+//! Usage: render_headless.out [options]
+//!   --width W, --height H    Resolution, 1200x800 by default.
+//!   --frames N               Number of frames to render, 1 by default.
+//!   --output PATTERN         printf-like pattern of file names taking the
+//!                            frame's index, the extension (.ppm, .png or
+//!                            .exr) selects the format. "frame_%04zu.png" by
+//!                            default.
+//!   --scene FILE             Scene description to render instead of the demo
+//!                            scene, which is static then, see SceneFile.
+//!   --obj FILE               Wavefront OBJ mesh added to the scene as is, its
+//!                            load time and peak memory are printed.
+//!   --save-cache FILE        Write the scene as compiled and built for the
+//!                            first frame to a binary scene cache.
+//!   --cache FILE             Render a scene cache instead of the demo scene,
+//!                            see --scene. Requires per-pixel mode tracing in
+//!                            world space through the BVH.
+//!   --path FILE              Camera path: a keyframe "x y z pitch yaw" per
+//!                            line, frames are spread evenly along it.
+//!   --mode NAME              Render mode, see getRenderModeName().
+//!   --threads N              Render threads, 0 for one per hardware core.
+//!   --aa NAME                Anti-aliasing, see getAntialiasingModeName().
+//!   --aa-side N              Resampled pixels get N x N rays, 4 by default.
+//!   --depth N                Max depth of reflected and refracted rays, 0
+//!                            disables them, 4 by default.
+//!   --integrator NAME        See getIntegratorName(), "whitted" by default.
+//!   --spp N                  Paths per pixel when path tracing, 64 by default.
+//!   --trace FILE             Chrome trace of the run, requires a build with
+//!                            ENABLE_PROFILING.
+//!   --no-bvh, --no-shadows, --camera-space
+//!
+//! Frame times are printed to stdout, with ENABLE_PROFILING followed by the
+//! frame's counters. A frame is written while the next one is being rendered.
+//!
+//! @author Nikita Mochalov (github.com/tralf-strues)
+//! @file render_headless.cpp
+//! @date 2021-10-26
+//!
+//! @copyright Copyright (c) 2021
+//------------------------------------------------------------------------------
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include "ray_tracer.h"
+#include "render_thread.h"
+#include "demo_scene.h"
+#include "image_io.h"
+#include "obj_loader.h"
+#include "scene_cache.h"
+#include "scene_file.h"
+#include "profiler.h"
+
+static const size_t   DEFAULT_WIDTH             = 1200;
+static const size_t   DEFAULT_HEIGHT            = 800;
+static const char*    DEFAULT_OUTPUT_PATTERN    = "frame_%04zu.png";
+static const size_t   DEFAULT_SAMPLES_PER_PIXEL = 64;
+static const size_t   MAX_FILE_NAME_LENGTH      = 512;
+
+static const float    FOV                       = 0.78f;
+static const float    NEAR                      = 1;
+static const float    FAR                       = 600;
+
+static const Material MESH_MATERIAL             = {{0.2f, 0.2f, 0.2f}, {0.7f, 0.7f, 0.7f}, {0.3f, 0.3f, 0.3f}, 30};
+
+struct CameraKeyframe
+{
+    Vec3<float> pos;
+    float       pitch;
+    float       yaw;
+};
+
+struct Options
+{
+    size_t           width             = DEFAULT_WIDTH;
+    size_t           height            = DEFAULT_HEIGHT;
+    size_t           framesCount       = 1;
+    const char*      outputPattern     = DEFAULT_OUTPUT_PATTERN;
+    const char*      pathFileName      = nullptr;
+    const char*      sceneFileName     = nullptr;
+    const char*      objFileName       = nullptr;
+    const char*      cacheFileName     = nullptr;
+    const char*      saveCacheFileName = nullptr;
+    const char*      traceFileName     = nullptr;
+    RenderMode       renderMode        = RENDER_MODE_PER_PIXEL;
+    size_t           threadsCount      = 0;
+    AntialiasingMode antialiasing      = ANTIALIASING_NONE;
+    size_t           antialiasingSide  = ANTIALIASING_DEFAULT_SIDE;
+    size_t           maxRayDepth       = SECONDARY_DEFAULT_MAX_DEPTH;
+    Integrator       integrator        = INTEGRATOR_WHITTED;
+    size_t           samplesPerPixel   = DEFAULT_SAMPLES_PER_PIXEL;
+    bool             useBvh            = true;
+    bool             enableShadows     = true;
+    bool             traceInWorldSpace = true;
+};
+
+void printUsage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [--width W] [--height H] [--frames N] [--output PATTERN] [--path FILE]\n"
+                    "       [--scene FILE] [--obj FILE] [--save-cache FILE] [--cache FILE] [--mode NAME]\n"
+                    "       [--threads N] [--aa NAME] [--aa-side N] [--depth N] [--integrator NAME] [--spp N]\n"
+                    "       [--trace FILE] [--no-bvh] [--no-shadows] [--camera-space]\n", program);
+}
+
+//------------------------------------------------------------------------------
+//! @return Whether all arguments are valid.
+//------------------------------------------------------------------------------
+bool parseOptions(int argc, char* argv[], Options* options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char* arg      = argv[i];
+        const char* value    = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool        hasValue = true;
+
+        if (strcmp(arg, "--width") == 0 && value != nullptr)
+        {
+            options->width = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--height") == 0 && value != nullptr)
+        {
+            options->height = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--frames") == 0 && value != nullptr)
+        {
+            options->framesCount = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--output") == 0 && value != nullptr)
+        {
+            options->outputPattern = value;
+        }
+        else if (strcmp(arg, "--path") == 0 && value != nullptr)
+        {
+            options->pathFileName = value;
+        }
+        else if (strcmp(arg, "--scene") == 0 && value != nullptr)
+        {
+            options->sceneFileName = value;
+        }
+        else if (strcmp(arg, "--obj") == 0 && value != nullptr)
+        {
+            options->objFileName = value;
+        }
+        else if (strcmp(arg, "--cache") == 0 && value != nullptr)
+        {
+            options->cacheFileName = value;
+        }
+        else if (strcmp(arg, "--save-cache") == 0 && value != nullptr)
+        {
+            options->saveCacheFileName = value;
+        }
+        else if (strcmp(arg, "--trace") == 0 && value != nullptr)
+        {
+            options->traceFileName = value;
+        }
+        else if (strcmp(arg, "--threads") == 0 && value != nullptr)
+        {
+            options->threadsCount = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--aa-side") == 0 && value != nullptr)
+        {
+            options->antialiasingSide = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--depth") == 0 && value != nullptr)
+        {
+            options->maxRayDepth = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--spp") == 0 && value != nullptr)
+        {
+            options->samplesPerPixel = strtoul(value, nullptr, 10);
+        }
+        else if (strcmp(arg, "--integrator") == 0 && value != nullptr)
+        {
+            size_t integrator = 0;
+            while (integrator < INTEGRATORS_COUNT &&
+                   strcmp(value, getIntegratorName((Integrator) integrator)) != 0)
+            {
+                integrator++;
+            }
+
+            if (integrator == INTEGRATORS_COUNT)
+            {
+                return false;
+            }
+
+            options->integrator = (Integrator) integrator;
+        }
+        else if (strcmp(arg, "--aa") == 0 && value != nullptr)
+        {
+            size_t mode = 0;
+            while (mode < ANTIALIASING_MODES_COUNT &&
+                   strcmp(value, getAntialiasingModeName((AntialiasingMode) mode)) != 0)
+            {
+                mode++;
+            }
+
+            if (mode == ANTIALIASING_MODES_COUNT)
+            {
+                return false;
+            }
+
+            options->antialiasing = (AntialiasingMode) mode;
+        }
+        else if (strcmp(arg, "--mode") == 0 && value != nullptr)
+        {
+            size_t mode = 0;
+            while (mode < RENDER_MODES_COUNT && strcmp(value, getRenderModeName((RenderMode) mode)) != 0)
+            {
+                mode++;
+            }
+
+            if (mode == RENDER_MODES_COUNT)
+            {
+                return false;
+            }
+
+            options->renderMode = (RenderMode) mode;
+        }
+        else
+        {
+            hasValue = false;
+
+            if (strcmp(arg, "--no-bvh") == 0)
+            {
+                options->useBvh = false;
+            }
+            else if (strcmp(arg, "--no-shadows") == 0)
+            {
+                options->enableShadows = false;
+            }
+            else if (strcmp(arg, "--camera-space") == 0)
+            {
+                options->traceInWorldSpace = false;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        i += hasValue;
+    }
+
+    /* Caches hold compiled primitives and BVH, which only world space per-pixel rendering uses, and
+       replace the whole scene */
+    bool tracesBvh   = options->renderMode == RENDER_MODE_PER_PIXEL && options->useBvh;
+    bool hasEntities = options->sceneFileName != nullptr || options->objFileName != nullptr;
+
+    if ((options->cacheFileName != nullptr && (!tracesBvh || !options->traceInWorldSpace || hasEntities)) ||
+        (options->saveCacheFileName != nullptr && !tracesBvh))
+    {
+        return false;
+    }
+
+    return options->width > 0 && options->height > 0 && options->framesCount > 0 &&
+           options->antialiasingSide > 0 && options->samplesPerPixel > 0 && getImageFormat(options->outputPattern) != IMAGE_FORMAT_UNKNOWN;
+}
+
+//------------------------------------------------------------------------------
+//! @return Whether the file has been read and contains at least a keyframe.
+//------------------------------------------------------------------------------
+bool loadCameraPath(const char* fileName, std::vector<CameraKeyframe>* path)
+{
+    FILE* file = fopen(fileName, "r");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    char line[256] = {};
+    while (fgets(line, sizeof(line), file) != nullptr)
+    {
+        CameraKeyframe keyframe = {};
+        if (line[0] != '#' && sscanf(line, "%f %f %f %f %f", &keyframe.pos.x, &keyframe.pos.y, &keyframe.pos.z,
+                                     &keyframe.pitch, &keyframe.yaw) == 5)
+        {
+            path->push_back(keyframe);
+        }
+    }
+
+    fclose(file);
+
+    return !path->empty();
+}
+
+//------------------------------------------------------------------------------
+//! @brief Place the camera on the path, linearly interpolating keyframes.
+//!
+//! @param progress From 0 at the first keyframe to 1 at the last one.
+//------------------------------------------------------------------------------
+void moveAlongPath(Camera& camera, const std::vector<CameraKeyframe>& path, float progress)
+{
+    float  position = progress * (float) (path.size() - 1);
+    size_t first    = (size_t) position;
+    size_t second   = first + 1 < path.size() ? first + 1 : first;
+    float  t        = position - (float) first;
+
+    const CameraKeyframe& from = path[first];
+    const CameraKeyframe& to   = path[second];
+
+    camera.setPos(from.pos + t * (to.pos - from.pos));
+    camera.setPitchVertical(from.pitch + t * (to.pitch - from.pitch));
+    camera.setYawHorizontal(from.yaw + t * (to.yaw - from.yaw));
+}
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, &options))
+    {
+        printUsage(argv[0]);
+        return -1;
+    }
+
+    std::vector<CameraKeyframe> path;
+    if (options.pathFileName != nullptr && !loadCameraPath(options.pathFileName, &path))
+    {
+        fprintf(stderr, "Couldn't load camera path '%s'\n", options.pathFileName);
+        return -1;
+    }
+
+    ViewFrustum frustum(FOV, (float) options.width / (float) options.height, NEAR, FAR);
+
+    DemoScene demo(frustum);
+    SceneFile sceneFile(frustum);
+    Camera    cachedCamera(frustum);
+    Scene     cachedScene(cachedCamera);
+
+    bool      fromCache = options.cacheFileName != nullptr;
+    bool      fromFile  = options.sceneFileName != nullptr;
+    Scene&    scene     = fromCache ? cachedScene : fromFile ? sceneFile.scene : demo.scene;
+
+    if (fromFile)
+    {
+        SceneFileStats loadStats = {};
+        if (!sceneFile.load(options.sceneFileName, &loadStats))
+        {
+            fprintf(stderr, "Couldn't load scene '%s' (line %zu)\n", options.sceneFileName,
+                    sceneFile.getErrorLine());
+            return -1;
+        }
+
+        printf("%s: %zu materials, %zu lights, %zu spheres, %zu triangles, %zu meshes (%zu faces), %.1f MiB, "
+               "load %.2f ms\n", options.sceneFileName, loadStats.materials, loadStats.lights, loadStats.spheres,
+               loadStats.triangles, loadStats.meshes, loadStats.faces, (float) loadStats.fileSize / (1 << 20),
+               loadStats.loadTime);
+    }
+
+    std::unique_ptr<Mesh> mesh = nullptr;
+    if (options.objFileName != nullptr)
+    {
+        ObjLoadStats loadStats = {};
+
+        mesh = loadObj(options.objFileName, &MESH_MATERIAL, options.threadsCount, &loadStats);
+        if (mesh == nullptr)
+        {
+            fprintf(stderr, "Couldn't load mesh '%s'\n", options.objFileName);
+            return -1;
+        }
+
+        printf("%s: %zu faces, %zu vertices, %.1f MiB in %zu chunks, load %.2f ms (map %.2f, count %.2f, "
+               "parse %.2f), peak memory %.1f MiB\n", options.objFileName, mesh->faces.getSize(),
+               mesh->vertices.getSize(), (float) loadStats.fileSize / (1 << 20), loadStats.chunksCount,
+               loadStats.totalTime, loadStats.mapTime, loadStats.countTime, loadStats.parseTime,
+               (float) loadStats.peakMemory / (1 << 20));
+
+        scene.addMesh(mesh.get());
+    }
+
+    FrameBuffer        firstFrame(options.width, options.height);
+    FrameBuffer        secondFrame(options.width, options.height);
+    ZBuffer            zbuffer(options.width, options.height);
+    AccumulationBuffer accumulation(options.width, options.height);
+    TileScheduler      scheduler(options.threadsCount);
+
+    RayTracer rayTracer = {&scene, &firstFrame, &zbuffer, &scheduler};
+    rayTracer.renderMode        = options.renderMode;
+    rayTracer.useBvh            = options.useBvh;
+    rayTracer.enableShadows     = options.enableShadows;
+    rayTracer.traceInWorldSpace = options.traceInWorldSpace;
+    rayTracer.antialiasing      = options.antialiasing;
+    rayTracer.antialiasingSide  = options.antialiasingSide;
+    rayTracer.maxRayDepth       = options.maxRayDepth;
+    rayTracer.integrator        = options.integrator;
+
+    SceneCache cache;
+    if (fromCache)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        if (!cache.load(options.cacheFileName, &scene, &rayTracer.primitives, &rayTracer.bvh))
+        {
+            fprintf(stderr, "Couldn't load scene cache '%s'\n", options.cacheFileName);
+            return -1;
+        }
+
+        std::chrono::duration<float, std::milli> loadTime = std::chrono::steady_clock::now() - startTime;
+        printf("%s: %zu primitives, %zu BVH nodes, %.1f MiB, load %.3f ms\n", options.cacheFileName,
+               rayTracer.primitives.getPrimitivesCount(), rayTracer.bvh.getNodesCount(),
+               (float) cache.getFileSize() / (1 << 20), loadTime.count());
+    }
+
+    /* A single accumulated pass holds all of the frame's paths */
+    if (options.integrator == INTEGRATOR_PATH_TRACING)
+    {
+        rayTracer.accumulation        = &accumulation;
+        rayTracer.maxSamplesCount     = 1;
+        rayTracer.pathSamplesPerFrame = options.samplesPerPixel;
+    }
+
+    RenderThread renderThread(rayTracer, firstFrame, secondFrame);
+
+    float totalRenderTime = 0;
+    auto  runStartTime    = std::chrono::steady_clock::now();
+
+    /* Called on the render thread */
+    auto renderFrame = [&rayTracer, &totalRenderTime]()
+    {
+        rayTracer.renderScene();
+        totalRenderTime += rayTracer.lastRenderTime;
+
+        /* After the camera moves the first pass is a low resolution preview */
+        while (rayTracer.isPathTracing() && rayTracer.progressiveState == PROGRESSIVE_MOTION)
+        {
+            rayTracer.renderScene();
+            totalRenderTime += rayTracer.lastRenderTime;
+        }
+    };
+
+    /* A frame is written while the next one is being rendered */
+    for (size_t frameIdx = 0; frameIdx <= options.framesCount; frameIdx++)
+    {
+        bool isRendering = frameIdx < options.framesCount;
+
+        if (isRendering)
+        {
+            if (!path.empty())
+            {
+                float progress = options.framesCount > 1 ? (float) frameIdx / (float) (options.framesCount - 1)
+                                                         : 0;
+                moveAlongPath(scene.camera, path, progress);
+            }
+
+            /* Same as a frame of the interactive app */
+            if (!fromCache && !fromFile)
+            {
+                demo.animate();
+            }
+
+            scene.updateWorldSpaceValues();
+
+            if (rayTracer.needsCameraSpaceValues())
+            {
+                scene.updateCameraSpaceValues();
+            }
+            else
+            {
+                scene.invalidateCameraSpaceValues();
+            }
+
+            zbuffer.reset();
+            renderThread.startFrame(renderFrame);
+        }
+
+        if (frameIdx > 0)
+        {
+            char fileName[MAX_FILE_NAME_LENGTH] = {};
+            snprintf(fileName, sizeof(fileName), options.outputPattern, frameIdx - 1);
+
+            auto startTime = std::chrono::steady_clock::now();
+            if (!writeImage(renderThread.getFrontBuffer(), fileName))
+            {
+                fprintf(stderr, "Couldn't write '%s'\n", fileName);
+                return -1;
+            }
+
+            std::chrono::duration<float, std::milli> writeTime = std::chrono::steady_clock::now() - startTime;
+            printf("frame %zu: write %.2f ms, %s\n", frameIdx - 1, writeTime.count(), fileName);
+        }
+
+        if (!isRendering)
+        {
+            break;
+        }
+
+        /* An unchanged image stays in the front buffer and is written again */
+        renderThread.finishFrame();
+
+        if (frameIdx == 0 && options.saveCacheFileName != nullptr)
+        {
+            if (!writeSceneCache(options.saveCacheFileName, scene, rayTracer.primitives, rayTracer.bvh))
+            {
+                fprintf(stderr, "Couldn't write scene cache '%s'\n", options.saveCacheFileName);
+                return -1;
+            }
+
+            printf("%s: %zu primitives, BVH built in %.2f ms\n", options.saveCacheFileName,
+                   rayTracer.primitives.getPrimitivesCount(), rayTracer.bvh.getBuildTime());
+        }
+
+        printf("frame %zu: render %.2f ms\n", frameIdx, rayTracer.lastRenderTime);
+
+        if (rayTracer.renderMode == RENDER_MODE_DEFERRED)
+        {
+            printf("    deferred: %s\n", rayTracer.gbufferReused ? "lighting pass only" : "geometry and lighting passes");
+        }
+
+        if (rayTracer.isAntialiasing())
+        {
+            const AntialiasingStats& stats = rayTracer.lastAntialiasingStats;
+            printf("    %s aa: %" PRIu64 " of %" PRIu64 " pixels resampled, %" PRIu64 " primary rays, "
+                   "%.2f rays/pixel\n", getAntialiasingModeName(rayTracer.antialiasing), stats.resampledPixels,
+                   stats.pixels, stats.pixels + stats.extraRays, stats.getRaysPerPixel());
+        }
+
+        if (rayTracer.isTracingSecondaryRays())
+        {
+            const SecondaryRayStats& stats = rayTracer.lastSecondaryStats;
+            printf("    depth %zu: %" PRIu64 " secondary rays (%" PRIu64 " reflected, %" PRIu64 " refracted), "
+                   "%" PRIu64 " terminated, %" PRIu64 " dropped\n", rayTracer.maxRayDepth, stats.rays,
+                   stats.reflected, stats.refracted, stats.terminated, stats.dropped);
+        }
+
+        if (rayTracer.isPathTracing())
+        {
+            const PathTracingStats& stats = rayTracer.lastPathStats;
+            printf("    path tracing: %" PRIu64 " samples, %.1f segments/sample, %.3f Msamples/s\n", stats.samples,
+                   stats.samples > 0 ? (float) stats.segments / (float) stats.samples : 0,
+                   stats.getSamplesPerSecond(rayTracer.lastRenderTime) / 1e6f);
+        }
+
+        PROFILE_END_FRAME();
+
+#ifdef ENABLE_PROFILING
+        const ProfileFrame& profile = Profiler::getInstance().getLastFrame();
+        for (size_t counter = 0; counter < PROFILE_COUNTERS_COUNT; counter++)
+        {
+            printf("    %-20s %12" PRIu64 "\n", Profiler::getCounterName((ProfileCounter) counter),
+                   profile.counters[counter]);
+        }
+
+        // Render time is in milliseconds
+        printf("    %-20s %12.2f\n", "Mrays/s", (float) profile.getRaysCount() / rayTracer.lastRenderTime / 1e3f);
+#endif
+    }
+
+    std::chrono::duration<float, std::milli> runTime = std::chrono::steady_clock::now() - runStartTime;
+    printf("%zu frames, %zux%zu, %s: average render %.2f ms, total %.2f ms with writes\n", options.framesCount,
+           options.width, options.height, getRenderModeName(rayTracer.renderMode),
+           totalRenderTime / options.framesCount, runTime.count());
+
+    if (options.traceFileName != nullptr)
+    {
+#ifdef ENABLE_PROFILING
+        if (!PROFILE_WRITE_TRACE(options.traceFileName))
+        {
+            fprintf(stderr, "Couldn't write '%s'\n", options.traceFileName);
+            return -1;
+        }
+#else
+        fprintf(stderr, "Built without ENABLE_PROFILING, no trace is written\n");
+#endif
+    }
+
+    return 0;
+}